@@ -54,7 +54,6 @@
  * - OS repository: https://github.com/6502-retro/6502-retro-os.git
  *
  */
-#include <SDL2/SDL_timer.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -79,6 +78,7 @@
 #include "sdcard.h"
 #include "tms9918a.h"
 #include "tms9918a_render.h"
+#include "rasterclock.h"
 
 #define TRACE_MEM       1
 #define TRACE_IRQ       2
@@ -108,6 +108,7 @@ static struct m6551 *uart;
 
 volatile int emulator_done;
 static uint8_t fast = 0;
+static struct rasterclock *rclock;
 
 static int trace = 0;
 
@@ -365,13 +366,11 @@ static void irqnotify(void)
                 irq6502();
 }
 
-static void take_a_nap(void)
+static unsigned retro_execute(void *unused, unsigned clocks)
 {
-        struct timespec t;
-        t.tv_sec = 0;
-        t.tv_nsec = 15000000;
-        if (nanosleep(&t, NULL))
-                perror("nanosleep");
+        unsigned ran = exec6502(clocks);
+        via_tick(via1, ran);
+        return ran;
 }
 
 static void usage(void)
@@ -388,7 +387,6 @@ int main(int argc, char *argv[])
         char *rompath = "6502retro.rom";
         char *sdpath = NULL;
         unsigned have_tms = 0;
-        static int tstates = 6667;      /* 4mhz / 60 / 10 */
 
         while ((opt = getopt(argc, argv, "d:fr:S:T")) != -1) {
                 switch (opt) {
@@ -461,23 +459,13 @@ int main(int argc, char *argv[])
         hookexternal(irqnotify);
         reset6502();
 
-        /* This is the wrong way to do it but it's easier for the moment. We
-           should track how much real time has occurred and try to keep cycle
-           matched with that. The scheme here works fine except when the host
-           is loaded though */
+        /* 60Hz frames of ten slices at 4MHz */
+        rclock = rasterclock_create(4000000, 6667, 10);
+        rasterclock_fast(rclock, fast);
+        rasterclock_cpu(rclock, retro_execute, NULL);
 
-        uint64_t start, end;
-        float elapsedMS;
         while (!emulator_done) {
-                if (vdp) {
-                        start = SDL_GetPerformanceCounter();
-                }
-
-                int i;
-                for (i = 0; i < 10; i++) {
-                        exec6502(tstates);
-                        via_tick(via1, tstates);
-                }
+                rasterclock_run_frame(rclock);
 
                 // Need to poll the sdl event handler quit offten.
                 if (vdp)
@@ -486,26 +474,11 @@ int main(int argc, char *argv[])
 
                 m6551_timer(uart);
 
-                /* leverage the SDL_GetTicks() to figure out how long to wait
-                 * before rendering the next frame. This gives a nice 60hz
-                 * approximation.
-                */
-                if (!fast)
-                {
-                        if (vdp)
-                        {
-                                tms9918a_rasterize(vdp);
-                                tms9918a_render(vdprend);
-
-                                end = SDL_GetPerformanceCounter();
-                                elapsedMS = (end -start) / (float)SDL_GetPerformanceFrequency() * 1000.0f;
-                                SDL_Delay((16.6667f - elapsedMS)>0 ? 16.6667f - elapsedMS : 0);
-                        }
-                        else
-                        {
-                                take_a_nap();
-                        }
+                if (vdp) {
+                        tms9918a_rasterize(vdp);
+                        tms9918a_render(vdprend);
                 }
+                rasterclock_sync(rclock);
         }
 
         exit(0);
@@ -81,10 +81,21 @@ void via_tick(struct via6522 *via, unsigned int clocks)
 			if (via->trace)
 				fprintf(stderr,"[VIA T2 expire.].\n");
 		}
-		via->t2 -= clocks;
+		else
+			via->t2 -= clocks;
 	}
 }
 
+/* VIA clocks until a timer next interrupts, or 0 if none is counting */
+unsigned int via_next_event(struct via6522 *via)
+{
+	unsigned int n = via->t1;
+
+	if (via->t2 && !(via->acr & 0x20) && (n == 0 || via->t2 < n))
+		n = via->t2;
+	return n;
+}
+
 uint8_t via_read(struct via6522 *via, uint8_t addr)
 {
 	uint8_t r;
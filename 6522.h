@@ -5,6 +5,7 @@
 struct via6522;
 
 extern void via_tick(struct via6522 *via, unsigned int cycles);
+extern unsigned int via_next_event(struct via6522 *via);
 extern void via_write(struct via6522 *via, uint8_t addr, uint8_t val);
 extern uint8_t via_read(struct via6522 *via, uint8_t addr);
 extern struct via6522 *via_create(void);
@@ -3692,42 +3692,76 @@ void m6800_reset(struct m6800 *cpu, int type, int io, int mode)
  *	See Figure 10-1 in the M68HC11 RM
  */
 
-static int prescaler(struct prescaler *p)
+static int prescaler(struct prescaler *p, unsigned n)
 {
-    if (p->count++ >= p->limit) {
-        p->count = 0;
-        return 1;
+    /* The divider produces an output on every limit + 1 inputs. Work out
+       how many outputs n inputs produce rather than stepping it */
+    unsigned first = p->limit + 1 - p->count;
+    unsigned r;
+    if (p->count >= p->limit)
+        first = 1;
+    if (n < first) {
+        p->count += n;
+        return 0;
     }
-    return 0;
+    r = n - first;
+    p->count = r % (p->limit + 1);
+    return 1 + r / (p->limit + 1);
 }
 
-static void m68hc11_e_clock(struct m6800 *cpu)
+/* How many inputs until the prescaler next produces an output */
+static unsigned prescaler_next(struct prescaler *p)
+{
+    if (p->count >= p->limit)
+        return 1;
+    return p->limit + 1 - p->count;
+}
+
+/* Does counting tcnt on by n pass through val */
+static int tcnt_hits(uint16_t tcnt, unsigned n, uint16_t val)
+{
+    return (uint16_t)(val - tcnt - 1) < n;
+}
+
+/*
+ *	Run the timer chain on by n E clocks. Rather than clocking each
+ *	divider we work out how many times each one overflows and only
+ *	do work for the events that actually fire within the interval.
+ */
+static void m68hc11_e_clocks(struct m6800 *cpu, unsigned n)
 {
+    unsigned t;
+
     /* Our emulation timer for an SPI transfer. This counts down E clocks
        between the start and end of an SPI transfer (master emulated only) */
     if (cpu->io.spi_ticks) {
-        if (!--cpu->io.spi_ticks) {
+        if (cpu->io.spi_ticks <= n) {
+            cpu->io.spi_ticks = 0;
             /* An SPI transfer completed: we don't emulate any double
                buffering */
             cpu->io.spdr_r = m68hc11_spi_done(cpu);
             cpu->io.spsr |= SPSR_SPIF;
             if (cpu->io.spcr & SPCR_SPIE)
                 m6800_raise_interrupt(cpu, IRQ_SPI);
-        }
+        } else
+            cpu->io.spi_ticks -= n;
     }
 
     /* 64 cycle lock */
-    if (cpu->io.lock)
-        cpu->io.lock--;
+    if (cpu->io.lock > n)
+        cpu->io.lock -= n;
+    else
+        cpu->io.lock = 0;
 
     /* A 2^13 divider feeds into the RTI and COP */
-    if (prescaler(&cpu->io.e13)) {
+    t = prescaler(&cpu->io.e13, n);
+    if (t) {
         /* 1 2 4 or 8 fom RTR[1:0] */
-        if (prescaler(&cpu->io.rti)) {
+        if (prescaler(&cpu->io.rti, t)) {
             cpu->io.tflg2 |= TF2_RTIF;
         }
         /* Always by 4 then by 1/4/16/64 ccording to CR[1:0] */
-        if (prescaler(&cpu->io.cop)) {
+        if (prescaler(&cpu->io.cop, t)) {
             if (!(cpu->io.config_latch & CFG_NOCOP)) {
                 /* We took a COP reset */
                 /* TODO */
@@ -3736,24 +3770,25 @@ static void m68hc11_e_clock(struct m6800 *cpu)
     }
 
     /* The tcnt scaler affects all of the ic/oc side */
-    if (!prescaler(&cpu->io.pr_tcnt))
+    t = prescaler(&cpu->io.pr_tcnt, n);
+    if (t == 0)
         return;
-    /* Free running counter */
-    cpu->io.tcnt++;
-    if (cpu->io.tcnt == 0)
+    /* Free running counter. Set the flags for anything we passed */
+    if (t >= 0x10000 - cpu->io.tcnt)
         cpu->io.tflg2 |= TF2_TOF;
     /* Comparators. Set the relevant flags, we will compute their effects
        later on */
-    if (cpu->io.tcnt == cpu->io.toc1)
+    if (tcnt_hits(cpu->io.tcnt, t, cpu->io.toc1))
         cpu->io.tflg1 |= TF1_OC1F;
-    if (cpu->io.tcnt == cpu->io.toc2)
+    if (tcnt_hits(cpu->io.tcnt, t, cpu->io.toc2))
         cpu->io.tflg1 |= TF1_OC2F;
-    if (cpu->io.tcnt == cpu->io.toc3)
+    if (tcnt_hits(cpu->io.tcnt, t, cpu->io.toc3))
         cpu->io.tflg1 |= TF1_OC3F;
-    if (cpu->io.tcnt == cpu->io.toc4)
+    if (tcnt_hits(cpu->io.tcnt, t, cpu->io.toc4))
         cpu->io.tflg1 |= TF1_OC4F;
-    if (cpu->io.tcnt == cpu->io.toc5)
+    if (tcnt_hits(cpu->io.tcnt, t, cpu->io.toc5))
         cpu->io.tflg1 |= TF1_OC5F;
+    cpu->io.tcnt += t;
     /* We don't model input counts on IC1-IC3 but if we did it would go
        here */
 
@@ -3817,7 +3852,7 @@ static void m68hc11_e_clock(struct m6800 *cpu)
  
 int m68hc11_execute(struct m6800 *cpu)
 {
-    int cycles, i;
+    int cycles;
 
     /* Interrupts ? */
     cycles = m68hc11_pre_execute(cpu);
@@ -3833,12 +3868,50 @@ int m68hc11_execute(struct m6800 *cpu)
         return cycles;
 
     /* Run the timers for these E cycles */
-    for (i = 0; i < cycles; i++)
-        m68hc11_e_clock(cpu);
-        
+    m68hc11_e_clocks(cpu, cycles);
     return cycles;
 }
 
+/*
+ *	Report how many E clocks until the timer chain next sets a flag or
+ *	completes an SPI transfer. Lets the caller size the work it does
+ *	between timer events.
+ */
+unsigned m68hc11_timer_next(struct m6800 *cpu)
+{
+    unsigned next, t, d;
+    struct prescaler *p = &cpu->io.pr_tcnt;
+
+    /* Next free running counter overflow or compare match */
+    d = 0x10000 - cpu->io.tcnt;
+    t = (uint16_t)(cpu->io.toc1 - cpu->io.tcnt - 1) + 1;
+    if (t < d)
+        d = t;
+    t = (uint16_t)(cpu->io.toc2 - cpu->io.tcnt - 1) + 1;
+    if (t < d)
+        d = t;
+    t = (uint16_t)(cpu->io.toc3 - cpu->io.tcnt - 1) + 1;
+    if (t < d)
+        d = t;
+    t = (uint16_t)(cpu->io.toc4 - cpu->io.tcnt - 1) + 1;
+    if (t < d)
+        d = t;
+    t = (uint16_t)(cpu->io.toc5 - cpu->io.tcnt - 1) + 1;
+    if (t < d)
+        d = t;
+    next = prescaler_next(p) + (d - 1) * (p->limit + 1);
+
+    /* Next real time interrupt */
+    t = prescaler_next(&cpu->io.e13) +
+        (prescaler_next(&cpu->io.rti) - 1) * (cpu->io.e13.limit + 1);
+    if (t < next)
+        next = t;
+
+    if (cpu->io.spi_ticks && cpu->io.spi_ticks < next)
+        next = cpu->io.spi_ticks;
+    return next;
+}
+
 void m68hc11e_reset(struct m6800 *cpu, int type, uint8_t cfg, const uint8_t *rom, uint8_t *eerom)
 {
     memset(cpu, 0, sizeof(*cpu));
@@ -295,6 +295,7 @@ extern void m68hc11a_reset(struct m6800 *cpu, int variant, uint8_t cfg, const ui
 extern void m68hc11e_reset(struct m6800 *cpu, int variant, uint8_t cfg, const uint8_t *rom, uint8_t *eerom);
 extern int m6800_execute(struct m6800 *cpu);
 extern int m68hc11_execute(struct m6800 *cpu);
+extern unsigned m68hc11_timer_next(struct m6800 *cpu);
 extern void m6800_clear_interrupt(struct m6800 *cpu, int irq);
 extern void m6800_raise_interrupt(struct m6800 *cpu, int irq);
 extern void m6800_rx_byte(struct m6800 *cpu, uint8_t byte);
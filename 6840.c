@@ -81,30 +81,54 @@ static void m6840_calc_outputs(struct m6840 *ptm)
     }
 }
 
-/* Count a timer in 16 or 8x8 bit mode */
-static void m6840_timer_count(struct ptm_timer *p, int restart)
+/*
+ *	Count a timer on by n clocks in 16 or 8x8 bit mode. Rather than
+ *	stepping the counter we work out where it ends up and how many
+ *	times it timed out on the way.
+ */
+static void m6840_timer_count(struct ptm_timer *p, int restart, unsigned n)
 {
+    unsigned t, r, period;
+
+    if (n == 0)
+        return;
     if (!(p->ctrl & 0x04)) {
-        /* The check occurs before the count down */
-        if (p->timer == 0) {
-            p->event = 1;
-            p->output ^= 1;
-            if (p->event && restart)
-                p->timer = p->wlatch;
+        /* The counter times out on the clock after it reaches zero and
+           then reloads (or wraps in one shot mode) */
+        t = p->timer;
+        if (n <= t) {
+            p->timer -= n;
+            return;
         }
-        p->timer--;
+        period = restart ? p->wlatch + 1 : 0x10000;
+        r = n - t - 1;
+        p->event = 1;
+        if ((1 + r / period) & 1)
+            p->output ^= 1;
+        p->timer = period - 1 - r % period;
     } else {
-        if ((p->timer & 0xFF) != 0)
-            p->timer--;
-        else {
-            p->timer &= 0xFF00;
-            if (p->timer) {
-                p->timer -= 0x0100;
-                p->timer |= p->wlatch & 0xFF;
-            } else {
-                p->event = 1;
-                if (restart)
-                    p->timer = p->wlatch;
+        /* Dual 8bit. The low byte counts down and reloads from the latch
+           each time it borrows from the high byte */
+        unsigned l = p->timer & 0xFF;
+        unsigned lp = (p->wlatch & 0xFF) + 1;
+
+        /* Clocks until we reach zero */
+        t = (p->timer >> 8) * lp + l;
+        if (n <= l)
+            p->timer -= n;
+        else if (n <= t) {
+            /* Once we have borrowed the low byte is within the latch
+               range so the count maps back onto the two bytes */
+            t -= n;
+            p->timer = ((t / lp) << 8) | (t % lp);
+        } else {
+            p->event = 1;
+            if (!restart)
+                p->timer = 0;
+            else {
+                period = ((p->wlatch >> 8) + 1) * lp;
+                t = period - 1 - (n - t - 1) % period;
+                p->timer = ((t / lp) << 8) | (t % lp);
             }
         }
         if ((p->timer & 0xFF00) == 0)
@@ -112,33 +136,31 @@ static void m6840_timer_count(struct ptm_timer *p, int restart)
         else
             p->output = 0;
     }
-    if (p->event && restart)
-        p->timer = p->wlatch;
 }
 
 /*
  *	Handle a timer being clocked by something
  */
-static void m6840_timer_clock(struct ptm_timer *p)
+static void m6840_timer_clock(struct ptm_timer *p, unsigned n)
 {
     switch((p->ctrl >> 3) & 7) {
         case 0:	/* Continuous */
-            m6840_timer_count(p, 1);
+            m6840_timer_count(p, 1, n);
             break;
         case 1:	/* Frequency compare (not supported yet) */
             break;
         case 2:	/* Continuous - not reset by write to latches */
-            m6840_timer_count(p, 1);
+            m6840_timer_count(p, 1, n);
             break;
         case 3:	/* Pulse width compare (not supported yet) */
             break;
         case 4:	/* One shot, reset by write to latches */
-            m6840_timer_count(p, 0);
+            m6840_timer_count(p, 0, n);
             break;
         case 5:	/* Frequency comparison (not supported yet) */
             break;
         case 6:	/* One shot, reset by gate/reset only */
-            m6840_timer_count(p, 0);
+            m6840_timer_count(p, 0, n);
         case 7:	/* Pulse width compare (not supported yet) */
             break;
     }
@@ -150,30 +172,61 @@ static void m6840_event_tick(struct ptm_timer *p)
     /* Internal clock ? */
     if (p->ctrl & 2)
         return;
-    m6840_timer_clock(p);
+    m6840_timer_clock(p, 1);
 }
 
-/* Perform internal tick on a timer */
-static void m6840_timer_tick(struct ptm_timer *p)
+/* Perform internal ticks on a timer */
+static void m6840_timer_tick(struct ptm_timer *p, unsigned n)
 {
     /* External clock */
     if (!(p->ctrl & 2))
         return;
-    m6840_timer_clock(p);
+    m6840_timer_clock(p, n);
 }
 
 /* Runs for every E clock */
 void m6840_tick(struct m6840 *ptm, int tstates)
 {
-    while(tstates--) {
-        m6840_timer_tick(&ptm->timer[1]);
-        m6840_timer_tick(&ptm->timer[2]);
-        m6840_timer_tick(&ptm->timer[3]);
-    }
+    m6840_timer_tick(&ptm->timer[1], tstates);
+    m6840_timer_tick(&ptm->timer[2], tstates);
+    m6840_timer_tick(&ptm->timer[3], tstates);
     m6840_calc_irq(ptm);
     m6840_calc_outputs(ptm);
 }
 
+/* How many internal clocks until a timer times out, 0 if never */
+static unsigned m6840_timer_next(struct ptm_timer *p)
+{
+    unsigned lp;
+    if (!(p->ctrl & 2))
+        return 0;
+    if ((p->ctrl >> 3) & 1)
+        return 0;
+    if (!(p->ctrl & 0x04))
+        return p->timer + 1;
+    lp = (p->wlatch & 0xFF) + 1;
+    return (p->timer >> 8) * lp + (p->timer & 0xFF) + 1;
+}
+
+/*
+ *	Report the number of E clocks until one of the internally clocked
+ *	timers next times out, or 0 if none will. Externally clocked
+ *	timers are not included as we don't know when the clocks arrive.
+ */
+unsigned m6840_next_event(struct m6840 *ptm)
+{
+    unsigned next = 0;
+    unsigned t;
+    int i;
+
+    for (i = 1; i <= 3; i++) {
+        t = m6840_timer_next(&ptm->timer[i]);
+        if (t && (next == 0 || t < next))
+            next = t;
+    }
+    return next;
+}
+
 /* External clock event */
 void m6840_external_clock(struct m6840 *ptm, int timer)
 {
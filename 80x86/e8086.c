@@ -92,6 +92,7 @@ void e86_init (e8086_t *c)
 	}
 
 	c->clock = 0;
+	c->until = 0;
 	c->opcnt = 0;
 	c->delay = 0;
 }
@@ -539,3 +540,49 @@ void e86_clock (e8086_t *c, unsigned n)
 	c->delay -= n;
 	c->clock += n;
 }
+
+unsigned long e86_run_until (e8086_t *c, unsigned long until)
+{
+	unsigned long start, n;
+
+	start = c->clock;
+	c->until = until;
+
+	while ((long) (c->until - c->clock) > 0) {
+		if (c->delay == 0) {
+			/* Nothing can wake a halted CPU before the end */
+			if ((c->state & E86_STATE_HALT) && !(c->irq && e86_get_if (c))) {
+				c->clock = c->until;
+				break;
+			}
+
+			e86_execute (c);
+
+			if (c->delay == 0) {
+				c->delay = 1;
+			}
+		}
+
+		n = c->until - c->clock;
+
+		if ((long) n <= 0) {
+			break;
+		}
+
+		if (n > c->delay) {
+			n = c->delay;
+		}
+
+		c->delay -= n;
+		c->clock += n;
+	}
+
+	return (c->clock - start);
+}
+
+void e86_stop_at (e8086_t *c, unsigned long clk)
+{
+	if ((long) (clk - c->until) < 0) {
+		c->until = clk;
+	}
+}
@@ -167,6 +167,7 @@ typedef struct e8086_t {
 
 	unsigned long    delay;
 	unsigned long    clock;
+	unsigned long    until;
 	unsigned         opcnt;
 } e8086_t;
 
@@ -415,6 +416,12 @@ void e86_execute (e8086_t *c);
 
 void e86_clock (e8086_t *c, unsigned n);
 
+/* Run until the clock reaches until. A device handler may pull the end
+   in with e86_stop_at when the guest reprograms it. Returns the number
+   of clocks run */
+unsigned long e86_run_until (e8086_t *c, unsigned long until);
+void e86_stop_at (e8086_t *c, unsigned long clk);
+
 
 void e86_push (e8086_t *c, unsigned short val);
 unsigned short e86_pop (e8086_t *c);
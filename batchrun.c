@@ -0,0 +1,618 @@
+/*
+ *	Run a batch of emulated machines in one process from a manifest,
+ *	feeding each one scripted console input and checking for expected
+ *	output.
+ *
+ *	Each job is a real rc2014 machine built from the same options the
+ *	rc2014 command takes, run through the emulator core in rc2014.c.
+ *	Every machine has its own state and its console is a virtual serial
+ *	device fed from the script, so no terminal state is touched. -f is
+ *	always given as there is nobody to keep real time for.
+ *
+ *	The jobs are spread over -j worker threads (default one per host
+ *	core). A worker runs the job at the head of its queue for a quantum
+ *	of emulated time and puts it back on the tail. A worker whose queue
+ *	runs dry steals jobs from the tails of the others, so the load
+ *	evens out as jobs finish.
+ *
+ *	Manifest format, one directive per line, # for comments
+ *
+ *	job name		start a new job
+ *	config options...	rc2014 command line options for the machine
+ *	poke addr bytes...	hex bytes to store from physical addr
+ *	timeout secs		give up after this much emulated time (default 60)
+ *	expect text		wait for text to appear in the output
+ *	send text		type text at the console
+ *	pause ms		let this much emulated time pass
+ *	exit			wait for the machine to stop
+ *	end			end of the job
+ *
+ *	Text may use \r \n \t \e \\ and \xHH escapes. Time is counted in
+ *	emulated 50Hz frames, so results do not depend on how busy the host
+ *	is. Console input is offered a byte per emulated millisecond or so,
+ *	which any sane polling loop keeps up with.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "serialdevice.h"
+#include "rc2014.h"
+
+#define MAX_OUTPUT	65536
+#define TAIL_SHOW	512
+#define MAX_ARGS	64
+
+#define FRAMES		50		/* Per emulated second */
+#define QUANTUM		5		/* Frames before giving up the worker */
+#define POLL_GAP	200		/* Console polls between input bytes */
+
+#define STEP_EXPECT	0
+#define STEP_SEND	1
+#define STEP_PAUSE	2
+#define STEP_EXIT	3
+
+struct step {
+	struct step *next;
+	unsigned type;
+	unsigned len;
+	unsigned ms;
+	char text[];
+};
+
+struct poke {
+	struct poke *next;
+	uint32_t addr;
+	uint8_t val;
+};
+
+#define JOB_RUNNING	0
+#define JOB_DONE	1
+
+struct job {
+	struct job *next;
+	unsigned id;
+	char *name;
+	unsigned timeout;
+	struct step *script;
+	struct step **tail;
+	char *argv[MAX_ARGS + 1];
+	int argc;
+	struct poke *pokes;
+
+	/* The machine */
+	struct rc2014 *m;
+	struct serial_device con;
+	unsigned stopped;
+
+	/* Console traffic */
+	char *input;
+	unsigned inlen;
+	unsigned inpos;
+	unsigned polls;
+	char *output;
+	unsigned outlen;
+	unsigned matched;
+
+	unsigned state;
+	struct step *step;
+	uint64_t frames;
+	uint64_t deadline;
+	uint64_t resume;
+	double start;
+	double elapsed;
+	const char *fail;
+};
+
+struct worker {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	struct job **queue;
+	unsigned head;
+	unsigned tail;
+};
+
+static struct job *jobs;
+static struct job **jobs_tail = &jobs;
+static unsigned njobs;
+static unsigned verbose;
+
+static struct worker *workers;
+static unsigned nworkers;
+static unsigned jobs_left;
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *xmalloc(size_t n)
+{
+	void *p = malloc(n);
+	if (p == NULL) {
+		fprintf(stderr, "batchrun: out of memory.\n");
+		exit(1);
+	}
+	return p;
+}
+
+static char *xstrdup(const char *s)
+{
+	return strcpy(xmalloc(strlen(s) + 1), s);
+}
+
+static unsigned unescape(char *d, const char *s)
+{
+	char *p = d;
+	unsigned n;
+
+	while (*s) {
+		if (*s != '\\' || s[1] == 0) {
+			*p++ = *s++;
+			continue;
+		}
+		s++;
+		switch (*s++) {
+		case 'r':
+			*p++ = '\r';
+			break;
+		case 'n':
+			*p++ = '\n';
+			break;
+		case 't':
+			*p++ = '\t';
+			break;
+		case 'e':
+			*p++ = 0x1B;
+			break;
+		case 'x':
+			n = 0;
+			while (*s && strchr("0123456789abcdefABCDEF", *s)) {
+				n = n * 16 + (*s <= '9' ? *s - '0' : (*s | 0x20) - 'a' + 10);
+				s++;
+			}
+			*p++ = n;
+			break;
+		default:
+			*p++ = s[-1];
+			break;
+		}
+	}
+	return p - d;
+}
+
+static void add_step(struct job *j, unsigned type, const char *text, unsigned ms)
+{
+	struct step *s = xmalloc(sizeof(struct step) + strlen(text) + 1);
+	s->next = NULL;
+	s->type = type;
+	s->len = unescape(s->text, text);
+	s->ms = ms;
+	*j->tail = s;
+	j->tail = &s->next;
+}
+
+static void load_manifest(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char buf[1024];
+	struct job *j = NULL;
+	struct poke *k, **kp = NULL;
+	unsigned line = 0;
+	unsigned long addr;
+	char *p, *arg, *e;
+
+	if (f == NULL) {
+		perror(path);
+		exit(1);
+	}
+	while (fgets(buf, sizeof(buf), f)) {
+		line++;
+		p = strchr(buf, '\n');
+		if (p)
+			*p = 0;
+		p = buf;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == 0 || *p == '#')
+			continue;
+		arg = strchr(p, ' ');
+		if (arg)
+			*arg++ = 0;
+		else
+			arg = p + strlen(p);
+
+		if (strcmp(p, "job") == 0) {
+			if (j)
+				goto bad;
+			j = xmalloc(sizeof(struct job));
+			memset(j, 0, sizeof(struct job));
+			j->name = xstrdup(arg);
+			j->timeout = 60;
+			j->tail = &j->script;
+			j->argv[0] = "rc2014";
+			j->argv[1] = "-f";
+			j->argc = 2;
+			kp = &j->pokes;
+			continue;
+		}
+		if (j == NULL)
+			goto bad;
+		if (strcmp(p, "config") == 0) {
+			for (p = strtok(arg, " \t"); p; p = strtok(NULL, " \t")) {
+				if (j->argc == MAX_ARGS)
+					goto bad;
+				j->argv[j->argc++] = xstrdup(p);
+			}
+		} else if (strcmp(p, "poke") == 0) {
+			addr = strtoul(arg, &e, 16);
+			if (e == arg)
+				goto bad;
+			for (p = e;; addr++) {
+				k = xmalloc(sizeof(struct poke));
+				k->val = strtoul(p, &e, 16);
+				if (e == p) {
+					free(k);
+					break;
+				}
+				k->addr = addr;
+				k->next = NULL;
+				*kp = k;
+				kp = &k->next;
+				p = e;
+			}
+		} else if (strcmp(p, "timeout") == 0)
+			j->timeout = atoi(arg);
+		else if (strcmp(p, "expect") == 0)
+			add_step(j, STEP_EXPECT, arg, 0);
+		else if (strcmp(p, "send") == 0)
+			add_step(j, STEP_SEND, arg, 0);
+		else if (strcmp(p, "pause") == 0)
+			add_step(j, STEP_PAUSE, "", atoi(arg));
+		else if (strcmp(p, "exit") == 0)
+			add_step(j, STEP_EXIT, "", 0);
+		else if (strcmp(p, "end") == 0) {
+			j->id = njobs++;
+			*jobs_tail = j;
+			jobs_tail = &j->next;
+			j = NULL;
+		} else
+			goto bad;
+	}
+	fclose(f);
+	if (j == NULL)
+		return;
+	line++;
+bad:
+	fprintf(stderr, "%s:%u: syntax error.\n", path, line);
+	exit(1);
+}
+
+/* Keep only the recent output once the buffer fills. An expect step never
+   needs anything before the last match so that much can always go */
+static void job_trim(struct job *j)
+{
+	unsigned n = j->outlen / 2;
+	if (n > j->matched)
+		n = j->matched;
+	if (n == 0)
+		n = j->outlen / 2;
+	memmove(j->output, j->output + n, j->outlen - n);
+	j->outlen -= n;
+	j->matched = j->matched > n ? j->matched - n : 0;
+}
+
+/*
+ *	The console is fed from the script and collects the output. The
+ *	UARTs take a byte as soon as one is offered, so space them out
+ *	rather than overrun a guest that is still busy with the last.
+ */
+
+static unsigned con_ready(struct serial_device *dev)
+{
+	struct job *j = dev->private;
+	if (j->inpos < j->inlen && ++j->polls >= POLL_GAP)
+		return 3;
+	return 2;
+}
+
+static uint8_t con_get(struct serial_device *dev)
+{
+	struct job *j = dev->private;
+	if (j->inpos == j->inlen)
+		return 0xFF;
+	j->polls = 0;
+	return j->input[j->inpos++];
+}
+
+static void con_put(struct serial_device *dev, uint8_t c)
+{
+	struct job *j = dev->private;
+	if (j->outlen == MAX_OUTPUT)
+		job_trim(j);
+	j->output[j->outlen++] = c;
+}
+
+static void con_send(struct job *j, const char *text, unsigned len)
+{
+	if (j->inpos == j->inlen)
+		j->inpos = j->inlen = 0;
+	j->input = realloc(j->input, j->inlen + len);
+	if (j->input == NULL) {
+		fprintf(stderr, "batchrun: out of memory.\n");
+		exit(1);
+	}
+	memcpy(j->input + j->inlen, text, len);
+	j->inlen += len;
+}
+
+/* Machines are built up front so bad options stop the run before it starts */
+static void job_setup(struct job *j)
+{
+	struct poke *k;
+
+	j->con.name = j->name;
+	j->con.private = j;
+	j->con.ready = con_ready;
+	j->con.get = con_get;
+	j->con.put = con_put;
+	j->output = xmalloc(MAX_OUTPUT);
+
+	j->m = rc2014_create(j->argc, j->argv, &j->con);
+	while ((k = j->pokes) != NULL) {
+		rc2014_poke(j->m, k->addr, k->val);
+		j->pokes = k->next;
+		free(k);
+	}
+
+	j->step = j->script;
+	j->deadline = (uint64_t)j->timeout * FRAMES;
+	j->state = JOB_RUNNING;
+}
+
+static void job_finish(struct job *j, const char *fail)
+{
+	j->state = JOB_DONE;
+	j->fail = fail;
+	j->elapsed = now() - j->start;
+
+	pthread_mutex_lock(&done_lock);
+	if (fail == NULL) {
+		printf("%s: PASS (%.2fs emulated, %.2fs)\n", j->name,
+			(double)j->frames / FRAMES, j->elapsed);
+		if (verbose == 0)
+			goto done;
+	} else
+		printf("%s: FAIL, %s (%.2fs emulated, %.2fs)\n", j->name, fail,
+			(double)j->frames / FRAMES, j->elapsed);
+	if (j->outlen) {
+		unsigned n = j->outlen > TAIL_SHOW ? TAIL_SHOW : j->outlen;
+		printf("---- %s output ----\n", j->name);
+		fwrite(j->output + j->outlen - n, n, 1, stdout);
+		printf("\n----\n");
+	}
+done:
+	fflush(stdout);
+	jobs_left--;
+	pthread_mutex_unlock(&done_lock);
+
+	rc2014_free(j->m);
+	free(j->input);
+	free(j->output);
+	j->m = NULL;
+	j->input = NULL;
+	j->output = NULL;
+}
+
+static char *find(char *h, unsigned hlen, const char *n, unsigned nlen)
+{
+	char *e = h + hlen;
+	if (nlen == 0)
+		return h;
+	while (h + nlen <= e) {
+		h = memchr(h, *n, e - h - nlen + 1);
+		if (h == NULL)
+			return NULL;
+		if (memcmp(h, n, nlen) == 0)
+			return h;
+		h++;
+	}
+	return NULL;
+}
+
+/* Run the script as far as we can without more emulated time passing */
+static void job_step(struct job *j)
+{
+	struct step *s;
+	char *p;
+
+	while ((s = j->step) != NULL) {
+		switch (s->type) {
+		case STEP_EXPECT:
+			p = find(j->output + j->matched, j->outlen - j->matched, s->text, s->len);
+			if (p == NULL) {
+				if (j->stopped)
+					job_finish(j, "machine stopped");
+				return;
+			}
+			j->matched = p - j->output + s->len;
+			break;
+		case STEP_SEND:
+			con_send(j, s->text, s->len);
+			break;
+		case STEP_PAUSE:
+			if (j->resume == 0)
+				j->resume = j->frames + (s->ms * FRAMES + 999) / 1000;
+			if (j->frames < j->resume)
+				return;
+			j->resume = 0;
+			break;
+		case STEP_EXIT:
+			if (!j->stopped)
+				return;
+			break;
+		}
+		j->step = s->next;
+	}
+	job_finish(j, NULL);
+}
+
+/* Run a job for one quantum of emulated time */
+static void job_quantum(struct job *j)
+{
+	uint64_t end = j->frames + QUANTUM;
+
+	if (j->start == 0)
+		j->start = now();
+	while (j->state == JOB_RUNNING) {
+		if (j->frames >= j->deadline) {
+			job_finish(j, "timed out");
+			break;
+		}
+		if (j->frames >= end)
+			break;
+		if (!j->stopped && !rc2014_run_frame(j->m))
+			j->stopped = 1;
+		j->frames++;
+		job_step(j);
+	}
+}
+
+/*
+ *	Each worker has a ring of jobs sized to hold them all. It takes
+ *	from the head of its own and puts jobs back on the tail, thieves
+ *	take from the tail.
+ */
+
+static void queue_put(struct worker *w, struct job *j)
+{
+	pthread_mutex_lock(&w->lock);
+	w->queue[w->tail] = j;
+	w->tail = (w->tail + 1) % (njobs + 1);
+	pthread_mutex_unlock(&w->lock);
+}
+
+static struct job *queue_take(struct worker *w, int steal)
+{
+	struct job *j = NULL;
+
+	pthread_mutex_lock(&w->lock);
+	if (w->head != w->tail) {
+		if (steal) {
+			w->tail = (w->tail + njobs) % (njobs + 1);
+			j = w->queue[w->tail];
+		} else {
+			j = w->queue[w->head];
+			w->head = (w->head + 1) % (njobs + 1);
+		}
+	}
+	pthread_mutex_unlock(&w->lock);
+	return j;
+}
+
+static void *worker_run(void *arg)
+{
+	struct worker *w = arg;
+	unsigned self = w - workers;
+	struct timespec ts;
+	struct job *j;
+	unsigned i, left;
+
+	for (;;) {
+		j = queue_take(w, 0);
+		for (i = 1; j == NULL && i < nworkers; i++)
+			j = queue_take(&workers[(self + i) % nworkers], 1);
+		if (j == NULL) {
+			pthread_mutex_lock(&done_lock);
+			left = jobs_left;
+			pthread_mutex_unlock(&done_lock);
+			if (left == 0)
+				return NULL;
+			/* The rest are all in the middle of a quantum */
+			ts.tv_sec = 0;
+			ts.tv_nsec = 1000000;
+			nanosleep(&ts, NULL);
+			continue;
+		}
+		job_quantum(j);
+		if (j->state == JOB_RUNNING)
+			queue_put(w, j);
+	}
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "batchrun: [-j jobs] [-v] manifest...\n");
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	struct job *j;
+	unsigned fails = 0;
+	unsigned i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "j:v")) != -1) {
+		switch (opt) {
+		case 'j':
+			nworkers = atoi(optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind == argc)
+		usage();
+	while (optind < argc)
+		load_manifest(argv[optind++]);
+	if (njobs == 0) {
+		printf("0 jobs.\n");
+		return 0;
+	}
+
+	if (nworkers == 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		nworkers = n > 0 ? n : 1;
+	}
+	if (nworkers > njobs)
+		nworkers = njobs;
+
+	workers = xmalloc(nworkers * sizeof(struct worker));
+	for (i = 0; i < nworkers; i++) {
+		pthread_mutex_init(&workers[i].lock, NULL);
+		workers[i].queue = xmalloc((njobs + 1) * sizeof(struct job *));
+		workers[i].head = 0;
+		workers[i].tail = 0;
+	}
+	for (j = jobs; j; j = j->next) {
+		job_setup(j);
+		queue_put(&workers[j->id % nworkers], j);
+	}
+	jobs_left = njobs;
+
+	for (i = 0; i < nworkers; i++) {
+		if (pthread_create(&workers[i].thread, NULL, worker_run, &workers[i])) {
+			fprintf(stderr, "batchrun: cannot create worker.\n");
+			exit(1);
+		}
+	}
+	for (i = 0; i < nworkers; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	for (j = jobs; j; j = j->next)
+		if (j->fail)
+			fails++;
+	printf("%u jobs, %u passed, %u failed.\n", njobs, njobs - fails, fails);
+	return fails ? 1 : 0;
+}
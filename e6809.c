@@ -28,69 +28,21 @@ enum {
 	IRQ_CWAI	= 2
 };
 
-/* index registers */
-
-static unsigned reg_x;
-static unsigned reg_y;
-
-/* user stack pointer */
-
-static unsigned reg_u;
-
-/* hardware stack pointer */
-
-static unsigned reg_s;
-
-/* program counter */
-
-static unsigned reg_pc;
-
-/* accumulators */
-
-static unsigned reg_a;
-static unsigned reg_b;
-
-/* direct page register */
-
-static unsigned reg_dp;
-
-/* condition codes */
-
-static unsigned reg_cc;
-
-/* flag to see if interrupts should be handled (sync/cwai). */
-
-static unsigned irq_status;
-
-static unsigned *rptr_xyus[4] = {
-	&reg_x,
-	&reg_y,
-	&reg_u,
-	&reg_s
-};
-
-static unsigned trace_cpu;
-
-/* user defined read and write functions */
-
-unsigned char e6809_read8(unsigned address);
-void e6809_write8(unsigned address, unsigned char data);
-
 /* obtain a particular condition code. returns 0 or 1. */
 
-static einline unsigned get_cc (unsigned flag)
+static einline unsigned get_cc (struct e6809 *cpu, unsigned flag)
 {
-	return (reg_cc / flag) & 1;
+	return (cpu->cc / flag) & 1;
 }
 
 /* set a particular condition code to either 0 or 1.
  * value parameter must be either 0 or 1.
  */
 
-static einline void set_cc (unsigned flag, unsigned value)
+static einline void set_cc (struct e6809 *cpu, unsigned flag, unsigned value)
 {
-	reg_cc &= ~flag;
-	reg_cc |= value * flag;
+	cpu->cc &= ~flag;
+	cpu->cc |= value * flag;
 }
 
 /* test carry */
@@ -160,103 +112,134 @@ static einline unsigned test_v (unsigned i0, unsigned i1, unsigned r)
 	return flag;
 }
 
-static einline unsigned get_reg_d (void)
+static einline unsigned get_reg_d (struct e6809 *cpu)
 {
-	return (reg_a << 8) | (reg_b & 0xff);
+	return (cpu->a << 8) | (cpu->b & 0xff);
 }
 
-static einline void set_reg_d (unsigned value)
+static einline void set_reg_d (struct e6809 *cpu, unsigned value)
 {
-	reg_a = value >> 8;
-	reg_b = value;
+	cpu->a = value >> 8;
+	cpu->b = value;
 }
 
 /* read a byte ... the returned value has the lower 8-bits set to the byte
  * while the upper bits are all zero.
  */
 
-static einline unsigned read8 (unsigned address)
+static einline unsigned read8 (struct e6809 *cpu, unsigned address)
 {
-	return e6809_read8(address & 0xffff);
+	uint8_t *page;
+
+	address &= 0xffff;
+	page = cpu->rmap[address >> 8];
+	if (page)
+		return page[address & 0xff];
+	cpu->io = 1;
+	return e6809_read8(cpu, address);
 }
 
 /* write a byte ... only the lower 8-bits of the unsigned data
  * is written. the upper bits are ignored.
  */
 
-static einline void write8 (unsigned address, unsigned data)
+static einline void write8 (struct e6809 *cpu, unsigned address, unsigned data)
 {
-	e6809_write8(address & 0xffff, (unsigned char) data);
+	uint8_t *page;
+
+	address &= 0xffff;
+	page = cpu->wmap[address >> 8];
+	if (page) {
+		page[address & 0xff] = data;
+		return;
+	}
+	cpu->io = 1;
+	e6809_write8(cpu, address, (unsigned char) data);
 }
 
-static einline unsigned read16 (unsigned address)
+static einline unsigned read16 (struct e6809 *cpu, unsigned address)
 {
 	unsigned datahi, datalo;
+	uint8_t *page = cpu->rmap[(address >> 8) & 0xff];
+
+	/* both bytes in the same mapped page */
+	if (page && (address & 0xff) != 0xff) {
+		address &= 0xff;
+		return (page[address] << 8) | page[address + 1];
+	}
 
-	datahi = read8 (address);
-	datalo = read8 (address + 1);
+	datahi = read8 (cpu, address);
+	datalo = read8 (cpu, address + 1);
 
 	return (datahi << 8) | datalo;
 }
 
-static einline void write16 (unsigned address, unsigned data)
+static einline void write16 (struct e6809 *cpu, unsigned address, unsigned data)
 {
-	write8 (address, data >> 8);
-	write8 (address + 1, data);
+	uint8_t *page = cpu->wmap[(address >> 8) & 0xff];
+
+	if (page && (address & 0xff) != 0xff) {
+		address &= 0xff;
+		page[address] = data >> 8;
+		page[address + 1] = data;
+		return;
+	}
+	write8 (cpu, address, data >> 8);
+	write8 (cpu, address + 1, data);
 }
 
-static einline void push8 (unsigned *sp, unsigned data)
+static einline void push8 (struct e6809 *cpu, unsigned *sp, unsigned data)
 {
 	(*sp)--;
-	write8 (*sp, data);
+	write8 (cpu, *sp, data);
 }
 
-static einline unsigned pull8 (unsigned *sp)
+static einline unsigned pull8 (struct e6809 *cpu, unsigned *sp)
 {
 	unsigned data;
 
-	data = read8 (*sp);
+	data = read8 (cpu, *sp);
 	(*sp)++;
 
 	return data;
 }
 
-static einline void push16 (unsigned *sp, unsigned data)
+static einline void push16 (struct e6809 *cpu, unsigned *sp, unsigned data)
 {
-	push8 (sp, data);
-	push8 (sp, data >> 8);
+	push8 (cpu, sp, data);
+	push8 (cpu, sp, data >> 8);
 }
 
-static einline unsigned pull16 (unsigned *sp)
+static einline unsigned pull16 (struct e6809 *cpu, unsigned *sp)
 {
 	unsigned datahi, datalo;
 
-	datahi = pull8 (sp);
-	datalo = pull8 (sp);
+	datahi = pull8 (cpu, sp);
+	datalo = pull8 (cpu, sp);
 
 	return (datahi << 8) | datalo;
 }
 
 /* read a byte from the address pointed to by the pc */
 
-static einline unsigned pc_read8 (void)
+static einline unsigned pc_read8 (struct e6809 *cpu)
 {
 	unsigned data;
 
-	data = read8 (reg_pc);
-	reg_pc++;
+	data = read8 (cpu, cpu->pc);
+	cpu->pc++;
 
 	return data;
 }
 
 /* read a word from the address pointed to by the pc */
 
-static einline unsigned pc_read16 (void)
+static einline unsigned pc_read16 (struct e6809 *cpu)
 {
 	unsigned data;
 
-	data = read16 (reg_pc);
-	reg_pc += 2;
+	data = read16 (cpu, cpu->pc);
+	cpu->pc += 2;
 
 	return data;
 }
@@ -273,29 +256,29 @@ static einline unsigned sign_extend (unsigned data)
  * instruction itself.
  */
 
-static einline unsigned ea_direct (void)
+static einline unsigned ea_direct (struct e6809 *cpu)
 {
-	return (reg_dp << 8) | pc_read8 ();
+	return (cpu->dp << 8) | pc_read8 (cpu);
 }
 
 /* extended addressing, address is obtained from 2 bytes following
  * the instruction.
  */
 
-static einline unsigned ea_extended (void)
+static einline unsigned ea_extended (struct e6809 *cpu)
 {
-	return pc_read16 ();
+	return pc_read16 (cpu);
 }
 
 /* indexed addressing */
 
-static einline unsigned ea_indexed (unsigned *cycles)
+static einline unsigned ea_indexed (struct e6809 *cpu, unsigned *cycles)
 {
 	unsigned r, op, ea;
 
 	/* post byte */
 
-	op = pc_read8 ();
+	op = pc_read8 (cpu);
 
 	r = (op >> 5) & 3;
 
@@ -318,7 +301,7 @@ static einline unsigned ea_indexed (unsigned *cycles)
 	case 0x6c: case 0x6d: case 0x6e: case 0x6f:
 		/* R, +[0, 15] */
 
-		ea = *rptr_xyus[r] + (op & 0xf);
+		ea = *cpu->rptr_xyus[r] + (op & 0xf);
 		(*cycles)++;
 		break;
 	case 0x10: case 0x11: case 0x12: case 0x13:
@@ -339,7 +322,7 @@ static einline unsigned ea_indexed (unsigned *cycles)
 	case 0x7c: case 0x7d: case 0x7e: case 0x7f:
 		/* R, +[-16, -1] */
 
-		ea = *rptr_xyus[r] + (op & 0xf) - 0x10;
+		ea = *cpu->rptr_xyus[r] + (op & 0xf) - 0x10;
 		(*cycles)++;
 		break;
 	case 0x80: case 0x81:
@@ -348,8 +331,8 @@ static einline unsigned ea_indexed (unsigned *cycles)
 	case 0xe0: case 0xe1:
 		/* ,R+ / ,R++ */
 
-		ea = *rptr_xyus[r];
-		*rptr_xyus[r] += 1 + (op & 1);
+		ea = *cpu->rptr_xyus[r];
+		*cpu->rptr_xyus[r] += 1 + (op & 1);
 		*cycles += 2 + (op & 1);
 		break;
 	case 0x90: case 0x91:
@@ -358,8 +341,8 @@ static einline unsigned ea_indexed (unsigned *cycles)
 	case 0xf0: case 0xf1:
 		/* [,R+] ??? / [,R++] */
 
-		ea = read16 (*rptr_xyus[r]);
-		*rptr_xyus[r] += 1 + (op & 1);
+		ea = read16 (cpu, *cpu->rptr_xyus[r]);
+		*cpu->rptr_xyus[r] += 1 + (op & 1);
 		*cycles += 5 + (op & 1);
 		break;
 	case 0x82: case 0x83:
@@ -369,8 +352,8 @@ static einline unsigned ea_indexed (unsigned *cycles)
 
 		/* ,-R / ,--R */
 
-		*rptr_xyus[r] -= 1 + (op & 1);
-		ea = *rptr_xyus[r];
+		*cpu->rptr_xyus[r] -= 1 + (op & 1);
+		ea = *cpu->rptr_xyus[r];
 		*cycles += 2 + (op & 1);
 		break;
 	case 0x92: case 0x93:
@@ -379,133 +362,133 @@ static einline unsigned ea_indexed (unsigned *cycles)
 	case 0xf2: case 0xf3:
 		/* [,-R] ??? / [,--R] */
 
-		*rptr_xyus[r] -= 1 + (op & 1);
-		ea = read16 (*rptr_xyus[r]);
+		*cpu->rptr_xyus[r] -= 1 + (op & 1);
+		ea = read16 (cpu, *cpu->rptr_xyus[r]);
 		*cycles += 5 + (op & 1);
 		break;
 	case 0x84: case 0xa4:
 	case 0xc4: case 0xe4:
 		/* ,R */
 
-		ea = *rptr_xyus[r];
+		ea = *cpu->rptr_xyus[r];
 		break;
 	case 0x94: case 0xb4:
 	case 0xd4: case 0xf4:
 		/* [,R] */
 
-		ea = read16 (*rptr_xyus[r]);
+		ea = read16 (cpu, *cpu->rptr_xyus[r]);
 		*cycles += 3;
 		break;
 	case 0x85: case 0xa5:
 	case 0xc5: case 0xe5:
 		/* B,R */
 
-		ea = *rptr_xyus[r] + sign_extend (reg_b);
+		ea = *cpu->rptr_xyus[r] + sign_extend (cpu->b);
 		*cycles += 1;
 		break;
 	case 0x95: case 0xb5:
 	case 0xd5: case 0xf5:
 		/* [B,R] */
 
-		ea = read16 (*rptr_xyus[r] + sign_extend (reg_b));
+		ea = read16 (cpu, *cpu->rptr_xyus[r] + sign_extend (cpu->b));
 		*cycles += 4;
 		break;
 	case 0x86: case 0xa6:
 	case 0xc6: case 0xe6:
 		/* A,R */
 
-		ea = *rptr_xyus[r] + sign_extend (reg_a);
+		ea = *cpu->rptr_xyus[r] + sign_extend (cpu->a);
 		*cycles += 1;
 		break;
 	case 0x96: case 0xb6:
 	case 0xd6: case 0xf6:
 		/* [A,R] */
 
-		ea = read16 (*rptr_xyus[r] + sign_extend (reg_a));
+		ea = read16 (cpu, *cpu->rptr_xyus[r] + sign_extend (cpu->a));
 		*cycles += 4;
 		break;
 	case 0x88: case 0xa8:
 	case 0xc8: case 0xe8:
 		/* byte,R */
 
-		ea = *rptr_xyus[r] + sign_extend (pc_read8 ());
+		ea = *cpu->rptr_xyus[r] + sign_extend (pc_read8 (cpu));
 		*cycles += 1;
 		break;
 	case 0x98: case 0xb8:
 	case 0xd8: case 0xf8:
 		/* [byte,R] */
 
-		ea = read16 (*rptr_xyus[r] + sign_extend (pc_read8 ()));
+		ea = read16 (cpu, *cpu->rptr_xyus[r] + sign_extend (pc_read8 (cpu)));
 		*cycles += 4;
 		break;
 	case 0x89: case 0xa9:
 	case 0xc9: case 0xe9:
 		/* word,R */
 
-		ea = *rptr_xyus[r] + pc_read16 ();
+		ea = *cpu->rptr_xyus[r] + pc_read16 (cpu);
 		*cycles += 4;
 		break;
 	case 0x99: case 0xb9:
 	case 0xd9: case 0xf9:
 		/* [word,R] */
 
-		ea = read16 (*rptr_xyus[r] + pc_read16 ());
+		ea = read16 (cpu, *cpu->rptr_xyus[r] + pc_read16 (cpu));
 		*cycles += 7;
 		break;
 	case 0x8b: case 0xab:
 	case 0xcb: case 0xeb:
 		/* D,R */
 
-		ea = *rptr_xyus[r] + get_reg_d ();
+		ea = *cpu->rptr_xyus[r] + get_reg_d (cpu);
 		*cycles += 4;
 		break;
 	case 0x9b: case 0xbb:
 	case 0xdb: case 0xfb:
 		/* [D,R] */
 
-		ea = read16 (*rptr_xyus[r] + get_reg_d ());
+		ea = read16 (cpu, *cpu->rptr_xyus[r] + get_reg_d (cpu));
 		*cycles += 7;
 		break;
 	case 0x8c: case 0xac:
 	case 0xcc: case 0xec:
 		/* byte, PC */
 
-		r = sign_extend (pc_read8 ());
-		ea = reg_pc + r;
+		r = sign_extend (pc_read8 (cpu));
+		ea = cpu->pc + r;
 		*cycles += 1;
 		break;
 	case 0x9c: case 0xbc:
 	case 0xdc: case 0xfc:
 		/* [byte, PC] */
 
-		r = sign_extend (pc_read8 ());
-		ea = read16 (reg_pc + r);
+		r = sign_extend (pc_read8 (cpu));
+		ea = read16 (cpu, cpu->pc + r);
 		*cycles += 4;
 		break;
 	case 0x8d: case 0xad:
 	case 0xcd: case 0xed:
 		/* word, PC */
 
-		r = pc_read16 ();
-		ea = reg_pc + r;
+		r = pc_read16 (cpu);
+		ea = cpu->pc + r;
 		*cycles += 5;
 		break;
 	case 0x9d: case 0xbd:
 	case 0xdd: case 0xfd:
 		/* [word, PC] */
 
-		r = pc_read16 ();
-		ea = read16 (reg_pc + r);
+		r = pc_read16 (cpu);
+		ea = read16 (cpu, cpu->pc + r);
 		*cycles += 8;
 		break;
 	case 0x9f:
 		/* [address] */
 
-		ea = read16 (pc_read16 ());
+		ea = read16 (cpu, pc_read16 (cpu));
 		*cycles += 5;
 		break;
 	default:
-		fprintf (stderr, "undefined post-byte at %04X\n", reg_pc);
+		fprintf (stderr, "undefined post-byte at %04X\n", cpu->pc);
 		ea = 0;
 		break;
 	}
@@ -517,7 +500,7 @@ static einline unsigned ea_indexed (unsigned *cycles)
  * essentially (0 - data).
  */
 
-static einline unsigned inst_neg (unsigned data)
+static einline unsigned inst_neg (struct e6809 *cpu, unsigned data)
 {
 	unsigned i0, i1, r;
 
@@ -525,27 +508,27 @@ static einline unsigned inst_neg (unsigned data)
 	i1 = ~data;
 	r = i0 + i1 + 1;
 
-	set_cc (FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_V, test_v (i0, i1, r));
-	set_cc (FLAG_C, test_c (i0, i1, r, 1));
+	set_cc (cpu, FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_V, test_v (i0, i1, r));
+	set_cc (cpu, FLAG_C, test_c (i0, i1, r, 1));
 
 	return r;
 }
 
 /* instruction: com */
 
-static einline unsigned inst_com (unsigned data)
+static einline unsigned inst_com (struct e6809 *cpu, unsigned data)
 {
 	unsigned r;
 
 	r = ~data;
 
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_V, 0);
-	set_cc (FLAG_C, 1);
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_V, 0);
+	set_cc (cpu, FLAG_C, 1);
 
 	return r;
 }
@@ -554,15 +537,15 @@ static einline unsigned inst_com (unsigned data)
  * cannot be faked as an add or substract.
  */
 
-static einline unsigned inst_lsr (unsigned data)
+static einline unsigned inst_lsr (struct e6809 *cpu, unsigned data)
 {
 	unsigned r;
 
 	r = (data >> 1) & 0x7f;
 
-	set_cc (FLAG_N, 0);
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_C, data & 1);
+	set_cc (cpu, FLAG_N, 0);
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_C, data & 1);
 
 	return r;
 }
@@ -571,16 +554,16 @@ static einline unsigned inst_lsr (unsigned data)
  * cannot be faked as an add or substract.
  */
 
-static einline unsigned inst_ror (unsigned data)
+static einline unsigned inst_ror (struct e6809 *cpu, unsigned data)
 {
 	unsigned r, c;
 
-	c = get_cc (FLAG_C);
+	c = get_cc (cpu, FLAG_C);
 	r = ((data >> 1) & 0x7f) | (c << 7);
 
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_C, data & 1);
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_C, data & 1);
 
 	return r;
 }
@@ -589,15 +572,15 @@ static einline unsigned inst_ror (unsigned data)
  * cannot be faked as an add or substract.
  */
 
-static einline unsigned inst_asr (unsigned data)
+static einline unsigned inst_asr (struct e6809 *cpu, unsigned data)
 {
 	unsigned r;
 
 	r = ((data >> 1) & 0x7f) | (data & 0x80);
 
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_C, data & 1);
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_C, data & 1);
 
 	return r;
 }
@@ -606,7 +589,7 @@ static einline unsigned inst_asr (unsigned data)
  * essentially (data + data). simple addition.
  */
 
-static einline unsigned inst_asl (unsigned data)
+static einline unsigned inst_asl (struct e6809 *cpu, unsigned data)
 {
 	unsigned i0, i1, r;
 
@@ -614,11 +597,11 @@ static einline unsigned inst_asl (unsigned data)
 	i1 = data;
 	r = i0 + i1;
 
-	set_cc (FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_V, test_v (i0, i1, r));
-	set_cc (FLAG_C, test_c (i0, i1, r, 0));
+	set_cc (cpu, FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_V, test_v (i0, i1, r));
+	set_cc (cpu, FLAG_C, test_c (i0, i1, r, 0));
 
 	return r;
 }
@@ -627,19 +610,19 @@ static einline unsigned inst_asl (unsigned data)
  * essentially (data + data + carry). addition with carry.
  */
 
-static einline unsigned inst_rol (unsigned data)
+static einline unsigned inst_rol (struct e6809 *cpu, unsigned data)
 {
 	unsigned i0, i1, c, r;
 
 	i0 = data;
 	i1 = data;
-	c = get_cc (FLAG_C);
+	c = get_cc (cpu, FLAG_C);
 	r = i0 + i1 + c;
 
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_V, test_v (i0, i1, r));
-	set_cc (FLAG_C, test_c (i0, i1, r, 0));
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_V, test_v (i0, i1, r));
+	set_cc (cpu, FLAG_C, test_c (i0, i1, r, 0));
 
 	return r;
 }
@@ -648,7 +631,7 @@ static einline unsigned inst_rol (unsigned data)
  * essentially (data - 1).
  */
 
-static einline unsigned inst_dec (unsigned data)
+static einline unsigned inst_dec (struct e6809 *cpu, unsigned data)
 {
 	unsigned i0, i1, r;
 
@@ -656,9 +639,9 @@ static einline unsigned inst_dec (unsigned data)
 	i1 = 0xff;
 	r = i0 + i1;
 
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_V, test_v (i0, i1, r));
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_V, test_v (i0, i1, r));
 
 	return r;
 }
@@ -667,7 +650,7 @@ static einline unsigned inst_dec (unsigned data)
  * essentially (data + 1).
  */
 
-static einline unsigned inst_inc (unsigned data)
+static einline unsigned inst_inc (struct e6809 *cpu, unsigned data)
 {
 	unsigned i0, i1, r;
 
@@ -675,42 +658,42 @@ static einline unsigned inst_inc (unsigned data)
 	i1 = 1;
 	r = i0 + i1;
 
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_V, test_v (i0, i1, r));
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_V, test_v (i0, i1, r));
 
 	return r;
 }
 
 /* instruction: tst */
 
-static einline void inst_tst8 (unsigned data)
+static einline void inst_tst8 (struct e6809 *cpu, unsigned data)
 {
-	set_cc (FLAG_N, test_n (data));
-	set_cc (FLAG_Z, test_z8 (data));
-	set_cc (FLAG_V, 0);
+	set_cc (cpu, FLAG_N, test_n (data));
+	set_cc (cpu, FLAG_Z, test_z8 (data));
+	set_cc (cpu, FLAG_V, 0);
 }
 
-static einline void inst_tst16 (unsigned data)
+static einline void inst_tst16 (struct e6809 *cpu, unsigned data)
 {
-	set_cc (FLAG_N, test_n (data >> 8));
-	set_cc (FLAG_Z, test_z16 (data));
-	set_cc (FLAG_V, 0);
+	set_cc (cpu, FLAG_N, test_n (data >> 8));
+	set_cc (cpu, FLAG_Z, test_z16 (data));
+	set_cc (cpu, FLAG_V, 0);
 }
 
 /* instruction: clr */
 
-static einline void inst_clr (void)
+static einline void inst_clr (struct e6809 *cpu)
 {
-	set_cc (FLAG_N, 0);
-	set_cc (FLAG_Z, 1);
-	set_cc (FLAG_V, 0);
-	set_cc (FLAG_C, 0);
+	set_cc (cpu, FLAG_N, 0);
+	set_cc (cpu, FLAG_Z, 1);
+	set_cc (cpu, FLAG_V, 0);
+	set_cc (cpu, FLAG_C, 0);
 }
 
 /* instruction: suba/subb */
 
-static einline unsigned inst_sub8 (unsigned data0, unsigned data1)
+static einline unsigned inst_sub8 (struct e6809 *cpu, unsigned data0, unsigned data1)
 {
 	unsigned i0, i1, r;
 
@@ -718,11 +701,11 @@ static einline unsigned inst_sub8 (unsigned data0, unsigned data1)
 	i1 = ~data1;
 	r = i0 + i1 + 1;
 
-	set_cc (FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_V, test_v (i0, i1, r));
-	set_cc (FLAG_C, test_c (i0, i1, r, 1));
+	set_cc (cpu, FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_V, test_v (i0, i1, r));
+	set_cc (cpu, FLAG_C, test_c (i0, i1, r, 1));
 
 	return r;
 }
@@ -731,20 +714,20 @@ static einline unsigned inst_sub8 (unsigned data0, unsigned data1)
  * only 8-bit version, 16-bit version not needed.
  */
 
-static einline unsigned inst_sbc (unsigned data0, unsigned data1)
+static einline unsigned inst_sbc (struct e6809 *cpu, unsigned data0, unsigned data1)
 {
 	unsigned i0, i1, c, r;
 
 	i0 = data0;
 	i1 = ~data1;
-	c = 1 - get_cc (FLAG_C);
+	c = 1 - get_cc (cpu, FLAG_C);
 	r = i0 + i1 + c;
 
-	set_cc (FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_V, test_v (i0, i1, r));
-	set_cc (FLAG_C, test_c (i0, i1, r, 1));
+	set_cc (cpu, FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_V, test_v (i0, i1, r));
+	set_cc (cpu, FLAG_C, test_c (i0, i1, r, 1));
 
 	return r;
 }
@@ -753,13 +736,13 @@ static einline unsigned inst_sbc (unsigned data0, unsigned data1)
  * only 8-bit version, 16-bit version not needed.
  */
 
-static einline unsigned inst_and (unsigned data0, unsigned data1)
+static einline unsigned inst_and (struct e6809 *cpu, unsigned data0, unsigned data1)
 {
 	unsigned r;
 
 	r = data0 & data1;
 
-	inst_tst8 (r);
+	inst_tst8 (cpu, r);
 
 	return r;
 }
@@ -768,13 +751,13 @@ static einline unsigned inst_and (unsigned data0, unsigned data1)
  * only 8-bit version, 16-bit version not needed.
  */
 
-static einline unsigned inst_eor (unsigned data0, unsigned data1)
+static einline unsigned inst_eor (struct e6809 *cpu, unsigned data0, unsigned data1)
 {
 	unsigned r;
 
 	r = data0 ^ data1;
 
-	inst_tst8 (r);
+	inst_tst8 (cpu, r);
 
 	return r;
 }
@@ -783,20 +766,20 @@ static einline unsigned inst_eor (unsigned data0, unsigned data1)
  * only 8-bit version, 16-bit version not needed.
  */
 
-static einline unsigned inst_adc (unsigned data0, unsigned data1)
+static einline unsigned inst_adc (struct e6809 *cpu, unsigned data0, unsigned data1)
 {
 	unsigned i0, i1, c, r;
 
 	i0 = data0;
 	i1 = data1;
-	c = get_cc (FLAG_C);
+	c = get_cc (cpu, FLAG_C);
 	r = i0 + i1 + c;
 
-	set_cc (FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_V, test_v (i0, i1, r));
-	set_cc (FLAG_C, test_c (i0, i1, r, 0));
+	set_cc (cpu, FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_V, test_v (i0, i1, r));
+	set_cc (cpu, FLAG_C, test_c (i0, i1, r, 0));
 
 	return r;
 }
@@ -805,20 +788,20 @@ static einline unsigned inst_adc (unsigned data0, unsigned data1)
  * only 8-bit version, 16-bit version not needed.
  */
 
-static einline unsigned inst_or (unsigned data0, unsigned data1)
+static einline unsigned inst_or (struct e6809 *cpu, unsigned data0, unsigned data1)
 {
 	unsigned r;
 
 	r = data0 | data1;
 
-	inst_tst8 (r);
+	inst_tst8 (cpu, r);
 
 	return r;
 }
 
 /* instruction: adda/addb */
 
-static einline unsigned inst_add8 (unsigned data0, unsigned data1)
+static einline unsigned inst_add8 (struct e6809 *cpu, unsigned data0, unsigned data1)
 {
 	unsigned i0, i1, r;
 
@@ -826,18 +809,18 @@ static einline unsigned inst_add8 (unsigned data0, unsigned data1)
 	i1 = data1;
 	r = i0 + i1;
 
-	set_cc (FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
-	set_cc (FLAG_N, test_n (r));
-	set_cc (FLAG_Z, test_z8 (r));
-	set_cc (FLAG_V, test_v (i0, i1, r));
-	set_cc (FLAG_C, test_c (i0, i1, r, 0));
+	set_cc (cpu, FLAG_H, test_c (i0 << 4, i1 << 4, r << 4, 0));
+	set_cc (cpu, FLAG_N, test_n (r));
+	set_cc (cpu, FLAG_Z, test_z8 (r));
+	set_cc (cpu, FLAG_V, test_v (i0, i1, r));
+	set_cc (cpu, FLAG_C, test_c (i0, i1, r, 0));
 
 	return r;
 }
 
 /* instruction: addd */
 
-static einline unsigned inst_add16 (unsigned data0, unsigned data1)
+static einline unsigned inst_add16 (struct e6809 *cpu, unsigned data0, unsigned data1)
 {
 	unsigned i0, i1, r;
 
@@ -845,17 +828,17 @@ static einline unsigned inst_add16 (unsigned data0, unsigned data1)
 	i1 = data1;
 	r = i0 + i1;
 
-	set_cc (FLAG_N, test_n (r >> 8));
-	set_cc (FLAG_Z, test_z16 (r));
-	set_cc (FLAG_V, test_v (i0 >> 8, i1 >> 8, r >> 8));
-	set_cc (FLAG_C, test_c (i0 >> 8, i1 >> 8, r >> 8, 0));
+	set_cc (cpu, FLAG_N, test_n (r >> 8));
+	set_cc (cpu, FLAG_Z, test_z16 (r));
+	set_cc (cpu, FLAG_V, test_v (i0 >> 8, i1 >> 8, r >> 8));
+	set_cc (cpu, FLAG_C, test_c (i0 >> 8, i1 >> 8, r >> 8, 0));
 
 	return r;
 }
 
 /* instruction: subd */
 
-static einline unsigned inst_sub16 (unsigned data0, unsigned data1)
+static einline unsigned inst_sub16 (struct e6809 *cpu, unsigned data0, unsigned data1)
 {
 	unsigned i0, i1, r;
 
@@ -863,174 +846,174 @@ static einline unsigned inst_sub16 (unsigned data0, unsigned data1)
 	i1 = ~data1;
 	r = i0 + i1 + 1;
 
-	set_cc (FLAG_N, test_n (r >> 8));
-	set_cc (FLAG_Z, test_z16 (r));
-	set_cc (FLAG_V, test_v (i0 >> 8, i1 >> 8, r >> 8));
-	set_cc (FLAG_C, test_c (i0 >> 8, i1 >> 8, r >> 8, 1));
+	set_cc (cpu, FLAG_N, test_n (r >> 8));
+	set_cc (cpu, FLAG_Z, test_z16 (r));
+	set_cc (cpu, FLAG_V, test_v (i0 >> 8, i1 >> 8, r >> 8));
+	set_cc (cpu, FLAG_C, test_c (i0 >> 8, i1 >> 8, r >> 8, 1));
 
 	return r;
 }
 
 /* instruction: 8-bit offset branch */
 
-static einline void inst_bra8 (unsigned test, unsigned op, unsigned *cycles)
+static einline void inst_bra8 (struct e6809 *cpu, unsigned test, unsigned op, unsigned *cycles)
 {
 	unsigned offset, mask;
 
-	offset = pc_read8 ();
+	offset = pc_read8 (cpu);
 
 	/* trying to avoid an if statement */
 
 	mask = (test ^ (op & 1)) - 1; /* 0xffff when taken, 0 when not taken */
-	reg_pc += sign_extend (offset) & mask;
+	cpu->pc += sign_extend (offset) & mask;
 
 	*cycles += 3;
 }
 
 /* instruction: 16-bit offset branch */
 
-static einline void inst_bra16 (unsigned test, unsigned op, unsigned *cycles)
+static einline void inst_bra16 (struct e6809 *cpu, unsigned test, unsigned op, unsigned *cycles)
 {
 	unsigned offset, mask;
 
-	offset = pc_read16 ();
+	offset = pc_read16 (cpu);
 
 	/* trying to avoid an if statement */
 
 	mask = (test ^ (op & 1)) - 1; /* 0xffff when taken, 0 when not taken */
-	reg_pc += offset & mask;
+	cpu->pc += offset & mask;
 
 	*cycles += 5 - mask;
 }
 
 /* instruction: pshs/pshu */
 
-static einline void inst_psh (unsigned op, unsigned *sp,
+static einline void inst_psh (struct e6809 *cpu, unsigned op, unsigned *sp,
 					   unsigned data, unsigned *cycles)
 {
 	if (op & 0x80) {
-		push16 (sp, reg_pc);
+		push16 (cpu, sp, cpu->pc);
 		*cycles += 2;
 	}
 
 	if (op & 0x40) {
 		/* either s or u */
-		push16 (sp, data);
+		push16 (cpu, sp, data);
 		*cycles += 2;
 	}
 
 	if (op & 0x20) {
-		push16 (sp, reg_y);
+		push16 (cpu, sp, cpu->y);
 		*cycles += 2;
 	}
 
 	if (op & 0x10) {
-		push16 (sp, reg_x);
+		push16 (cpu, sp, cpu->x);
 		*cycles += 2;
 	}
 
 	if (op & 0x08) {
-		push8 (sp, reg_dp);
+		push8 (cpu, sp, cpu->dp);
 		*cycles += 1;
 	}
 
 	if (op & 0x04) {
-		push8 (sp, reg_b);
+		push8 (cpu, sp, cpu->b);
 		*cycles += 1;
 	}
 
 	if (op & 0x02) {
-		push8 (sp, reg_a);
+		push8 (cpu, sp, cpu->a);
 		*cycles += 1;
 	}
 
 	if (op & 0x01) {
-		push8 (sp, reg_cc);
+		push8 (cpu, sp, cpu->cc);
 		*cycles += 1;
 	}
 }
 
 /* instruction: puls/pulu */
 
-static einline void inst_pul (unsigned op, unsigned *sp, unsigned *osp,
+static einline void inst_pul (struct e6809 *cpu, unsigned op, unsigned *sp, unsigned *osp,
 					   unsigned *cycles)
 {
 	if (op & 0x01) {
-		reg_cc = pull8 (sp);
+		cpu->cc = pull8 (cpu, sp);
 		*cycles += 1;
 	}
 
 	if (op & 0x02) {
-		reg_a = pull8 (sp);
+		cpu->a = pull8 (cpu, sp);
 		*cycles += 1;
 	}
 
 	if (op & 0x04) {
-		reg_b = pull8 (sp);
+		cpu->b = pull8 (cpu, sp);
 		*cycles += 1;
 	}
 
 	if (op & 0x08) {
-		reg_dp = pull8 (sp);
+		cpu->dp = pull8 (cpu, sp);
 		*cycles += 1;
 	}
 
 	if (op & 0x10) {
-		reg_x = pull16 (sp);
+		cpu->x = pull16 (cpu, sp);
 		*cycles += 2;
 	}
 
 	if (op & 0x20) {
-		reg_y = pull16 (sp);
+		cpu->y = pull16 (cpu, sp);
 		*cycles += 2;
 	}
 
 	if (op & 0x40) {
 		/* either s or u */
-		*osp = pull16 (sp);
+		*osp = pull16 (cpu, sp);
 		*cycles += 2;
 	}
 
 	if (op & 0x80) {
-		reg_pc = pull16 (sp);
+		cpu->pc = pull16 (cpu, sp);
 		*cycles += 2;
 	}
 }
 
-static einline unsigned exgtfr_read (unsigned reg)
+static einline unsigned exgtfr_read (struct e6809 *cpu, unsigned reg)
 {
 	unsigned data;
 
 	switch (reg) {
 	case 0x0:
-		data = get_reg_d ();
+		data = get_reg_d (cpu);
 		break;
 	case 0x1:
-		data = reg_x;
+		data = cpu->x;
 		break;
 	case 0x2:
-		data = reg_y;
+		data = cpu->y;
 		break;
 	case 0x3:
-		data = reg_u;
+		data = cpu->u;
 		break;
 	case 0x4:
-		data = reg_s;
+		data = cpu->s;
 		break;
 	case 0x5:
-		data = reg_pc;
+		data = cpu->pc;
 		break;
 	case 0x8:
-		data = 0xff00 | reg_a;
+		data = 0xff00 | cpu->a;
 		break;
 	case 0x9:
-		data = 0xff00 | reg_b;
+		data = 0xff00 | cpu->b;
 		break;
 	case 0xa:
-		data = 0xff00 | reg_cc;
+		data = 0xff00 | cpu->cc;
 		break;
 	case 0xb:
-		data = 0xff00 | reg_dp;
+		data = 0xff00 | cpu->dp;
 		break;
 	default:
 		data = 0xffff;
@@ -1041,38 +1024,38 @@ static einline unsigned exgtfr_read (unsigned reg)
 	return data;
 }
 
-static einline void exgtfr_write (unsigned reg, unsigned data)
+static einline void exgtfr_write (struct e6809 *cpu, unsigned reg, unsigned data)
 {
 	switch (reg) {
 	case 0x0:
-		set_reg_d (data);
+		set_reg_d (cpu, data);
 		break;
 	case 0x1:
-		reg_x = data;
+		cpu->x = data;
 		break;
 	case 0x2:
-		reg_y = data;
+		cpu->y = data;
 		break;
 	case 0x3:
-		reg_u = data;
+		cpu->u = data;
 		break;
 	case 0x4:
-		reg_s = data;
+		cpu->s = data;
 		break;
 	case 0x5:
-		reg_pc = data;
+		cpu->pc = data;
 		break;
 	case 0x8:
-		reg_a = data;
+		cpu->a = data;
 		break;
 	case 0x9:
-		reg_b = data;
+		cpu->b = data;
 		break;
 	case 0xa:
-		reg_cc = data;
+		cpu->cc = data;
 		break;
 	case 0xb:
-		reg_dp = data;
+		cpu->dp = data;
 		break;
 	default:
 		printf ("illegal exgtfr reg %.1x\n", reg);
@@ -1082,1055 +1065,1067 @@ static einline void exgtfr_write (unsigned reg, unsigned data)
 
 /* instruction: exg */
 
-static einline void inst_exg (void)
+static einline void inst_exg (struct e6809 *cpu)
 {
 	unsigned op, tmp;
 
-	op = pc_read8 ();
+	op = pc_read8 (cpu);
 
-	tmp = exgtfr_read (op & 0xf);
-	exgtfr_write (op & 0xf, exgtfr_read (op >> 4));
-	exgtfr_write (op >> 4, tmp);
+	tmp = exgtfr_read (cpu, op & 0xf);
+	exgtfr_write (cpu, op & 0xf, exgtfr_read (cpu, op >> 4));
+	exgtfr_write (cpu, op >> 4, tmp);
 }
 
 /* instruction: tfr */
 
-static einline void inst_tfr (void)
+static einline void inst_tfr (struct e6809 *cpu)
 {
 	unsigned op;
 
-	op = pc_read8 ();
+	op = pc_read8 (cpu);
 
-	exgtfr_write (op & 0xf, exgtfr_read (op >> 4));
+	exgtfr_write (cpu, op & 0xf, exgtfr_read (cpu, op >> 4));
 }
 
 /* reset the 6809 */
 
-void e6809_reset (int trace)
+void e6809_reset (struct e6809 *cpu, int trace)
 {
-	reg_x = 0;
-	reg_y = 0;
-	reg_u = 0;
-	reg_s = 0;
+	cpu->rptr_xyus[0] = &cpu->x;
+	cpu->rptr_xyus[1] = &cpu->y;
+	cpu->rptr_xyus[2] = &cpu->u;
+	cpu->rptr_xyus[3] = &cpu->s;
+	cpu->debug = trace;
+
+	cpu->x = 0;
+	cpu->y = 0;
+	cpu->u = 0;
+	cpu->s = 0;
 
-	reg_a = 0;
-	reg_b = 0;
+	cpu->a = 0;
+	cpu->b = 0;
 
-	reg_dp = 0;
+	cpu->dp = 0;
 
 	/* The processor starts with DP = 0 and CC I and F set. On the 6309
 	   some other bits may be set, on the 6809 generally not.
 	   (checked by Ciaran @ xroar) */
 
-	reg_cc = FLAG_I | FLAG_F;
-	irq_status = IRQ_NORMAL;
+	cpu->cc = FLAG_I | FLAG_F;
+	cpu->irq_status = IRQ_NORMAL;
 
-	reg_pc = read16 (0xfffe);
+	cpu->pc = read16 (cpu, 0xfffe);
 }
 
-/* execute a single instruction or handle interrupts and return */
+/* handle the interrupt lines, returns the cycles taken to enter a handler */
 
-unsigned e6809_sstep (unsigned irq_i, unsigned irq_f)
+static unsigned e6809_interrupt (struct e6809 *cpu, unsigned irq_i, unsigned irq_f)
 {
-	unsigned op;
 	unsigned cycles = 0;
-	unsigned ea, i0, i1, r;
 
 	if (irq_f) {
-		if (get_cc (FLAG_F) == 0) {
-			if (irq_status != IRQ_CWAI) {
-				set_cc (FLAG_E, 0);
-				inst_psh (0x81, &reg_s, reg_u, &cycles);
+		if (get_cc (cpu, FLAG_F) == 0) {
+			if (cpu->irq_status != IRQ_CWAI) {
+				set_cc (cpu, FLAG_E, 0);
+				inst_psh (cpu, 0x81, &cpu->s, cpu->u, &cycles);
 			}
 
-			set_cc (FLAG_I, 1);
-			set_cc (FLAG_F, 1);
+			set_cc (cpu, FLAG_I, 1);
+			set_cc (cpu, FLAG_F, 1);
 
-			reg_pc = read16 (0xfff6);
-			irq_status = IRQ_NORMAL;
+			cpu->pc = read16 (cpu, 0xfff6);
+			cpu->irq_status = IRQ_NORMAL;
 			cycles += 7;
-			if (trace_cpu)
+			if (cpu->debug)
 				fprintf(stderr, "\nF Interrupt\n");
 		} else {
-			if (irq_status == IRQ_SYNC) {
-				irq_status = IRQ_NORMAL;
+			if (cpu->irq_status == IRQ_SYNC) {
+				cpu->irq_status = IRQ_NORMAL;
 			}
 		}
 	}
 
 	if (irq_i) {
-		if (get_cc (FLAG_I) == 0) {
-			if (irq_status != IRQ_CWAI) {
-				set_cc (FLAG_E, 1);
-				inst_psh (0xff, &reg_s, reg_u, &cycles);
+		if (get_cc (cpu, FLAG_I) == 0) {
+			if (cpu->irq_status != IRQ_CWAI) {
+				set_cc (cpu, FLAG_E, 1);
+				inst_psh (cpu, 0xff, &cpu->s, cpu->u, &cycles);
 			}
 
-			set_cc (FLAG_I, 1);
+			set_cc (cpu, FLAG_I, 1);
 
-			reg_pc = read16 (0xfff8);
-			irq_status = IRQ_NORMAL;
+			cpu->pc = read16 (cpu, 0xfff8);
+			cpu->irq_status = IRQ_NORMAL;
 			cycles += 7;
-			if (trace_cpu)
+			if (cpu->debug)
 				fprintf(stderr, "\nI Interrupt\n");
 		} else {
-			if (irq_status == IRQ_SYNC) {
-				irq_status = IRQ_NORMAL;
+			if (cpu->irq_status == IRQ_SYNC) {
+				cpu->irq_status = IRQ_NORMAL;
 			}
 		}
 	}
 
-	if (irq_status != IRQ_NORMAL) {
-		return cycles + 1;
-	}
+	return cycles;
+}
+
+/* execute a single instruction */
+
+static unsigned e6809_execute (struct e6809 *cpu)
+{
+	unsigned op;
+	unsigned cycles = 0;
+	unsigned ea, i0, i1, r;
 
-	e6809_instruction(reg_pc);
-	op = pc_read8 ();
+	if (cpu->debug)
+		e6809_instruction(cpu, cpu->pc);
+	op = pc_read8 (cpu);
 
 	switch (op) {
 	/* page 0 instructions */
 
 	/* neg, nega, negb */
 	case 0x00:
-		ea = ea_direct ();
-		r = inst_neg (read8 (ea));
-		write8 (ea, r);
+		ea = ea_direct (cpu);
+		r = inst_neg (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x40:
-		reg_a = inst_neg (reg_a);
+		cpu->a = inst_neg (cpu, cpu->a);
 		cycles += 2;
 		break;
 	case 0x50:
-		reg_b = inst_neg (reg_b);
+		cpu->b = inst_neg (cpu, cpu->b);
 		cycles += 2;
 		break;
 	case 0x60:
-		ea = ea_indexed (&cycles);
-		r = inst_neg (read8 (ea));
-		write8 (ea, r);
+		ea = ea_indexed (cpu, &cycles);
+		r = inst_neg (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x70:
-		ea = ea_extended ();
-		r = inst_neg (read8 (ea));
-		write8 (ea, r);
+		ea = ea_extended (cpu);
+		r = inst_neg (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 7;
 		break;
 	/* com, coma, comb */
 	case 0x03:
-		ea = ea_direct ();
-		r = inst_com (read8 (ea));
-		write8 (ea, r);
+		ea = ea_direct (cpu);
+		r = inst_com (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x43:
-		reg_a = inst_com (reg_a);
+		cpu->a = inst_com (cpu, cpu->a);
 		cycles += 2;
 		break;
 	case 0x53:
-		reg_b = inst_com (reg_b);
+		cpu->b = inst_com (cpu, cpu->b);
 		cycles += 2;
 		break;
 	case 0x63:
-		ea = ea_indexed (&cycles);
-		r = inst_com (read8 (ea));
-		write8 (ea, r);
+		ea = ea_indexed (cpu, &cycles);
+		r = inst_com (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x73:
-		ea = ea_extended ();
-		r = inst_com (read8 (ea));
-		write8 (ea, r);
+		ea = ea_extended (cpu);
+		r = inst_com (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 7;
 		break;
 	/* lsr, lsra, lsrb */
 	case 0x04:
-		ea = ea_direct ();
-		r = inst_lsr (read8 (ea));
-		write8 (ea, r);
+		ea = ea_direct (cpu);
+		r = inst_lsr (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x44:
-		reg_a = inst_lsr (reg_a);
+		cpu->a = inst_lsr (cpu, cpu->a);
 		cycles += 2;
 		break;
 	case 0x54:
-		reg_b = inst_lsr (reg_b);
+		cpu->b = inst_lsr (cpu, cpu->b);
 		cycles += 2;
 		break;
 	case 0x64:
-		ea = ea_indexed (&cycles);
-		r = inst_lsr (read8 (ea));
-		write8 (ea, r);
+		ea = ea_indexed (cpu, &cycles);
+		r = inst_lsr (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x74:
-		ea = ea_extended ();
-		r = inst_lsr (read8 (ea));
-		write8 (ea, r);
+		ea = ea_extended (cpu);
+		r = inst_lsr (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 7;
 		break;
 	/* ror, rora, rorb */
 	case 0x06:
-		ea = ea_direct ();
-		r = inst_ror (read8 (ea));
-		write8 (ea, r);
+		ea = ea_direct (cpu);
+		r = inst_ror (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x46:
-		reg_a = inst_ror (reg_a);
+		cpu->a = inst_ror (cpu, cpu->a);
 		cycles += 2;
 		break;
 	case 0x56:
-		reg_b = inst_ror (reg_b);
+		cpu->b = inst_ror (cpu, cpu->b);
 		cycles += 2;
 		break;
 	case 0x66:
-		ea = ea_indexed (&cycles);
-		r = inst_ror (read8 (ea));
-		write8 (ea, r);
+		ea = ea_indexed (cpu, &cycles);
+		r = inst_ror (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x76:
-		ea = ea_extended ();
-		r = inst_ror (read8 (ea));
-		write8 (ea, r);
+		ea = ea_extended (cpu);
+		r = inst_ror (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 7;
 		break;
 	/* asr, asra, asrb */
 	case 0x07:
-		ea = ea_direct ();
-		r = inst_asr (read8 (ea));
-		write8 (ea, r);
+		ea = ea_direct (cpu);
+		r = inst_asr (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x47:
-		reg_a = inst_asr (reg_a);
+		cpu->a = inst_asr (cpu, cpu->a);
 		cycles += 2;
 		break;
 	case 0x57:
-		reg_b = inst_asr (reg_b);
+		cpu->b = inst_asr (cpu, cpu->b);
 		cycles += 2;
 		break;
 	case 0x67:
-		ea = ea_indexed (&cycles);
-		r = inst_asr (read8 (ea));
-		write8 (ea, r);
+		ea = ea_indexed (cpu, &cycles);
+		r = inst_asr (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x77:
-		ea = ea_extended ();
-		r = inst_asr (read8 (ea));
-		write8 (ea, r);
+		ea = ea_extended (cpu);
+		r = inst_asr (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 7;
 		break;
 	/* asl, asla, aslb */
 	case 0x08:
-		ea = ea_direct ();
-		r = inst_asl (read8 (ea));
-		write8 (ea, r);
+		ea = ea_direct (cpu);
+		r = inst_asl (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x48:
-		reg_a = inst_asl (reg_a);
+		cpu->a = inst_asl (cpu, cpu->a);
 		cycles += 2;
 		break;
 	case 0x58:
-		reg_b = inst_asl (reg_b);
+		cpu->b = inst_asl (cpu, cpu->b);
 		cycles += 2;
 		break;
 	case 0x68:
-		ea = ea_indexed (&cycles);
-		r = inst_asl (read8 (ea));
-		write8 (ea, r);
+		ea = ea_indexed (cpu, &cycles);
+		r = inst_asl (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x78:
-		ea = ea_extended ();
-		r = inst_asl (read8 (ea));
-		write8 (ea, r);
+		ea = ea_extended (cpu);
+		r = inst_asl (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 7;
 		break;
 	/* rol, rola, rolb */
 	case 0x09:
-		ea = ea_direct ();
-		r = inst_rol (read8 (ea));
-		write8 (ea, r);
+		ea = ea_direct (cpu);
+		r = inst_rol (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x49:
-		reg_a = inst_rol (reg_a);
+		cpu->a = inst_rol (cpu, cpu->a);
 		cycles += 2;
 		break;
 	case 0x59:
-		reg_b = inst_rol (reg_b);
+		cpu->b = inst_rol (cpu, cpu->b);
 		cycles += 2;
 		break;
 	case 0x69:
-		ea = ea_indexed (&cycles);
-		r = inst_rol (read8 (ea));
-		write8 (ea, r);
+		ea = ea_indexed (cpu, &cycles);
+		r = inst_rol (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x79:
-		ea = ea_extended ();
-		r = inst_rol (read8 (ea));
-		write8 (ea, r);
+		ea = ea_extended (cpu);
+		r = inst_rol (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 7;
 		break;
 	/* dec, deca, decb */
 	case 0x0a:
-		ea = ea_direct ();
-		r = inst_dec (read8 (ea));
-		write8 (ea, r);
+		ea = ea_direct (cpu);
+		r = inst_dec (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x4a:
-		reg_a = inst_dec (reg_a);
+		cpu->a = inst_dec (cpu, cpu->a);
 		cycles += 2;
 		break;
 	case 0x5a:
-		reg_b = inst_dec (reg_b);
+		cpu->b = inst_dec (cpu, cpu->b);
 		cycles += 2;
 		break;
 	case 0x6a:
-		ea = ea_indexed (&cycles);
-		r = inst_dec (read8 (ea));
-		write8 (ea, r);
+		ea = ea_indexed (cpu, &cycles);
+		r = inst_dec (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x7a:
-		ea = ea_extended ();
-		r = inst_dec (read8 (ea));
-		write8 (ea, r);
+		ea = ea_extended (cpu);
+		r = inst_dec (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 7;
 		break;
 	/* inc, inca, incb */
 	case 0x0c:
-		ea = ea_direct ();
-		r = inst_inc (read8 (ea));
-		write8 (ea, r);
+		ea = ea_direct (cpu);
+		r = inst_inc (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x4c:
-		reg_a = inst_inc (reg_a);
+		cpu->a = inst_inc (cpu, cpu->a);
 		cycles += 2;
 		break;
 	case 0x5c:
-		reg_b = inst_inc (reg_b);
+		cpu->b = inst_inc (cpu, cpu->b);
 		cycles += 2;
 		break;
 	case 0x6c:
-		ea = ea_indexed (&cycles);
-		r = inst_inc (read8 (ea));
-		write8 (ea, r);
+		ea = ea_indexed (cpu, &cycles);
+		r = inst_inc (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 6;
 		break;
 	case 0x7c:
-		ea = ea_extended ();
-		r = inst_inc (read8 (ea));
-		write8 (ea, r);
+		ea = ea_extended (cpu);
+		r = inst_inc (cpu, read8 (cpu, ea));
+		write8 (cpu, ea, r);
 		cycles += 7;
 		break;
 	/* tst, tsta, tstb */
 	case 0x0d:
-		ea = ea_direct ();
-		inst_tst8 (read8 (ea));
+		ea = ea_direct (cpu);
+		inst_tst8 (cpu, read8 (cpu, ea));
 		cycles += 6;
 		break;
 	case 0x4d:
-		inst_tst8 (reg_a);
+		inst_tst8 (cpu, cpu->a);
 		cycles += 2;
 		break;
 	case 0x5d:
-		inst_tst8 (reg_b);
+		inst_tst8 (cpu, cpu->b);
 		cycles += 2;
 		break;
 	case 0x6d:
-		ea = ea_indexed (&cycles);
-		inst_tst8 (read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		inst_tst8 (cpu, read8 (cpu, ea));
 		cycles += 6;
 		break;
 	case 0x7d:
-		ea = ea_extended ();
-		inst_tst8 (read8 (ea));
+		ea = ea_extended (cpu);
+		inst_tst8 (cpu, read8 (cpu, ea));
 		cycles += 7;
 		break;
 	/* jmp */
 	case 0x0e:
-		reg_pc = ea_direct ();
+		cpu->pc = ea_direct (cpu);
 		cycles += 3;
 		break;
 	case 0x6e:
-		reg_pc = ea_indexed (&cycles);
+		cpu->pc = ea_indexed (cpu, &cycles);
 		cycles += 3;
 		break;
 	case 0x7e:
-		reg_pc = ea_extended ();
+		cpu->pc = ea_extended (cpu);
 		cycles += 4;
 		break;
 	/* clr */
 	case 0x0f:
-		ea = ea_direct ();
-		inst_clr ();
-		write8 (ea, 0);
+		ea = ea_direct (cpu);
+		inst_clr (cpu);
+		write8 (cpu, ea, 0);
 		cycles += 6;
 		break;
 	case 0x4f:
-		inst_clr ();
-		reg_a = 0;
+		inst_clr (cpu);
+		cpu->a = 0;
 		cycles += 2;
 		break;
 	case 0x5f:
-		inst_clr ();
-		reg_b = 0;
+		inst_clr (cpu);
+		cpu->b = 0;
 		cycles += 2;
 		break;
 	case 0x6f:
-		ea = ea_indexed (&cycles);
-		inst_clr ();
-		write8 (ea, 0);
+		ea = ea_indexed (cpu, &cycles);
+		inst_clr (cpu);
+		write8 (cpu, ea, 0);
 		cycles += 6;
 		break;
 	case 0x7f:
-		ea = ea_extended ();
-		inst_clr ();
-		write8 (ea, 0);
+		ea = ea_extended (cpu);
+		inst_clr (cpu);
+		write8 (cpu, ea, 0);
 		cycles += 7;
 		break;
 	/* suba */
 	case 0x80:
-		reg_a = inst_sub8 (reg_a, pc_read8 ());
+		cpu->a = inst_sub8 (cpu, cpu->a, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0x90:
-		ea = ea_direct ();
-		reg_a = inst_sub8 (reg_a, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->a = inst_sub8 (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xa0:
-		ea = ea_indexed (&cycles);
-		reg_a = inst_sub8 (reg_a, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->a = inst_sub8 (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xb0:
-		ea = ea_extended ();
-		reg_a = inst_sub8 (reg_a, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->a = inst_sub8 (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* subb */
 	case 0xc0:
-		reg_b = inst_sub8 (reg_b, pc_read8 ());
+		cpu->b = inst_sub8 (cpu, cpu->b, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0xd0:
-		ea = ea_direct ();
-		reg_b = inst_sub8 (reg_b, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->b = inst_sub8 (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xe0:
-		ea = ea_indexed (&cycles);
-		reg_b = inst_sub8 (reg_b, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->b = inst_sub8 (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xf0:
-		ea = ea_extended ();
-		reg_b = inst_sub8 (reg_b, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->b = inst_sub8 (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* cmpa */
 	case 0x81:
-		inst_sub8 (reg_a, pc_read8 ());
+		inst_sub8 (cpu, cpu->a, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0x91:
-		ea = ea_direct ();
-		inst_sub8 (reg_a, read8 (ea));
+		ea = ea_direct (cpu);
+		inst_sub8 (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xa1:
-		ea = ea_indexed (&cycles);
-		inst_sub8 (reg_a, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		inst_sub8 (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xb1:
-		ea = ea_extended ();
-		inst_sub8 (reg_a, read8 (ea));
+		ea = ea_extended (cpu);
+		inst_sub8 (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* cmpb */
 	case 0xc1:
-		inst_sub8 (reg_b, pc_read8 ());
+		inst_sub8 (cpu, cpu->b, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0xd1:
-		ea = ea_direct ();
-		inst_sub8 (reg_b, read8 (ea));
+		ea = ea_direct (cpu);
+		inst_sub8 (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xe1:
-		ea = ea_indexed (&cycles);
-		inst_sub8 (reg_b, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		inst_sub8 (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xf1:
-		ea = ea_extended ();
-		inst_sub8 (reg_b, read8 (ea));
+		ea = ea_extended (cpu);
+		inst_sub8 (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* sbca */
 	case 0x82:
-		reg_a = inst_sbc (reg_a, pc_read8 ());
+		cpu->a = inst_sbc (cpu, cpu->a, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0x92:
-		ea = ea_direct ();
-		reg_a = inst_sbc (reg_a, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->a = inst_sbc (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xa2:
-		ea = ea_indexed (&cycles);
-		reg_a = inst_sbc (reg_a, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->a = inst_sbc (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xb2:
-		ea = ea_extended ();
-		reg_a = inst_sbc (reg_a, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->a = inst_sbc (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* sbcb */
 	case 0xc2:
-		reg_b = inst_sbc (reg_b, pc_read8 ());
+		cpu->b = inst_sbc (cpu, cpu->b, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0xd2:
-		ea = ea_direct ();
-		reg_b = inst_sbc (reg_b, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->b = inst_sbc (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xe2:
-		ea = ea_indexed (&cycles);
-		reg_b = inst_sbc (reg_b, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->b = inst_sbc (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xf2:
-		ea = ea_extended ();
-		reg_b = inst_sbc (reg_b, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->b = inst_sbc (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* anda */
 	case 0x84:
-		reg_a = inst_and (reg_a, pc_read8 ());
+		cpu->a = inst_and (cpu, cpu->a, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0x94:
-		ea = ea_direct ();
-		reg_a = inst_and (reg_a, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->a = inst_and (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xa4:
-		ea = ea_indexed (&cycles);
-		reg_a = inst_and (reg_a, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->a = inst_and (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xb4:
-		ea = ea_extended ();
-		reg_a = inst_and (reg_a, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->a = inst_and (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* andb */
 	case 0xc4:
-		reg_b = inst_and (reg_b, pc_read8 ());
+		cpu->b = inst_and (cpu, cpu->b, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0xd4:
-		ea = ea_direct ();
-		reg_b = inst_and (reg_b, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->b = inst_and (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xe4:
-		ea = ea_indexed (&cycles);
-		reg_b = inst_and (reg_b, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->b = inst_and (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xf4:
-		ea = ea_extended ();
-		reg_b = inst_and (reg_b, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->b = inst_and (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* bita */
 	case 0x85:
-		inst_and (reg_a, pc_read8 ());
+		inst_and (cpu, cpu->a, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0x95:
-		ea = ea_direct ();
-		inst_and (reg_a, read8 (ea));
+		ea = ea_direct (cpu);
+		inst_and (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xa5:
-		ea = ea_indexed (&cycles);
-		inst_and (reg_a, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		inst_and (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xb5:
-		ea = ea_extended ();
-		inst_and (reg_a, read8 (ea));
+		ea = ea_extended (cpu);
+		inst_and (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* bitb */
 	case 0xc5:
-		inst_and (reg_b, pc_read8 ());
+		inst_and (cpu, cpu->b, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0xd5:
-		ea = ea_direct ();
-		inst_and (reg_b, read8 (ea));
+		ea = ea_direct (cpu);
+		inst_and (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xe5:
-		ea = ea_indexed (&cycles);
-		inst_and (reg_b, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		inst_and (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xf5:
-		ea = ea_extended ();
-		inst_and (reg_b, read8 (ea));
+		ea = ea_extended (cpu);
+		inst_and (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* lda */
 	case 0x86:
-		reg_a = pc_read8 ();
-		inst_tst8 (reg_a);
+		cpu->a = pc_read8 (cpu);
+		inst_tst8 (cpu, cpu->a);
 		cycles += 2;
 		break;
 	case 0x96:
-		ea = ea_direct ();
-		reg_a = read8 (ea);
-		inst_tst8 (reg_a);
+		ea = ea_direct (cpu);
+		cpu->a = read8 (cpu, ea);
+		inst_tst8 (cpu, cpu->a);
 		cycles += 4;
 		break;
 	case 0xa6:
-		ea = ea_indexed (&cycles);
-		reg_a = read8 (ea);
-		inst_tst8 (reg_a);
+		ea = ea_indexed (cpu, &cycles);
+		cpu->a = read8 (cpu, ea);
+		inst_tst8 (cpu, cpu->a);
 		cycles += 4;
 		break;
 	case 0xb6:
-		ea = ea_extended ();
-		reg_a = read8 (ea);
-		inst_tst8 (reg_a);
+		ea = ea_extended (cpu);
+		cpu->a = read8 (cpu, ea);
+		inst_tst8 (cpu, cpu->a);
 		cycles += 5;
 		break;
 	/* ldb */
 	case 0xc6:
-		reg_b = pc_read8 ();
-		inst_tst8 (reg_b);
+		cpu->b = pc_read8 (cpu);
+		inst_tst8 (cpu, cpu->b);
 		cycles += 2;
 		break;
 	case 0xd6:
-		ea = ea_direct ();
-		reg_b = read8 (ea);
-		inst_tst8 (reg_b);
+		ea = ea_direct (cpu);
+		cpu->b = read8 (cpu, ea);
+		inst_tst8 (cpu, cpu->b);
 		cycles += 4;
 		break;
 	case 0xe6:
-		ea = ea_indexed (&cycles);
-		reg_b = read8 (ea);
-		inst_tst8 (reg_b);
+		ea = ea_indexed (cpu, &cycles);
+		cpu->b = read8 (cpu, ea);
+		inst_tst8 (cpu, cpu->b);
 		cycles += 4;
 		break;
 	case 0xf6:
-		ea = ea_extended ();
-		reg_b = read8 (ea);
-		inst_tst8 (reg_b);
+		ea = ea_extended (cpu);
+		cpu->b = read8 (cpu, ea);
+		inst_tst8 (cpu, cpu->b);
 		cycles += 5;
 		break;
 	/* sta */
 	case 0x97:
-		ea = ea_direct ();
-		write8 (ea, reg_a);
-		inst_tst8 (reg_a);
+		ea = ea_direct (cpu);
+		write8 (cpu, ea, cpu->a);
+		inst_tst8 (cpu, cpu->a);
 		cycles += 4;
 		break;
 	case 0xa7:
-		ea = ea_indexed (&cycles);
-		write8 (ea, reg_a);
-		inst_tst8 (reg_a);
+		ea = ea_indexed (cpu, &cycles);
+		write8 (cpu, ea, cpu->a);
+		inst_tst8 (cpu, cpu->a);
 		cycles += 4;
 		break;
 	case 0xb7:
-		ea = ea_extended ();
-		write8 (ea, reg_a);
-		inst_tst8 (reg_a);
+		ea = ea_extended (cpu);
+		write8 (cpu, ea, cpu->a);
+		inst_tst8 (cpu, cpu->a);
 		cycles += 5;
 		break;
 	/* stb */
 	case 0xd7:
-		ea = ea_direct ();
-		write8 (ea, reg_b);
-		inst_tst8 (reg_b);
+		ea = ea_direct (cpu);
+		write8 (cpu, ea, cpu->b);
+		inst_tst8 (cpu, cpu->b);
 		cycles += 4;
 		break;
 	case 0xe7:
-		ea = ea_indexed (&cycles);
-		write8 (ea, reg_b);
-		inst_tst8 (reg_b);
+		ea = ea_indexed (cpu, &cycles);
+		write8 (cpu, ea, cpu->b);
+		inst_tst8 (cpu, cpu->b);
 		cycles += 4;
 		break;
 	case 0xf7:
-		ea = ea_extended ();
-		write8 (ea, reg_b);
-		inst_tst8 (reg_b);
+		ea = ea_extended (cpu);
+		write8 (cpu, ea, cpu->b);
+		inst_tst8 (cpu, cpu->b);
 		cycles += 5;
 		break;
 	/* eora */
 	case 0x88:
-		reg_a = inst_eor (reg_a, pc_read8 ());
+		cpu->a = inst_eor (cpu, cpu->a, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0x98:
-		ea = ea_direct ();
-		reg_a = inst_eor (reg_a, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->a = inst_eor (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xa8:
-		ea = ea_indexed (&cycles);
-		reg_a = inst_eor (reg_a, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->a = inst_eor (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xb8:
-		ea = ea_extended ();
-		reg_a = inst_eor (reg_a, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->a = inst_eor (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* eorb */
 	case 0xc8:
-		reg_b = inst_eor (reg_b, pc_read8 ());
+		cpu->b = inst_eor (cpu, cpu->b, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0xd8:
-		ea = ea_direct ();
-		reg_b = inst_eor (reg_b, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->b = inst_eor (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xe8:
-		ea = ea_indexed (&cycles);
-		reg_b = inst_eor (reg_b, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->b = inst_eor (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xf8:
-		ea = ea_extended ();
-		reg_b = inst_eor (reg_b, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->b = inst_eor (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* adca */
 	case 0x89:
-		reg_a = inst_adc (reg_a, pc_read8 ());
+		cpu->a = inst_adc (cpu, cpu->a, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0x99:
-		ea = ea_direct ();
-		reg_a = inst_adc (reg_a, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->a = inst_adc (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xa9:
-		ea = ea_indexed (&cycles);
-		reg_a = inst_adc (reg_a, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->a = inst_adc (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xb9:
-		ea = ea_extended ();
-		reg_a = inst_adc (reg_a, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->a = inst_adc (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* adcb */
 	case 0xc9:
-		reg_b = inst_adc (reg_b, pc_read8 ());
+		cpu->b = inst_adc (cpu, cpu->b, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0xd9:
-		ea = ea_direct ();
-		reg_b = inst_adc (reg_b, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->b = inst_adc (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xe9:
-		ea = ea_indexed (&cycles);
-		reg_b = inst_adc (reg_b, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->b = inst_adc (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xf9:
-		ea = ea_extended ();
-		reg_b = inst_adc (reg_b, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->b = inst_adc (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* ora */
 	case 0x8a:
-		reg_a = inst_or (reg_a, pc_read8 ());
+		cpu->a = inst_or (cpu, cpu->a, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0x9a:
-		ea = ea_direct ();
-		reg_a = inst_or (reg_a, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->a = inst_or (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xaa:
-		ea = ea_indexed (&cycles);
-		reg_a = inst_or (reg_a, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->a = inst_or (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xba:
-		ea = ea_extended ();
-		reg_a = inst_or (reg_a, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->a = inst_or (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* orb */
 	case 0xca:
-		reg_b = inst_or (reg_b, pc_read8 ());
+		cpu->b = inst_or (cpu, cpu->b, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0xda:
-		ea = ea_direct ();
-		reg_b = inst_or (reg_b, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->b = inst_or (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xea:
-		ea = ea_indexed (&cycles);
-		reg_b = inst_or (reg_b, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->b = inst_or (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xfa:
-		ea = ea_extended ();
-		reg_b = inst_or (reg_b, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->b = inst_or (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* adda */
 	case 0x8b:
-		reg_a = inst_add8 (reg_a, pc_read8 ());
+		cpu->a = inst_add8 (cpu, cpu->a, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0x9b:
-		ea = ea_direct ();
-		reg_a = inst_add8 (reg_a, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->a = inst_add8 (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xab:
-		ea = ea_indexed (&cycles);
-		reg_a = inst_add8 (reg_a, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->a = inst_add8 (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xbb:
-		ea = ea_extended ();
-		reg_a = inst_add8 (reg_a, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->a = inst_add8 (cpu, cpu->a, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* addb */
 	case 0xcb:
-		reg_b = inst_add8 (reg_b, pc_read8 ());
+		cpu->b = inst_add8 (cpu, cpu->b, pc_read8 (cpu));
 		cycles += 2;
 		break;
 	case 0xdb:
-		ea = ea_direct ();
-		reg_b = inst_add8 (reg_b, read8 (ea));
+		ea = ea_direct (cpu);
+		cpu->b = inst_add8 (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xeb:
-		ea = ea_indexed (&cycles);
-		reg_b = inst_add8 (reg_b, read8 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		cpu->b = inst_add8 (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 4;
 		break;
 	case 0xfb:
-		ea = ea_extended ();
-		reg_b = inst_add8 (reg_b, read8 (ea));
+		ea = ea_extended (cpu);
+		cpu->b = inst_add8 (cpu, cpu->b, read8 (cpu, ea));
 		cycles += 5;
 		break;
 	/* subd */
 	case 0x83:
-		set_reg_d (inst_sub16 (get_reg_d (), pc_read16 ()));
+		set_reg_d (cpu, inst_sub16 (cpu, get_reg_d (cpu), pc_read16 (cpu)));
 		cycles += 4;
 		break;
 	case 0x93:
-		ea = ea_direct ();
-		set_reg_d (inst_sub16 (get_reg_d (), read16 (ea)));
+		ea = ea_direct (cpu);
+		set_reg_d (cpu, inst_sub16 (cpu, get_reg_d (cpu), read16 (cpu, ea)));
 		cycles += 6;
 		break;
 	case 0xa3:
-		ea = ea_indexed (&cycles);
-		set_reg_d (inst_sub16 (get_reg_d (), read16 (ea)));
+		ea = ea_indexed (cpu, &cycles);
+		set_reg_d (cpu, inst_sub16 (cpu, get_reg_d (cpu), read16 (cpu, ea)));
 		cycles += 6;
 		break;
 	case 0xb3:
-		ea = ea_extended ();
-		set_reg_d (inst_sub16 (get_reg_d (), read16 (ea)));
+		ea = ea_extended (cpu);
+		set_reg_d (cpu, inst_sub16 (cpu, get_reg_d (cpu), read16 (cpu, ea)));
 		cycles += 7;
 		break;
 	/* cmpx */
 	case 0x8c:
-		inst_sub16 (reg_x, pc_read16 ());
+		inst_sub16 (cpu, cpu->x, pc_read16 (cpu));
 		cycles += 4;
 		break;
 	case 0x9c:
-		ea = ea_direct ();
-		inst_sub16 (reg_x, read16 (ea));
+		ea = ea_direct (cpu);
+		inst_sub16 (cpu, cpu->x, read16 (cpu, ea));
 		cycles += 6;
 		break;
 	case 0xac:
-		ea = ea_indexed (&cycles);
-		inst_sub16 (reg_x, read16 (ea));
+		ea = ea_indexed (cpu, &cycles);
+		inst_sub16 (cpu, cpu->x, read16 (cpu, ea));
 		cycles += 6;
 		break;
 	case 0xbc:
-		ea = ea_extended ();
-		inst_sub16 (reg_x, read16 (ea));
+		ea = ea_extended (cpu);
+		inst_sub16 (cpu, cpu->x, read16 (cpu, ea));
 		cycles += 7;
 		break;
 	/* ldx */
 	case 0x8e:
-		reg_x = pc_read16 ();
-		inst_tst16 (reg_x);
+		cpu->x = pc_read16 (cpu);
+		inst_tst16 (cpu, cpu->x);
 		cycles += 3;
 		break;
 	case 0x9e:
-		ea = ea_direct ();
-		reg_x = read16 (ea);
-		inst_tst16 (reg_x);
+		ea = ea_direct (cpu);
+		cpu->x = read16 (cpu, ea);
+		inst_tst16 (cpu, cpu->x);
 		cycles += 5;
 		break;
 	case 0xae:
-		ea = ea_indexed (&cycles);
-		reg_x = read16 (ea);
-		inst_tst16 (reg_x);
+		ea = ea_indexed (cpu, &cycles);
+		cpu->x = read16 (cpu, ea);
+		inst_tst16 (cpu, cpu->x);
 		cycles += 5;
 		break;
 	case 0xbe:
-		ea = ea_extended ();
-		reg_x = read16 (ea);
-		inst_tst16 (reg_x);
+		ea = ea_extended (cpu);
+		cpu->x = read16 (cpu, ea);
+		inst_tst16 (cpu, cpu->x);
 		cycles += 6;
 		break;
 	/* ldu */
 	case 0xce:
-		reg_u = pc_read16 ();
-		inst_tst16 (reg_u);
+		cpu->u = pc_read16 (cpu);
+		inst_tst16 (cpu, cpu->u);
 		cycles += 3;
 		break;
 	case 0xde:
-		ea = ea_direct ();
-		reg_u = read16 (ea);
-		inst_tst16 (reg_u);
+		ea = ea_direct (cpu);
+		cpu->u = read16 (cpu, ea);
+		inst_tst16 (cpu, cpu->u);
 		cycles += 5;
 		break;
 	case 0xee:
-		ea = ea_indexed (&cycles);
-		reg_u = read16 (ea);
-		inst_tst16 (reg_u);
+		ea = ea_indexed (cpu, &cycles);
+		cpu->u = read16 (cpu, ea);
+		inst_tst16 (cpu, cpu->u);
 		cycles += 5;
 		break;
 	case 0xfe:
-		ea = ea_extended ();
-		reg_u = read16 (ea);
-		inst_tst16 (reg_u);
+		ea = ea_extended (cpu);
+		cpu->u = read16 (cpu, ea);
+		inst_tst16 (cpu, cpu->u);
 		cycles += 6;
 		break;
 	/* stx */
 	case 0x9f:
-		ea = ea_direct ();
-		write16 (ea, reg_x);
-		inst_tst16 (reg_x);
+		ea = ea_direct (cpu);
+		write16 (cpu, ea, cpu->x);
+		inst_tst16 (cpu, cpu->x);
 		cycles += 5;
 		break;
 	case 0xaf:
-		ea = ea_indexed (&cycles);
-		write16 (ea, reg_x);
-		inst_tst16 (reg_x);
+		ea = ea_indexed (cpu, &cycles);
+		write16 (cpu, ea, cpu->x);
+		inst_tst16 (cpu, cpu->x);
 		cycles += 5;
 		break;
 	case 0xbf:
-		ea = ea_extended ();
-		write16 (ea, reg_x);
-		inst_tst16 (reg_x);
+		ea = ea_extended (cpu);
+		write16 (cpu, ea, cpu->x);
+		inst_tst16 (cpu, cpu->x);
 		cycles += 6;
 		break;
 	/* stu */
 	case 0xdf:
-		ea = ea_direct ();
-		write16 (ea, reg_u);
-		inst_tst16 (reg_u);
+		ea = ea_direct (cpu);
+		write16 (cpu, ea, cpu->u);
+		inst_tst16 (cpu, cpu->u);
 		cycles += 5;
 		break;
 	case 0xef:
-		ea = ea_indexed (&cycles);
-		write16 (ea, reg_u);
-		inst_tst16 (reg_u);
+		ea = ea_indexed (cpu, &cycles);
+		write16 (cpu, ea, cpu->u);
+		inst_tst16 (cpu, cpu->u);
 		cycles += 5;
 		break;
 	case 0xff:
-		ea = ea_extended ();
-		write16 (ea, reg_u);
-		inst_tst16 (reg_u);
+		ea = ea_extended (cpu);
+		write16 (cpu, ea, cpu->u);
+		inst_tst16 (cpu, cpu->u);
 		cycles += 6;
 		break;
 	/* addd */
 	case 0xc3:
-		set_reg_d (inst_add16 (get_reg_d (), pc_read16 ()));
+		set_reg_d (cpu, inst_add16 (cpu, get_reg_d (cpu), pc_read16 (cpu)));
 		cycles += 4;
 		break;
 	case 0xd3:
-		ea = ea_direct ();
-		set_reg_d (inst_add16 (get_reg_d (), read16 (ea)));
+		ea = ea_direct (cpu);
+		set_reg_d (cpu, inst_add16 (cpu, get_reg_d (cpu), read16 (cpu, ea)));
 		cycles += 6;
 		break;
 	case 0xe3:
-		ea = ea_indexed (&cycles);
-		set_reg_d (inst_add16 (get_reg_d (), read16 (ea)));
+		ea = ea_indexed (cpu, &cycles);
+		set_reg_d (cpu, inst_add16 (cpu, get_reg_d (cpu), read16 (cpu, ea)));
 		cycles += 6;
 		break;
 	case 0xf3:
-		ea = ea_extended ();
-		set_reg_d (inst_add16 (get_reg_d (), read16 (ea)));
+		ea = ea_extended (cpu);
+		set_reg_d (cpu, inst_add16 (cpu, get_reg_d (cpu), read16 (cpu, ea)));
 		cycles += 7;
 		break;
 	/* ldd */
 	case 0xcc:
-		set_reg_d (pc_read16 ());
-		inst_tst16 (get_reg_d ());
+		set_reg_d (cpu, pc_read16 (cpu));
+		inst_tst16 (cpu, get_reg_d (cpu));
 		cycles += 3;
 		break;
 	case 0xdc:
-		ea = ea_direct ();
-		set_reg_d (read16 (ea));
-		inst_tst16 (get_reg_d ());
+		ea = ea_direct (cpu);
+		set_reg_d (cpu, read16 (cpu, ea));
+		inst_tst16 (cpu, get_reg_d (cpu));
 		cycles += 5;
 		break;
 	case 0xec:
-		ea = ea_indexed (&cycles);
-		set_reg_d (read16 (ea));
-		inst_tst16 (get_reg_d ());
+		ea = ea_indexed (cpu, &cycles);
+		set_reg_d (cpu, read16 (cpu, ea));
+		inst_tst16 (cpu, get_reg_d (cpu));
 		cycles += 5;
 		break;
 	case 0xfc:
-		ea = ea_extended ();
-		set_reg_d (read16 (ea));
-		inst_tst16 (get_reg_d ());
+		ea = ea_extended (cpu);
+		set_reg_d (cpu, read16 (cpu, ea));
+		inst_tst16 (cpu, get_reg_d (cpu));
 		cycles += 6;
 		break;
 	/* std */
 	case 0xdd:
-		ea = ea_direct ();
-		write16 (ea, get_reg_d ());
-		inst_tst16 (get_reg_d ());
+		ea = ea_direct (cpu);
+		write16 (cpu, ea, get_reg_d (cpu));
+		inst_tst16 (cpu, get_reg_d (cpu));
 		cycles += 5;
 		break;
 	case 0xed:
-		ea = ea_indexed (&cycles);
-		write16 (ea, get_reg_d ());
-		inst_tst16 (get_reg_d ());
+		ea = ea_indexed (cpu, &cycles);
+		write16 (cpu, ea, get_reg_d (cpu));
+		inst_tst16 (cpu, get_reg_d (cpu));
 		cycles += 5;
 		break;
 	case 0xfd:
-		ea = ea_extended ();
-		write16 (ea, get_reg_d ());
-		inst_tst16 (get_reg_d ());
+		ea = ea_extended (cpu);
+		write16 (cpu, ea, get_reg_d (cpu));
+		inst_tst16 (cpu, get_reg_d (cpu));
 		cycles += 6;
 		break;
 	/* nop */
@@ -2139,11 +2134,11 @@ unsigned e6809_sstep (unsigned irq_i, unsigned irq_f)
 		break;
 	/* mul */
 	case 0x3d:
-		r = (reg_a & 0xff) * (reg_b & 0xff);
-		set_reg_d (r);
+		r = (cpu->a & 0xff) * (cpu->b & 0xff);
+		set_reg_d (cpu, r);
 
-		set_cc (FLAG_Z, test_z16 (r));
-		set_cc (FLAG_C, (r >> 7) & 1);
+		set_cc (cpu, FLAG_Z, test_z16 (r));
+		set_cc (cpu, FLAG_C, (r >> 7) & 1);
 
 		cycles += 11;
 		break;
@@ -2151,414 +2146,414 @@ unsigned e6809_sstep (unsigned irq_i, unsigned irq_f)
 	case 0x20:
 	/* brn */
 	case 0x21:
-		inst_bra8 (0, op, &cycles);
+		inst_bra8 (cpu, 0, op, &cycles);
 		break;
 	/* bhi */
 	case 0x22:
 	/* bls */
 	case 0x23:
-		inst_bra8 (get_cc (FLAG_C) | get_cc (FLAG_Z), op, &cycles);
+		inst_bra8 (cpu, get_cc (cpu, FLAG_C) | get_cc (cpu, FLAG_Z), op, &cycles);
 		break;
 	/* bhs/bcc */
 	case 0x24:
 	/* blo/bcs */
 	case 0x25:
-		inst_bra8 (get_cc (FLAG_C), op, &cycles);
+		inst_bra8 (cpu, get_cc (cpu, FLAG_C), op, &cycles);
 		break;
 	/* bne */
 	case 0x26:
 	/* beq */
 	case 0x27:
-		inst_bra8 (get_cc (FLAG_Z), op, &cycles);
+		inst_bra8 (cpu, get_cc (cpu, FLAG_Z), op, &cycles);
 		break;
 	/* bvc */
 	case 0x28:
 	/* bvs */
 	case 0x29:
-		inst_bra8 (get_cc (FLAG_V), op, &cycles);
+		inst_bra8 (cpu, get_cc (cpu, FLAG_V), op, &cycles);
 		break;
 	/* bpl */
 	case 0x2a:
 	/* bmi */
 	case 0x2b:
-		inst_bra8 (get_cc (FLAG_N), op, &cycles);
+		inst_bra8 (cpu, get_cc (cpu, FLAG_N), op, &cycles);
 		break;
 	/* bge */
 	case 0x2c:
 	/* blt */
 	case 0x2d:
-		inst_bra8 (get_cc (FLAG_N) ^ get_cc (FLAG_V), op, &cycles);
+		inst_bra8 (cpu, get_cc (cpu, FLAG_N) ^ get_cc (cpu, FLAG_V), op, &cycles);
 		break;
 	/* bgt */
 	case 0x2e:
 	/* ble */
 	case 0x2f:
-		inst_bra8 (get_cc (FLAG_Z) |
-				   (get_cc (FLAG_N) ^ get_cc (FLAG_V)), op, &cycles);
+		inst_bra8 (cpu, get_cc (cpu, FLAG_Z) |
+				   (get_cc (cpu, FLAG_N) ^ get_cc (cpu, FLAG_V)), op, &cycles);
 		break;
 	/* lbra */
 	case 0x16:
-		r = pc_read16 ();
-		reg_pc += r;
+		r = pc_read16 (cpu);
+		cpu->pc += r;
 		cycles += 5;
 		break;
 	/* lbsr */
 	case 0x17:
-		r = pc_read16 ();
-		push16 (&reg_s, reg_pc);
-		reg_pc += r;
+		r = pc_read16 (cpu);
+		push16 (cpu, &cpu->s, cpu->pc);
+		cpu->pc += r;
 		cycles += 9;
 		break;
 	/* bsr */
 	case 0x8d:
-		r = pc_read8 ();
-		push16 (&reg_s, reg_pc);
-		reg_pc += sign_extend (r);
+		r = pc_read8 (cpu);
+		push16 (cpu, &cpu->s, cpu->pc);
+		cpu->pc += sign_extend (r);
 		cycles += 7;
 		break;
 	/* jsr */
 	case 0x9d:
-		ea = ea_direct ();
-		push16 (&reg_s, reg_pc);
-		reg_pc = ea;
+		ea = ea_direct (cpu);
+		push16 (cpu, &cpu->s, cpu->pc);
+		cpu->pc = ea;
 		cycles += 7;
 		break;
 	case 0xad:
-		ea = ea_indexed (&cycles);
-		push16 (&reg_s, reg_pc);
-		reg_pc = ea;
+		ea = ea_indexed (cpu, &cycles);
+		push16 (cpu, &cpu->s, cpu->pc);
+		cpu->pc = ea;
 		cycles += 7;
 		break;
 	case 0xbd:
-		ea = ea_extended ();
-		push16 (&reg_s, reg_pc);
-		reg_pc = ea;
+		ea = ea_extended (cpu);
+		push16 (cpu, &cpu->s, cpu->pc);
+		cpu->pc = ea;
 		cycles += 8;
 		break;
 	/* leax */
 	case 0x30:
-		reg_x = ea_indexed (&cycles);
-		set_cc (FLAG_Z, test_z16 (reg_x));
+		cpu->x = ea_indexed (cpu, &cycles);
+		set_cc (cpu, FLAG_Z, test_z16 (cpu->x));
 		cycles += 4;
 		break;
 	/* leay */
 	case 0x31:
-		reg_y = ea_indexed (&cycles);
-		set_cc (FLAG_Z, test_z16 (reg_y));
+		cpu->y = ea_indexed (cpu, &cycles);
+		set_cc (cpu, FLAG_Z, test_z16 (cpu->y));
 		cycles += 4;
 		break;
 	/* leas */
 	case 0x32:
-		reg_s = ea_indexed (&cycles);
+		cpu->s = ea_indexed (cpu, &cycles);
 		cycles += 4;
 		break;
 	/* leau */
 	case 0x33:
-		reg_u = ea_indexed (&cycles);
+		cpu->u = ea_indexed (cpu, &cycles);
 		cycles += 4;
 		break;
 	/* pshs */
 	case 0x34:
-		inst_psh (pc_read8 (), &reg_s, reg_u, &cycles);
+		inst_psh (cpu, pc_read8 (cpu), &cpu->s, cpu->u, &cycles);
 		cycles += 5;
 		break;
 	/* puls */
 	case 0x35:
-		inst_pul (pc_read8 (), &reg_s, &reg_u, &cycles);
+		inst_pul (cpu, pc_read8 (cpu), &cpu->s, &cpu->u, &cycles);
 		cycles += 5;
 		break;
 	/* pshu */
 	case 0x36:
-		inst_psh (pc_read8 (), &reg_u, reg_s, &cycles);
+		inst_psh (cpu, pc_read8 (cpu), &cpu->u, cpu->s, &cycles);
 		cycles += 5;
 		break;
 	/* pulu */
 	case 0x37:
-		inst_pul (pc_read8 (), &reg_u, &reg_s, &cycles);
+		inst_pul (cpu, pc_read8 (cpu), &cpu->u, &cpu->s, &cycles);
 		cycles += 5;
 		break;
 	/* rts */
 	case 0x39:
-		reg_pc = pull16 (&reg_s);
+		cpu->pc = pull16 (cpu, &cpu->s);
 		cycles += 5;
 		break;
 	/* abx */
 	case 0x3a:
-		reg_x += reg_b & 0xff;
+		cpu->x += cpu->b & 0xff;
 		cycles += 3;
 		break;
 	/* orcc */
 	case 0x1a:
-		reg_cc |= pc_read8 ();
+		cpu->cc |= pc_read8 (cpu);
 		cycles += 3;
 		break;
 	/* andcc */
 	case 0x1c:
-		reg_cc &= pc_read8 ();
+		cpu->cc &= pc_read8 (cpu);
 		cycles += 3;
 		break;
 	/* sex */
 	case 0x1d:
-		set_reg_d (sign_extend (reg_b));
-		set_cc (FLAG_N, test_n (reg_a));
-		set_cc (FLAG_Z, test_z16 (get_reg_d ()));
+		set_reg_d (cpu, sign_extend (cpu->b));
+		set_cc (cpu, FLAG_N, test_n (cpu->a));
+		set_cc (cpu, FLAG_Z, test_z16 (get_reg_d (cpu)));
 		cycles += 2;
 		break;
 	/* exg */
 	case 0x1e:
-		inst_exg ();
+		inst_exg (cpu);
 		cycles += 8;
 		break;
 	/* tfr */
 	case 0x1f:
-		inst_tfr ();
+		inst_tfr (cpu);
 		cycles += 6;
 		break;
 	/* rti */
 	case 0x3b:
-		reg_cc = pull8(&reg_s);
+		cpu->cc = pull8(cpu, &cpu->s);
 		cycles += 1;
-		if (get_cc (FLAG_E)) {
-			inst_pul (0xfe, &reg_s, &reg_u, &cycles);
+		if (get_cc (cpu, FLAG_E)) {
+			inst_pul (cpu, 0xfe, &cpu->s, &cpu->u, &cycles);
 		} else {
-			inst_pul (0x80, &reg_s, &reg_u, &cycles);
+			inst_pul (cpu, 0x80, &cpu->s, &cpu->u, &cycles);
 		}
 		cycles += 3;
 		break;
 	/* swi */
 	case 0x3f:
-		set_cc (FLAG_E, 1);
-		inst_psh (0xff, &reg_s, reg_u, &cycles);
-		set_cc (FLAG_I, 1);
-		set_cc (FLAG_F, 1);
-	        reg_pc = read16 (0xfffa);
+		set_cc (cpu, FLAG_E, 1);
+		inst_psh (cpu, 0xff, &cpu->s, cpu->u, &cycles);
+		set_cc (cpu, FLAG_I, 1);
+		set_cc (cpu, FLAG_F, 1);
+	        cpu->pc = read16 (cpu, 0xfffa);
 	        cycles += 7;
 		break;
 	/* sync */
 	case 0x13:
-		irq_status = IRQ_SYNC;
+		cpu->irq_status = IRQ_SYNC;
 		cycles += 2;
 		break;
 	/* daa */
 	case 0x19:
-		i0 = reg_a;
+		i0 = cpu->a;
 		i1 = 0;
 
-		if ((reg_a & 0x0f) > 0x09 || get_cc (FLAG_H) == 1) {
+		if ((cpu->a & 0x0f) > 0x09 || get_cc (cpu, FLAG_H) == 1) {
 			i1 |= 0x06;
 		}
 
-		if ((reg_a & 0xf0) > 0x80 && (reg_a & 0x0f) > 0x09) {
+		if ((cpu->a & 0xf0) > 0x80 && (cpu->a & 0x0f) > 0x09) {
 			i1 |= 0x60;
 		}
 
-		if ((reg_a & 0xf0) > 0x90 || get_cc (FLAG_C) == 1) {
+		if ((cpu->a & 0xf0) > 0x90 || get_cc (cpu, FLAG_C) == 1) {
 			i1 |= 0x60;
 		}
 
-		reg_a = i0 + i1;
+		cpu->a = i0 + i1;
 
-		set_cc (FLAG_N, test_n (reg_a));
-		set_cc (FLAG_Z, test_z8 (reg_a));
-		set_cc (FLAG_V, 0);
-		set_cc (FLAG_C, test_c (i0, i1, reg_a, 0));
+		set_cc (cpu, FLAG_N, test_n (cpu->a));
+		set_cc (cpu, FLAG_Z, test_z8 (cpu->a));
+		set_cc (cpu, FLAG_V, 0);
+		set_cc (cpu, FLAG_C, test_c (i0, i1, cpu->a, 0));
 		cycles += 2;
 		break;
 	/* cwai */
 	case 0x3c:
-		reg_cc &= pc_read8 ();
-		set_cc (FLAG_E, 1);
-		inst_psh (0xff, &reg_s, reg_u, &cycles);
-		irq_status = IRQ_CWAI;
+		cpu->cc &= pc_read8 (cpu);
+		set_cc (cpu, FLAG_E, 1);
+		inst_psh (cpu, 0xff, &cpu->s, cpu->u, &cycles);
+		cpu->irq_status = IRQ_CWAI;
 		cycles += 4;
 		break;
 
 	/* page 1 instructions */
 
 	case 0x10:
-		op = pc_read8 ();
+		op = pc_read8 (cpu);
 
 		switch (op) {
 		/* lbra */
 		case 0x20:
 		/* lbrn */
 		case 0x21:
-			inst_bra16 (0, op, &cycles);
+			inst_bra16 (cpu, 0, op, &cycles);
 			break;
 		/* lbhi */
 		case 0x22:
 		/* lbls */
 		case 0x23:
-			inst_bra16 (get_cc (FLAG_C) | get_cc (FLAG_Z), op, &cycles);
+			inst_bra16 (cpu, get_cc (cpu, FLAG_C) | get_cc (cpu, FLAG_Z), op, &cycles);
 			break;
 		/* lbhs/lbcc */
 		case 0x24:
 		/* lblo/lbcs */
 		case 0x25:
-			inst_bra16 (get_cc (FLAG_C), op, &cycles);
+			inst_bra16 (cpu, get_cc (cpu, FLAG_C), op, &cycles);
 			break;
 		/* lbne */
 		case 0x26:
 		/* lbeq */
 		case 0x27:
-			inst_bra16 (get_cc (FLAG_Z), op, &cycles);
+			inst_bra16 (cpu, get_cc (cpu, FLAG_Z), op, &cycles);
 			break;
 		/* lbvc */
 		case 0x28:
 		/* lbvs */
 		case 0x29:
-			inst_bra16 (get_cc (FLAG_V), op, &cycles);
+			inst_bra16 (cpu, get_cc (cpu, FLAG_V), op, &cycles);
 			break;
 		/* lbpl */
 		case 0x2a:
 		/* lbmi */
 		case 0x2b:
-			inst_bra16 (get_cc (FLAG_N), op, &cycles);
+			inst_bra16 (cpu, get_cc (cpu, FLAG_N), op, &cycles);
 			break;
 		/* lbge */
 		case 0x2c:
 		/* lblt */
 		case 0x2d:
-			inst_bra16 (get_cc (FLAG_N) ^ get_cc (FLAG_V), op, &cycles);
+			inst_bra16 (cpu, get_cc (cpu, FLAG_N) ^ get_cc (cpu, FLAG_V), op, &cycles);
 			break;
 		/* lbgt */
 		case 0x2e:
 		/* lble */
 		case 0x2f:
-			inst_bra16 (get_cc (FLAG_Z) |
-						(get_cc (FLAG_N) ^ get_cc (FLAG_V)), op, &cycles);
+			inst_bra16 (cpu, get_cc (cpu, FLAG_Z) |
+						(get_cc (cpu, FLAG_N) ^ get_cc (cpu, FLAG_V)), op, &cycles);
 			break;
 		/* cmpd */
 		case 0x83:
-			inst_sub16 (get_reg_d (), pc_read16 ());
+			inst_sub16 (cpu, get_reg_d (cpu), pc_read16 (cpu));
 			cycles += 5;
 			break;
 		case 0x93:
-			ea = ea_direct ();
-			inst_sub16 (get_reg_d (), read16 (ea));
+			ea = ea_direct (cpu);
+			inst_sub16 (cpu, get_reg_d (cpu), read16 (cpu, ea));
 			cycles += 7;
 			break;
 		case 0xa3:
-			ea = ea_indexed (&cycles);
-			inst_sub16 (get_reg_d (), read16 (ea));
+			ea = ea_indexed (cpu, &cycles);
+			inst_sub16 (cpu, get_reg_d (cpu), read16 (cpu, ea));
 			cycles += 7;
 			break;
 		case 0xb3:
-			ea = ea_extended ();
-			inst_sub16 (get_reg_d (), read16 (ea));
+			ea = ea_extended (cpu);
+			inst_sub16 (cpu, get_reg_d (cpu), read16 (cpu, ea));
 			cycles += 8;
 			break;
 		/* cmpy */
 		case 0x8c:
-			inst_sub16 (reg_y, pc_read16 ());
+			inst_sub16 (cpu, cpu->y, pc_read16 (cpu));
 			cycles += 5;
 			break;
 		case 0x9c:
-			ea = ea_direct ();
-			inst_sub16 (reg_y, read16 (ea));
+			ea = ea_direct (cpu);
+			inst_sub16 (cpu, cpu->y, read16 (cpu, ea));
 			cycles += 7;
 			break;
 		case 0xac:
-			ea = ea_indexed (&cycles);
-			inst_sub16 (reg_y, read16 (ea));
+			ea = ea_indexed (cpu, &cycles);
+			inst_sub16 (cpu, cpu->y, read16 (cpu, ea));
 			cycles += 7;
 			break;
 		case 0xbc:
-			ea = ea_extended ();
-			inst_sub16 (reg_y, read16 (ea));
+			ea = ea_extended (cpu);
+			inst_sub16 (cpu, cpu->y, read16 (cpu, ea));
 			cycles += 8;
 			break;
 		/* ldy */
 		case 0x8e:
-			reg_y = pc_read16 ();
-			inst_tst16 (reg_y);
+			cpu->y = pc_read16 (cpu);
+			inst_tst16 (cpu, cpu->y);
 			cycles += 4;
 			break;
 		case 0x9e:
-			ea = ea_direct ();
-			reg_y = read16 (ea);
-			inst_tst16 (reg_y);
+			ea = ea_direct (cpu);
+			cpu->y = read16 (cpu, ea);
+			inst_tst16 (cpu, cpu->y);
 			cycles += 6;
 			break;
 		case 0xae:
-			ea = ea_indexed (&cycles);
-			reg_y = read16 (ea);
-			inst_tst16 (reg_y);
+			ea = ea_indexed (cpu, &cycles);
+			cpu->y = read16 (cpu, ea);
+			inst_tst16 (cpu, cpu->y);
 			cycles += 6;
 			break;
 		case 0xbe:
-			ea = ea_extended ();
-			reg_y = read16 (ea);
-			inst_tst16 (reg_y);
+			ea = ea_extended (cpu);
+			cpu->y = read16 (cpu, ea);
+			inst_tst16 (cpu, cpu->y);
 			cycles += 7;
 			break;
 		/* sty */
 		case 0x9f:
-			ea = ea_direct ();
-			write16 (ea, reg_y);
-			inst_tst16 (reg_y);
+			ea = ea_direct (cpu);
+			write16 (cpu, ea, cpu->y);
+			inst_tst16 (cpu, cpu->y);
 			cycles += 6;
 			break;
 		case 0xaf:
-			ea = ea_indexed (&cycles);
-			write16 (ea, reg_y);
-			inst_tst16 (reg_y);
+			ea = ea_indexed (cpu, &cycles);
+			write16 (cpu, ea, cpu->y);
+			inst_tst16 (cpu, cpu->y);
 			cycles += 6;
 			break;
 		case 0xbf:
-			ea = ea_extended ();
-			write16 (ea, reg_y);
-			inst_tst16 (reg_y);
+			ea = ea_extended (cpu);
+			write16 (cpu, ea, cpu->y);
+			inst_tst16 (cpu, cpu->y);
 			cycles += 7;
 			break;
 		/* lds */
 		case 0xce:
-			reg_s = pc_read16 ();
-			inst_tst16 (reg_s);
+			cpu->s = pc_read16 (cpu);
+			inst_tst16 (cpu, cpu->s);
 			cycles += 4;
 			break;
 		case 0xde:
-			ea = ea_direct ();
-			reg_s = read16 (ea);
-			inst_tst16 (reg_s);
+			ea = ea_direct (cpu);
+			cpu->s = read16 (cpu, ea);
+			inst_tst16 (cpu, cpu->s);
 			cycles += 6;
 			break;
 		case 0xee:
-			ea = ea_indexed (&cycles);
-			reg_s = read16 (ea);
-			inst_tst16 (reg_s);
+			ea = ea_indexed (cpu, &cycles);
+			cpu->s = read16 (cpu, ea);
+			inst_tst16 (cpu, cpu->s);
 			cycles += 6;
 			break;
 		case 0xfe:
-			ea = ea_extended ();
-			reg_s = read16 (ea);
-			inst_tst16 (reg_s);
+			ea = ea_extended (cpu);
+			cpu->s = read16 (cpu, ea);
+			inst_tst16 (cpu, cpu->s);
 			cycles += 7;
 			break;
 		/* sts */
 		case 0xdf:
-			ea = ea_direct ();
-			write16 (ea, reg_s);
-			inst_tst16 (reg_s);
+			ea = ea_direct (cpu);
+			write16 (cpu, ea, cpu->s);
+			inst_tst16 (cpu, cpu->s);
 			cycles += 6;
 			break;
 		case 0xef:
-			ea = ea_indexed (&cycles);
-			write16 (ea, reg_s);
-			inst_tst16 (reg_s);
+			ea = ea_indexed (cpu, &cycles);
+			write16 (cpu, ea, cpu->s);
+			inst_tst16 (cpu, cpu->s);
 			cycles += 6;
 			break;
 		case 0xff:
-			ea = ea_extended ();
-			write16 (ea, reg_s);
-			inst_tst16 (reg_s);
+			ea = ea_extended (cpu);
+			write16 (cpu, ea, cpu->s);
+			inst_tst16 (cpu, cpu->s);
 			cycles += 7;
 			break;
 		/* swi2 */
 		case 0x3f:
-			set_cc (FLAG_E, 1);
-			inst_psh (0xff, &reg_s, reg_u, &cycles);
-		    reg_pc = read16 (0xfff4);
+			set_cc (cpu, FLAG_E, 1);
+			inst_psh (cpu, 0xff, &cpu->s, cpu->u, &cycles);
+		    cpu->pc = read16 (cpu, 0xfff4);
 			cycles += 8;
 			break;
 		default:
@@ -2571,54 +2566,54 @@ unsigned e6809_sstep (unsigned irq_i, unsigned irq_f)
 	/* page 2 instructions */
 
 	case 0x11:
-		op = pc_read8 ();
+		op = pc_read8 (cpu);
 
 		switch (op) {
 		/* cmpu */
 		case 0x83:
-			inst_sub16 (reg_u, pc_read16 ());
+			inst_sub16 (cpu, cpu->u, pc_read16 (cpu));
 			cycles += 5;
 			break;
 		case 0x93:
-			ea = ea_direct ();
-			inst_sub16 (reg_u, read16 (ea));
+			ea = ea_direct (cpu);
+			inst_sub16 (cpu, cpu->u, read16 (cpu, ea));
 			cycles += 7;
 			break;
 		case 0xa3:
-			ea = ea_indexed (&cycles);
-			inst_sub16 (reg_u, read16 (ea));
+			ea = ea_indexed (cpu, &cycles);
+			inst_sub16 (cpu, cpu->u, read16 (cpu, ea));
 			cycles += 7;
 			break;
 		case 0xb3:
-			ea = ea_extended ();
-			inst_sub16 (reg_u, read16 (ea));
+			ea = ea_extended (cpu);
+			inst_sub16 (cpu, cpu->u, read16 (cpu, ea));
 			cycles += 8;
 			break;
 		/* cmps */
 		case 0x8c:
-			inst_sub16 (reg_s, pc_read16 ());
+			inst_sub16 (cpu, cpu->s, pc_read16 (cpu));
 			cycles += 5;
 			break;
 		case 0x9c:
-			ea = ea_direct ();
-			inst_sub16 (reg_s, read16 (ea));
+			ea = ea_direct (cpu);
+			inst_sub16 (cpu, cpu->s, read16 (cpu, ea));
 			cycles += 7;
 			break;
 		case 0xac:
-			ea = ea_indexed (&cycles);
-			inst_sub16 (reg_s, read16 (ea));
+			ea = ea_indexed (cpu, &cycles);
+			inst_sub16 (cpu, cpu->s, read16 (cpu, ea));
 			cycles += 7;
 			break;
 		case 0xbc:
-			ea = ea_extended ();
-			inst_sub16 (reg_s, read16 (ea));
+			ea = ea_extended (cpu);
+			inst_sub16 (cpu, cpu->s, read16 (cpu, ea));
 			cycles += 8;
 			break;
 		/* swi3 */
 		case 0x3f:
-			set_cc (FLAG_E, 1);
-			inst_psh (0xff, &reg_s, reg_u, &cycles);
-		    reg_pc = read16 (0xfff2);
+			set_cc (cpu, FLAG_E, 1);
+			inst_psh (cpu, 0xff, &cpu->s, cpu->u, &cycles);
+		    cpu->pc = read16 (cpu, 0xfff2);
 			cycles += 8;
 			break;
 		default:
@@ -2636,17 +2631,79 @@ unsigned e6809_sstep (unsigned irq_i, unsigned irq_f)
 	return cycles;
 }
 
-struct reg6809 *e6809_get_regs(void)
+/* execute a single instruction or handle interrupts and return */
+
+unsigned e6809_sstep (struct e6809 *cpu, unsigned irq_i, unsigned irq_f)
 {
-	static struct reg6809 r;
-	r.x = reg_x;
-	r.y = reg_y;
-	r.u = reg_u;
-	r.s = reg_s;
-	r.pc = reg_pc;
-	r.a = reg_a;
-	r.b = reg_b;
-	r.dp = reg_dp;
-	r.cc = reg_cc;
-	return &r;
+	unsigned cycles = 0;
+
+	if (irq_i || irq_f)
+		cycles = e6809_interrupt (cpu, irq_i, irq_f);
+	if (cpu->irq_status != IRQ_NORMAL)
+		return cycles + 1;
+	return cycles + e6809_execute (cpu);
+}
+
+/* run instructions until at least the given number of cycles have passed
+ * and return the cycles actually used. the interrupt lines are fetched
+ * from irq at the start and again after any instruction that went to
+ * e6809_read8 or e6809_write8, as only those can change device state.
+ * irq may be NULL if nothing interrupts the processor.
+ */
+
+unsigned e6809_run (struct e6809 *cpu, unsigned cycles, e6809_irq_t irq)
+{
+	unsigned used = 0;
+	unsigned lines = irq ? irq(cpu) : 0;
+
+	while (used < cycles) {
+		cpu->io = 0;
+		if (lines)
+			used += e6809_interrupt (cpu, lines & E6809_IRQ,
+						lines & E6809_FIRQ);
+		if (cpu->irq_status == IRQ_NORMAL)
+			used += e6809_execute (cpu);
+		else {
+			/* in sync or cwai, and nothing can change until the
+			   next run */
+			return cycles;
+		}
+		if (cpu->io && irq)
+			lines = irq(cpu);
+	}
+	return used;
+}
+
+/* map 256 byte pages of the address space straight onto host memory.
+ * base NULL returns those pages to e6809_read8 and e6809_write8.
+ */
+
+void e6809_map (struct e6809 *cpu, unsigned addr, unsigned len,
+		uint8_t *base, unsigned writable)
+{
+	unsigned page = (addr >> 8) & 0xff;
+	unsigned n = len >> 8;
+
+	while (n--) {
+		cpu->rmap[page] = base;
+		cpu->wmap[page] = writable ? base : NULL;
+		if (base)
+			base += 0x100;
+		page = (page + 1) & 0xff;
+	}
+}
+
+struct reg6809 *e6809_get_regs(struct e6809 *cpu)
+{
+	struct reg6809 *r = &cpu->regs;
+	r->x = cpu->x;
+	r->y = cpu->y;
+	r->u = cpu->u;
+	r->s = cpu->s;
+	r->pc = cpu->pc;
+	r->a = cpu->a;
+	r->b = cpu->b;
+	r->dp = cpu->dp;
+	r->cc = cpu->cc;
+	return r;
 }
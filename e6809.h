@@ -3,22 +3,51 @@
 
 #include <stdint.h>
 
-/* user defined read and write functions */
-
-extern unsigned char e6809_read8(unsigned address);
-extern void e6809_write8(unsigned address, unsigned char data);
-
-extern void e6809_instruction(unsigned address);
-
-void e6809_reset (int trace);
-unsigned e6809_sstep (unsigned irq_i, unsigned irq_f);
-
 struct reg6809 {
     uint16_t pc;
     uint16_t x,y,u,s;
     uint8_t a,b,dp,cc;
 };
 
-struct reg6809 *e6809_get_regs(void);
+struct e6809 {
+    /* registers, only the low 8 or 16 bits are valid */
+    unsigned x, y, u, s;
+    unsigned pc;
+    unsigned a, b;
+    unsigned dp;
+    unsigned cc;
+    /* sync/cwai state */
+    unsigned irq_status;
+    unsigned *rptr_xyus[4];
+    /* call e6809_instruction before each instruction */
+    unsigned debug;
+    /* set when an access went to e6809_read8/e6809_write8 */
+    unsigned io;
+    /* host memory for each 256 byte page, or NULL to use the callbacks */
+    uint8_t *rmap[256];
+    uint8_t *wmap[256];
+    struct reg6809 regs;
+};
+
+/* interrupt lines returned by an e6809_irq_t */
+#define E6809_IRQ	1
+#define E6809_FIRQ	2
+
+typedef unsigned (*e6809_irq_t)(struct e6809 *cpu);
+
+/* user defined read and write functions */
+
+extern unsigned char e6809_read8(struct e6809 *cpu, unsigned address);
+extern void e6809_write8(struct e6809 *cpu, unsigned address, unsigned char data);
+
+extern void e6809_instruction(struct e6809 *cpu, unsigned address);
+
+void e6809_reset (struct e6809 *cpu, int trace);
+unsigned e6809_sstep (struct e6809 *cpu, unsigned irq_i, unsigned irq_f);
+unsigned e6809_run (struct e6809 *cpu, unsigned cycles, e6809_irq_t irq);
+void e6809_map (struct e6809 *cpu, unsigned addr, unsigned len,
+		uint8_t *base, unsigned writable);
+
+struct reg6809 *e6809_get_regs(struct e6809 *cpu);
 
 #endif
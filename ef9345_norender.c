@@ -23,7 +23,7 @@ void ef9345_render(struct ef9345_renderer *render)
 {
 }
 
-void ef8345_renderer_free(struct ef9345_renderer *render)
+void ef9345_renderer_free(struct ef9345_renderer *render)
 {
 }
 
@@ -49,10 +49,15 @@ void ef9345_render(struct ef9345_renderer *render)
     SDL_RenderPresent(render->render);
 }
 
-void ef8345_renderer_free(struct ef9345_renderer *render)
+void ef9345_renderer_free(struct ef9345_renderer *render)
 {
     if (render->texture)
         SDL_DestroyTexture(render->texture);
+    if (render->render)
+        SDL_DestroyRenderer(render->render);
+    if (render->window)
+        SDL_DestroyWindow(render->window);
+    free(render);
 }
 
 
@@ -0,0 +1,718 @@
+/*
+ *	On chip peripherals of the 80C188
+ *
+ *	The peripheral control block sits at I/O 0xFF00 from reset and holds
+ *	the interrupt controller (master mode only), the three timers, the
+ *	chip select registers and the two DMA channels.
+ *
+ *	The timers are not clocked every instruction. They are brought up
+ *	to date from the CPU clock when the PCB is touched or an event falls
+ *	due, and the board asks for the time of the next expiry so it can
+ *	run the CPU straight up to it.
+ *
+ *	Not modelled: memory mapped PCB, slave (iRMX) mode, cascade and
+ *	special fully nested modes, the timer input pins (taken as tied
+ *	high, so timers with EXT set never count and the gate is always
+ *	open) and the DRQ pins. DMA runs unsynchronised transfers to
+ *	completion when started and timer 2 synchronised transfers one per
+ *	timer 2 expiry.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "80x86/e8086.h"
+#include "i80188_io.h"
+
+/* Timer control */
+#define TCON_EN		0x8000
+#define TCON_INH	0x4000
+#define TCON_INT	0x2000
+#define TCON_RIU	0x1000
+#define TCON_MC		0x0020
+#define TCON_RTG	0x0010
+#define TCON_P		0x0008
+#define TCON_EXT	0x0004
+#define TCON_ALT	0x0002
+#define TCON_CONT	0x0001
+
+/* DMA control */
+#define DCON_DM		0x8000
+#define DCON_DDEC	0x4000
+#define DCON_DINC	0x2000
+#define DCON_SM		0x1000
+#define DCON_SDEC	0x0800
+#define DCON_SINC	0x0400
+#define DCON_TC		0x0200
+#define DCON_INT	0x0100
+#define DCON_SYN	0x00C0
+#define DCON_P		0x0020
+#define DCON_TDRQ	0x0010
+#define DCON_CHG	0x0004
+#define DCON_ST		0x0002
+#define DCON_BW		0x0001
+
+/* Interrupt sources in the order they tie at equal priority */
+#define SRC_TMR		0
+#define SRC_DMA0	1
+#define SRC_DMA1	2
+#define SRC_INT0	3
+#define NUM_SRC		7
+
+/* Interrupt source control registers */
+#define ICON_PRI	0x0007
+#define ICON_MSK	0x0008
+#define ICON_LTM	0x0010
+
+#define INTSTS_DHLT	0x8000
+
+static const uint8_t src_bit[NUM_SRC] = {
+	0x01, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80
+};
+
+struct i80188_timer {
+	uint16_t count;
+	uint16_t cmpa;
+	uint16_t cmpb;
+	uint16_t con;
+};
+
+struct i80188_dma {
+	uint32_t src;
+	uint32_t dst;
+	uint16_t tc;
+	uint16_t con;
+};
+
+struct i80188_io {
+	e8086_t *cpu;
+	uint16_t relreg;
+	/* Interrupt controller */
+	uint16_t icon[NUM_SRC];
+	uint8_t reqst;
+	uint8_t inserv;
+	uint8_t primsk;
+	uint16_t intsts;
+	uint8_t pins;
+	/* Timers count at a quarter of the CPU clock */
+	struct i80188_timer timer[3];
+	unsigned prediv;
+	unsigned long last;
+	/* UMCS LMCS PACS MMCS MPCS */
+	uint16_t cs[5];
+	struct i80188_dma dma[2];
+	int trace;
+};
+
+static int i80188_pick(struct i80188_io *io)
+{
+	unsigned inpri = 8;
+	int best = -1;
+	unsigned bestpri = 8;
+	unsigned pri;
+	int i;
+
+	for (i = 0; i < NUM_SRC; i++) {
+		pri = io->icon[i] & ICON_PRI;
+		if ((io->inserv & src_bit[i]) && pri < inpri)
+			inpri = pri;
+	}
+	for (i = 0; i < NUM_SRC; i++) {
+		if (!(io->reqst & src_bit[i]) || (io->icon[i] & ICON_MSK))
+			continue;
+		pri = io->icon[i] & ICON_PRI;
+		/* Fully nested: only strictly higher priority interrupts
+		   a handler already in service */
+		if (pri > io->primsk || pri >= inpri)
+			continue;
+		if (pri < bestpri) {
+			best = i;
+			bestpri = pri;
+		}
+	}
+	return best;
+}
+
+static void i80188_update_irq(struct i80188_io *io)
+{
+	e86_irq(io->cpu, i80188_pick(io) >= 0);
+}
+
+static uint8_t i80188_vector(struct i80188_io *io, int src)
+{
+	if (src == SRC_TMR) {
+		if (io->intsts & 1)
+			return 8;
+		if (io->intsts & 2)
+			return 18;
+		return 19;
+	}
+	if (src == SRC_DMA0)
+		return 10;
+	if (src == SRC_DMA1)
+		return 11;
+	return 12 + src - SRC_INT0;
+}
+
+/* Acknowledge the best pending interrupt and return its type */
+static uint8_t i80188_ack(struct i80188_io *io, int src)
+{
+	uint8_t vec = i80188_vector(io, src);
+
+	io->inserv |= src_bit[src];
+	if (src == SRC_TMR) {
+		io->intsts &= ~(1 << (vec == 8 ? 0 : vec - 17));
+		if (!(io->intsts & 7))
+			io->reqst &= ~src_bit[src];
+	} else if (src < SRC_INT0 || !(io->icon[src] & ICON_LTM))
+		io->reqst &= ~src_bit[src];
+	if (io->trace)
+		fprintf(stderr, "80C188: interrupt type %u\n", vec);
+	i80188_update_irq(io);
+	return vec;
+}
+
+static unsigned char i80188_inta(void *ext)
+{
+	struct i80188_io *io = ext;
+	int src = i80188_pick(io);
+	/* The request went away between sampling and acknowledge */
+	if (src < 0)
+		return 7;
+	return i80188_ack(io, src);
+}
+
+static void i80188_eoi(struct i80188_io *io, uint16_t val)
+{
+	int i;
+	int best = -1;
+
+	if (val & 0x8000) {
+		/* Non specific: the highest priority in service */
+		for (i = 0; i < NUM_SRC; i++) {
+			if (!(io->inserv & src_bit[i]))
+				continue;
+			if (best < 0 || (io->icon[i] & ICON_PRI) < (io->icon[best] & ICON_PRI))
+				best = i;
+		}
+	} else {
+		val &= 0x1F;
+		if (val == 8)
+			best = SRC_TMR;
+		else if (val == 10)
+			best = SRC_DMA0;
+		else if (val == 11)
+			best = SRC_DMA1;
+		else if (val >= 12 && val <= 15)
+			best = SRC_INT0 + val - 12;
+	}
+	if (best >= 0)
+		io->inserv &= ~src_bit[best];
+}
+
+static void i80188_request(struct i80188_io *io, int src)
+{
+	io->reqst |= src_bit[src];
+	i80188_update_irq(io);
+}
+
+void i80188_int_pin(struct i80188_io *io, unsigned pin, bool level)
+{
+	unsigned src = SRC_INT0 + pin;
+	uint8_t bit = 1 << pin;
+	uint8_t old = io->pins & bit;
+
+	if (level)
+		io->pins |= bit;
+	else
+		io->pins &= ~bit;
+	if (io->icon[src] & ICON_LTM) {
+		if (level)
+			io->reqst |= src_bit[src];
+		else
+			io->reqst &= ~src_bit[src];
+	} else if (level && !old)
+		io->reqst |= src_bit[src];
+	i80188_update_irq(io);
+}
+
+/*
+ *	DMA
+ */
+
+static uint32_t i80188_dma_step(uint32_t addr, uint16_t con, uint16_t inc, uint16_t dec, unsigned size)
+{
+	if ((con & (inc | dec)) == inc)
+		addr += size;
+	else if ((con & (inc | dec)) == dec)
+		addr -= size;
+	return addr & 0xFFFFF;
+}
+
+/* Move one byte or word and return the bus clocks it took */
+static unsigned i80188_dma_xfer(struct i80188_io *io, unsigned ch)
+{
+	struct i80188_dma *d = &io->dma[ch];
+	e8086_t *cpu = io->cpu;
+	unsigned size = (d->con & DCON_BW) ? 2 : 1;
+	unsigned i;
+	uint8_t v;
+
+	/* The 80C188 bus is 8 bits wide so a word is two byte transfers */
+	for (i = 0; i < size; i++) {
+		if (d->con & DCON_SM)
+			v = e86_get_mem8(cpu, (d->src + i) >> 4, (d->src + i) & 0x0F);
+		else
+			v = e86_get_prt8(cpu, (d->src + i) & 0xFFFF);
+		if (d->con & DCON_DM)
+			e86_set_mem8(cpu, (d->dst + i) >> 4, (d->dst + i) & 0x0F, v);
+		else
+			e86_set_prt8(cpu, (d->dst + i) & 0xFFFF, v);
+	}
+	d->src = i80188_dma_step(d->src, d->con, DCON_SINC, DCON_SDEC, size);
+	d->dst = i80188_dma_step(d->dst, d->con, DCON_DINC, DCON_DDEC, size);
+	d->tc--;
+	if ((d->con & DCON_TC) && d->tc == 0) {
+		d->con &= ~DCON_ST;
+		if (d->con & DCON_INT)
+			i80188_request(io, SRC_DMA0 + ch);
+	}
+	return 8 * size;
+}
+
+static bool i80188_dma_ready(struct i80188_io *io, unsigned ch)
+{
+	return (io->dma[ch].con & DCON_ST) && !(io->intsts & INTSTS_DHLT);
+}
+
+/* An unsynchronised channel has the bus until it finishes. The CPU is
+   held off the bus for the time taken */
+static void i80188_dma_run(struct i80188_io *io, unsigned ch)
+{
+	struct i80188_dma *d = &io->dma[ch];
+	unsigned long clocks = 0;
+	unsigned n = d->tc ? d->tc : 0x10000;
+
+	if (!i80188_dma_ready(io, ch) || (d->con & (DCON_SYN | DCON_TDRQ)))
+		return;
+	/* Without terminal count the channel would run until stopped; we
+	   stop after one pass of the count instead */
+	while (n-- && (d->con & DCON_ST))
+		clocks += i80188_dma_xfer(io, ch);
+	d->con &= ~DCON_ST;
+	io->cpu->delay += clocks;
+	if (io->trace)
+		fprintf(stderr, "80C188: DMA%u done in %lu clocks\n", ch, clocks);
+}
+
+/*
+ *	Timers
+ */
+
+static uint32_t i80188_timer_max(struct i80188_timer *t)
+{
+	uint16_t m = (t->con & TCON_RIU) ? t->cmpb : t->cmpa;
+	return m ? m : 0x10000;
+}
+
+/* Ticks until the count next reaches the max count */
+static uint32_t i80188_timer_left(struct i80188_timer *t)
+{
+	uint32_t m = i80188_timer_max(t);
+	if (t->count < m)
+		return m - t->count;
+	return 0x10000 - t->count + m;
+}
+
+/* Run a timer on by some ticks and return how many times it expired */
+static unsigned i80188_timer_run(struct i80188_io *io, unsigned n, uint32_t ticks)
+{
+	struct i80188_timer *t = &io->timer[n];
+	uint32_t left;
+	unsigned exp = 0;
+
+	while (ticks && (t->con & TCON_EN)) {
+		left = i80188_timer_left(t);
+		if (ticks < left) {
+			t->count += ticks;
+			break;
+		}
+		ticks -= left;
+		t->count = 0;
+		exp++;
+		t->con |= TCON_MC;
+		if (t->con & TCON_INT) {
+			io->intsts |= 1 << n;
+			io->reqst |= src_bit[SRC_TMR];
+		}
+		if (t->con & TCON_ALT) {
+			t->con ^= TCON_RIU;
+			if (!(t->con & (TCON_RIU | TCON_CONT)))
+				t->con &= ~TCON_EN;
+		} else if (!(t->con & TCON_CONT))
+			t->con &= ~TCON_EN;
+		else if (ticks >= i80188_timer_max(t)) {
+			/* Free running: skip whole periods in one go */
+			exp += ticks / i80188_timer_max(t);
+			ticks %= i80188_timer_max(t);
+		}
+	}
+	return exp;
+}
+
+static void i80188_advance(struct i80188_io *io, unsigned long clocks)
+{
+	uint32_t ticks;
+	unsigned t2;
+	unsigned i;
+
+	clocks += io->prediv;
+	ticks = clocks >> 2;
+	io->prediv = clocks & 3;
+	if (ticks == 0)
+		return;
+
+	t2 = i80188_timer_run(io, 2, ticks);
+	for (i = 0; i < 2; i++) {
+		if (io->timer[i].con & TCON_EXT)
+			continue;
+		i80188_timer_run(io, i, (io->timer[i].con & TCON_P) ? t2 : ticks);
+	}
+	/* Timer 2 requests one transfer per expiry */
+	for (i = 0; i < 2; i++) {
+		unsigned n = t2;
+		while (n-- && i80188_dma_ready(io, i) && (io->dma[i].con & DCON_TDRQ))
+			io->cpu->delay += i80188_dma_xfer(io, i);
+	}
+	i80188_update_irq(io);
+}
+
+void i80188_sync(struct i80188_io *io)
+{
+	unsigned long now = e86_get_clock(io->cpu);
+	i80188_advance(io, now - io->last);
+	io->last = now;
+}
+
+unsigned long i80188_next_event(struct i80188_io *io)
+{
+	struct i80188_timer *t2 = &io->timer[2];
+	uint32_t ticks = 0xFFFFFFFF;
+	uint32_t k2 = 0;
+	uint32_t k;
+	bool t2run = (t2->con & TCON_EN) != 0;
+	unsigned i;
+
+	i80188_sync(io);
+
+	if (t2run) {
+		k2 = i80188_timer_left(t2);
+		/* Only wake for timer 2 if something sees it expire */
+		if (t2->con & TCON_INT)
+			ticks = k2;
+		for (i = 0; i < 2; i++)
+			if (i80188_dma_ready(io, i) && (io->dma[i].con & DCON_TDRQ))
+				ticks = k2;
+	}
+	for (i = 0; i < 2; i++) {
+		struct i80188_timer *t = &io->timer[i];
+		if ((t->con & (TCON_EN | TCON_INT | TCON_EXT)) != (TCON_EN | TCON_INT))
+			continue;
+		k = i80188_timer_left(t);
+		if (t->con & TCON_P) {
+			/* Counts timer 2 expiries */
+			if (!t2run || (k > 1 && !(t2->con & TCON_CONT)))
+				continue;
+			k = k2 + (k - 1) * i80188_timer_max(t2);
+		}
+		if (k < ticks)
+			ticks = k;
+	}
+	if (ticks == 0xFFFFFFFF)
+		return ~0UL;
+	return 4UL * ticks - io->prediv;
+}
+
+/*
+ *	Register access
+ */
+
+bool i80188_iospace(struct i80188_io *io, uint16_t addr)
+{
+	/* A memory mapped PCB does not appear in I/O space */
+	if (io->relreg & 0x1000)
+		return false;
+	return (addr >> 8) == (io->relreg & 0xFF);
+}
+
+static void i80188_timer_con(struct i80188_io *io, unsigned n, uint16_t val)
+{
+	struct i80188_timer *t = &io->timer[n];
+	uint16_t keep = TCON_RIU;
+	uint16_t old = t->con;
+
+	if (!(val & TCON_INH))
+		keep |= TCON_EN;
+	val &= TCON_EN | TCON_INT | TCON_MC | TCON_CONT |
+		(n < 2 ? TCON_RTG | TCON_P | TCON_EXT | TCON_ALT : 0);
+	t->con = (val & ~keep) | (old & keep);
+	/* Starting again begins from compare A */
+	if ((t->con & TCON_EN) && !(old & TCON_EN))
+		t->con &= ~TCON_RIU;
+	if (io->trace)
+		fprintf(stderr, "80C188: T%ucon %04X\n", n, t->con);
+}
+
+static uint16_t i80188_get(struct i80188_io *io, uint8_t r, bool ack)
+{
+	unsigned i;
+	int src;
+	uint16_t v;
+
+	if (r >= 0x32 && r <= 0x3E)
+		return io->icon[(r - 0x32) >> 1];
+	if (r >= 0x50 && r <= 0x66) {
+		struct i80188_timer *t = &io->timer[(r - 0x50) >> 3];
+		switch (r & 6) {
+		case 0:
+			return t->count;
+		case 2:
+			return t->cmpa;
+		case 4:
+			return t->cmpb;
+		case 6:
+			return t->con;
+		}
+	}
+	if (r >= 0xA0 && r <= 0xA8)
+		return io->cs[(r - 0xA0) >> 1];
+	if (r >= 0xC0 && r <= 0xDA) {
+		struct i80188_dma *d = &io->dma[(r - 0xC0) >> 4];
+		switch (r & 0x0E) {
+		case 0x00:
+			return d->src;
+		case 0x02:
+			return d->src >> 16;
+		case 0x04:
+			return d->dst;
+		case 0x06:
+			return d->dst >> 16;
+		case 0x08:
+			return d->tc;
+		case 0x0A:
+			return d->con & ~DCON_CHG;
+		}
+	}
+	switch (r) {
+	case 0x24:	/* POLL */
+	case 0x26:	/* POLLSTS */
+		src = i80188_pick(io);
+		if (src < 0)
+			return 0;
+		if (r == 0x24 && ack)
+			return 0x8000 | i80188_ack(io, src);
+		return 0x8000 | i80188_vector(io, src);
+	case 0x28:	/* IMASK */
+		v = 0;
+		for (i = 0; i < NUM_SRC; i++)
+			if (io->icon[i] & ICON_MSK)
+				v |= src_bit[i];
+		return v;
+	case 0x2A:
+		return io->primsk;
+	case 0x2C:
+		return io->inserv;
+	case 0x2E:
+		return io->reqst;
+	case 0x30:
+		return io->intsts;
+	case 0xFE:
+		return io->relreg;
+	}
+	if (io->trace)
+		fprintf(stderr, "80C188: read of unknown PCB register %02X\n", r);
+	return 0;
+}
+
+static void i80188_put(struct i80188_io *io, uint8_t r, uint16_t val)
+{
+	unsigned i;
+
+	if (r >= 0x32 && r <= 0x3E) {
+		/* Only the external pins have trigger mode and cascade bits */
+		i = (r - 0x32) >> 1;
+		io->icon[i] = val & (i >= SRC_INT0 ? 0x7F : 0x0F);
+		return;
+	}
+	if (r >= 0x50 && r <= 0x66) {
+		struct i80188_timer *t = &io->timer[(r - 0x50) >> 3];
+		switch (r & 6) {
+		case 0:
+			t->count = val;
+			break;
+		case 2:
+			t->cmpa = val;
+			break;
+		case 4:
+			t->cmpb = val;
+			break;
+		case 6:
+			i80188_timer_con(io, (r - 0x50) >> 3, val);
+			break;
+		}
+		return;
+	}
+	if (r >= 0xA0 && r <= 0xA8) {
+		io->cs[(r - 0xA0) >> 1] = val;
+		return;
+	}
+	if (r >= 0xC0 && r <= 0xDA) {
+		unsigned ch = (r - 0xC0) >> 4;
+		struct i80188_dma *d = &io->dma[ch];
+		switch (r & 0x0E) {
+		case 0x00:
+			d->src = (d->src & 0xF0000) | val;
+			break;
+		case 0x02:
+			d->src = (d->src & 0xFFFF) | ((uint32_t)(val & 0x0F) << 16);
+			break;
+		case 0x04:
+			d->dst = (d->dst & 0xF0000) | val;
+			break;
+		case 0x06:
+			d->dst = (d->dst & 0xFFFF) | ((uint32_t)(val & 0x0F) << 16);
+			break;
+		case 0x08:
+			d->tc = val;
+			break;
+		case 0x0A:
+			if (val & DCON_CHG)
+				d->con = val & ~DCON_CHG;
+			else
+				d->con = (val & ~(DCON_CHG | DCON_ST)) | (d->con & DCON_ST);
+			i80188_dma_run(io, ch);
+			break;
+		}
+		return;
+	}
+	switch (r) {
+	case 0x22:
+		i80188_eoi(io, val);
+		break;
+	case 0x28:
+		for (i = 0; i < NUM_SRC; i++) {
+			if (val & src_bit[i])
+				io->icon[i] |= ICON_MSK;
+			else
+				io->icon[i] &= ~ICON_MSK;
+		}
+		break;
+	case 0x2A:
+		io->primsk = val & 7;
+		break;
+	case 0x2C:
+		io->inserv = val & 0xFD;
+		break;
+	case 0x30:
+		io->intsts = val & (INTSTS_DHLT | 7);
+		if (io->intsts & 7)
+			io->reqst |= src_bit[SRC_TMR];
+		else
+			io->reqst &= ~src_bit[SRC_TMR];
+		break;
+	case 0xFE:
+		io->relreg = val;
+		if (val & 0x5000)
+			fprintf(stderr, "80C188: memory mapped PCB and slave mode are not supported.\n");
+		break;
+	default:
+		if (io->trace)
+			fprintf(stderr, "80C188: write to unknown PCB register %02X of %04X\n", r, val);
+	}
+}
+
+uint16_t i80188_read(struct i80188_io *io, uint16_t addr)
+{
+	uint16_t r;
+
+	i80188_sync(io);
+	r = i80188_get(io, addr & 0xFE, true);
+	if (io->trace)
+		fprintf(stderr, "80C188: R %02X = %04X\n", addr & 0xFE, r);
+	return r;
+}
+
+void i80188_write(struct i80188_io *io, uint16_t addr, uint16_t val)
+{
+	i80188_sync(io);
+	if (io->trace)
+		fprintf(stderr, "80C188: W %02X = %04X\n", addr & 0xFE, val);
+	i80188_put(io, addr & 0xFE, val);
+	i80188_update_irq(io);
+	/* The next event may have moved, so hand back to the board */
+	e86_stop_at(io->cpu, e86_get_clock(io->cpu));
+}
+
+/* The PCB is 16 bits wide. Byte accesses from the 8 bit bus see the
+   half they address, and a byte write leaves the other half alone */
+uint8_t i80188_read8(struct i80188_io *io, uint16_t addr)
+{
+	if (addr & 1) {
+		i80188_sync(io);
+		return i80188_get(io, addr & 0xFE, false) >> 8;
+	}
+	return i80188_read(io, addr);
+}
+
+void i80188_write8(struct i80188_io *io, uint16_t addr, uint8_t val)
+{
+	uint16_t r;
+
+	i80188_sync(io);
+	r = i80188_get(io, addr & 0xFE, false);
+	if (addr & 1)
+		r = (r & 0x00FF) | (val << 8);
+	else
+		r = (r & 0xFF00) | val;
+	i80188_write(io, addr, r);
+}
+
+static void i80188_reset(struct i80188_io *io)
+{
+	unsigned i;
+
+	io->relreg = 0x20FF;
+	for (i = 0; i < NUM_SRC; i++)
+		io->icon[i] = ICON_MSK | ICON_PRI;
+	io->primsk = 7;
+	io->cs[0] = 0xFFFB;
+}
+
+struct i80188_io *i80188_create(e8086_t *cpu)
+{
+	struct i80188_io *io = malloc(sizeof(struct i80188_io));
+	if (io == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+	memset(io, 0, sizeof(struct i80188_io));
+	io->cpu = cpu;
+	io->last = e86_get_clock(cpu);
+	i80188_reset(io);
+	/* e86_set_inta_fct takes the handler as a void pointer */
+	cpu->inta_ext = io;
+	cpu->inta = i80188_inta;
+	return io;
+}
+
+void i80188_free(struct i80188_io *io)
+{
+	free(io);
+}
+
+void i80188_trace(struct i80188_io *io, int trace)
+{
+	io->trace = trace;
+}
@@ -0,0 +1,16 @@
+struct i80188_io;
+
+bool i80188_iospace(struct i80188_io *io, uint16_t addr);
+uint16_t i80188_read(struct i80188_io *io, uint16_t addr);
+void i80188_write(struct i80188_io *io, uint16_t addr, uint16_t val);
+uint8_t i80188_read8(struct i80188_io *io, uint16_t addr);
+void i80188_write8(struct i80188_io *io, uint16_t addr, uint8_t val);
+/* Bring the timers up to the CPU clock */
+void i80188_sync(struct i80188_io *io);
+/* CPU clocks until the next timer event, or ~0UL if none is due */
+unsigned long i80188_next_event(struct i80188_io *io);
+/* External INT0-INT3 pins */
+void i80188_int_pin(struct i80188_io *io, unsigned pin, bool level);
+struct i80188_io *i80188_create(e8086_t *cpu);
+void i80188_free(struct i80188_io *io);
+void i80188_trace(struct i80188_io *io, int trace);
@@ -122,6 +122,19 @@ static uint16_t le16(uint16_t v)
   return p[0] | (p[1] << 8);
 }
 
+static uint32_t le32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
 static void ide_xlate_errno(struct ide_taskfile *t, int len)
 {
   t->status |= ST_ERR;
@@ -456,12 +469,45 @@ static void ide_set_error(struct ide_drive *d)
   completed(&d->taskfile);
 }
 
+/*
+ *	Sparse images keep a bitmap of the data sectors that have been
+ *	written. Sectors the map does not cover count as written.
+ */
+static int ide_written(struct ide_drive *d, off_t sector)
+{
+  sector -= 2;
+  if (sector < 0 || sector >= (off_t)d->maplen * 8)
+    return 1;
+  return d->map[sector >> 3] & (1 << (sector & 7));
+}
+
+/*
+ *	Record a sector as written. The data goes to disk before the map so
+ *	a crash in between loses only the new contents of that sector.
+ */
+static int ide_mark_written(struct ide_drive *d, off_t sector)
+{
+  off_t byte = (sector - 2) >> 3;
+
+  d->map[byte] |= 1 << ((sector - 2) & 7);
+  if (pwrite(d->fd, d->map + byte, 1, d->mappos + byte) != 1)
+    return -1;
+  return 0;
+}
+
 static int ide_read_sector(struct ide_drive *d)
 {
   int len;
 
   d->dptr = d->data;
-  if ((len = read(d->fd, d->data, 512)) != 512) {
+  if (d->map && d->offset * 512 >= d->mappos)
+    len = 0;		/* Past the data, into the map */
+  else if (d->map && !ide_written(d, d->offset)) {
+    memset(d->data, d->fill, 512);
+    len = 512;
+  } else
+    len = pread(d->fd, d->data, 512, d->offset * 512);
+  if (len != 512) {
     perror("ide_read_sector");
     d->taskfile.status |= ST_ERR;
     d->taskfile.status &= ~ST_DSC;
@@ -469,7 +515,7 @@ static int ide_read_sector(struct ide_drive *d)
     return -1;
   }
   HEXDUMP_DATA(d->data)
-  d->offset += 512;
+  d->offset++;
   return 0;
 }
 
@@ -478,14 +524,21 @@ static int ide_write_sector(struct ide_drive *d)
   int len;
 
   d->dptr = d->data;
-  if ((len = write(d->fd, d->data, 512)) != 512) {
+  if (d->map && d->offset * 512 >= d->mappos)
+    len = 0;		/* Past the data, into the map */
+  else
+    len = pwrite(d->fd, d->data, 512, d->offset * 512);
+  if (len == 512 && d->map && !ide_written(d, d->offset) &&
+      ide_mark_written(d, d->offset) == -1)
+    len = -1;
+  if (len != 512) {
     d->taskfile.status |= ST_ERR;
     d->taskfile.status &= ~ST_DSC;
     ide_xlate_errno(&d->taskfile, len);
     return -1;
   }
   HEXDUMP_DATA(d->data)
-  d->offset += 512;
+  d->offset++;
   return 0;
 }
 
@@ -759,6 +812,22 @@ int ide_attach(struct ide_controller *c, int drive, int fd)
     ide_fault(d, "bad magic");
     return -1;
   }
+  d->map = NULL;
+  if (d->data[IDE_HDR_SPARSE] == 'S') {
+    d->fill = d->data[IDE_HDR_FILL];
+    d->mappos = (off_t)le32(d->data + IDE_HDR_MAP) * 512;
+    d->maplen = le32(d->data + IDE_HDR_MAPLEN);
+    if (d->maplen == 0 || (d->map = malloc(d->maplen)) == NULL) {
+      ide_fault(d, "bad allocation map");
+      return -1;
+    }
+    if (pread(fd, d->map, d->maplen, d->mappos) != (ssize_t)d->maplen) {
+      ide_fault(d, "i/o error on attach");
+      free(d->map);
+      d->map = NULL;
+      return -1;
+    }
+  }
   d->fd = fd;
   d->present = 1;
   d->heads = le16(d->identify[3]);
@@ -779,6 +848,8 @@ void ide_detach(struct ide_drive *d)
   close(d->fd);
   d->fd = -1;
   d->present = 0;
+  free(d->map);
+  d->map = NULL;
 }
 
 /*
@@ -846,7 +917,11 @@ static void make_serial(uint16_t *p)
   make_ascii(p, buf, 20);
 }
 
-int ide_make_drive(uint8_t type, int fd)
+/*
+ *	Write the header and identify blocks for a new drive image and
+ *	return the number of data sectors, or a negative error.
+ */
+static long ide_make_header(uint8_t type, int fd)
 {
   uint8_t s, h;
   uint16_t c;
@@ -861,7 +936,7 @@ int ide_make_drive(uint8_t type, int fd)
   if (write(fd, ident, 512) != 512)
     return -1;
 
-  memset(ident, 0, 8);
+  memset(ident, 0, 16);
   ident[0] = le16((1 << 15) | (1 << 6));	/* Non removable */
   make_serial(ident + 10);
   ident[47] = 0; /* no read multi for now */
@@ -936,10 +1011,59 @@ int ide_make_drive(uint8_t type, int fd)
   ident[61] = ident[58];
   if (write(fd, ident, 512) != 512)
     return -1;
+  return sectors;
+}
 
-  memset(ident, 0xE5, 512);
-  while(sectors--)
-    if (write(fd, ident, 512) != 512)
+/*
+ *	Create a drive image with every sector filled with 0xE5 so that
+ *	CP/M sees empty directories. Written in large chunks as the bigger
+ *	drive types run to hundreds of megabytes.
+ */
+int ide_make_drive(uint8_t type, int fd)
+{
+  static uint8_t buf[65536];
+  long sectors = ide_make_header(type, fd);
+  size_t len;
+
+  if (sectors < 0)
+    return sectors;
+  memset(buf, 0xE5, sizeof(buf));
+  while(sectors) {
+    len = sectors > 128 ? 128 : sectors;
+    if (write(fd, buf, len * 512) != len * 512)
       return -1;
+    sectors -= len;
+  }
+  return 0;
+}
+
+/*
+ *	Create a sparse drive image. The data area is left unwritten and an
+ *	allocation map after it records which sectors the guest has written.
+ *	The rest read back as the fill byte, so the image can be copied or
+ *	stored anywhere without losing track of them. On file systems with
+ *	holes only the sectors written take up space.
+ */
+int ide_make_sparse(uint8_t type, int fd)
+{
+  long sectors = ide_make_header(type, fd);
+  uint8_t hdr[IDE_HDR_MAPLEN + 4];
+  uint32_t maplen;
+
+  if (sectors < 0)
+    return sectors;
+  maplen = (sectors + 7) / 8;
+  /* The header block is otherwise zero past the magic */
+  memset(hdr, 0, sizeof(hdr));
+  hdr[IDE_HDR_SPARSE] = 'S';
+  hdr[IDE_HDR_FILL] = 0xE5;
+  put_le32(hdr + IDE_HDR_MAP, 2 + sectors);
+  put_le32(hdr + IDE_HDR_MAPLEN, maplen);
+  if (pwrite(fd, hdr + IDE_HDR_SPARSE, sizeof(hdr) - IDE_HDR_SPARSE,
+             IDE_HDR_SPARSE) != sizeof(hdr) - IDE_HDR_SPARSE)
+    return -1;
+  /* Data and map all read as zero, which in the map means unwritten */
+  if (ftruncate(fd, (2 + (off_t)sectors) * 512 + maplen) == -1)
+    return -1;
   return 0;
 }
@@ -58,6 +58,10 @@ struct ide_drive {
   int fd;
   off_t offset;
   int length;
+  uint8_t *map;			/* Sparse images: sectors written */
+  off_t mappos;
+  uint32_t maplen;
+  uint8_t fill;			/* Value unwritten sectors read as */
 };
 
 struct ide_controller {
@@ -69,6 +73,14 @@ struct ide_controller {
 
 extern const uint8_t ide_magic[8];
 
+/* Header block bytes following the magic. A sparse image has a bitmap of
+   the data sectors written, MAPLEN bytes starting at sector MAP (both 32bit
+   little endian). Sectors not yet written read back as the fill byte */
+#define IDE_HDR_SPARSE	8
+#define IDE_HDR_FILL	9
+#define IDE_HDR_MAP	12
+#define IDE_HDR_MAPLEN	16
+
 void ide_reset_begin(struct ide_controller *c);
 uint8_t ide_read8(struct ide_controller *c, uint8_t r);
 void ide_write8(struct ide_controller *c, uint8_t r, uint8_t v);
@@ -83,4 +95,5 @@ void ide_detach(struct ide_drive *d);
 void ide_free(struct ide_controller *c);
 
 int ide_make_drive(uint8_t type, int fd);
+int ide_make_sparse(uint8_t type, int fd);
 #endif
@@ -4,6 +4,11 @@
 
   Use this code for whatever you want. I don't care. It's officially public domain.
   Credit would be appreciated.
+
+  Reworked to keep the CPU state in a context structure and to evaluate the
+  flags lazily. The ALU operations record just enough about their result for
+  the flags to be worked out when something actually looks at them
+  (conditional branches, PUSH PSW, DAA and tracing).
 */
 
 #include <stdio.h>
@@ -16,35 +21,100 @@
 
 static char *i8080_disassemble(uint16_t addr);
 
-#define reg16_PSW (((uint16_t)reg8[A] << 8) | (uint16_t)reg8[FLAGS])
-#define reg16_BC (((uint16_t)reg8[B] << 8) | (uint16_t)reg8[C])
-#define reg16_DE (((uint16_t)reg8[D] << 8) | (uint16_t)reg8[E])
-#define reg16_HL (((uint16_t)reg8[H] << 8) | (uint16_t)reg8[L])
+struct i8080 {
+	/* Indexed by reg_t. The M slot is unused */
+	uint8_t reg[8];
+	uint16_t sp;
+	uint16_t pc;
+	uint8_t inte;
+	uint8_t halted;
+	uint8_t intpend;
+	/* Lazy flags. S and P come from res, Z from zres, AC is bit 4 of
+	   acx and carry is kept as 0 or 1. fbits holds the fixed bits */
+	uint8_t res;
+	uint8_t zres;
+	uint8_t acx;
+	uint8_t carry;
+	uint8_t fbits;
+};
 
-uint8_t reg8[9], INTE = 0;
-uint16_t reg_SP, reg_PC;
-
-#define set_S() reg8[FLAGS] |= 0x80
-#define set_Z() reg8[FLAGS] |= 0x40
-#define set_AC() reg8[FLAGS] |= 0x10
-#define set_P() reg8[FLAGS] |= 0x04
-#define set_C() reg8[FLAGS] |= 0x01
-#define clear_S() reg8[FLAGS] &= 0x7F
-#define clear_Z() reg8[FLAGS] &= 0xBF
-#define clear_AC() reg8[FLAGS] &= 0xEF
-#define clear_P() reg8[FLAGS] &= 0xFB
-#define clear_C() reg8[FLAGS] &= 0xFE
-#define test_S() (reg8[FLAGS] & 0x80)
-#define test_Z() (reg8[FLAGS] & 0x40)
-#define test_AC() (reg8[FLAGS] & 0x10)
-#define test_P() (reg8[FLAGS] & 0x04)
-#define test_C() (reg8[FLAGS] & 0x01)
-
-static unsigned halted;
+/* Flags start out clear */
+static struct i8080 i8080_state = {
+	.res = 0x01,
+	.zres = 0x01
+};
 
 FILE *i8080_log;
 
-static uint8_t intpend;
+#define reg8	cpu->reg
+#define reg_SP	cpu->sp
+#define reg_PC	cpu->pc
+
+#define reg16_BC (((uint16_t)reg8[B] << 8) | (uint16_t)reg8[C])
+#define reg16_DE (((uint16_t)reg8[D] << 8) | (uint16_t)reg8[E])
+#define reg16_HL (((uint16_t)reg8[H] << 8) | (uint16_t)reg8[L])
+
+/* Register pair by instruction encoding: BC, DE, HL, SP */
+#define read_RP(rp) \
+	((rp) == 3 ? reg_SP : (uint16_t)((reg8[(rp) * 2] << 8) | reg8[(rp) * 2 + 1]))
+#define write_RP(rp, v) \
+	do { \
+		uint16_t v_ = (v); \
+		if ((rp) == 3) \
+			reg_SP = v_; \
+		else { \
+			reg8[(rp) * 2] = v_ >> 8; \
+			reg8[(rp) * 2 + 1] = v_; \
+		} \
+	} while(0)
+
+#define push16(v) \
+	do { \
+		uint16_t v_ = (v); \
+		i8080_write(--reg_SP, v_ >> 8); \
+		i8080_write(--reg_SP, (uint8_t)v_); \
+	} while(0)
+
+/* Source operand for the ALU group, r or M */
+#define alu_src(r) \
+	((r) == M ? i8080_read(reg16_HL) : reg8[r])
+
+/* Record an 8bit result for S Z and P */
+#define set_res(v) \
+	cpu->res = cpu->zres = (v)
+
+/* The ALU operations. AC is the carry (or borrow) out of bit 3 which is
+   bit 4 of a ^ b ^ result, and the 8080 sets AC on no borrow for subtracts */
+#define alu_add(v, ci) \
+	do { \
+		uint8_t b_ = (v); \
+		unsigned t_ = reg8[A] + b_ + (ci); \
+		cpu->acx = reg8[A] ^ b_ ^ t_; \
+		cpu->carry = t_ >> 8; \
+		set_res(reg8[A] = t_); \
+	} while(0)
+
+#define alu_cmp(v, ci) \
+	do { \
+		uint8_t b_ = (v); \
+		unsigned t_ = reg8[A] - b_ - (ci); \
+		cpu->acx = ~(reg8[A] ^ b_ ^ t_); \
+		cpu->carry = (t_ >> 8) & 1; \
+		set_res(t_); \
+	} while(0)
+
+#define alu_sub(v, ci) \
+	do { \
+		alu_cmp(v, ci); \
+		reg8[A] = cpu->res; \
+	} while(0)
+
+#define alu_logic(r, ac) \
+	do { \
+		cpu->acx = (ac); \
+		cpu->carry = 0; \
+		set_res(r); \
+	} while(0)
 
 static const uint8_t parity[0x100] = {
 	1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0,
@@ -57,161 +127,59 @@ static const uint8_t parity[0x100] = {
 	0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1
 };
 
-uint16_t read_RP(uint8_t rp) {
-	switch (rp) {
-		case 0x00:
-			return reg16_BC;
-		case 0x01:
-			return reg16_DE;
-		case 0x02:
-			return reg16_HL;
-		case 0x03:
-			return reg_SP;
-	}
-	return 0;
-}
-
-uint16_t read_RP_PUSHPOP(uint8_t rp) {
-	switch (rp) {
-		case 0x00:
-			return reg16_BC;
-		case 0x01:
-			return reg16_DE;
-		case 0x02:
-			return reg16_HL;
-		case 0x03:
-			return (reg16_PSW | 0x02) & 0xFFD7;
-	}
-	return 0;
-}
-
-void write_RP(uint8_t rp, uint8_t lb, uint8_t hb) {
-	switch (rp) {
-		case 0x00:
-			reg8[C] = lb;
-			reg8[B] = hb;
-			break;
-		case 0x01:
-			reg8[E] = lb;
-			reg8[D] = hb;
-			break;
-		case 0x02:
-			reg8[L] = lb;
-			reg8[H] = hb;
-			break;
-		case 0x03:
-			reg_SP = (uint16_t)lb | ((uint16_t)hb << 8);
-			break;
-	}
-}
-
-void write16_RP(uint8_t rp, uint16_t value) {
-	switch (rp) {
-		case 0x00:
-			reg8[C] = value & 0x00FF;
-			reg8[B] = value >> 8;
-			break;
-		case 0x01:
-			reg8[E] = value & 0x00FF;
-			reg8[D] = value >> 8;
-			break;
-		case 0x02:
-			reg8[L] = value & 0x00FF;
-			reg8[H] = value >> 8;
-			break;
-		case 0x03:
-			reg_SP = value;
-			break;
-	}
-}
-
-void write16_RP_PUSHPOP(uint8_t rp, uint16_t value) {
-	switch (rp) {
-		case 0x00:
-			reg8[C] = value & 0x00FF;
-			reg8[B] = value >> 8;
-			break;
-		case 0x01:
-			reg8[E] = value & 0x00FF;
-			reg8[D] = value >> 8;
-			break;
-		case 0x02:
-			reg8[L] = value & 0x00FF;
-			reg8[H] = value >> 8;
-			break;
-		case 0x03:
-			reg8[FLAGS] = ((value & 0x00FF) | 0x02) & 0xD7;
-			reg8[A] = value >> 8;
-			break;
-	}
-}
-
-void calc_SZP(uint8_t value) {
-	if (value == 0) set_Z(); else clear_Z();
-	if (value & 0x80) set_S(); else clear_S();
-	if (parity[value]) set_P(); else clear_P();
-}
-
-void calc_AC(uint8_t val1, uint8_t val2) {
-	if (((val1 & 0x0F) + (val2 & 0x0F)) > 0x0F) {
-		set_AC();
-	} else {
-		clear_AC();
-	}
-}
-
-void calc_AC_carry(uint8_t val1, uint8_t val2) {
-	if (((val1 & 0x0F) + (val2 & 0x0F)) >= 0x0F) {
-		set_AC();
-	} else {
-		clear_AC();
-	}
-}
-
-void calc_subAC(int8_t val1, uint8_t val2) {
-	if ((val2 & 0x0F) <= (val1 & 0x0F)) {
-		set_AC();
-	} else {
-		clear_AC();
-	}
+/* Build the flags byte from the lazy state */
+static uint8_t get_flags(struct i8080 *cpu)
+{
+	uint8_t f = cpu->fbits | cpu->carry | (cpu->acx & 0x10) | (cpu->res & 0x80);
+	if (cpu->zres == 0)
+		f |= 0x40;
+	if (parity[cpu->res])
+		f |= 0x04;
+	return f;
 }
 
-void calc_subAC_borrow(int8_t val1, uint8_t val2) {
-	if ((val2 & 0x0F) < (val1 & 0x0F)) {
-		set_AC();
-	} else {
-		clear_AC();
-	}
+/* Load the lazy state from a flags byte. S and P can always be represented
+   by one of 0x00, 0x01, 0x80 or 0x81 */
+static void set_flags(struct i8080 *cpu, uint8_t f)
+{
+	cpu->carry = f & 0x01;
+	cpu->acx = f & 0x10;
+	cpu->zres = !(f & 0x40);
+	cpu->res = (f & 0x80) | (((f >> 7) ^ (f >> 2) ^ 1) & 1);
+	cpu->fbits = f & 0x2A;
 }
 
-uint8_t test_cond(uint8_t code) {
+static uint8_t test_cond(struct i8080 *cpu, uint8_t code) {
 	switch (code) {
 		case 0: //Z not set
-			if (!test_Z()) return 1; else return 0;
+			return cpu->zres != 0;
 		case 1: //Z set
-			if (test_Z()) return 1; else return 0;
+			return cpu->zres == 0;
 		case 2: //C not set
-			if (!test_C()) return 1; else return 0;
+			return !cpu->carry;
 		case 3: //C set
-			if (test_C()) return 1; else return 0;
+			return cpu->carry;
 		case 4: //P not set
-			if (!test_P()) return 1; else return 0;
+			return !parity[cpu->res];
 		case 5: //P set
-			if (test_P()) return 1; else return 0;
+			return parity[cpu->res];
 		case 6: //S not set
-			if (!test_S()) return 1; else return 0;
+			return !(cpu->res & 0x80);
 		case 7: //S set
-			if (test_S()) return 1; else return 0;
+			return cpu->res >> 7;
 	}
 	return 0;
 }
 
-void i8080_push(uint16_t value) {
-	i8080_write(--reg_SP, value >> 8);
-	i8080_write(--reg_SP, (uint8_t)value);
+/* Operand fetch, keeping the two reads on the bus in order */
+static uint16_t fetch16(struct i8080 *cpu) {
+	uint16_t temp;
+	temp = i8080_read(reg_PC);
+	temp |= (uint16_t)i8080_read(reg_PC + 1) << 8;
+	return temp;
 }
 
-uint16_t i8080_pop(void) {
+static uint16_t i8080_pop(struct i8080 *cpu) {
 	uint16_t temp;
 	temp = i8080_read(reg_SP++);
 	temp |= (uint16_t)i8080_read(reg_SP++) << 8;
@@ -220,48 +188,44 @@ uint16_t i8080_pop(void) {
 
 void i8080_set_int(int n)
 {
-	intpend |= n;
+	i8080_state.intpend |= n;
 }
 
 void i8080_clear_int(int n)
 {
-	intpend &= ~n;
-}
-
-
-void i8080_jump(uint16_t addr) {
-	reg_PC = addr;
+	i8080_state.intpend &= ~n;
 }
 
 void i8080_reset(void) {
-	reg_PC = reg_SP = 0x0000;
+	i8080_state.pc = i8080_state.sp = 0x0000;
 	//reg8[FLAGS] = 0x02;
 }
 
 void i8080_write_reg8(reg_t reg, uint8_t value) {
-	if (reg == M) {
-		i8080_write(reg16_HL, value);
-	} else {
-		reg8[reg] = value;
-	}
+	if (reg == M)
+		i8080_write((i8080_state.reg[H] << 8) | i8080_state.reg[L], value);
+	else if (reg == FLAGS)
+		set_flags(&i8080_state, value);
+	else
+		i8080_state.reg[reg] = value;
 }
 
 uint8_t i8080_read_reg8(reg_t reg) {
-	if (reg == M) {
-		return i8080_read(reg16_HL);
-	} else {
-		return reg8[reg];
-	}
+	if (reg == M)
+		return i8080_read((i8080_state.reg[H] << 8) | i8080_state.reg[L]);
+	if (reg == FLAGS)
+		return get_flags(&i8080_state);
+	return i8080_state.reg[reg];
 }
 
 uint16_t i8080_read_reg16(reg_t reg) {
 	switch (reg) {
-		case AF: return reg16_PSW;
-		case BC: return reg16_BC;
-		case DE: return reg16_DE;
-		case HL: return reg16_HL;
-		case SP: return reg_SP;
-		case PC: return reg_PC;
+		case AF: return (i8080_state.reg[A] << 8) | get_flags(&i8080_state);
+		case BC: return (i8080_state.reg[B] << 8) | i8080_state.reg[C];
+		case DE: return (i8080_state.reg[D] << 8) | i8080_state.reg[E];
+		case HL: return (i8080_state.reg[H] << 8) | i8080_state.reg[L];
+		case SP: return i8080_state.sp;
+		case PC: return i8080_state.pc;
 		default:;
 	}
 	return 0;
@@ -269,12 +233,12 @@ uint16_t i8080_read_reg16(reg_t reg) {
 
 void i8080_write_reg16(reg_t reg, uint16_t value) {
 	switch (reg) {
-		case AF: reg8[A] = value>>8; reg8[FLAGS] = value; break;
-		case BC: reg8[B] = value>>8; reg8[C] = value; break;
-		case DE: reg8[D] = value>>8; reg8[E] = value; break;
-		case HL: reg8[H] = value>>8; reg8[L] = value; break;
-		case SP: reg_SP = value; break;
-		case PC: reg_PC = value; break;
+		case AF: i8080_state.reg[A] = value>>8; set_flags(&i8080_state, value); break;
+		case BC: i8080_state.reg[B] = value>>8; i8080_state.reg[C] = value; break;
+		case DE: i8080_state.reg[D] = value>>8; i8080_state.reg[E] = value; break;
+		case HL: i8080_state.reg[H] = value>>8; i8080_state.reg[L] = value; break;
+		case SP: i8080_state.sp = value; break;
+		case PC: i8080_state.pc = value; break;
 		default:;
 	}
 }
@@ -297,7 +261,12 @@ static char *i8080_flags(uint8_t v)
 	return buf;
 }
 
+/*
+ *	Run instructions until at least the given number of clocks have
+ *	passed. Returns the overrun as zero or a negative value.
+ */
 int i8080_exec(int cycles) {
+	struct i8080 *cpu = &i8080_state;
 	uint8_t opcode, temp8, reg, reg2;
 	uint16_t temp16;
 	uint32_t temp32;
@@ -305,22 +274,22 @@ int i8080_exec(int cycles) {
 	/* TODO: merge in from 8085 interrupt code */
 	while (cycles > 0) {
 
-		if (intpend & INT_NMI) {
-			INTE = 0;
-			intpend &= ~INT_NMI;
-			i8080_push(reg_PC + halted);
+		if (cpu->intpend & INT_NMI) {
+			cpu->inte = 0;
+			cpu->intpend &= ~INT_NMI;
+			push16(reg_PC + cpu->halted);
 			reg_PC = 0x24;
 			cycles -= 12;	/* FIXME: 8080 clocking check */
 			if (i8080_log)
 				fprintf(i8080_log, "NMI taken.\n");
-		} else if (INTE && (intpend & INT_IRQ)) {
-			INTE = 0;
+		} else if (cpu->inte && (cpu->intpend & INT_IRQ)) {
+			cpu->inte = 0;
 			if (i8080_log)
 				fprintf(i8080_log, "IRQ taken\n");
 			opcode = i8080_get_vector();
 			if (i8080_log)
 				fprintf(i8080_log, "IRQ taken (vector op %02X)\n", opcode);
-			if (halted)
+			if (cpu->halted)
 				reg_PC++;
 			cycles -= 12;	/* Check 8080 timings */
 			if (i8080_log)
@@ -331,35 +300,35 @@ int i8080_exec(int cycles) {
 			if (i8080_log)
 				fprintf(i8080_log, "%04X : %02X %02X %02X : %6s %02X %04X %04X %04X %04X %s\n",
 					reg_PC, i8080_debug_read(reg_PC), i8080_debug_read(reg_PC + 1), i8080_debug_read(reg_PC + 2),
-					i8080_flags(reg8[FLAGS]), reg8[A], reg16_BC, reg16_DE, reg16_HL, reg_SP,
+					i8080_flags(get_flags(cpu)), reg8[A], reg16_BC, reg16_DE, reg16_HL, reg_SP,
 						i8080_disassemble(reg_PC));
 			reg_PC++;
 		}
 		/* if we are re-executing a hlt it'll set halted again */
-		halted = 0;
+		cpu->halted = 0;
 
 		switch (opcode) {
 			case 0x3A: //LDA a - load A from memory
-				temp16 = (uint16_t)i8080_read(reg_PC) | ((uint16_t)i8080_read(reg_PC+1)<<8);
+				temp16 = fetch16(cpu);
 				reg8[A] = i8080_read(temp16);
 				reg_PC += 2;
 				cycles -= 13;
 				break;
 			case 0x32: //STA a - store A to memory
-				temp16 = (uint16_t)i8080_read(reg_PC) | ((uint16_t)i8080_read(reg_PC+1)<<8);
+				temp16 = fetch16(cpu);
 				i8080_write(temp16, reg8[A]);
 				reg_PC += 2;
 				cycles -= 13;
 				break;
 			case 0x2A: //LHLD a - load H:L from memory
-				temp16 = (uint16_t)i8080_read(reg_PC) | ((uint16_t)i8080_read(reg_PC+1)<<8);
+				temp16 = fetch16(cpu);
 				reg8[L] = i8080_read(temp16++);
 				reg8[H] = i8080_read(temp16);
 				reg_PC += 2;
 				cycles -= 16;
 				break;
 			case 0x22: //SHLD a - store H:L to memory
-				temp16 = (uint16_t)i8080_read(reg_PC) | ((uint16_t)i8080_read(reg_PC+1)<<8);
+				temp16 = fetch16(cpu);
 				i8080_write(temp16++, reg8[L]);
 				i8080_write(temp16, reg8[H]);
 				reg_PC += 2;
@@ -375,105 +344,75 @@ int i8080_exec(int cycles) {
 				cycles -= 5;
 				break;
 			case 0xC6: //ADI # - add immediate to A
-				temp8 = i8080_read(reg_PC++);
-				temp16 = (uint16_t)reg8[A] + (uint16_t)temp8;
-				if (temp16 & 0xFF00) set_C(); else clear_C();
-				calc_AC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_add(i8080_read(reg_PC++), 0);
 				cycles -= 7;
 				break;
 			case 0xCE: //ACI # - add immediate to A with carry
-				temp8 = i8080_read(reg_PC++);
-				temp16 = (uint16_t)reg8[A] + (uint16_t)temp8 + (uint16_t)test_C();
-				if (test_C()) calc_AC_carry(reg8[A], temp8); else calc_AC(reg8[A], temp8);
-				if (temp16 & 0xFF00) set_C(); else clear_C();
-				calc_SZP((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_add(i8080_read(reg_PC++), cpu->carry);
 				cycles -= 7;
 				break;
 			case 0xD6: //SUI # - subtract immediate from A
-				temp8 = i8080_read(reg_PC++);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8;
-				if (((temp16 & 0x00FF) >= reg8[A]) && temp8) set_C(); else clear_C();
-				calc_subAC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_sub(i8080_read(reg_PC++), 0);
 				cycles -= 7;
 				break;
 			case 0x27: //DAA - decimal adjust accumulator
 				temp16 = reg8[A];
-				if (((temp16 & 0x0F) > 0x09) || test_AC()) {
-					if (((temp16 & 0x0F) + 0x06) & 0xF0) set_AC(); else clear_AC();
+				if (((temp16 & 0x0F) > 0x09) || (cpu->acx & 0x10)) {
+					cpu->acx = ((temp16 & 0x0F) + 0x06) & 0xF0 ? 0x10 : 0x00;
 					temp16 += 0x06;
-					if (temp16 & 0xFF00) set_C(); //can also cause carry to be set during addition to the low nibble
+					if (temp16 & 0xFF00) cpu->carry = 1; //can also cause carry to be set during addition to the low nibble
 				}
-				if (((temp16 & 0xF0) > 0x90) || test_C()) {
+				if (((temp16 & 0xF0) > 0x90) || cpu->carry) {
 					temp16 += 0x60;
-					if (temp16 & 0xFF00) set_C(); //doesn't clear it if this clause is false
+					if (temp16 & 0xFF00) cpu->carry = 1; //doesn't clear it if this clause is false
 				}
-				calc_SZP((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				set_res(reg8[A] = (uint8_t)temp16);
 				cycles -= 4;
 				break;
 			case 0xE6: //ANI # - AND immediate with A
 				temp8 = i8080_read(reg_PC++);
-				if ((reg8[A] | temp8) & 0x08) set_AC(); else clear_AC();
-				reg8[A] &= temp8;
-				clear_C();
-				calc_SZP(reg8[A]);
+				/* AC is the or of bit 3 of the values */
+				alu_logic(reg8[A] & temp8, (reg8[A] | temp8) << 1);
+				reg8[A] = cpu->res;
 				cycles -= 7;
 				break;
 			case 0xF6: //ORI # - OR immediate with A
 				reg8[A] |= i8080_read(reg_PC++);
-				clear_AC();
-				clear_C();
-				calc_SZP(reg8[A]);
+				alu_logic(reg8[A], 0);
 				cycles -= 7;
 				break;
 			case 0xEE: //XRI # - XOR immediate with A
 				reg8[A] ^= i8080_read(reg_PC++);
-				clear_AC();
-				clear_C();
-				calc_SZP(reg8[A]);
+				alu_logic(reg8[A], 0);
 				cycles -= 7;
 				break;
 			case 0xDE: //SBI # - subtract immediate from A with borrow
-				temp8 = i8080_read(reg_PC++);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8 - (uint16_t)test_C();
-				if (test_C()) calc_subAC_borrow(reg8[A], temp8); else calc_subAC(reg8[A], temp8);
-				if (((temp16 & 0x00FF) >= reg8[A]) && (temp8 | test_C())) set_C(); else clear_C();
-				calc_SZP((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_sub(i8080_read(reg_PC++), cpu->carry);
 				cycles -= 7;
 				break;
 			case 0xFE: //CPI # - compare immediate with A
-				temp8 = i8080_read(reg_PC++);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8;
-				if (((temp16 & 0x00FF) >= reg8[A]) && temp8) set_C(); else clear_C();
-				calc_subAC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
+				alu_cmp(i8080_read(reg_PC++), 0);
 				cycles -= 7;
 				break;
 			case 0x07: //RLC - rotate A left
-				if (reg8[A] & 0x80) set_C(); else clear_C();
+				cpu->carry = reg8[A] >> 7;
 				reg8[A] = (reg8[A] >> 7) | (reg8[A] << 1);
 				cycles -= 4;
 				break;
 			case 0x0F: //RRC - rotate A right
-				if (reg8[A] & 0x01) set_C(); else clear_C();
+				cpu->carry = reg8[A] & 0x01;
 				reg8[A] = (reg8[A] << 7) | (reg8[A] >> 1);
 				cycles -= 4;
 				break;
 			case 0x17: //RAL - rotate A left through carry
-				temp8 = test_C();
-				if (reg8[A] & 0x80) set_C(); else clear_C();
+				temp8 = cpu->carry;
+				cpu->carry = reg8[A] >> 7;
 				reg8[A] = (reg8[A] << 1) | temp8;
 				cycles -= 4;
 				break;
 			case 0x1F: //RAR - rotate A right through carry
-				temp8 = test_C();
-				if (reg8[A] & 0x01) set_C(); else clear_C();
+				temp8 = cpu->carry;
+				cpu->carry = reg8[A] & 0x01;
 				reg8[A] = (reg8[A] >> 1) | (temp8 << 7);
 				cycles -= 4;
 				break;
@@ -482,11 +421,11 @@ int i8080_exec(int cycles) {
 				cycles -= 4;
 				break;
 			case 0x3F: //CMC - compliment carry flag
-				reg8[FLAGS] ^= 1;
+				cpu->carry ^= 1;
 				cycles -= 4;
 				break;
 			case 0x37: //STC - set carry flag
-				set_C();
+				cpu->carry = 1;
 				cycles -= 4;
 				break;
 			case 0xC7: //RST n - restart (call n*8)
@@ -497,7 +436,7 @@ int i8080_exec(int cycles) {
 			case 0xDF:
 			case 0xEF:
 			case 0xFF:
-				i8080_push(reg_PC);
+				push16(reg_PC);
 				reg_PC = (uint16_t)((opcode >> 3) & 7) << 3;
 				cycles -= 11;
 				break;
@@ -506,9 +445,9 @@ int i8080_exec(int cycles) {
 				cycles -= 5;
 				break;
 			case 0xE3: //XTHL - swap H:L with top word on stack
-				temp16 = i8080_pop();
-				i8080_push(reg16_HL);
-				write16_RP(2, temp16);
+				temp16 = i8080_pop(cpu);
+				push16(reg16_HL);
+				write_RP(2, temp16);
 				cycles -= 18;
 				break;
 			case 0xF9: //SPHL - set SP to content of HL
@@ -524,17 +463,17 @@ int i8080_exec(int cycles) {
 				cycles -= 10;
 				break;
 			case 0xFB: //EI - enable interrupts
-				INTE = 1;
+				cpu->inte = 1;
 				cycles -= 4;
 				break;
 			case 0xF3: //DI - disbale interrupts
-				INTE = 0;
+				cpu->inte = 0;
 				cycles -= 4;
 				break;
 			case 0x76: //HLT - halt processor
 				reg_PC--;
 				cycles -= 7;
-				halted = 1;
+				cpu->halted = 1;
 				break;
 			case 0x00: //NOP - no operation
 #ifdef ALLOW_UNDEFINED
@@ -566,35 +505,37 @@ int i8080_exec(int cycles) {
 			case 0x4F: case 0x5F: case 0x6F: case 0x7F:
 				reg = (opcode >> 3) & 7;
 				reg2 = opcode & 7;
-				i8080_write_reg8(reg, i8080_read_reg8(reg2));
-				if ((reg == M) || (reg2 == M)) {
+				if (reg2 == M) {
+					reg8[reg] = i8080_read(reg16_HL);
+					cycles -= 7;
+				} else if (reg == M) {
+					i8080_write(reg16_HL, reg8[reg2]);
 					cycles -= 7;
 				} else {
+					reg8[reg] = reg8[reg2];
 					cycles -= 5;
 				}
 				break;
 			case 0x06: //MVI D,# - move immediate to register
 			case 0x16:
 			case 0x26:
-			case 0x36:
 			case 0x0E:
 			case 0x1E:
 			case 0x2E:
 			case 0x3E:
-				reg = (opcode >> 3) & 7;
-				i8080_write_reg8(reg, i8080_read(reg_PC++));
-				if (reg == M) {
-					cycles -= 10;
-				} else {
-					cycles -= 7;
-				}
+				reg8[(opcode >> 3) & 7] = i8080_read(reg_PC++);
+				cycles -= 7;
+				break;
+			case 0x36: //MVI M,#
+				i8080_write(reg16_HL, i8080_read(reg_PC++));
+				cycles -= 10;
 				break;
 			case 0x01: //LXI RP,# - load register pair immediate
 			case 0x11:
 			case 0x21:
 			case 0x31:
 				reg = (opcode >> 4) & 3;
-				write_RP(reg, i8080_read(reg_PC), i8080_read(reg_PC + 1));
+				write_RP(reg, fetch16(cpu));
 				reg_PC += 2;
 				cycles -= 10;
 				break;
@@ -617,47 +558,49 @@ int i8080_exec(int cycles) {
 			case 0x04: //INR D - increment register
 			case 0x14:
 			case 0x24:
-			case 0x34:
 			case 0x0C:
 			case 0x1C:
 			case 0x2C:
 			case 0x3C:
 				reg = (opcode >> 3) & 7;
-				temp8 = i8080_read_reg8(reg); //reg8[reg];
-				calc_AC(temp8, 1);
-				calc_SZP(temp8 + 1);
-				i8080_write_reg8(reg, temp8 + 1); //reg8[reg]++;
-				if (reg == M) {
-					cycles -= 10;
-				} else {
-					cycles -= 5;
-				}
+				temp8 = reg8[reg] + 1;
+				cpu->acx = temp8 ^ reg8[reg] ^ 1;
+				set_res(reg8[reg] = temp8);
+				cycles -= 5;
+				break;
+			case 0x34: //INR M
+				temp8 = i8080_read(reg16_HL);
+				cpu->acx = temp8 ^ (temp8 + 1) ^ 1;
+				set_res(temp8 + 1);
+				i8080_write(reg16_HL, cpu->res);
+				cycles -= 10;
 				break;
 			case 0x05: //DCR D - decrement register
 			case 0x15:
 			case 0x25:
-			case 0x35:
 			case 0x0D:
 			case 0x1D:
 			case 0x2D:
 			case 0x3D:
 				reg = (opcode >> 3) & 7;
-				temp8 = i8080_read_reg8(reg); //reg8[reg];
-				calc_subAC(temp8, 1);
-				calc_SZP(temp8 - 1);
-				i8080_write_reg8(reg, temp8 - 1); //reg8[reg]--;
-				if (reg == M) {
-					cycles -= 10;
-				} else {
-					cycles -= 5;
-				}
+				temp8 = reg8[reg] - 1;
+				cpu->acx = ~(temp8 ^ reg8[reg] ^ 1);
+				set_res(reg8[reg] = temp8);
+				cycles -= 5;
+				break;
+			case 0x35: //DCR M
+				temp8 = i8080_read(reg16_HL);
+				cpu->acx = ~(temp8 ^ (temp8 - 1) ^ 1);
+				set_res(temp8 - 1);
+				i8080_write(reg16_HL, cpu->res);
+				cycles -= 10;
 				break;
 			case 0x03: //INX RP - increment register pair
 			case 0x13:
 			case 0x23:
 			case 0x33:
 				reg = (opcode >> 4) & 3;
-				write16_RP(reg, read_RP(reg) + 1);
+				write_RP(reg, read_RP(reg) + 1);
 				cycles -= 5;
 				break;
 			case 0x0B: //DCX RP - decrement register pair
@@ -665,7 +608,7 @@ int i8080_exec(int cycles) {
 			case 0x2B:
 			case 0x3B:
 				reg = (opcode >> 4) & 3;
-				write16_RP(reg, read_RP(reg) - 1);
+				write_RP(reg, read_RP(reg) - 1);
 				cycles -= 5;
 				break;
 			case 0x09: //DAD RP - add register pair to HL
@@ -674,8 +617,8 @@ int i8080_exec(int cycles) {
 			case 0x39:
 				reg = (opcode >> 4) & 3;
 				temp32 = (uint32_t)reg16_HL + (uint32_t)read_RP(reg);
-				write16_RP(2, (uint16_t)temp32);
-				if (temp32 & 0xFFFF0000) set_C(); else clear_C();
+				write_RP(2, (uint16_t)temp32);
+				cpu->carry = temp32 >> 16;
 				cycles -= 10;
 				break;
 			case 0x80: //ADD S - add register or memory to A
@@ -687,12 +630,7 @@ int i8080_exec(int cycles) {
 			case 0x86:
 			case 0x87:
 				reg = opcode & 7;
-				temp8 = i8080_read_reg8(reg);
-				temp16 = (uint16_t)reg8[A] + (uint16_t)temp8;
-				if (temp16 & 0xFF00) set_C(); else clear_C();
-				calc_AC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_add(alu_src(reg), 0);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -708,12 +646,7 @@ int i8080_exec(int cycles) {
 			case 0x8E:
 			case 0x8F:
 				reg = opcode & 7;
-				temp8 = i8080_read_reg8(reg);
-				temp16 = (uint16_t)reg8[A] + (uint16_t)temp8 + (uint16_t)test_C();
-				if (test_C()) calc_AC_carry(reg8[A], temp8); else calc_AC(reg8[A], temp8);
-				if (temp16 & 0xFF00) set_C(); else clear_C();
-				calc_SZP((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_add(alu_src(reg), cpu->carry);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -729,12 +662,7 @@ int i8080_exec(int cycles) {
 			case 0x96:
 			case 0x97:
 				reg = opcode & 7;
-				temp8 = i8080_read_reg8(reg);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8;
-				if (((temp16 & 0x00FF) >= reg8[A]) && temp8) set_C(); else clear_C();
-				calc_subAC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_sub(alu_src(reg), 0);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -750,12 +678,7 @@ int i8080_exec(int cycles) {
 			case 0x9E:
 			case 0x9F:
 				reg = opcode & 7;
-				temp8 = i8080_read_reg8(reg);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8 - (uint16_t)test_C();
-				if (test_C()) calc_subAC_borrow(reg8[A], temp8); else calc_subAC(reg8[A], temp8);
-				if (((temp16 & 0x00FF) >= reg8[A]) && (temp8 | test_C())) set_C(); else clear_C();
-				calc_SZP((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_sub(alu_src(reg), cpu->carry);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -771,11 +694,9 @@ int i8080_exec(int cycles) {
 			case 0xA6:
 			case 0xA7:
 				reg = opcode & 7;
-				temp8 = i8080_read_reg8(reg);
-				if ((reg8[A] | temp8) & 0x08) set_AC(); else clear_AC();
-				reg8[A] &= temp8;
-				clear_C();
-				calc_SZP(reg8[A]);
+				temp8 = alu_src(reg);
+				alu_logic(reg8[A] & temp8, (reg8[A] | temp8) << 1);
+				reg8[A] = cpu->res;
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -791,10 +712,8 @@ int i8080_exec(int cycles) {
 			case 0xB6:
 			case 0xB7:
 				reg = opcode & 7;
-				reg8[A] |= i8080_read_reg8(reg);
-				clear_AC();
-				clear_C();
-				calc_SZP(reg8[A]);
+				reg8[A] |= alu_src(reg);
+				alu_logic(reg8[A], 0);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -810,10 +729,8 @@ int i8080_exec(int cycles) {
 			case 0xAE:
 			case 0xAF:
 				reg = opcode & 7;
-				reg8[A] ^= i8080_read_reg8(reg);
-				clear_AC();
-				clear_C();
-				calc_SZP(reg8[A]);
+				reg8[A] ^= alu_src(reg);
+				alu_logic(reg8[A], 0);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -829,11 +746,7 @@ int i8080_exec(int cycles) {
 			case 0xBE:
 			case 0xBF:
 				reg = opcode & 7;
-				temp8 = i8080_read_reg8(reg);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8;
-				if (((temp16 & 0x00FF) >= reg8[A]) && temp8) set_C(); else clear_C();
-				calc_subAC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
+				alu_cmp(alu_src(reg), 0);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -844,8 +757,7 @@ int i8080_exec(int cycles) {
 #ifdef ALLOW_UNDEFINED
 			case 0xCB:
 #endif
-				temp16 = (uint16_t)i8080_read(reg_PC) | (((uint16_t)i8080_read(reg_PC + 1)) << 8);
-				reg_PC = temp16;
+				reg_PC = fetch16(cpu);
 				cycles -= 10;
 				break;
 			case 0xC2: //Jccc - conditional jumps
@@ -856,8 +768,8 @@ int i8080_exec(int cycles) {
 			case 0xEA:
 			case 0xF2:
 			case 0xFA:
-				temp16 = (uint16_t)i8080_read(reg_PC) | (((uint16_t)i8080_read(reg_PC + 1)) << 8);
-				if (test_cond((opcode >> 3) & 7)) reg_PC = temp16; else reg_PC += 2;
+				temp16 = fetch16(cpu);
+				if (test_cond(cpu, (opcode >> 3) & 7)) reg_PC = temp16; else reg_PC += 2;
 				cycles -= 10;
 				break;
 			case 0xCD: //CALL a - unconditional call
@@ -866,8 +778,8 @@ int i8080_exec(int cycles) {
 			case 0xED:
 			case 0xFD:
 #endif
-				temp16 = (uint16_t)i8080_read(reg_PC) | (((uint16_t)i8080_read(reg_PC + 1)) << 8);
-				i8080_push(reg_PC + 2);
+				temp16 = fetch16(cpu);
+				push16(reg_PC + 2);
 				reg_PC = temp16;
 				cycles -= 17;
 				break;
@@ -879,9 +791,9 @@ int i8080_exec(int cycles) {
 			case 0xEC:
 			case 0xF4:
 			case 0xFC:
-				temp16 = (uint16_t)i8080_read(reg_PC) | (((uint16_t)i8080_read(reg_PC + 1)) << 8);
-				if (test_cond((opcode >> 3) & 7)) {
-					i8080_push(reg_PC + 2);
+				temp16 = fetch16(cpu);
+				if (test_cond(cpu, (opcode >> 3) & 7)) {
+					push16(reg_PC + 2);
 					reg_PC = temp16;
 					cycles -= 17;
 				} else {
@@ -893,7 +805,7 @@ int i8080_exec(int cycles) {
 #ifdef ALLOW_UNDEFINED
 			case 0xD9:
 #endif
-				reg_PC = i8080_pop();
+				reg_PC = i8080_pop(cpu);
 				cycles -= 10;
 				break;
 			case 0xC0: //Rccc - conditional returns
@@ -904,8 +816,8 @@ int i8080_exec(int cycles) {
 			case 0xE8:
 			case 0xF0:
 			case 0xF8:
-				if (test_cond((opcode >> 3) & 7)) {
-					reg_PC = i8080_pop();
+				if (test_cond(cpu, (opcode >> 3) & 7)) {
+					reg_PC = i8080_pop(cpu);
 					cycles -= 11;
 				} else {
 					cycles -= 5;
@@ -914,17 +826,25 @@ int i8080_exec(int cycles) {
 			case 0xC5: //PUSH RP - push register pair on the stack
 			case 0xD5:
 			case 0xE5:
-			case 0xF5:
 				reg = (opcode >> 4) & 3;
-				i8080_push(read_RP_PUSHPOP(reg));
+				push16(read_RP(reg));
+				cycles -= 11;
+				break;
+			case 0xF5: //PUSH PSW
+				push16((reg8[A] << 8) | ((get_flags(cpu) | 0x02) & 0xD7));
 				cycles -= 11;
 				break;
 			case 0xC1: //POP RP - pop register pair from the stack
 			case 0xD1:
 			case 0xE1:
-			case 0xF1:
 				reg = (opcode >> 4) & 3;
-				write16_RP_PUSHPOP(reg, i8080_pop());
+				write_RP(reg, i8080_pop(cpu));
+				cycles -= 10;
+				break;
+			case 0xF1: //POP PSW
+				temp16 = i8080_pop(cpu);
+				set_flags(cpu, (temp16 | 0x02) & 0xD7);
+				reg8[A] = temp16 >> 8;
 				cycles -= 10;
 				break;
 
@@ -940,6 +860,7 @@ int i8080_exec(int cycles) {
 	return cycles;
 }
 
+
 /*
  *	8080 disassembler - added by Alan Cox 2025 (from the 8085 one)
  */
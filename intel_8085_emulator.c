@@ -9,6 +9,10 @@
   
   The 8085 emulation is WIP and the 8085 undocumented instruction behaviour
   is exactly that so may not be entirely correct.
+
+  The CPU state now lives in a context structure and the flags are worked
+  out lazily. Each ALU operation records its result (and for V and K its
+  operands) and the flag byte is only built when something looks at it.
   
   Permission is hereby granted, free of charge, to any person obtaining a copy
   of this software and associated documentation files (the "Software"), to deal
@@ -38,41 +42,132 @@
 
 static char *i8085_disassemble(uint16_t addr);
 
-#define reg16_PSW (((uint16_t)reg8[A] << 8) | (uint16_t)reg8[FLAGS])
-#define reg16_BC (((uint16_t)reg8[B] << 8) | (uint16_t)reg8[C])
-#define reg16_DE (((uint16_t)reg8[D] << 8) | (uint16_t)reg8[E])
-#define reg16_HL (((uint16_t)reg8[H] << 8) | (uint16_t)reg8[L])
+/* How the undocumented V and K flags are derived from the last operation */
+#define VK_ADD		0	/* V from an add of va + vb + vc, K = V ^ S(vr) */
+#define VK_SUB		1	/* V from a subtract of va - vb - vc, K = V ^ S(vr) */
+#define VK_SET		2	/* V is va, K = V ^ S(vr) */
+#define VK_RAW		3	/* V is va, K is vb */
+
+struct i8085 {
+	/* Indexed by reg_t. The M slot is unused */
+	uint8_t reg[8];
+	uint16_t sp;
+	uint16_t pc;
+	uint8_t inte;
+	uint8_t im;
+	uint8_t intprotect;
+	uint8_t halted;
+	uint8_t intpend;
+	/* Lazy flags. S and P come from res, Z from zres, AC is bit 4 of
+	   acx and carry is kept as 0 or 1. fbits holds bit 3 */
+	uint8_t res;
+	uint8_t zres;
+	uint8_t acx;
+	uint8_t carry;
+	uint8_t fbits;
+	/* Lazy V and K */
+	uint8_t vkind;
+	uint8_t va;
+	uint8_t vb;
+	uint8_t vc;
+	uint8_t vr;
+};
 
-uint8_t reg8[9], INTE = 0;
-uint16_t reg_SP, reg_PC;
-uint8_t reg_IM = 0x07;	/* Verified with a Tundra CA80C85B */
-uint8_t intprotect;
-#define set_S() reg8[FLAGS] |= 0x80
-#define set_Z() reg8[FLAGS] |= 0x40
-#define set_K() reg8[FLAGS] |= 0x20
-#define set_AC() reg8[FLAGS] |= 0x10
-#define set_P() reg8[FLAGS] |= 0x04
-#define set_V() reg8[FLAGS] |= 0x02
-#define set_C() reg8[FLAGS] |= 0x01
-#define clear_S() reg8[FLAGS] &= 0x7F
-#define clear_Z() reg8[FLAGS] &= 0xBF
-#define clear_K() reg8[FLAGS] &= 0xDF
-#define clear_AC() reg8[FLAGS] &= 0xEF
-#define clear_P() reg8[FLAGS] &= 0xFB
-#define clear_V() reg8[FLAGS] &= 0xFD
-#define clear_C() reg8[FLAGS] &= 0xFE
-#define test_S() (reg8[FLAGS] & 0x80)
-#define test_Z() (reg8[FLAGS] & 0x40)
-#define test_K() (reg8[FLAGS] & 0x20)
-#define test_AC() (reg8[FLAGS] & 0x10)
-#define test_P() (reg8[FLAGS] & 0x04)
-#define test_V() (reg8[FLAGS] & 0x02)
-#define test_C() (reg8[FLAGS] & 0x01)
+/* Flags start out clear */
+static struct i8085 i8085_state = {
+	.im = 0x07,	/* Verified with a Tundra CA80C85B */
+	.res = 0x01,
+	.zres = 0x01,
+	.vkind = VK_RAW
+};
 
 FILE *i8085_log;
 
-static uint8_t intpend;
-static uint8_t halted;
+#define reg8	cpu->reg
+#define reg_SP	cpu->sp
+#define reg_PC	cpu->pc
+
+#define reg16_BC (((uint16_t)reg8[B] << 8) | (uint16_t)reg8[C])
+#define reg16_DE (((uint16_t)reg8[D] << 8) | (uint16_t)reg8[E])
+#define reg16_HL (((uint16_t)reg8[H] << 8) | (uint16_t)reg8[L])
+
+/* Register pair by instruction encoding: BC, DE, HL, SP */
+#define read_RP(rp) \
+	((rp) == 3 ? reg_SP : (uint16_t)((reg8[(rp) * 2] << 8) | reg8[(rp) * 2 + 1]))
+#define write_RP(rp, v) \
+	do { \
+		uint16_t v_ = (v); \
+		if ((rp) == 3) \
+			reg_SP = v_; \
+		else { \
+			reg8[(rp) * 2] = v_ >> 8; \
+			reg8[(rp) * 2 + 1] = v_; \
+		} \
+	} while(0)
+
+#define push16(v) \
+	do { \
+		uint16_t v_ = (v); \
+		i8085_write(--reg_SP, v_ >> 8); \
+		i8085_write(--reg_SP, (uint8_t)v_); \
+	} while(0)
+
+/* Source operand for the ALU group, r or M */
+#define alu_src(r) \
+	((r) == M ? i8085_read(reg16_HL) : reg8[r])
+
+/* Record an 8bit result for S Z and P */
+#define set_res(v) \
+	cpu->res = cpu->zres = (v)
+
+#define set_vk(kind, a, b, c, r) \
+	do { \
+		cpu->vkind = (kind); \
+		cpu->va = (a); \
+		cpu->vb = (b); \
+		cpu->vc = (c); \
+		cpu->vr = (r); \
+	} while(0)
+
+/* The ALU operations. AC is the carry (or borrow) out of bit 3 which is
+   bit 4 of a ^ b ^ result, and AC is set on no borrow for subtracts */
+#define alu_add(v, ci) \
+	do { \
+		uint8_t b_ = (v); \
+		uint8_t c_ = (ci); \
+		unsigned t_ = reg8[A] + b_ + c_; \
+		cpu->acx = reg8[A] ^ b_ ^ t_; \
+		cpu->carry = t_ >> 8; \
+		set_vk(VK_ADD, reg8[A], b_, c_, t_); \
+		set_res(reg8[A] = t_); \
+	} while(0)
+
+#define alu_cmp(v, ci) \
+	do { \
+		uint8_t b_ = (v); \
+		uint8_t c_ = (ci); \
+		unsigned t_ = reg8[A] - b_ - c_; \
+		cpu->acx = ~(reg8[A] ^ b_ ^ t_); \
+		cpu->carry = (t_ >> 8) & 1; \
+		set_vk(VK_SUB, reg8[A], b_, c_, t_); \
+		set_res(t_); \
+	} while(0)
+
+#define alu_sub(v, ci) \
+	do { \
+		alu_cmp(v, ci); \
+		reg8[A] = cpu->res; \
+	} while(0)
+
+/* The 8085 always sets AC on an AND, the 8080 it's an or of bit 3 of
+   the values */
+#define alu_logic(r, ac) \
+	do { \
+		cpu->acx = (ac); \
+		cpu->carry = 0; \
+		set_res(r); \
+		set_vk(VK_SET, 0, 0, 0, cpu->res); \
+	} while(0)
 
 static const uint8_t parity[0x100] = {
 	1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0,
@@ -85,134 +180,7 @@ static const uint8_t parity[0x100] = {
 	0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1
 };
 
-uint16_t read_RP(uint8_t rp) {
-	switch (rp) {
-		case 0x00:
-			return reg16_BC;
-		case 0x01:
-			return reg16_DE;
-		case 0x02:
-			return reg16_HL;
-		case 0x03:
-			return reg_SP;
-	}
-	return 0;
-}
-
-uint16_t read_RP_PUSHPOP(uint8_t rp) {
-	switch (rp) {
-		case 0x00:
-			return reg16_BC;
-		case 0x01:
-			return reg16_DE;
-		case 0x02:
-			return reg16_HL;
-		case 0x03:
-			return reg16_PSW;
-	}
-	return 0;
-}
-
-void write_RP(uint8_t rp, uint8_t lb, uint8_t hb) {
-	switch (rp) {
-		case 0x00:
-			reg8[C] = lb;
-			reg8[B] = hb;
-			break;
-		case 0x01:
-			reg8[E] = lb;
-			reg8[D] = hb;
-			break;
-		case 0x02:
-			reg8[L] = lb;
-			reg8[H] = hb;
-			break;
-		case 0x03:
-			reg_SP = (uint16_t)lb | ((uint16_t)hb << 8);
-			break;
-	}
-}
-
-void write16_RP(uint8_t rp, uint16_t value) {
-	switch (rp) {
-		case 0x00:
-			reg8[C] = value & 0x00FF;
-			reg8[B] = value >> 8;
-			break;
-		case 0x01:
-			reg8[E] = value & 0x00FF;
-			reg8[D] = value >> 8;
-			break;
-		case 0x02:
-			reg8[L] = value & 0x00FF;
-			reg8[H] = value >> 8;
-			break;
-		case 0x03:
-			reg_SP = value;
-			break;
-	}
-}
-
-void write16_RP_PUSHPOP(uint8_t rp, uint16_t value) {
-	switch (rp) {
-		case 0x00:
-			reg8[C] = value & 0x00FF;
-			reg8[B] = value >> 8;
-			break;
-		case 0x01:
-			reg8[E] = value & 0x00FF;
-			reg8[D] = value >> 8;
-			break;
-		case 0x02:
-			reg8[L] = value & 0x00FF;
-			reg8[H] = value >> 8;
-			break;
-		case 0x03:
-			reg8[FLAGS] = (value & 0x00FF) & 0xF7;
-			reg8[A] = value >> 8;
-			break;
-	}
-}
-
-void calc_SZP(uint8_t value) {
-	if (value == 0) set_Z(); else clear_Z();
-	if (value & 0x80) set_S(); else clear_S();
-	if (parity[value]) set_P(); else clear_P();
-}
-
-void calc_AC(uint8_t val1, uint8_t val2) {
-	if (((val1 & 0x0F) + (val2 & 0x0F)) > 0x0F) {
-		set_AC();
-	} else {
-		clear_AC();
-	}
-}
-
-void calc_AC_carry(uint8_t val1, uint8_t val2) {
-	if (((val1 & 0x0F) + (val2 & 0x0F)) >= 0x0F) {
-		set_AC();
-	} else {
-		clear_AC();
-	}
-}
-
-void calc_subAC(int8_t val1, uint8_t val2) {
-	if ((val2 & 0x0F) <= (val1 & 0x0F)) {
-		set_AC();
-	} else {
-		clear_AC();
-	}
-}
-
-void calc_subAC_borrow(int8_t val1, uint8_t val2) {
-	if ((val2 & 0x0F) < (val1 & 0x0F)) {
-		set_AC();
-	} else {
-		clear_AC();
-	}
-}
-
-void calc_Vadd(int8_t val1, int8_t val2, int c)
+static uint8_t calc_Vadd(int8_t val1, int8_t val2, int c)
 {
 	/* Did adding bits 0-6 together carry into bit 7 ? */
 	uint8_t c6 = ((val1 & 0x7F) + (val2 & 0x7F) + c) & 0x80;
@@ -220,79 +188,103 @@ void calc_Vadd(int8_t val1, int8_t val2, int c)
 	uint16_t c7 = ((uint16_t)val1 + val2 + c) & 0x100;
 	/* V is the xor of the two carries */
 	/* Annoying C has no ^^ operator */
-	if ((!!c6) ^ (!!c7))
-		set_V();
-	else
-		clear_V();
+	return (!!c6) ^ (!!c7);
 }
 
 /* 16bit maths is actually 8bit maths done twice */
-void calc_Vadd16(int16_t val1, int16_t val2)
+static uint8_t calc_Vadd16(uint16_t val1, uint16_t val2)
 {
 	/* Internal carry of the first add */
 	int c = ((val1 & 0xFF) + (val2 & 0xFF)) & 0x100;
 	/* Fed into the carry of the following adc */
-	calc_Vadd(val1 >> 8, val2 >> 8, !!c);
+	return calc_Vadd(val1 >> 8, val2 >> 8, !!c);
 }
 
-void calc_Vsub(int8_t val1, int8_t val2, int c)
+static uint8_t calc_Vsub(int8_t val1, int8_t val2, int c)
 {
 	uint8_t c6 = ((val1 & 0x7F) - (val2 & 0x7F) - c) & 0x80;
 	uint16_t c7 = ((val1 - val2 - c) & 0x100) >> 1;
-	if (c6 ^ c7)
-		set_V();
-	else
-		clear_V();
+	return !!(c6 ^ c7);
 }
 
-void calc_Vsub16(int16_t val1, int16_t val2)
+/* Work out V and K as flag bits */
+static uint8_t get_VK(struct i8085 *cpu)
 {
-	int c = (val1 & 0xFF) < (val2 & 0xFF);
-	calc_Vsub(val1 >> 8, val2 >> 8, c);
+	uint8_t v;
+
+	switch (cpu->vkind) {
+	case VK_ADD:
+		v = calc_Vadd(cpu->va, cpu->vb, cpu->vc);
+		break;
+	case VK_SUB:
+		v = calc_Vsub(cpu->va, cpu->vb, cpu->vc);
+		break;
+	case VK_SET:
+		v = cpu->va;
+		break;
+	default:
+		return (cpu->va << 1) | (cpu->vb << 5);
+	}
+	return (v << 1) | ((v ^ (cpu->vr >> 7)) << 5);
 }
 
-void calc_K(int8_t r)
+#define test_V()	(get_VK(cpu) & 0x02)
+#define test_K()	(get_VK(cpu) & 0x20)
+
+/* Build the flags byte from the lazy state */
+static uint8_t get_flags(struct i8085 *cpu)
 {
-	if ((!!test_V()) ^ !!(r & 0x80))
-		set_K();
-	else
-		clear_K();
+	uint8_t f = cpu->fbits | cpu->carry | (cpu->acx & 0x10) | (cpu->res & 0x80);
+	if (cpu->zres == 0)
+		f |= 0x40;
+	if (parity[cpu->res])
+		f |= 0x04;
+	return f | get_VK(cpu);
 }
 
-void calc_KVlogic(uint8_t val)
+/* Load the lazy state from a flags byte. S and P can always be represented
+   by one of 0x00, 0x01, 0x80 or 0x81 */
+static void set_flags(struct i8085 *cpu, uint8_t f)
 {
-	clear_V();
-	calc_K(val);
+	cpu->carry = f & 0x01;
+	cpu->acx = f & 0x10;
+	cpu->zres = !(f & 0x40);
+	cpu->res = (f & 0x80) | (((f >> 7) ^ (f >> 2) ^ 1) & 1);
+	cpu->fbits = f & 0x08;
+	set_vk(VK_RAW, (f >> 1) & 1, (f >> 5) & 1, 0, 0);
 }
 
-uint8_t test_cond(uint8_t code) {
+static uint8_t test_cond(struct i8085 *cpu, uint8_t code) {
 	switch (code) {
 		case 0: //Z not set
-			if (!test_Z()) return 1; else return 0;
+			return cpu->zres != 0;
 		case 1: //Z set
-			if (test_Z()) return 1; else return 0;
+			return cpu->zres == 0;
 		case 2: //C not set
-			if (!test_C()) return 1; else return 0;
+			return !cpu->carry;
 		case 3: //C set
-			if (test_C()) return 1; else return 0;
+			return cpu->carry;
 		case 4: //P not set
-			if (!test_P()) return 1; else return 0;
+			return !parity[cpu->res];
 		case 5: //P set
-			if (test_P()) return 1; else return 0;
+			return parity[cpu->res];
 		case 6: //S not set
-			if (!test_S()) return 1; else return 0;
+			return !(cpu->res & 0x80);
 		case 7: //S set
-			if (test_S()) return 1; else return 0;
+			return cpu->res >> 7;
 	}
 	return 0;
 }
 
-void i8085_push(uint16_t value) {
-	i8085_write(--reg_SP, value >> 8);
-	i8085_write(--reg_SP, (uint8_t)value);
+/* Operand fetch, keeping the two reads on the bus in order */
+static uint16_t fetch16(struct i8085 *cpu) {
+	uint16_t temp;
+	temp = i8085_read(reg_PC);
+	temp |= (uint16_t)i8085_read(reg_PC + 1) << 8;
+	return temp;
 }
 
-uint16_t i8085_pop(void) {
+static uint16_t i8085_pop(struct i8085 *cpu) {
 	uint16_t temp;
 	temp = i8085_read(reg_SP++);
 	temp |= (uint16_t)i8085_read(reg_SP++) << 8;
@@ -301,48 +293,44 @@ uint16_t i8085_pop(void) {
 
 void i8085_set_int(int n)
 {
-	intpend |= n;
+	i8085_state.intpend |= n;
 }
 
 void i8085_clear_int(int n)
 {
-	intpend &= ~n;
-}
-
-
-void i8085_jump(uint16_t addr) {
-	reg_PC = addr;
+	i8085_state.intpend &= ~n;
 }
 
 void i8085_reset(void) {
-	reg_PC = reg_SP = 0x0000;
+	i8085_state.pc = i8085_state.sp = 0x0000;
 	//reg8[FLAGS] = 0x02;
 }
 
 void i8085_write_reg8(reg_t reg, uint8_t value) {
-	if (reg == M) {
-		i8085_write(reg16_HL, value);
-	} else {
-		reg8[reg] = value;
-	}
+	if (reg == M)
+		i8085_write((i8085_state.reg[H] << 8) | i8085_state.reg[L], value);
+	else if (reg == FLAGS)
+		set_flags(&i8085_state, value);
+	else
+		i8085_state.reg[reg] = value;
 }
 
 uint8_t i8085_read_reg8(reg_t reg) {
-	if (reg == M) {
-		return i8085_read(reg16_HL);
-	} else {
-		return reg8[reg];
-	}
+	if (reg == M)
+		return i8085_read((i8085_state.reg[H] << 8) | i8085_state.reg[L]);
+	if (reg == FLAGS)
+		return get_flags(&i8085_state);
+	return i8085_state.reg[reg];
 }
 
 uint16_t i8085_read_reg16(reg_t reg) {
 	switch (reg) {
-		case AF: return reg16_PSW;
-		case BC: return reg16_BC;
-		case DE: return reg16_DE;
-		case HL: return reg16_HL;
-		case SP: return reg_SP;
-		case PC: return reg_PC;
+		case AF: return (i8085_state.reg[A] << 8) | get_flags(&i8085_state);
+		case BC: return (i8085_state.reg[B] << 8) | i8085_state.reg[C];
+		case DE: return (i8085_state.reg[D] << 8) | i8085_state.reg[E];
+		case HL: return (i8085_state.reg[H] << 8) | i8085_state.reg[L];
+		case SP: return i8085_state.sp;
+		case PC: return i8085_state.pc;
 		default:
 			fprintf(stderr, "bogus rr16\n");
 	}
@@ -351,12 +339,12 @@ uint16_t i8085_read_reg16(reg_t reg) {
 
 void i8085_write_reg16(reg_t reg, uint16_t value) {
 	switch (reg) {
-		case AF: reg8[A] = value>>8; reg8[FLAGS] = value; break;
-		case BC: reg8[B] = value>>8; reg8[C] = value; break;
-		case DE: reg8[D] = value>>8; reg8[E] = value; break;
-		case HL: reg8[H] = value>>8; reg8[L] = value; break;
-		case SP: reg_SP = value; break;
-		case PC: reg_PC = value; break;
+		case AF: i8085_state.reg[A] = value>>8; set_flags(&i8085_state, value); break;
+		case BC: i8085_state.reg[B] = value>>8; i8085_state.reg[C] = value; break;
+		case DE: i8085_state.reg[D] = value>>8; i8085_state.reg[E] = value; break;
+		case HL: i8085_state.reg[H] = value>>8; i8085_state.reg[L] = value; break;
+		case SP: i8085_state.sp = value; break;
+		case PC: i8085_state.pc = value; break;
 		default:
 			fprintf(stderr, "bogus rr16\n");
 	}
@@ -381,29 +369,27 @@ static char *i8085_flags(uint8_t v)
 }
 
 int i8085_exec(int cycles) {
+	struct i8085 *cpu = &i8085_state;
 	uint8_t opcode, temp8, reg, reg2;
 	uint16_t temp16;
 	uint32_t temp32;
-	uint8_t vec;
+	uint8_t vec, k;
 
 	while (cycles > 0) {
 		/* TRAP is edge and level - must see the edge and it held */
-		if (intpend & INT_NMI) {	/* TRAP - NMI */
-			INTE = 0;
-			intpend &= ~8;
-			if (halted)
-				i8085_push(reg_PC + 1);
-			else
-				i8085_push(reg_PC);
+		if (cpu->intpend & INT_NMI) {	/* TRAP - NMI */
+			cpu->inte = 0;
+			cpu->intpend &= ~8;
+			push16(reg_PC + cpu->halted);
 			reg_PC = 0x24;
 			cycles -= 12; /* Check me */
 			if (i8085_log)
 				fprintf(i8085_log, "NMI taken.\n");
 		/* The others are level except 0x3C which is positive edge.
 		   The 8085 prioritizes so we must do likewise */
-		} else if (INTE && intprotect == 0 && (intpend & ~reg_IM)) {
-			INTE = 0;
-			temp8 = intpend & ~reg_IM;
+		} else if (cpu->inte && cpu->intprotect == 0 && (cpu->intpend & ~cpu->im)) {
+			cpu->inte = 0;
+			temp8 = cpu->intpend & ~cpu->im;
 
 			if (i8085_log)
 				fprintf(i8085_log, "IRQ taken (%x)\n", temp8);
@@ -412,56 +398,52 @@ int i8085_exec(int cycles) {
 				/* FIXME: we should temporarily mask not
 				   clear here. We clear in SIM */
 				vec = 0x3C;
-				intpend &= ~INT_RST75;
+				cpu->intpend &= ~INT_RST75;
 			} else if (temp8 & INT_RST65)
 				vec = 0x34;
 			else if (temp8 & INT_RST55)
 				vec = 0x2C;
 			else
 				vec = 0x38;
-			if (halted)
-				i8085_push(reg_PC + 1);
-			else
-				i8085_push(reg_PC);
+			push16(reg_PC + cpu->halted);
 			reg_PC = vec;
 			cycles -= 12;	/* Check me */
 		}
-		intprotect = 0;
-		halted = 0;
+		cpu->intprotect = 0;
+		cpu->halted = 0;
 
 		opcode = i8085_read(reg_PC);
 		
 		if (i8085_log)
 			fprintf(i8085_log, "%04X : %02X %02X %02X : %6s %02X %04X %04X %04X %04X %s\n",
 				reg_PC, i8085_debug_read(reg_PC), i8085_debug_read(reg_PC + 1), i8085_debug_read(reg_PC + 2),
-				i8085_flags(reg8[FLAGS]), reg8[A], reg16_BC, reg16_DE, reg16_HL, reg_SP,
+				i8085_flags(get_flags(cpu)), reg8[A], reg16_BC, reg16_DE, reg16_HL, reg_SP,
 					i8085_disassemble(reg_PC));
 		
 		reg_PC++;
 
 		switch (opcode) {
 			case 0x3A: //LDA a - load A from memory
-				temp16 = (uint16_t)i8085_read(reg_PC) | ((uint16_t)i8085_read(reg_PC+1)<<8);
+				temp16 = fetch16(cpu);
 				reg8[A] = i8085_read(temp16);
 				reg_PC += 2;
 				cycles -= 13;
 				break;
 			case 0x32: //STA a - store A to memory
-				temp16 = (uint16_t)i8085_read(reg_PC) | ((uint16_t)i8085_read(reg_PC+1)<<8);
+				temp16 = fetch16(cpu);
 				i8085_write(temp16, reg8[A]);
 				reg_PC += 2;
 				cycles -= 13;
 				break;
 			case 0x2A: //LHLD a - load H:L from memory
-				temp16 = (uint16_t)i8085_read(reg_PC);
-				temp16 |= ((uint16_t)i8085_read(reg_PC+1)<<8);
+				temp16 = fetch16(cpu);
 				reg8[L] = i8085_read(temp16++);
 				reg8[H] = i8085_read(temp16);
 				reg_PC += 2;
 				cycles -= 16;
 				break;
 			case 0x22: //SHLD a - store H:L to memory
-				temp16 = (uint16_t)i8085_read(reg_PC) | ((uint16_t)i8085_read(reg_PC+1)<<8);
+				temp16 = fetch16(cpu);
 				i8085_write(temp16++, reg8[L]);
 				i8085_write(temp16, reg8[H]);
 				reg_PC += 2;
@@ -477,139 +459,91 @@ int i8085_exec(int cycles) {
 				cycles -= 5;
 				break;
 			case 0xC6: //ADI # - add immediate to A
-				temp8 = i8085_read(reg_PC++);
-				temp16 = (uint16_t)reg8[A] + (uint16_t)temp8;
-				if (temp16 & 0xFF00) set_C(); else clear_C();
-				calc_AC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
-				calc_Vadd(reg8[A], temp8, 0);
-				calc_K((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_add(i8085_read(reg_PC++), 0);
 				cycles -= 7;
 				break;
 			case 0xCE: //ACI # - add immediate to A with carry
-				temp8 = i8085_read(reg_PC++);
-				temp16 = (uint16_t)reg8[A] + (uint16_t)temp8 + (uint16_t)test_C();
-				if (test_C()) calc_AC_carry(reg8[A], temp8); else calc_AC(reg8[A], temp8);
 				/* The carry out is computed including the
 				   carry in of the bit before */
-				calc_Vadd(reg8[A], temp8, test_C());
-				if (temp16 & 0xFF00) set_C(); else clear_C();
-				calc_SZP((uint8_t)temp16);
-				calc_K((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_add(i8085_read(reg_PC++), cpu->carry);
 				cycles -= 7;
 				break;
 			case 0xD6: //SUI # - subtract immediate from A
-				temp8 = i8085_read(reg_PC++);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8;
-				if (((temp16 & 0x00FF) >= reg8[A]) && temp8) set_C(); else clear_C();
-				calc_subAC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
-				calc_Vsub(reg8[A], temp8, 0);
-				calc_K((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_sub(i8085_read(reg_PC++), 0);
 				cycles -= 7;
 				break;
 			case 0x27: //DAA - decimal adjust accumulator
 				temp8 = reg8[A];
 				temp16 = temp8;
-				if (((temp16 & 0x0F) > 0x09) || test_AC()) {
-					if (((temp16 & 0x0F) + 0x06) & 0xF0) set_AC(); else clear_AC();
+				if (((temp16 & 0x0F) > 0x09) || (cpu->acx & 0x10)) {
+					cpu->acx = ((temp16 & 0x0F) + 0x06) & 0xF0 ? 0x10 : 0x00;
 					temp16 += 0x06;
-					if (temp16 & 0xFF00) set_C(); //can also cause carry to be set during addition to the low nibble
+					if (temp16 & 0xFF00) cpu->carry = 1; //can also cause carry to be set during addition to the low nibble
 				}
-				if (((temp16 & 0xF0) > 0x90) || test_C()) {
+				if (((temp16 & 0xF0) > 0x90) || cpu->carry) {
 					temp16 += 0x60;
-					if (temp16 & 0xFF00) set_C(); //doesn't clear it if this clause is false
+					if (temp16 & 0xFF00) cpu->carry = 1; //doesn't clear it if this clause is false
 				}
-				calc_SZP((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				set_res(reg8[A] = (uint8_t)temp16);
 				/* Verify this behaviour */
-				if ((temp8 & 0xF0) == 0x70 &&
-					(temp16 & 0xF0) == 0x80)
-					set_V();
-				else
-					clear_V();
-				calc_K(reg8[A]);
+				set_vk(VK_SET, (temp8 & 0xF0) == 0x70 && (temp16 & 0xF0) == 0x80,
+					0, 0, reg8[A]);
 				cycles -= 4;
 				break;
 			case 0xE6: //ANI # - AND immediate with A
-				temp8 = i8085_read(reg_PC++);
 				/* This differs from 8080 */
-				set_AC();
-				reg8[A] &= temp8;
-				clear_C();
-				calc_SZP(reg8[A]);
-				calc_KVlogic(reg8[A]);
+				alu_logic(reg8[A] & i8085_read(reg_PC++), 0x10);
+				reg8[A] = cpu->res;
 				cycles -= 7;
 				break;
 			case 0xF6: //ORI # - OR immediate with A
 				reg8[A] |= i8085_read(reg_PC++);
-				clear_AC();
-				clear_C();
-				calc_SZP(reg8[A]);
-				calc_KVlogic(reg8[A]);
+				alu_logic(reg8[A], 0);
 				cycles -= 7;
 				break;
 			case 0xEE: //XRI # - XOR immediate with A
 				reg8[A] ^= i8085_read(reg_PC++);
-				clear_AC();
-				clear_C();
-				calc_SZP(reg8[A]);
-				calc_KVlogic(reg8[A]);
+				alu_logic(reg8[A], 0);
 				cycles -= 7;
 				break;
 			case 0xDE: //SBI # - subtract immediate from A with borrow
-				temp8 = i8085_read(reg_PC++);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8 - (uint16_t)test_C();
-				if (test_C()) calc_subAC_borrow(reg8[A], temp8); else calc_subAC(reg8[A], temp8);
-				calc_Vsub(reg8[A], temp8, test_C());
-				if (((temp16 & 0x00FF) >= reg8[A]) && (temp8 | test_C())) set_C(); else clear_C();
-				calc_SZP((uint8_t)temp16);
-				calc_K((uint8_t)temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_sub(i8085_read(reg_PC++), cpu->carry);
 				cycles -= 7;
 				break;
 			case 0xFE: //CPI # - compare immediate with A
-				temp8 = i8085_read(reg_PC++);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8;
-				if (((temp16 & 0x00FF) >= reg8[A]) && temp8) set_C(); else clear_C();
-				calc_subAC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
-				calc_Vsub(reg8[A], temp8, 0);
-				calc_K((uint8_t)temp16);
+				alu_cmp(i8085_read(reg_PC++), 0);
 				cycles -= 7;
 				break;
 			case 0x07: //RLC - rotate A left
-				if (reg8[A] & 0x80) set_C(); else clear_C();
-				calc_Vadd(reg8[A],reg8[A], reg8[A] & 0x80);
-				reg8[A] = (reg8[A] >> 7) | (reg8[A] << 1);
-				calc_K(reg8[A]);
+				temp8 = reg8[A];
+				cpu->carry = temp8 >> 7;
+				reg8[A] = (temp8 >> 7) | (temp8 << 1);
+				set_vk(VK_ADD, temp8, temp8, temp8 & 0x80, reg8[A]);
 				cycles -= 4;
 				break;
 			case 0x0F: //RRC - rotate A right
-				if (reg8[A] & 0x01) set_C(); else clear_C();
+				cpu->carry = reg8[A] & 0x01;
 				reg8[A] = (reg8[A] << 7) | (reg8[A] >> 1);
-				clear_V();
 				/* Verify if RR ops affect K */
+				k = !!test_K();
+				set_vk(VK_RAW, 0, k, 0, 0);
 				cycles -= 4;
 				break;
 			case 0x17: //RAL - rotate A left through carry
-				temp8 = test_C();
-				if (reg8[A] & 0x80) set_C(); else clear_C();
-				calc_Vadd(reg8[A],reg8[A], temp8);
-				reg8[A] = (reg8[A] << 1) | temp8;
-				calc_K(reg8[A]);
+				temp8 = cpu->carry;
+				set_vk(VK_ADD, reg8[A], reg8[A], temp8, (reg8[A] << 1) | temp8);
+				cpu->carry = reg8[A] >> 7;
+				reg8[A] = cpu->vr;
 				cycles -= 4;
 				break;
 			case 0x1F: //RAR - rotate A right through carry
-				temp8 = test_C();
-				if (reg8[A] & 0x01) set_C(); else clear_C();
+				temp8 = cpu->carry;
+				cpu->carry = reg8[A] & 0x01;
 				reg8[A] = (reg8[A] >> 1) | (temp8 << 7);
 				cycles -= 4;
 				/* Verify if RR ops affect K */
-				clear_V();
+				k = !!test_K();
+				set_vk(VK_RAW, 0, k, 0, 0);
 				break;
 			case 0x2F: //CMA - complement A
 				reg8[A] = ~reg8[A];
@@ -617,17 +551,17 @@ int i8085_exec(int cycles) {
 				/* This does not affect flags */
 				break;
 			case 0x3F: //CMC - complement carry flag
-				reg8[FLAGS] ^= 1;
+				cpu->carry ^= 1;
 				cycles -= 4;
 				break;
 			case 0x37: //STC - set carry flag
-				set_C();
+				cpu->carry = 1;
 				cycles -= 4;
 				break;
 			case 0xCB: //RSTv
 				if (test_V()) {
 					cycles -= 6;
-					i8085_push(reg_PC);
+					push16(reg_PC);
 					reg_PC = 0x40;
 				}
 				cycles -= 6;
@@ -640,7 +574,7 @@ int i8085_exec(int cycles) {
 			case 0xDF:
 			case 0xEF:
 			case 0xFF:
-				i8085_push(reg_PC);
+				push16(reg_PC);
 				reg_PC = (uint16_t)((opcode >> 3) & 7) << 3;
 				cycles -= 12;
 				break;
@@ -650,9 +584,9 @@ int i8085_exec(int cycles) {
 				cycles -= 6;
 				break;
 			case 0xE3: //XTHL - swap H:L with top word on stack
-				temp16 = i8085_pop();
-				i8085_push(reg16_HL);
-				write16_RP(2, temp16);
+				temp16 = i8085_pop(cpu);
+				push16(reg16_HL);
+				write_RP(2, temp16);
 				cycles -= 16;
 				break;
 			case 0xF9: //SPHL - set SP to content of HL
@@ -668,97 +602,79 @@ int i8085_exec(int cycles) {
 				cycles -= 10;
 				break;
 			case 0xFB: //EI - enable intersrupts
-				INTE = 1;
-				intprotect = 1;
+				cpu->inte = 1;
+				cpu->intprotect = 1;
 				cycles -= 4;
 				break;
 			case 0xF3: //DI - disbale interrupts
-				INTE = 0;
+				cpu->inte = 0;
 				cycles -= 4;
 				break;
 			case 0x76: //HLT - halt processor
 				reg_PC--;
 				cycles -= 7;
-				halted = 1;
+				cpu->halted = 1;
 				break;
 			case 0x00: //NOP - no operation
 				cycles -= 4;
 				break;
 			case 0x08: // DSUB - 16bit subtraction
 				/* Does SUB L,C; SBC H,B for flags */
-				temp8 = reg8[C];
-				temp16 = (uint16_t)reg8[L] - (uint16_t)temp8;
-				if ((temp16 & 0x00FF) >= reg8[L] && temp8)
-					set_C();
-				else
-					clear_C();
+				temp16 = (uint16_t)reg8[L] - (uint16_t)reg8[C];
 				reg8[L] = (uint8_t)temp16;
 				/* We don't need the other intermediate flags */
-				temp8 = reg8[B];
-				temp16 = (uint16_t)reg8[H] - (uint16_t)temp8 - (uint16_t)test_C();
-				if (test_C())
-					calc_subAC_borrow(reg8[H], temp8);
-				else
-					calc_subAC(reg8[H], temp8);				
-				calc_Vsub(reg8[H], temp8, test_C());
-				if ((temp16 & 0x00FF) >= reg8[H] && (temp8 | test_C()))
-					set_C();
-				else
-					clear_C();
-				calc_SZP((uint8_t)temp16);
-				calc_K(temp16);
-				reg8[H] = (uint8_t)temp16;
+				temp8 = (temp16 >> 8) & 1;
+				temp16 = (uint16_t)reg8[H] - (uint16_t)reg8[B] - temp8;
+				cpu->acx = ~(reg8[H] ^ reg8[B] ^ temp16);
+				cpu->carry = (temp16 >> 8) & 1;
+				set_vk(VK_SUB, reg8[H], reg8[B], temp8, temp16);
+				set_res(reg8[H] = (uint8_t)temp16);
 				cycles -= 10;
 				break;					
 			case 0x10: // ARHL
-				if (reg16_HL & 1)
-					set_C();
-				else
-					clear_C();
+				cpu->carry = reg8[L] & 1;
 				temp16 = reg16_HL >> 1;
 				if (temp16 & 0x4000)
 					temp16 |= 0x8000;
-				i8085_write_reg16(HL, temp16);
+				write_RP(2, temp16);
 				cycles -= 7;
 				break;
 			case 0x18: // RDEL
 				/* Affects only CY and V */
 				temp16 = reg16_DE;
-				temp8 = test_C();
-				i8085_write_reg16(DE, (temp16 << 1) + temp8);
-				if (temp16 & 0x8000)
-					set_C();
-				else
-					clear_C();
+				temp8 = cpu->carry;
+				write_RP(1, (temp16 << 1) + temp8);
+				cpu->carry = temp16 >> 15;
 				cycles -= 10;
 				/* This seems to be a DAD D,D with carry but
 				   I'm not enitrely sure. FIXME */
-				calc_Vadd16(temp16, temp16 + temp8);
+				k = !!test_K();
+				set_vk(VK_RAW, calc_Vadd16(temp16, temp16 + temp8), k, 0, 0);
 				break;
 			case 0x20: // RIM
-				temp8 = reg_IM & 0x07;
-				if (intpend & INT_RST75)
+				temp8 = cpu->im & 0x07;
+				if (cpu->intpend & INT_RST75)
 					temp8 |= 0x10;
 				temp8 |= i8085_get_input() ? 0x80: 0x00;
-				temp8 |= (intpend & 7)  << 4;
+				temp8 |= (cpu->intpend & 7)  << 4;
 				reg8[A] = temp8;
 				cycles -= 4;
 				break;
 			case 0x28: // LDHI
-				i8085_write_reg16(DE, reg16_HL + i8085_read(reg_PC++));
+				write_RP(1, reg16_HL + i8085_read(reg_PC++));
 				cycles -= 10;
 				break;
 			case 0x30: // SIM
 				if (reg8[A] & 0x08)
-					reg_IM = reg8[A] & 0x07;
+					cpu->im = reg8[A] & 0x07;
 				if (reg8[A] & 0x10)
-					intpend &= ~INT_RST75;
+					cpu->intpend &= ~INT_RST75;
 				if (reg8[A] & 0x40)
 					i8085_set_output(reg8[A] & 0x80);
 				cycles -= 4;
 				break;
 			case 0x38: // LDSI
-				i8085_write_reg16(DE, reg_SP + i8085_read(reg_PC++));
+				write_RP(1, reg_SP + i8085_read(reg_PC++));
 				cycles -= 10;
 				break;
 			case 0x40: case 0x50: case 0x60: case 0x70: //MOV D,S - move register to register
@@ -779,38 +695,37 @@ int i8085_exec(int cycles) {
 			case 0x4F: case 0x5F: case 0x6F: case 0x7F:
 				reg = (opcode >> 3) & 7;
 				reg2 = opcode & 7;
-				i8085_write_reg8(reg, i8085_read_reg8(reg2));
-				if ((reg == M) || (reg2 == M)) {
+				if (reg2 == M) {
+					reg8[reg] = i8085_read(reg16_HL);
+					cycles -= 7;
+				} else if (reg == M) {
+					i8085_write(reg16_HL, reg8[reg2]);
 					cycles -= 7;
 				} else {
+					reg8[reg] = reg8[reg2];
 					cycles -= 4;
 				}
 				break;
 			case 0x06: //MVI D,# - move immediate to register
 			case 0x16:
 			case 0x26:
-			case 0x36:
 			case 0x0E:
 			case 0x1E:
 			case 0x2E:
 			case 0x3E:
-				reg = (opcode >> 3) & 7;
-				i8085_write_reg8(reg, i8085_read(reg_PC++));
-				if (reg == M) {
-					cycles -= 10;
-				} else {
-					cycles -= 7;
-				}
+				reg8[(opcode >> 3) & 7] = i8085_read(reg_PC++);
+				cycles -= 7;
+				break;
+			case 0x36: //MVI M,#
+				i8085_write(reg16_HL, i8085_read(reg_PC++));
+				cycles -= 10;
 				break;
 			case 0x01: //LXI RP,# - load register pair immediate
 			case 0x11:
 			case 0x21:
 			case 0x31:
 				reg = (opcode >> 4) & 3;
-				/* Although there are not internal side effects we must put
-				   the two reads on the bus in order */
-				temp8 = i8085_read(reg_PC);
-				write_RP(reg, temp8, i8085_read(reg_PC + 1));
+				write_RP(reg, fetch16(cpu));
 				reg_PC += 2;
 				cycles -= 10;
 				break;
@@ -833,50 +748,46 @@ int i8085_exec(int cycles) {
 			case 0x04: //INR D - increment register
 			case 0x14:
 			case 0x24:
-			case 0x34:
 			case 0x0C:
 			case 0x1C:
 			case 0x2C:
 			case 0x3C:
 				reg = (opcode >> 3) & 7;
-				temp8 = i8085_read_reg8(reg); //reg8[reg];
-				calc_AC(temp8, 1);
-				calc_SZP(temp8 + 1);
-				if (temp8 == 0x7F)
-					set_V();
-				else
-					clear_V();
-				calc_K(temp8+1);
-				i8085_write_reg8(reg, temp8 + 1); //reg8[reg]++;
-				if (reg == M) {
-					cycles -= 10;
-				} else {
-					cycles -= 4;
-				}
+				temp8 = reg8[reg];
+				cpu->acx = temp8 ^ (temp8 + 1) ^ 1;
+				set_res(reg8[reg] = temp8 + 1);
+				set_vk(VK_SET, temp8 == 0x7F, 0, 0, cpu->res);
+				cycles -= 4;
+				break;
+			case 0x34: //INR M
+				temp8 = i8085_read(reg16_HL);
+				cpu->acx = temp8 ^ (temp8 + 1) ^ 1;
+				set_res(temp8 + 1);
+				set_vk(VK_SET, temp8 == 0x7F, 0, 0, cpu->res);
+				i8085_write(reg16_HL, cpu->res);
+				cycles -= 10;
 				break;
 			case 0x05: //DCR D - decrement register
 			case 0x15:
 			case 0x25:
-			case 0x35:
 			case 0x0D:
 			case 0x1D:
 			case 0x2D:
 			case 0x3D:
 				reg = (opcode >> 3) & 7;
-				temp8 = i8085_read_reg8(reg); //reg8[reg];
-				calc_subAC(temp8, 1);
-				calc_SZP(temp8 - 1);
-				if (temp8 == 0x80)
-					set_V();
-				else
-					clear_V();
-				calc_K(temp8 - 1);
-				i8085_write_reg8(reg, temp8 - 1); //reg8[reg]--;
-				if (reg == M) {
-					cycles -= 10;
-				} else {
-					cycles -= 4;
-				}
+				temp8 = reg8[reg];
+				cpu->acx = ~(temp8 ^ (temp8 - 1) ^ 1);
+				set_res(reg8[reg] = temp8 - 1);
+				set_vk(VK_SET, temp8 == 0x80, 0, 0, cpu->res);
+				cycles -= 4;
+				break;
+			case 0x35: //DCR M
+				temp8 = i8085_read(reg16_HL);
+				cpu->acx = ~(temp8 ^ (temp8 - 1) ^ 1);
+				set_res(temp8 - 1);
+				set_vk(VK_SET, temp8 == 0x80, 0, 0, cpu->res);
+				i8085_write(reg16_HL, cpu->res);
+				cycles -= 10;
 				break;
 			case 0x03: //INX RP - increment register pair
 			case 0x13:
@@ -884,15 +795,8 @@ int i8085_exec(int cycles) {
 			case 0x33:
 				reg = (opcode >> 4) & 3;
 				temp16 = read_RP(reg) + 1;
-				if (temp16 == 0x8000)
-					set_V();
-				else
-					clear_V();
-				if (temp16 == 0x0000)
-					set_K();
-				else
-					clear_K();
-				write16_RP(reg, temp16);
+				set_vk(VK_RAW, temp16 == 0x8000, temp16 == 0x0000, 0, 0);
+				write_RP(reg, temp16);
 				cycles -= 6;
 				break;
 			case 0x0B: //DCX RP - decrement register pair
@@ -901,15 +805,8 @@ int i8085_exec(int cycles) {
 			case 0x3B:
 				reg = (opcode >> 4) & 3;
 				temp16 = read_RP(reg) - 1;
-				if (temp16 == 0x7FFF)
-					set_V();
-				else
-					clear_V();
-				if (temp16 == 0xFFFF)
-					set_K();
-				else
-					clear_K();
-				write16_RP(reg, temp16);
+				set_vk(VK_RAW, temp16 == 0x7FFF, temp16 == 0xFFFF, 0, 0);
+				write_RP(reg, temp16);
 				cycles -= 6;
 				break;
 			case 0x09: //DAD RP - add register pair to HL
@@ -917,11 +814,13 @@ int i8085_exec(int cycles) {
 			case 0x29:
 			case 0x39:
 				reg = (opcode >> 4) & 3;
-				calc_Vadd16(reg16_HL, read_RP(reg));
-				temp32 = (uint32_t)reg16_HL + (uint32_t)read_RP(reg);
-				write16_RP(2, (uint16_t)temp32);
-				if (temp32 & 0xFFFF0000) set_C(); else clear_C();
-				calc_K(temp32 >> 8);;
+				temp16 = read_RP(reg);
+				temp32 = (uint32_t)reg16_HL + (uint32_t)temp16;
+				/* V is that of the add of the upper bytes */
+				set_vk(VK_ADD, reg8[H], temp16 >> 8,
+					(reg8[L] + (temp16 & 0xFF)) >> 8, temp32 >> 8);
+				write_RP(2, (uint16_t)temp32);
+				cpu->carry = temp32 >> 16;
 				cycles -= 10;
 				break;
 			case 0x80: //ADD S - add register or memory to A
@@ -933,14 +832,7 @@ int i8085_exec(int cycles) {
 			case 0x86:
 			case 0x87:
 				reg = opcode & 7;
-				temp8 = i8085_read_reg8(reg);
-				temp16 = (uint16_t)reg8[A] + (uint16_t)temp8;
-				if (temp16 & 0xFF00) set_C(); else clear_C();
-				calc_AC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
-				calc_Vadd(reg8[A], temp8, 0);
-				calc_K(temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_add(alu_src(reg), 0);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -956,14 +848,7 @@ int i8085_exec(int cycles) {
 			case 0x8E:
 			case 0x8F:
 				reg = opcode & 7;
-				temp8 = i8085_read_reg8(reg);
-				temp16 = (uint16_t)reg8[A] + (uint16_t)temp8 + (uint16_t)test_C();
-				if (test_C()) calc_AC_carry(reg8[A], temp8); else calc_AC(reg8[A], temp8);
-				calc_Vadd(reg8[A], temp8, test_C());
-				if (temp16 & 0xFF00) set_C(); else clear_C();
-				calc_SZP((uint8_t)temp16);
-				calc_K(temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_add(alu_src(reg), cpu->carry);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -979,14 +864,7 @@ int i8085_exec(int cycles) {
 			case 0x96:
 			case 0x97:
 				reg = opcode & 7;
-				temp8 = i8085_read_reg8(reg);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8;
-				if (((temp16 & 0x00FF) >= reg8[A]) && temp8) set_C(); else clear_C();
-				calc_subAC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
-				calc_Vsub(reg8[A], temp8, 0);
-				calc_K(temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_sub(alu_src(reg), 0);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -1002,14 +880,7 @@ int i8085_exec(int cycles) {
 			case 0x9E:
 			case 0x9F:
 				reg = opcode & 7;
-				temp8 = i8085_read_reg8(reg);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8 - (uint16_t)test_C();
-				if (test_C()) calc_subAC_borrow(reg8[A], temp8); else calc_subAC(reg8[A], temp8);
-				calc_Vsub(reg8[A], temp8, test_C());
-				if (((temp16 & 0x00FF) >= reg8[A]) && (temp8 | test_C())) set_C(); else clear_C();
-				calc_SZP((uint8_t)temp16);
-				calc_K(temp16);
-				reg8[A] = (uint8_t)temp16;
+				alu_sub(alu_src(reg), cpu->carry);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -1025,14 +896,8 @@ int i8085_exec(int cycles) {
 			case 0xA6:
 			case 0xA7:
 				reg = opcode & 7;
-				temp8 = i8085_read_reg8(reg);
-				/* The 8085 always sets AC, the 8080 it's an
-				   or of bit 3 of the values */
-				set_AC();
-				reg8[A] &= temp8;
-				clear_C();
-				calc_SZP(reg8[A]);
-				calc_KVlogic(reg8[A]);
+				alu_logic(reg8[A] & alu_src(reg), 0x10);
+				reg8[A] = cpu->res;
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -1048,11 +913,8 @@ int i8085_exec(int cycles) {
 			case 0xB6:
 			case 0xB7:
 				reg = opcode & 7;
-				reg8[A] |= i8085_read_reg8(reg);
-				clear_AC();
-				clear_C();
-				calc_SZP(reg8[A]);
-				calc_KVlogic(reg8[A]);
+				reg8[A] |= alu_src(reg);
+				alu_logic(reg8[A], 0);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -1068,11 +930,8 @@ int i8085_exec(int cycles) {
 			case 0xAE:
 			case 0xAF:
 				reg = opcode & 7;
-				reg8[A] ^= i8085_read_reg8(reg);
-				clear_AC();
-				clear_C();
-				calc_SZP(reg8[A]);
-				calc_KVlogic(reg8[A]);
+				reg8[A] ^= alu_src(reg);
+				alu_logic(reg8[A], 0);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -1088,13 +947,7 @@ int i8085_exec(int cycles) {
 			case 0xBE:
 			case 0xBF:
 				reg = opcode & 7;
-				temp8 = i8085_read_reg8(reg);
-				temp16 = (uint16_t)reg8[A] - (uint16_t)temp8;
-				if (((temp16 & 0x00FF) >= reg8[A]) && temp8) set_C(); else clear_C();
-				calc_subAC(reg8[A], temp8);
-				calc_SZP((uint8_t)temp16);
-				calc_Vsub(reg8[A], temp8, 0);
-				calc_K(temp16);
+				alu_cmp(alu_src(reg), 0);
 				if (reg == M) {
 					cycles -= 7;
 				} else {
@@ -1102,9 +955,7 @@ int i8085_exec(int cycles) {
 				}
 				break;
 			case 0xC3: //JMP a - unconditional jump
-				temp16 = (uint8_t)i8085_read(reg_PC);
-				temp16 |= (((uint16_t)i8085_read(reg_PC + 1)) << 8);
-				reg_PC = temp16;
+				reg_PC = fetch16(cpu);
 				cycles -= 10;
 				break;
 			case 0xC2: //Jccc - conditional jumps
@@ -1115,9 +966,8 @@ int i8085_exec(int cycles) {
 			case 0xEA:
 			case 0xF2:
 			case 0xFA:
-				temp16 = (uint8_t)i8085_read(reg_PC);
-				temp16 |= (((uint16_t)i8085_read(reg_PC + 1)) << 8);
-				if (test_cond((opcode >> 3) & 7)) {
+				temp16 = fetch16(cpu);
+				if (test_cond(cpu, (opcode >> 3) & 7)) {
 					reg_PC = temp16;
 					cycles -= 10;
 				} else {
@@ -1126,8 +976,7 @@ int i8085_exec(int cycles) {
 				}
 				break;
 			case 0xDD: // JNK
-				temp16 = (uint8_t)i8085_read(reg_PC);
-				temp16 |= (((uint16_t)i8085_read(reg_PC + 1)) << 8);
+				temp16 = fetch16(cpu);
 				if (!test_K()) {
 					reg_PC = temp16;
 					cycles -= 10;
@@ -1136,14 +985,13 @@ int i8085_exec(int cycles) {
 					cycles -= 7;
 				}
 				break;
-			case 0xED:
+			case 0xED: // LHLX
 				reg8[L] = i8085_read(reg16_DE);
 				reg8[H] = i8085_read(reg16_DE + 1);
 				cycles -= 10;
 				break;
 			case 0xFD: // JK
-				temp16 = (uint8_t)i8085_read(reg_PC);
-				temp16 |= (((uint16_t)i8085_read(reg_PC + 1)) << 8);
+				temp16 = fetch16(cpu);
 				if (test_K()) {
 					reg_PC = temp16;
 					cycles -= 10;
@@ -1153,9 +1001,8 @@ int i8085_exec(int cycles) {
 				}
 				break;
 			case 0xCD: //CALL a - unconditional call
-				temp16 = (uint8_t)i8085_read(reg_PC);
-				temp16 |= (((uint16_t)i8085_read(reg_PC + 1)) << 8);
-				i8085_push(reg_PC + 2);
+				temp16 = fetch16(cpu);
+				push16(reg_PC + 2);
 				reg_PC = temp16;
 				cycles -= 18;
 				break;
@@ -1167,10 +1014,9 @@ int i8085_exec(int cycles) {
 			case 0xEC:
 			case 0xF4:
 			case 0xFC:
-				temp16 = (uint8_t)i8085_read(reg_PC);
-				temp16 |= (((uint16_t)i8085_read(reg_PC + 1)) << 8);
-				if (test_cond((opcode >> 3) & 7)) {
-					i8085_push(reg_PC + 2);
+				temp16 = fetch16(cpu);
+				if (test_cond(cpu, (opcode >> 3) & 7)) {
+					push16(reg_PC + 2);
 					reg_PC = temp16;
 					cycles -= 18;
 				} else {
@@ -1184,7 +1030,7 @@ int i8085_exec(int cycles) {
 				cycles -= 10;
 				break;
 			case 0xC9: //RET - unconditional return
-				reg_PC = i8085_pop();
+				reg_PC = i8085_pop(cpu);
 				cycles -= 10;
 				break;
 			case 0xC0: //Rccc - conditional returns
@@ -1195,8 +1041,8 @@ int i8085_exec(int cycles) {
 			case 0xE8:
 			case 0xF0:
 			case 0xF8:
-				if (test_cond((opcode >> 3) & 7)) {
-					reg_PC = i8085_pop();
+				if (test_cond(cpu, (opcode >> 3) & 7)) {
+					reg_PC = i8085_pop(cpu);
 					cycles -= 12;
 				} else {
 					cycles -= 6;
@@ -1205,18 +1051,26 @@ int i8085_exec(int cycles) {
 			case 0xC5: //PUSH RP - push register pair on the stack
 			case 0xD5:
 			case 0xE5:
-			case 0xF5:
 				reg = (opcode >> 4) & 3;
-				i8085_push(read_RP_PUSHPOP(reg));
+				push16(read_RP(reg));
 				/* 11 on 8080 12 on 8085 */
 				cycles -= 12;
 				break;
+			case 0xF5: //PUSH PSW
+				push16((reg8[A] << 8) | get_flags(cpu));
+				cycles -= 12;
+				break;
 			case 0xC1: //POP RP - pop register pair from the stack
 			case 0xD1:
 			case 0xE1:
-			case 0xF1:
 				reg = (opcode >> 4) & 3;
-				write16_RP_PUSHPOP(reg, i8085_pop());
+				write_RP(reg, i8085_pop(cpu));
+				cycles -= 10;
+				break;
+			case 0xF1: //POP PSW
+				temp16 = i8085_pop(cpu);
+				set_flags(cpu, temp16 & 0xF7);
+				reg8[A] = temp16 >> 8;
 				cycles -= 10;
 				break;
 			default:
@@ -11,18 +11,31 @@
 typedef struct CPUEvent CPUEvent;
 typedef void CPUHandler( word32 timestamp );
 
+/* Events are kept in a binary heap ordered by the absolute value of
+ * cpu_cycle_count at which they fire. 'slot' is the event's position
+ * in the heap, or 0 if it is not currently scheduled.
+ */
+
 struct CPUEvent
 {
-    CPUEvent *      next;
-    CPUEvent *      previous;
-    long            counter;
+    word32          when;
+    int             slot;
     CPUHandler *    handler;
 };
 
+#define CPUEVENT_MAX    64
+
+/* Cycle count at which the earliest scheduled event fires */
+extern word32 cpu_event_next;
+
+/* Wrap safe comparison of two cycle counts */
+#define CPUEvent_due(now, when) ((sword32)((word32)(now) - (word32)(when)) >= 0)
+
 void CPUEvent_elapse( word32 delta );
 void CPUEvent_dispatch( void );
 void CPUEvent_initialize( void );
 void CPUEvent_schedule( CPUEvent *, word32, CPUHandler * );
+void CPUEvent_cancel( CPUEvent * );
 
 #endif
 
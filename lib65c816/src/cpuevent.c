@@ -7,93 +7,160 @@
 
 #include <lib65816/cpuevent.h>
 #include <stdio.h>
+#include <stdlib.h>
 
-struct List
+/* The heap is 1 based so that the parent of n is n / 2 and a slot of 0
+ * can mean "not scheduled".
+ */
+
+static CPUEvent *heap[CPUEVENT_MAX + 1];
+static int heapSize;
+
+word32 cpu_event_next;
+
+/* When nothing is scheduled keep the next event as far away as the
+ * wrap safe comparison allows.
+ */
+
+static void
+updateNext( void )
+{
+    if( heapSize )
+        cpu_event_next = heap[1] -> when;
+    else
+        cpu_event_next = cpu_cycle_count + 0x7FFFFFFF;
+}
+
+static int
+before( CPUEvent *a, CPUEvent *b )
+{
+    return (sword32)(a -> when - b -> when) < 0;
+}
+
+static void
+place( CPUEvent *thisEvent, int n )
+{
+    heap[n] = thisEvent;
+    thisEvent -> slot = n;
+}
+
+static void
+siftUp( int n )
 {
-    CPUEvent *  head;
-    void *      null;
-    CPUEvent *  tail;
-};
+    CPUEvent *thisEvent = heap[n];
+
+    while( n > 1 && before( thisEvent, heap[n / 2] ) )
+    {
+        place( heap[n / 2], n );
+        n /= 2;
+    }
+    place( thisEvent, n );
+}
+
+static void
+siftDown( int n )
+{
+    CPUEvent *thisEvent = heap[n];
+    int child;
+
+    while( ( child = n * 2 ) <= heapSize )
+    {
+        if( child < heapSize && before( heap[child + 1], heap[child] ) )
+            child++;
+        if( !before( heap[child], thisEvent ) )
+            break;
+        place( heap[child], n );
+        n = child;
+    }
+    place( thisEvent, n );
+}
 
-static struct List eventList;
+static void
+removeEvent( CPUEvent *thisEvent )
+{
+    int n = thisEvent -> slot;
+    CPUEvent *last = heap[heapSize--];
+
+    thisEvent -> slot = 0;
+    if( last == thisEvent )
+        return;
+
+    /* Move the last entry into the hole and restore the heap order in
+     * whichever direction it needs to go.
+     */
+
+    place( last, n );
+    if( n > 1 && before( last, heap[n / 2] ) )
+        siftUp( n );
+    else
+        siftDown( n );
+}
 
 void
 CPUEvent_initialize( void )
 {
-    eventList.head = (CPUEvent *)(&eventList.null);
-    eventList.null = 0;
-    eventList.tail = (CPUEvent *)(&eventList);
+    while( heapSize )
+        heap[heapSize--] -> slot = 0;
+    updateNext();
 }
 
 void
 CPUEvent_elapse( word32 cycles )
 {
-    eventList.head -> counter -= cycles;
-    if( eventList.head -> counter < 0 )
-    {
-        eventList.head -> counter = 0;
+    cpu_cycle_count += cycles;
+    if( CPUEvent_due( cpu_cycle_count, cpu_event_next ) )
         CPUEvent_dispatch();
-    }
 }
 
+/* Schedule an event to fire 'when' cycles from now. Scheduling an event
+ * that is already pending moves it.
+ */
+
 void
 CPUEvent_schedule( CPUEvent *thisEvent, word32 when, CPUHandler *proc )
 {
-    CPUEvent *p, *q;
+    if( thisEvent -> slot )
+        removeEvent( thisEvent );
+
+    if( heapSize == CPUEVENT_MAX )
+    {
+        fprintf( stderr, "lib65816: too many CPU events.\n" );
+        exit( 1 );
+    }
 
-    thisEvent -> counter = when;
+    thisEvent -> when = cpu_cycle_count + when;
     thisEvent -> handler = proc;
 
-    p = (CPUEvent *)&eventList;
-    q = p -> next;
+    place( thisEvent, ++heapSize );
+    siftUp( heapSize );
+    updateNext();
+}
 
-    while( ( thisEvent -> counter ) && ( q -> next ) )
+void
+CPUEvent_cancel( CPUEvent *thisEvent )
+{
+    if( thisEvent -> slot )
     {
-        /* Newly scheduled event is before 'q', so insert it in front of
-         * q and compensate q's countdown accordingly.
-         */
-
-        if( thisEvent -> counter < q -> counter )
-        {
-            p -> next = thisEvent;     thisEvent -> next = q;
-            q -> previous = thisEvent; thisEvent -> previous = p;
-
-            q -> counter -= thisEvent -> counter;
-            return;
-        }
-        
-        /* Otherwise, q occurs before thisEvent, so we compensate thisEvent's counter
-         * as we continue to find the ideal insertion point.
-         */
-
-        thisEvent -> counter -= q -> counter;
-        if( thisEvent -> counter < 0 ) thisEvent -> counter = 0;
-        p = q;
-        q = q -> next;
+        removeEvent( thisEvent );
+        updateNext();
     }
-
-    p -> next = thisEvent;     thisEvent -> next = q;
-    q -> previous = thisEvent; thisEvent -> previous = p;
 }
 
 void
 CPUEvent_dispatch( void )
 {
-    CPUEvent *p, *nextEvent, *thisEvent;
+    CPUEvent *thisEvent;
 
-    thisEvent = eventList.head;
-    while( thisEvent -> next )
+    while( heapSize && CPUEvent_due( cpu_cycle_count, heap[1] -> when ) )
     {
-        if( thisEvent -> counter != 0 ) return;
-
         /* We need to dequeue the node FIRST, because the called
          * handler may attempt to reschedule the event.
          */
 
-        p = thisEvent -> previous;     nextEvent = thisEvent -> next;
-        p -> next = nextEvent;          nextEvent -> previous = p;
-
-        thisEvent -> handler( 0 ); thisEvent = nextEvent;
+        thisEvent = heap[1];
+        removeEvent( thisEvent );
+        thisEvent -> handler( thisEvent -> when );
     }
+    updateNext();
 }
 
@@ -13,6 +13,7 @@
 #define CPU_DISPATCH
 
 #include <lib65816/cpu.h>
+#include <lib65816/cpuevent.h>
 #include "cpumicro.h"
 #include <stdio.h>
 
@@ -149,33 +150,47 @@ byte    cpu_cycle_table[1300] =
 };
 #endif
 
+/* The periodic update is just another event so the dispatch loop only
+ * ever has to look at the next event due. Like the old poll it is handed
+ * the current cycle count and the next one is timed from now. A period of
+ * 0 still means an update before every instruction: scheduling 1 cycle
+ * out makes it due again as soon as any instruction has run.
+ */
+
+static CPUEvent update_event;
+
+static void CPU_update(word32 timestamp)
+{
+    E_UPDATE(cpu_cycle_count);
+    CPUEvent_schedule(&update_event, cpu_update_period ? cpu_update_period : 1,
+                      CPU_update);
+}
+
 void CPU_run(void)
 {
-    word32  last_update,next_update;
     int opcode;
 
     cpu_cycle_count = 0;
-    last_update = 0;
-    next_update = cpu_update_period;
+    CPUEvent_schedule(&update_event, cpu_update_period, CPU_update);
     E = 1;
     F_setM(1);
     F_setX(1);
     CPU_modeSwitch();
 
 dispatch:
-    if (cpu_cycle_count >= next_update) goto update;
+    if (CPUEvent_due(cpu_cycle_count, cpu_event_next)) goto update;
 update_resume:
 #ifdef DEBUG
     if (cpu_trace) goto debug;
 debug_resume:
 #endif
     if (cpu_reset) goto reset;
-    if (cpu_stop) goto dispatch;
+    if (cpu_stop) goto idle;
     if (cpu_abort) goto abort;
     if (cpu_nmi) goto nmi;
     if (cpu_irq) goto irq;
 irq_return:
-    if (cpu_wait) { cpu_cycle_count++; goto dispatch; }
+    if (cpu_wait) goto idle;
     opcode = M_READ_OPCODE(PC.A);
     PC.W.PC++;
 
@@ -192,11 +207,16 @@ irq_return:
 /* we take the branch penalty (if there is one).            */
 
 update:
-    E_UPDATE(cpu_cycle_count);
-    last_update = cpu_cycle_count;
-    next_update = last_update + cpu_update_period;
+    CPUEvent_dispatch();
     goto update_resume;
 
+/* Stopped or waiting for an interrupt. Nothing can change until an event
+ * handler runs so skip straight to the next one.
+ */
+idle:
+    cpu_cycle_count = cpu_event_next;
+    goto dispatch;
+
 #ifdef DEBUG
 debug:
     CPU_debug();
@@ -132,8 +132,12 @@ struct Z180OpcodeTable
  */ 
 static void write8 (Z180Context* ctx, ushort addr, byte val)
 {
+	byte* p = ctx->writeMap[addr >> 12];
 	ctx->tstates += 3;
-	ctx->memWrite(ctx->memParam, addr, val);	
+	if (p != NULL)
+		p[addr & 0xFFF] = val;
+	else
+		ctx->memWrite(ctx->memParam, addr, val);
 }
 
 
@@ -146,8 +150,12 @@ static void write16 (Z180Context* ctx, ushort addr, ushort val)
 
 static byte read8 (Z180Context* ctx, ushort addr)
 {
+	byte* p = ctx->readMap[addr >> 12];
 	ctx->tstates += 3;
-	return ctx->memRead(ctx->memParam, addr);	
+	/* Hosts watch opcode fetches for things like RETI */
+	if (p != NULL && !ctx->M1)
+		return p[addr & 0xFFF];
+	return ctx->memRead(ctx->memParam, addr);
 }
 
 
@@ -94,6 +94,14 @@ typedef struct
 	Z180DataIn	memRead;
 	Z180DataOut	memWrite;
 	int		memParam;
+
+	/** Optional host pointers to the start of each 4K page of the
+	 * logical address space. Data reads and writes to a page with a
+	 * pointer go straight to host memory, NULL pages and opcode fetches
+	 * use memRead/memWrite. The host must keep them in step with the MMU.
+	 */
+	byte*		readMap[16];
+	byte*		writeMap[16];
 	
 	Z180DataIn	ioRead;
 	Z180DataOut	ioWrite;
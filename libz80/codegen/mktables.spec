@@ -222,6 +222,7 @@ CPDR
 	{
 		ctx->tstates += 5;
 		ctx->PC -= 2;
+		doBlockCP(ctx, -1);
 	}
 
 CPD
@@ -246,6 +247,7 @@ CPIR
 	{
 		ctx->tstates += 5;
 		ctx->PC -= 2;
+		doBlockCP(ctx, 1);
 	}
 
 CPI
@@ -316,6 +318,7 @@ INDR
 	{
 		ctx->tstates += 5;
 		ctx->PC -= 2;
+		doBlockIN(ctx, -1);
 	}
 
 IND
@@ -336,6 +339,7 @@ INIR
 	{
 		ctx->tstates += 5;
 		ctx->PC -= 2;
+		doBlockIN(ctx, 1);
 	}
 
 INI
@@ -457,6 +461,7 @@ LDIR
 	{
 		ctx->tstates += 5;
 		ctx->PC -= 2;
+		doBlockLD(ctx, 1);
 	}
 
 LDI
@@ -477,6 +482,7 @@ LDDR
 	{
 		ctx->tstates += 5;
 		ctx->PC -= 2;
+		doBlockLD(ctx, -1);
 	}
 
 LDD
@@ -520,6 +526,7 @@ OTIR
 	{
 		ctx->tstates += 5;
 		ctx->PC -= 2;
+		doBlockOUT(ctx, 1);
 	}
 
 OUTD
@@ -541,6 +548,7 @@ OTDR
 	{
 		ctx->tstates += 5;
 		ctx->PC -= 2;
+		doBlockOUT(ctx, -1);
 	}
 
 OUT \(C\),0
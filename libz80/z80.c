@@ -650,6 +650,205 @@ static void doDAA(Z80Context * ctx) {
   adjustFlags(ctx, BR.A);
 }
  
+/* ---------------------------------------------------------
+ *  Block instruction fast path
+ * ---------------------------------------------------------
+ *
+ * A repeating block instruction normally executes one iteration per call
+ * to Z80Execute, fetching ED xx again each time. When the host supplies a
+ * memMap callback we can instead run the iterations that would happen in
+ * the rest of this Z80ExecuteTStates slice in a tight loop.
+ *
+ * Every batched iteration is one that repeats (21 T-states, R += 2) and is
+ * not the last one in the slice. The final iteration is always left to the
+ * normal instruction code so the flags come out exactly as they would have.
+ */
+
+#define BLOCK_TSTATES	21
+
+/* Is it safe to batch anything and if so where is the instruction ? */
+static int blockFastOK(Z80Context* ctx, byte** op)
+{
+	if (ctx->memMap == NULL || ctx->exec_int_vector)
+		return 0;
+	/* An interrupt would be taken before the next iteration */
+	if (ctx->nmi_req || (ctx->int_req && ctx->IFF1))
+		return 0;
+	if (ctx->tstates + BLOCK_TSTATES >= ctx->tstates_limit)
+		return 0;
+	/* We need to see the opcode in case the block overwrites it */
+	op[0] = ctx->memMap(ctx->memParam, ctx->PC, 0);
+	op[1] = ctx->memMap(ctx->memParam, ctx->PC + 1, 0);
+	return op[0] && op[1];
+}
+
+/* How many further iterations finish before the slice ends */
+static unsigned blockBudget(Z80Context* ctx)
+{
+	if (ctx->tstates + BLOCK_TSTATES >= ctx->tstates_limit)
+		return 0;
+	return (ctx->tstates_limit - ctx->tstates - 1) / BLOCK_TSTATES;
+}
+
+/* Charge for n skipped iterations: two M1 fetches each */
+static void blockAccount(Z80Context* ctx, unsigned n)
+{
+	ctx->tstates += n * BLOCK_TSTATES;
+	ctx->R = (ctx->R & 0x80) | ((ctx->R + 2 * n) & 0x7f);
+}
+
+/* Bytes left in the 256 byte page of a pointer going in direction dir */
+static unsigned blockSpan(ushort addr, int dir)
+{
+	if (dir > 0)
+		return 256 - (addr & 0xFF);
+	return (addr & 0xFF) + 1;
+}
+
+static int blockHits(byte* p, unsigned len, int dir, byte* op)
+{
+	byte* lo = dir > 0 ? p : p - len + 1;
+	return (op >= lo && op < lo + len);
+}
+
+/* LDIR / LDDR */
+static void doBlockLD(Z80Context* ctx, int dir)
+{
+	byte* op[2];
+	unsigned n, len, i;
+	byte* src;
+	byte* dst;
+
+	if (!blockFastOK(ctx, op))
+		return;
+	n = blockBudget(ctx);
+	if (n > WR.BC - 1U)
+		n = WR.BC - 1;
+	while (n)
+	{
+		src = ctx->memMap(ctx->memParam, WR.HL, 0);
+		dst = ctx->memMap(ctx->memParam, WR.DE, 1);
+		if (src == NULL || dst == NULL)
+			break;
+		len = n;
+		if (len > blockSpan(WR.HL, dir))
+			len = blockSpan(WR.HL, dir);
+		if (len > blockSpan(WR.DE, dir))
+			len = blockSpan(WR.DE, dir);
+		/* Stop short of rewriting our own opcode */
+		while (len && (blockHits(dst, len, dir, op[0]) ||
+				blockHits(dst, len, dir, op[1])))
+			len--;
+		if (len == 0)
+			break;
+		if (dir > 0)
+		{
+			if (dst + len <= src || src + len <= dst)
+				memcpy(dst, src, len);
+			else
+				for (i = 0; i < len; i++)
+					dst[i] = src[i];
+		}
+		else
+		{
+			for (i = 0; i < len; i++)
+				*dst-- = *src--;
+		}
+		WR.HL += dir * (int)len;
+		WR.DE += dir * (int)len;
+		WR.BC -= len;
+		blockAccount(ctx, len);
+		n -= len;
+	}
+}
+
+/* CPIR / CPDR: batch everything up to the next match */
+static void doBlockCP(Z80Context* ctx, int dir)
+{
+	byte* op[2];
+	unsigned n, len, i;
+	byte* src;
+	byte* hit;
+
+	if (!blockFastOK(ctx, op))
+		return;
+	n = blockBudget(ctx);
+	if (n > WR.BC - 1U)
+		n = WR.BC - 1;
+	while (n)
+	{
+		src = ctx->memMap(ctx->memParam, WR.HL, 0);
+		if (src == NULL)
+			break;
+		len = n;
+		if (len > blockSpan(WR.HL, dir))
+			len = blockSpan(WR.HL, dir);
+		if (dir > 0)
+		{
+			hit = memchr(src, BR.A, len);
+			if (hit)
+				len = hit - src;
+		}
+		else
+		{
+			for (i = 0; i < len; i++)
+				if (src[-(int)i] == BR.A)
+					break;
+			hit = (i < len) ? src : NULL;
+			len = i;
+		}
+		WR.HL += dir * (int)len;
+		WR.BC -= len;
+		blockAccount(ctx, len);
+		n -= len;
+		/* The matching iteration is done by CPI/CPD proper */
+		if (hit)
+			break;
+	}
+}
+
+/* INIR / INDR. The port may have side effects so we go a byte at a time and
+   recheck for interrupts and mapping changes after each one */
+static void doBlockIN(Z80Context* ctx, int dir)
+{
+	byte* op[2];
+	byte* dst;
+
+	while (BR.B > 1 && blockFastOK(ctx, op))
+	{
+		dst = ctx->memMap(ctx->memParam, WR.HL, 1);
+		if (dst == NULL || dst == op[0] || dst == op[1])
+			break;
+		ctx->R = (ctx->R & 0x80) | ((ctx->R + 2) & 0x7f);
+		ctx->tstates += 13;
+		*dst = ctx->ioRead(ctx->ioParam, WR.BC);
+		ctx->tstates += 8;
+		WR.HL += dir;
+		BR.B--;
+	}
+}
+
+/* OTIR / OTDR */
+static void doBlockOUT(Z80Context* ctx, int dir)
+{
+	byte* op[2];
+	byte* src;
+
+	while (BR.B > 1 && blockFastOK(ctx, op))
+	{
+		src = ctx->memMap(ctx->memParam, WR.HL, 0);
+		if (src == NULL)
+			break;
+		ctx->R = (ctx->R & 0x80) | ((ctx->R + 2) & 0x7f);
+		ctx->tstates += 16;
+		BR.B--;
+		ctx->ioWrite(ctx->ioParam, WR.BC, *src);
+		ctx->tstates += 5;
+		WR.HL += dir;
+	}
+}
+
+
 #include "codegen/opcodes_impl.c"
 
 
@@ -778,11 +977,39 @@ void Z80Execute (Z80Context* ctx)
 }
 
 
+/* A halted CPU that cannot take an interrupt just refetches the HALT every
+   4 T-states until the end of the slice, so account for that in one go. Only
+   done when memMap says the fetch has no side effects */
+static int haltIdle(Z80Context* ctx)
+{
+	if (ctx->memMap == NULL || ctx->exec_int_vector)
+		return 0;
+	if (ctx->nmi_req || (ctx->int_req && ctx->IFF1))
+		return 0;
+	return ctx->memMap(ctx->memParam, ctx->PC, 0) != NULL;
+}
+
+
 unsigned Z80ExecuteTStates(Z80Context* ctx, unsigned tstates)
 {
+	unsigned n;
+
 	ctx->tstates = 0;
+	ctx->tstates_limit = tstates;
 	while (ctx->tstates < tstates)
+	{
+		if (ctx->halted && haltIdle(ctx))
+		{
+			n = (tstates - ctx->tstates + 3) / 4;
+			ctx->M1PC = ctx->PC;
+			ctx->defer_int = 0;
+			ctx->tstates += 4 * n;
+			ctx->R = (ctx->R & 0x80) | ((ctx->R + n) & 0x7f);
+			break;
+		}
 		Z80Execute(ctx);
+	}
+	ctx->tstates_limit = 0;
 	return ctx->tstates;
 }
 
@@ -40,6 +40,15 @@ typedef byte (*Z80DataIn) 	(int param, ushort address);
 typedef void (*Z80DataOut)	(int param, ushort address, byte data);
 
 
+/** Function type to map an address directly onto host memory.
+ * Returns a pointer to the byte at address if it may be read (or written
+ * if write is set) directly with no side effects, or NULL if the access must
+ * go through the data callbacks. The pointer must remain valid up to the end
+ * of the 256 byte page containing address.
+ */
+typedef byte *(*Z80MemMap)	(int param, ushort address, int write);
+
+
 /** 
  * A Z80 register set.
  * An union is used since we want independent access to the high and low bytes of the 16-bit registers.
@@ -98,6 +107,13 @@ typedef struct
 	Z80DataIn	ioRead;
 	Z80DataOut	ioWrite;
 	int			ioParam;
+
+	/** Optional direct memory map. If set then repeating block
+	 * instructions run inside Z80ExecuteTStates may complete several
+	 * iterations at once over directly mapped memory, and a halted CPU
+	 * that cannot take an interrupt skips to the end of the slice. The
+	 * trace hook is only called for the work that is not batched. */
+	Z80MemMap	memMap;
 	
 	byte		halted;
 	unsigned	tstates;
@@ -136,6 +152,11 @@ typedef struct
 
 	byte exec_int_vector;
 
+	/* The T-state target of the current Z80ExecuteTStates call, 0 if
+	 * not inside one. Block instructions use this to know how many
+	 * iterations they may batch. */
+	unsigned tstates_limit;
+
 	void (*trace)(unsigned int memparam);
 
 } Z80Context;
@@ -146,7 +167,8 @@ void Z80Execute (Z80Context* ctx);
 
 /** Execute enough instructions to use at least tstates cycles.
  * Returns the number of tstates actually executed.  Note: Resets
- * ctx->tstates.*/
+ * ctx->tstates. If a memMap is set this may batch block instructions and
+ * idle HALT cycles, giving the same results as executing them singly.*/
 unsigned Z80ExecuteTStates(Z80Context* ctx, unsigned tstates);
 
 /** Decode the next instruction to be executed.
@@ -1,14 +1,22 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include "ide.h"
 
 int main(int argc, const char *argv[])
 {
-  int t, fd;
+  int t, fd, r;
+  int sparse = 0;
+  if (argc == 4 && strcmp(argv[1], "-s") == 0) {
+    sparse = 1;
+    argv[1] = argv[0];
+    argv++;
+    argc--;
+  }
   if (argc != 3) {
-    fprintf(stderr, "%s [type] [path]\n", argv[0]);
+    fprintf(stderr, "%s [-s] [type] [path]\n", argv[0]);
     exit(1);
   }
   t = atoi(argv[1]);
@@ -21,7 +29,11 @@ int main(int argc, const char *argv[])
     perror(argv[2]);
     exit(1);
   }
-  if (ide_make_drive(t, fd) < 0) {
+  if (sparse)
+    r = ide_make_sparse(t, fd);
+  else
+    r = ide_make_drive(t, fd);
+  if (r < 0) {
     perror(argv[2]);
     exit(1);
   }
@@ -50,6 +50,7 @@
 #include "wd17xx.h"
 #include "ide.h"
 #include "58174.h"
+#include "rasterclock.h"
 
 #define CWIDTH 8
 #define CHEIGHT 16
@@ -87,6 +88,7 @@ static struct ide_controller *ide;
 static struct mm58174 *rtc;
 
 static uint8_t fast;
+static struct rasterclock *rclock;
 volatile int emulator_done;
 
 static uint8_t mem_be;
@@ -614,9 +616,19 @@ static void usage(void)
 	exit(EXIT_FAILURE);
 }
 
+/* exec6502 carries any overrun into the next call itself */
+static unsigned utan_execute(void *unused, unsigned clocks)
+{
+	exec6502(clocks);
+	if (tanex) {
+		via_tick(via1, clocks);
+		via_tick(via2, clocks);
+	}
+	return clocks;
+}
+
 int main(int argc, char *argv[])
 {
-	static struct timespec tc;
 	static int tstates = 750;	/* 750KHz */
 	int opt;
 	char *rom_path = "microtan.rom";
@@ -791,10 +803,11 @@ int main(int argc, char *argv[])
 		SDL_RenderSetLogicalSize(render, 32 * CWIDTH,  16 * CHEIGHT);
 	}
 
-	/* 10ms - it's a balance between nice behaviour and simulation
-	   smoothness */
-	tc.tv_sec = 0;
-	tc.tv_nsec = 10000000L;
+	/* 10ms frames of 10 slices - it's a balance between nice behaviour
+	   and simulation smoothness */
+	rclock = rasterclock_create(tstates * 1000UL, tstates, 10);
+	rasterclock_fast(rclock, fast);
+	rasterclock_cpu(rclock, utan_execute, NULL);
 
 	if (tcgetattr(0, &term) == 0) {
 		saved_term = term;
@@ -821,20 +834,8 @@ int main(int argc, char *argv[])
 	/* Has to be done after CPU init so we can set the registers */
 	if (m65_path)
 		load_m65(m65_path);
-	/* This is the wrong way to do it but it's easier for the moment. We
-	   should track how much real time has occurred and try to keep cycle
-	   matched with that. The scheme here works fine except when the host
-	   is loaded though */
-
 	while (!emulator_done) {
-		int i;
-		for (i = 0; i < 10; i++) {
-			exec6502(tstates);
-			if (tanex) {
-				via_tick(via1, tstates);
-				via_tick(via2, tstates);
-			}
-		}
+		rasterclock_run_frame(rclock);
 		if (machine == MACH_MICROTAN) {
 			/* We want to run UI events before we rasterize */
 			if (ui_event())
@@ -847,9 +848,7 @@ int main(int argc, char *argv[])
 			m6551_timer(uart);
 		if (tandos)
 			wd17xx_tick(fdc, 10);
-		/* Do 10ms of I/O and delays */
-		if (!fast)
-			nanosleep(&tc, NULL);
+		rasterclock_sync(rclock);
 	}
 	exit(0);
 }
@@ -28,12 +28,19 @@
 #define MINIRV32_IO_OFFSET		0x60000000U
 #define MINIRV32_IO_SIZE		0x40000000U
 
-#define MINIRV32_LOAD4(addr)		mem_read_32(addr, &trap, &rval)
-#define MINIRV32_LOAD2(addr)		mem_read_16(addr, &trap, &rval)
-#define MINIRV32_LOAD1(addr)		mem_read_8(addr, &trap, &rval)
-#define MINIRV32_STORE4(addr, val)	mem_write_32(addr, val, &trap, &rval)
-#define MINIRV32_STORE2(addr, val)	mem_write_16(addr, val, &trap, &rval)
-#define MINIRV32_STORE1(addr, val)	mem_write_8(addr, val, &trap, &rval)
+/* Nearly every access is to RAM so that is done in line, calling out
+   only for the aliases and for faults */
+#define RAM_BASE			0x3FC80000U
+#define IRAM_BASE			0x40380000U
+#define RAM_HIT(addr, len)		((uint32_t)((addr) - RAM_BASE) <= sizeof(ram) - (len))
+#define RAM_PTR(addr)			(ram + ((addr) - RAM_BASE))
+
+#define MINIRV32_LOAD4(addr)		(RAM_HIT(addr, 4) ? ram_read_32(RAM_PTR(addr)) : mem_read_32(addr, &trap, &rval))
+#define MINIRV32_LOAD2(addr)		(RAM_HIT(addr, 2) ? ram_read_16(RAM_PTR(addr)) : mem_read_16(addr, &trap, &rval))
+#define MINIRV32_LOAD1(addr)		(RAM_HIT(addr, 1) ? *RAM_PTR(addr) : mem_read_8(addr, &trap, &rval))
+#define MINIRV32_STORE4(addr, val)	(RAM_HIT(addr, 4) ? ram_write_32(RAM_PTR(addr), val) : mem_write_32(addr, val, &trap, &rval))
+#define MINIRV32_STORE2(addr, val)	(RAM_HIT(addr, 2) ? ram_write_16(RAM_PTR(addr), val) : mem_write_16(addr, val, &trap, &rval))
+#define MINIRV32_STORE1(addr, val)	(RAM_HIT(addr, 1) ? ram_write_8(RAM_PTR(addr), val) : mem_write_8(addr, val, &trap, &rval))
 
 /* FIXME */
 #define ALIGN	1
@@ -54,6 +61,14 @@ static volatile int done;
 
 static int trace = 0;
 
+/* Run in 5ms slices, each made of calls into the core of 200us worth
+   of instructions at the nominal clock (one instruction per clock) */
+#define SLICE_US	5000
+#define QUANTUM_US	200
+
+static unsigned int mhz = 20;
+static unsigned int fast;
+
 static uint32_t rv32_glue(uint32_t pc, uint32_t ir, uint32_t retval);
 static uint32_t io_out(uint32_t addr, uint32_t val);
 static uint32_t io_in(uint32_t addr);
@@ -66,6 +81,38 @@ static uint32_t mem_write_32(uint32_t addr, uint32_t val, uint32_t *trap, uint32
 static uint32_t mem_write_16(uint32_t addr, uint32_t val, uint32_t *trap, uint32_t *rval);
 static uint32_t mem_write_8(uint32_t addr, uint32_t val, uint32_t *trap, uint32_t *rval);
 
+static inline uint32_t ram_read_16(const uint8_t *p)
+{
+	return *p | (p[1] << 8);
+}
+
+static inline uint32_t ram_read_32(const uint8_t *p)
+{
+	return *p | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t ram_write_8(uint8_t *p, uint32_t val)
+{
+	*p = val;
+	return 0;
+}
+
+static inline uint32_t ram_write_16(uint8_t *p, uint32_t val)
+{
+	*p = val;
+	p[1] = val >> 8;
+	return 0;
+}
+
+static inline uint32_t ram_write_32(uint8_t *p, uint32_t val)
+{
+	*p = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+	return 0;
+}
+
 #define MINIRV32WARN	printf
 #define MINIRV32_DECORATE	static
 #define MINIRV32_IMPLEMENTATION
@@ -78,7 +125,11 @@ static uint32_t mem_write_8(uint32_t addr, uint32_t val, uint32_t *trap, uint32_
 #define MINIRV32_OTHERCSR_WRITE(csr, value) \
                                 csr_out(csr, value)
 
-static void disassemble(uint32_t ir, uint32_t addr);
+static void rv_disassemble(uint32_t ir, uint32_t addr);
+
+/* Called for every instruction so keep the check out here */
+#define disassemble(ir, addr) \
+                                do { if (trace & TRACE_CPU) rv_disassemble(ir, addr); } while (0)
 
 #include "riscv/mini-rv32ima.h"
 
@@ -218,18 +269,18 @@ uint32_t rv32_glue(uint32_t pc, uint32_t ir, uint32_t trap)
 	return trap;
 }
 
-/* FIXME: wrong for reads overlapping end */
-static uint8_t *mem_addr(uint32_t addr, uint32_t *trap, uint32_t *rval, unsigned is_write)
+/* The slow path: the instruction RAM alias and anything that faults */
+static uint8_t *mem_addr(uint32_t addr, unsigned len, uint32_t *trap, uint32_t *rval, unsigned is_write)
 {
-	if (addr >= 0x3FC80000 && addr <= 0x3FCE0000)
-		return ram + (addr & 0x3FFFF);
-	if (addr >= 0x4038000 && addr <= 0x403E0000 && !is_write) {
+	if (RAM_HIT(addr, len))
+		return RAM_PTR(addr);
+	if (addr - IRAM_BASE <= sizeof(ram) - len && !is_write) {
 		if (addr & 3) {
 			*trap = ALIGN;
 			*rval = addr;
 			return NULL;
 		}
-		return ram + (addr & 0x3FFFF);
+		return ram + (addr - IRAM_BASE);
 	}
 	/* TODO 50000000-50001FFF */
 	*trap = INVALID;
@@ -239,7 +290,7 @@ static uint8_t *mem_addr(uint32_t addr, uint32_t *trap, uint32_t *rval, unsigned
 
 static uint32_t mem_read_8(uint32_t addr, uint32_t *trap, uint32_t *rval)
 {
-	uint8_t *p = mem_addr(addr, trap, rval, 0);
+	uint8_t *p = mem_addr(addr, 1, trap, rval, 0);
 	if (p)
 		return *p;
 	else
@@ -248,7 +299,7 @@ static uint32_t mem_read_8(uint32_t addr, uint32_t *trap, uint32_t *rval)
 
 static uint32_t mem_read_16(uint32_t addr, uint32_t *trap, uint32_t *rval)
 {
-	uint8_t *p = mem_addr(addr, trap, rval, 0);
+	uint8_t *p = mem_addr(addr, 2, trap, rval, 0);
 	if (p == NULL)
 		return 0;
 	return *p + (p[1] << 8);
@@ -256,7 +307,7 @@ static uint32_t mem_read_16(uint32_t addr, uint32_t *trap, uint32_t *rval)
 
 static uint32_t mem_read_32(uint32_t addr, uint32_t *trap, uint32_t *rval)
 {
-	uint8_t *p = mem_addr(addr, trap, rval, 0);
+	uint8_t *p = mem_addr(addr, 4, trap, rval, 0);
 	if (p == NULL)
 		return 0;
 	return *p + (p[1] << 8) + (p[2] << 16) + (p[3] << 24);
@@ -264,7 +315,7 @@ static uint32_t mem_read_32(uint32_t addr, uint32_t *trap, uint32_t *rval)
 
 static uint32_t mem_write_8(uint32_t addr, uint32_t val, uint32_t *trap, uint32_t *rval)
 {
-	uint8_t *p = mem_addr(addr, trap, rval, 1);
+	uint8_t *p = mem_addr(addr, 1, trap, rval, 1);
 	if (p == NULL)
 		return 0;
 	*p = val;
@@ -273,7 +324,7 @@ static uint32_t mem_write_8(uint32_t addr, uint32_t val, uint32_t *trap, uint32_
 
 static unsigned mem_write_16(uint32_t addr, uint32_t val, uint32_t *trap, uint32_t *rval)
 {
-	uint8_t *p = mem_addr(addr, trap, rval, 1);
+	uint8_t *p = mem_addr(addr, 2, trap, rval, 1);
 	if (p == NULL)
 		return 0;
 	*p = val;
@@ -283,7 +334,7 @@ static unsigned mem_write_16(uint32_t addr, uint32_t val, uint32_t *trap, uint32
 
 static unsigned mem_write_32(uint32_t addr, uint32_t val, uint32_t *trap, uint32_t *rval)
 {
-	uint8_t *p = mem_addr(addr, trap, rval, 1);
+	uint8_t *p = mem_addr(addr, 4, trap, rval, 1);
 	if (p == NULL)
 		return 0;
 	*p = val;
@@ -293,11 +344,9 @@ static unsigned mem_write_32(uint32_t addr, uint32_t val, uint32_t *trap, uint32
 	return 0;
 }
 
-static void disassemble(uint32_t ir, uint32_t addr)
+static void rv_disassemble(uint32_t ir, uint32_t addr)
 {
 	char buf[256];
-	if (!(trace & TRACE_CPU))
-		return;
 	fprintf(stderr, "%08X: ", addr);
 	disasm_inst(buf, sizeof(buf), rv32, addr, ir);
 	fprintf(stderr, "%s\n", buf);
@@ -318,21 +367,37 @@ static void exit_cleanup(void)
 
 static void usage(void)
 {
-	fprintf(stderr, "mini-riscv: [-r rom] [-S disk] [-d debug]\n");
+	fprintf(stderr, "mini-riscv: [-f] [-m mhz] [-r rom] [-S disk] [-d debug]\n");
 	exit(EXIT_FAILURE);
 }
 
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
 int main(int argc, char *argv[])
 {
 	static struct timespec tc;
+	uint64_t next, now;
 	int opt;
 	int fd;
 	char *rompath = "mini-riscv.rom";
 	char *sdpath = NULL;
 //	unsigned int cycles = 0;
 
-	while ((opt = getopt(argc, argv, "r:d:S:")) != -1) {
+	while ((opt = getopt(argc, argv, "fm:r:d:S:")) != -1) {
 		switch (opt) {
+		case 'f':
+			fast = 1;
+			break;
+		case 'm':
+			mhz = atoi(optarg);
+			if (mhz == 0 || mhz > 1000)
+				usage();
+			break;
 		case 'r':
 			rompath = optarg;
 			break;
@@ -373,11 +438,6 @@ int main(int argc, char *argv[])
 		sd_blockmode(sdcard);
 	}
 
-	/* 5ms - it's a balance between nice behaviour and simulation
-	   smoothness */
-	tc.tv_sec = 0;
-	tc.tv_nsec = 5000000L;
-
 	if (tcgetattr(0, &term) == 0) {
 		saved_term = term;
 		atexit(exit_cleanup);
@@ -397,36 +457,42 @@ int main(int argc, char *argv[])
 	cpu.regs[10] = 0x00;
 	cpu.extraflags |= 3;
 
-	/* This is the wrong way to do it but it's easier for the moment. We
-	   should track how much real time has occurred and try to keep cycle
-	   matched with that. The scheme here works fine except when the host
-	   is loaded though */
-
+	/* Keep the emulated clock in step with real time, sleeping off
+	   whatever is left of each slice. The core timer is advanced by
+	   emulated time so it stays consistent with the instruction count.
+	   If the host falls well behind give up on catching up */
+	next = now_us();
 	while (!done) {
-//		unsigned int i;
 		unsigned int j;
-		uint32_t elapsed = 0;
-
-		for (j = 0; j < 100; j++) {
-                        uint32_t ret = MiniRV32IMAStep(&cpu, ram, 0, elapsed, 1024);
-                        switch(ret) {
-                        case 0:
-                        case 1:
-                        case 3:
-                            break;
-                        case 0x7777:
-                        case 0x5555:
-                            done = 1;
-                            break;
-                        default:
-                            fprintf(stderr, "invalid rv32 ret %x\n",
-                                ret);
-                            done = 1;
-                            break;
-                        }
+
+		for (j = 0; j < SLICE_US / QUANTUM_US && !done; j++) {
+			uint32_t ret = MiniRV32IMAStep(&cpu, ram, 0, QUANTUM_US, mhz * QUANTUM_US);
+			switch(ret) {
+			case 0:
+			case 1:		/* Waiting for an interrupt */
+			case 3:
+				break;
+			case 0x7777:
+			case 0x5555:
+				done = 1;
+				break;
+			default:
+				fprintf(stderr, "invalid rv32 ret %x\n",
+					ret);
+				done = 1;
+				break;
+			}
 		}
-		/* Do 5ms of I/O and delays */
-		nanosleep(&tc, NULL);
+		if (fast)
+			continue;
+		next += SLICE_US;
+		now = now_us();
+		if (next > now) {
+			tc.tv_sec = 0;
+			tc.tv_nsec = (next - now) * 1000;
+			nanosleep(&tc, NULL);
+		} else if (now - next > 100000)
+			next = now;
 		/* poll_irq_event(); */
 	}
 	exit(0);
@@ -723,7 +723,7 @@ int main(int argc, char *argv[])
 			for (j = 0; j < 10; j++) {
 				while (states < tstate_steps) {
 					unsigned int used;
-					used = z180_dma(io);
+					used = z180_dma(io, tstate_steps - states);
 					if (used == 0)
 						used = Z180Execute(&cpu_z180);
 					ps2_event(ps2, used);
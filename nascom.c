@@ -39,6 +39,7 @@
 
 #include "event.h"
 #include "keymatrix.h"
+#include "rasterclock.h"
 
 #include "nasfont.h"
 
@@ -92,6 +93,7 @@ static uint8_t map_gm802 = 0x11;
 
 static Z80Context cpu_z80;
 static uint8_t fast;
+static struct rasterclock *rclock;
 volatile int emulator_done;
 
 #define TRACE_MEM	0x000001
@@ -981,9 +983,13 @@ static void usage(void)
 	exit(EXIT_FAILURE);
 }
 
+static unsigned nascom_execute(void *unused, unsigned tstates)
+{
+	return Z80ExecuteTStates(&cpu_z80, tstates);
+}
+
 int main(int argc, char *argv[])
 {
-	static struct timespec tc;
 	static int tstates = 200;	/* 2MHz */
 	int opt;
 	char *rom_path = "nassys3.nal";
@@ -1235,11 +1241,11 @@ int main(int argc, char *argv[])
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
 	SDL_RenderSetLogicalSize(render, 48 * CWIDTH,  16 * CHEIGHT);
 
-	/* 10ms - it's a balance between nice behaviour and simulation
-	   smoothness */
-
-	tc.tv_sec = 0;
-	tc.tv_nsec = 10000000L;
+	/* 10ms frames of 100 slices - it's a balance between nice behaviour
+	   and simulation smoothness */
+	rclock = rasterclock_create(tstates * 10000UL, tstates, 100);
+	rasterclock_fast(rclock, fast);
+	rasterclock_cpu(rclock, nascom_execute, NULL);
 
 	if (tcgetattr(0, &term) == 0) {
 		saved_term = term;
@@ -1267,17 +1273,9 @@ int main(int argc, char *argv[])
 	if (cpmmap)
 		cpu_z80.PC = 0xF000;
 
-	/* This is the wrong way to do it but it's easier for the moment. We
-	   should track how much real time has occurred and try to keep cycle
-	   matched with that. The scheme here works fine except when the host
-	   is loaded though */
-
 	while (!emulator_done) {
-		int i;
-		/* Each cycle we do 20000 or 40000 T states */
-		for (i = 0; i < 100; i++) {
-			Z80ExecuteTStates(&cpu_z80, tstates);
-		}
+		/* Each frame we do 20000 or 40000 T states */
+		rasterclock_run_frame(rclock);
 
 		/* We want to run UI events before we rasterize */
 		if (ui_event())
@@ -1295,9 +1293,7 @@ int main(int argc, char *argv[])
 			if (mm58174_irqpending(rtc))
 				Z80NMI(&cpu_z80);
 		}
-		/* Do 10ms of I/O and delays */
-		if (!fast)
-			nanosleep(&tc, NULL);
+		rasterclock_sync(rclock);
 		if (fdc)
 			wd17xx_tick(fdc, 10);
 	}
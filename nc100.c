@@ -33,14 +33,15 @@
 #include <SDL2/SDL.h>
 
 #include "event.h"
+#include "present_sdl2.h"
 #include "keymatrix.h"
+#include "rasterclock.h"
 
 #include "libz80/z80.h"
 #include "z80dis.h"
 
 static SDL_Window *window;
-static SDL_Renderer *render;
-static SDL_Texture *texture;
+static struct present *present;
 static uint32_t texturebits[480 * 64];
 
 struct keymatrix *matrix;
@@ -76,6 +77,7 @@ static uint8_t sound[4];
 static uint8_t cardstat = CSTAT_PRESENT | CSTAT_5V;
 
 static uint8_t fast;
+static struct rasterclock *rclock;
 volatile int emulator_done;
 
 #define TRACE_MEM	0x000001
@@ -586,10 +588,7 @@ static void nc100_render(void)
 	rect.w = 480;
 	rect.h = 64;
 
-	SDL_UpdateTexture(texture, NULL, texturebits, 480 * 4);
-	SDL_RenderClear(render);
-	SDL_RenderCopy(render, texture, NULL, &rect);
-	SDL_RenderPresent(render);
+	present_frame(present, texturebits, 480 * 4, &rect, 0xFF000000);
 }
 
 static struct termios saved_term, term;
@@ -611,9 +610,13 @@ static void usage(void)
 	exit(EXIT_FAILURE);
 }
 
+static unsigned nc100_execute(void *unused, unsigned tstates)
+{
+	return Z80ExecuteTStates(&cpu_z80, tstates);
+}
+
 int main(int argc, char *argv[])
 {
-	static struct timespec tc;
 	int opt;
 	int fd;
 	char *rom_path = "nc100.rom";
@@ -703,31 +706,14 @@ int main(int argc, char *argv[])
 			SDL_GetError());
 		exit(1);
 	}
-	render = SDL_CreateRenderer(window, -1, 0);
-	if (render == NULL) {
-		fprintf(stderr, "nc100: unable to create renderer: %s\n",
-			SDL_GetError());
-		exit(1);
-	}
-	texture = SDL_CreateTexture(render, SDL_PIXELFORMAT_ARGB8888,
-		SDL_TEXTUREACCESS_STREAMING,
-		480, 64);
-	if (texture == NULL) {
-		fprintf(stderr, "nc100: unable to create texture: %s\n",
-			SDL_GetError());
-		exit(1);
-	}
-	SDL_SetRenderDrawColor(render, 0, 0, 0, 255);
-	SDL_RenderClear(render);
-	SDL_RenderPresent(render);
+	present = present_create("nc100", window, 0, 480, 64, 480, 64);
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-	SDL_RenderSetLogicalSize(render, 480, 64);
 
-	/* 10ms - it's a balance between nice behaviour and simulation
-	   smoothness */
-
-	tc.tv_sec = 0;
-	tc.tv_nsec = 10000000L;
+	/* 10ms frames of 100 slices - it's a balance between nice behaviour
+	   and simulation smoothness. The LCD has no beam to race */
+	rclock = rasterclock_create(6000000, 600, 100);
+	rasterclock_fast(rclock, fast);
+	rasterclock_cpu(rclock, nc100_execute, NULL);
 
 	if (tcgetattr(0, &term) == 0) {
 		saved_term = term;
@@ -751,16 +737,8 @@ int main(int argc, char *argv[])
 	cpu_z80.memWrite = mem_write;
 	cpu_z80.trace = nc100_trace;
 
-	/* This is the wrong way to do it but it's easier for the moment. We
-	   should track how much real time has occurred and try to keep cycle
-	   matched with that. The scheme here works fine except when the host
-	   is loaded though */
-
 	while (!emulator_done) {
-		int i;
-		for (i = 0; i < 100; i++) {
-			Z80ExecuteTStates(&cpu_z80, 600);
-		}
+		rasterclock_run_frame(rclock);
 
 		/* We want to run UI events before we rasterize */
 		if (ui_event())
@@ -772,9 +750,7 @@ int main(int argc, char *argv[])
 		if ((~irqstat & irqmask) & 0x0F) {
 			Z80INT(&cpu_z80, 0xFF);
 		}
-		/* Do 5ms of I/O and delays */
-		if (!fast)
-			nanosleep(&tc, NULL);
+		rasterclock_sync(rclock);
 	}
 	fd = open("nc100.ram", O_RDWR|O_CREAT, 0600);
 	if (fd != -1) {
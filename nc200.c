@@ -59,6 +59,7 @@
 #include <SDL2/SDL.h>
 
 #include "event.h"
+#include "present_sdl2.h"
 #include "keymatrix.h"
 
 #include "libz80/z80.h"
@@ -66,8 +67,7 @@
 #include "z80dis.h"
 
 static SDL_Window *window;
-static SDL_Renderer *render;
-static SDL_Texture *texture;
+static struct present *present;
 static uint32_t texturebits[480 * 128];
 
 static FDC_PTR fdc;
@@ -621,10 +621,7 @@ static void nc200_render(void)
 	rect.w = 480;
 	rect.h = 128;
 
-	SDL_UpdateTexture(texture, NULL, texturebits, 480 * 4);
-	SDL_RenderClear(render);
-	SDL_RenderCopy(render, texture, NULL, &rect);
-	SDL_RenderPresent(render);
+	present_frame(present, texturebits, 480 * 4, &rect, 0xFF000000);
 }
 
 static void swap_disk(int n)
@@ -779,25 +776,8 @@ int main(int argc, char *argv[])
 			SDL_GetError());
 		exit(1);
 	}
-	render = SDL_CreateRenderer(window, -1, 0);
-	if (render == NULL) {
-		fprintf(stderr, "nc200: unable to create renderer: %s\n",
-			SDL_GetError());
-		exit(1);
-	}
-	texture = SDL_CreateTexture(render, SDL_PIXELFORMAT_ARGB8888,
-		SDL_TEXTUREACCESS_STREAMING,
-		480, 128);
-	if (texture == NULL) {
-		fprintf(stderr, "nc200: unable to create texture: %s\n",
-			SDL_GetError());
-		exit(1);
-	}
-	SDL_SetRenderDrawColor(render, 0, 0, 0, 255);
-	SDL_RenderClear(render);
-	SDL_RenderPresent(render);
+	present = present_create("nc200", window, 0, 480, 128, 480, 128);
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-	SDL_RenderSetLogicalSize(render, 480, 128);
 
 	/* 10ms - it's a balance between nice behaviour and simulation
 	   smoothness */
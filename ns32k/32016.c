@@ -96,27 +96,109 @@ const uint32_t OpSizeLookup[6] = {
 
 /*
  *	Simple memory interface
+ *
+ *	The platform may hand us a block of plain memory from address 0
+ *	(ns32016_set_ram). Accesses that fall wholly within it are done
+ *	directly with a single host load or store instead of a callback
+ *	per byte. Anything else, including any access that would wrap or
+ *	reach the I/O space, goes through ns32016_read8/write8 as before.
  */
- 
+
+static uint8_t *ram;
+static uint32_t ram_size;
+static uint32_t ram_wlow;
+
+/*
+ *	Instruction stream fetches outside the window are served from a
+ *	prefetch queue, as on the real part, so the opcode, displacements
+ *	and immediates of an instruction cost one refill of the queue
+ *	rather than four callbacks each. The queue is refilled whenever a
+ *	fetch runs off its end and dropped by any write that lands in it.
+ *	A refill reads ahead of the guest so it is only used below the I/O
+ *	space the platform gives with ns32016_set_io, and not at all when
+ *	there is no window, which is how a platform asks for exact cycles
+ *	on its bus (memory tracing).
+ */
+
+#define PFQ_SIZE	16
+
+static uint8_t pfq[PFQ_SIZE];
+static uint32_t pfq_addr;
+static uint8_t pfq_valid;
+static uint32_t io_base;
+
+void ns32016_set_ram(uint8_t *base, uint32_t size, uint32_t wlow)
+{
+	ram = base;
+	ram_size = base ? size : 0;
+	ram_wlow = wlow;
+	pfq_valid = 0;
+}
+
+void ns32016_set_io(uint32_t base)
+{
+	io_base = base;
+	pfq_valid = 0;
+}
+
+#define RAM_OK(addr, len)	((addr) < ram_size && ram_size - (addr) >= (len))
+#define RAM_WOK(addr, len)	(RAM_OK(addr, len) && (addr) >= ram_wlow)
+#define PFQ_HIT(addr, len)	(pfq_valid && (addr) - pfq_addr <= PFQ_SIZE - (len))
+#define PFQ_OK(addr)		(ram_size && ((addr) & MEM_MASK) + PFQ_SIZE <= io_base)
+
 static uint8_t read_x8(uint32_t addr)
 {
+	if (addr < ram_size)
+		return ram[addr];
 	return ns32016_read8(addr);
 }
 
 static uint16_t read_x16(uint32_t addr)
 {
-	uint16_t r = ns32016_read8(addr);
+	uint16_t r;
+	if (RAM_OK(addr, 2)) {
+		uint8_t *p = ram + addr;
+		return p[0] | (p[1] << 8);
+	}
+	r = ns32016_read8(addr);
 	r |= ns32016_read8(addr + 1) << 8;
 	return r;
 }
 
 static uint32_t read_x32(uint32_t addr)
 {
-	uint32_t r = read_x16(addr);
+	uint32_t r;
+	if (RAM_OK(addr, 4)) {
+		uint8_t *p = ram + addr;
+		return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+	r = read_x16(addr);
 	r |= read_x16(addr + 2) << 16;
 	return r;
 }
 
+/* Fetch from the instruction stream */
+static uint32_t fetch_x32(uint32_t addr)
+{
+	uint8_t *p;
+	unsigned int i;
+
+	if (RAM_OK(addr, 4))
+		p = ram + addr;
+	else if (addr < ram_size || !PFQ_OK(addr))
+		return read_x32(addr);	/* Off the end of the window, or I/O */
+	else {
+		if (!PFQ_HIT(addr, 4)) {
+			for (i = 0; i < PFQ_SIZE; i++)
+				pfq[i] = ns32016_read8(addr + i);
+			pfq_addr = addr;
+			pfq_valid = 1;
+		}
+		p = pfq + (addr - pfq_addr);
+	}
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
 static uint64_t read_x64(uint32_t addr)
 {
 	uint64_t r = read_x32(addr);
@@ -142,17 +224,37 @@ static uint32_t read_n(uint32_t addr, uint32_t size)
 
 static void write_x8(uint32_t addr, uint8_t val)
 {
-	ns32016_write8(addr, val);
+	if (RAM_WOK(addr, 1))
+		ram[addr] = val;
+	else {
+		if (PFQ_HIT(addr, 1))
+			pfq_valid = 0;
+		ns32016_write8(addr, val);
+	}
 }
 
 static void write_x16(uint32_t addr, uint16_t val)
 {
+	if (RAM_WOK(addr, 2)) {
+		uint8_t *p = ram + addr;
+		p[0] = val;
+		p[1] = val >> 8;
+		return;
+	}
 	write_x8(addr, val);
 	write_x8(addr + 1, val >> 8);
 }
 
 static void write_x32(uint32_t addr, uint32_t val)
 {
+	if (RAM_WOK(addr, 4)) {
+		uint8_t *p = ram + addr;
+		p[0] = val;
+		p[1] = val >> 8;
+		p[2] = val >> 16;
+		p[3] = val >> 24;
+		return;
+	}
 	write_x16(addr, val);
 	write_x16(addr + 2, val >> 16);
 }
@@ -241,6 +343,7 @@ void ns32016_reset_addr(uint32_t StartAddress)
 
 	pc = StartAddress;
 	psr = 0;
+	pfq_valid = 0;
 
 	FSR = 0;
 
@@ -310,7 +413,7 @@ int32_t GetDisplacement(uint32_t * pPC)
 	int32_t Value;
 
 	MultiReg Disp;
-	Disp.u32 = SWAP32(read_x32(*pPC));
+	Disp.u32 = SWAP32(fetch_x32(*pPC));
 
 	switch (Disp.u32 >> 29)
 		// Look at the top 3 bits
@@ -512,13 +615,13 @@ static void GetGenPhase2(RegLKU gen, int c)
 			MultiReg temp3;
 
 			if (OpSize.Op[c] == sz64) {
-				temp3.u32 = SWAP32(read_x32(pc));
+				temp3.u32 = SWAP32(fetch_x32(pc));
 				Immediate64.u64 = (((uint64_t) temp3.u32) << 32);
-				temp3.u32 = SWAP32(read_x32(pc + 4));
+				temp3.u32 = SWAP32(fetch_x32(pc + 4));
 				Immediate64.u64 |= temp3.u32;
 			} else {
 				// Why can't they just decided on an endian and then stick to it?
-				temp3.u32 = SWAP32(read_x32(pc));
+				temp3.u32 = SWAP32(fetch_x32(pc));
 				if (OpSize.Op[c] == sz8)
 					genaddr[c] = temp3.u8;
 				else if (OpSize.Op[c] == sz16)
@@ -1096,7 +1199,7 @@ void ns32016_exec(int cycles)
 			ns32016_disassemble(pc, tracebuf + 1, sizeof(tracebuf) - 1);
 			fprintf(stderr, "%s\n", tracebuf);
 		}
-		opcode = read_x32(pc);
+		opcode = fetch_x32(pc);
 
 		if (pc == PR.BPC) {
 			SET_TRAP(BreakPointHit);
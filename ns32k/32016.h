@@ -14,6 +14,8 @@ extern void ns32016_close(void);
 extern void ns32016_build_matrix(void);
 extern void ns32016_set_irq(unsigned mask);
 extern void ns32016_trace(unsigned onoff);
+extern void ns32016_set_ram(uint8_t *base, uint32_t size, uint32_t wlow);
+extern void ns32016_set_io(uint32_t base);
 /*
  *	Platform provided
  */
@@ -29,6 +29,8 @@ struct ns8060 {
 	uint8_t int_latch;
 	uint8_t input;		/* A and B bits */
 
+	long slack;		/* Overrun from the last ns8060_run */
+
 	int trace;		/* TODO */
 };
 
@@ -179,293 +181,402 @@ static uint8_t get_imm8(struct ns8060 *cpu)
 	return v;
 }
 
-/* Generate an effective address */
-static uint16_t make_address(struct ns8060 *cpu, int mode, int8_t off, int notjmp)
+/*
+ *	Effective addresses. The mode is fixed by the opcode so each
+ *	handler calls the form it needs directly.
+ */
+
+/* Indexed off a pointer. A displacement of 0x80 means use E */
+static uint16_t ea_indexed(struct ns8060 *cpu)
 {
-	if ((off & 0xff) == 0x80 && notjmp)
+	int8_t off = get_off8(cpu);
+	if ((off & 0xff) == 0x80)
 		off = cpu->e;
+	return add12(cpu->p[cpu->i & 3], off);
+}
 
-	if (!(mode & 4)) {	// not AutoIndex
-		return add12(cpu->p[mode & 3], off);
-	} else {		// AutoIndex
-		if (off < 0) {
-			cpu->p[mode & 3] = add12(cpu->p[mode & 3], off);
-			return cpu->p[mode & 3];
-		} else {
-			uint16_t oldptr = cpu->p[mode & 3];
-			cpu->p[mode & 3] = add12(cpu->p[mode & 3], off);
-			return oldptr;
-		}
-	}
+/* Jumps never substitute E */
+static uint16_t ea_jump(struct ns8060 *cpu)
+{
+	int8_t off = get_off8(cpu);
+	return add12(cpu->p[cpu->i & 3], off);
 }
 
-static void illegal(struct ns8060 *cpu)
+/* Auto-indexed: pre-decrement for negative, post-increment for positive */
+static uint16_t ea_autoindex(struct ns8060 *cpu)
+{
+	uint16_t *p = &cpu->p[cpu->i & 3];
+	uint16_t oldptr;
+	int8_t off = get_off8(cpu);
+	if ((off & 0xff) == 0x80)
+		off = cpu->e;
+	oldptr = *p;
+	*p = add12(*p, off);
+	if (off < 0)
+		return *p;
+	return oldptr;
+}
+
+static unsigned int illegal(struct ns8060 *cpu)
 {
 	fprintf(stderr, "Illegal operation 0x%02X at 0x%04X.\n", cpu->i, cpu->p[0]);
 	/* We don't have a model for ilegals so we don't know how to behave here */
 	exit(1);
 }
 
-static unsigned int memop(struct ns8060 *cpu)
+/*
+ *	Memory reference instructions (C0-FF). The low three bits select
+ *	indexed (0-3), immediate (4) or auto-indexed (5-7). Each operation
+ *	gets a handler per form.
+ */
+#define MEMOP(name, op, ccmem, ccimm) \
+static unsigned int name##_indexed(struct ns8060 *cpu) \
+{ \
+	uint8_t val = mread(cpu, ea_indexed(cpu)); \
+	op; \
+	return ccmem; \
+} \
+static unsigned int name##_auto(struct ns8060 *cpu) \
+{ \
+	uint8_t val = mread(cpu, ea_autoindex(cpu)); \
+	op; \
+	return ccmem; \
+} \
+static unsigned int name##_imm(struct ns8060 *cpu) \
+{ \
+	uint8_t val = get_imm8(cpu); \
+	op; \
+	return ccimm; \
+}
+
+MEMOP(op_ld, cpu->a = val, 18, 10)
+MEMOP(op_and, cpu->a &= val, 18, 10)
+MEMOP(op_or, cpu->a |= val, 18, 10)
+MEMOP(op_xor, cpu->a ^= val, 18, 10)
+MEMOP(op_dad, dad(cpu, val), 23, 15)
+MEMOP(op_add, add(cpu, val), 19, 11)
+MEMOP(op_cad, add(cpu, ~val), 20, 12)
+
+static unsigned int op_st_indexed(struct ns8060 *cpu)
 {
-	uint16_t addr;
-	uint8_t val;
-	unsigned int immediate = 0;
+	mwrite(cpu, ea_indexed(cpu), cpu->a);
+	return 18;
+}
 
-	if ((cpu->i & 0x07) == 4) {
-		val = get_imm8(cpu);
-		immediate = 1;
-	} else
-		addr = make_address(cpu, cpu->i & 7, get_off8(cpu), 1);
-
-	switch (cpu->i & 0xF8) {
-	case 0xC0:		/* LD */
-		if (!immediate) {
-			cpu->a = mread(cpu, addr);
-			return 18;
-		}
-		cpu->a = val;
-		return 10;
-	case 0xC8:		/* ST */
-		if (immediate)
-			break;
-		mwrite(cpu, addr, cpu->a);
-		return 18;
-	case 0xD0:		/* AND */
-		if (!immediate) {
-			cpu->a &= mread(cpu, addr);
-			return 18;
-		}
-		cpu->a &= val;
-		return 10;
-	case 0xD8:		/* OR */
-		if (!immediate) {
-			cpu->a |= mread(cpu, addr);
-			return 18;
-		}
-		cpu->a |= val;
-		return 10;
-	case 0xE0:		/* XOR */
-		if (!immediate) {
-			cpu->a ^= mread(cpu, addr);
-			return 18;
-		}
-		cpu->a ^= val;
-		return 10;
-	case 0xE8:		/* DAD */
-		if (!immediate) {
-			dad(cpu, mread(cpu, addr));
-			return 23;
-		}
-		dad(cpu, val);
-		return 15;
-	case 0xF0:		/* ADD */
-		if (!immediate) {
-			add(cpu, mread(cpu, addr));
-			return 19;
-		}
-		add(cpu, val);
-		return 11;
-	case 0xF8:		/* CAD */
-		if (!immediate) {
-			add(cpu, ~mread(cpu, addr));
-			return 20;
-		}
-		add(cpu, ~val);
-		return 12;
-	}
-	illegal(cpu);
-	return 20;		/* ?? */
+static unsigned int op_st_auto(struct ns8060 *cpu)
+{
+	mwrite(cpu, ea_autoindex(cpu), cpu->a);
+	return 18;
 }
 
-static unsigned int dbop(struct ns8060 *cpu)
+/*
+ *	Displacement instructions (80-BF)
+ */
+static unsigned int op_dly(struct ns8060 *cpu)
 {
-	unsigned int ptr = cpu->i & 3;
-	int8_t disp = get_off8(cpu);
-
-	int notjmp = 1;
-	if ((cpu->i >= 0x90) && (cpu->i < 0xa0))
-		notjmp = 0;
-
-	unsigned int addr = make_address(cpu, cpu->i & 3, disp, notjmp);
-
-	switch (cpu->i & 0xFC) {
-	case 0x8C:
-		/* TODO: We don't model stuff happening during the delay */
-		if (ptr == 3)
-			return 514 * (uint8_t) disp + cpu->a + 13;
-		break;
-	case 0x90:		/* JMP */
-		cpu->p[0] = addr;
-		return 11;
-	case 0x94:		/* JP */
-		if (cpu->a & 0x80)
-			return 9;
-		cpu->p[0] = addr;
-		return 11;
-	case 0x98:		/* JZ */
-		if (cpu->a)
-			return 9;
-		cpu->p[0] = addr;
-		return 11;
-	case 0x9C:		/* JNZ */
-		if (cpu->a == 0)
-			return 9;
-		cpu->p[0] = addr;
-		return 11;
-	case 0xA8:		/* ILD */
-		mwrite(cpu, addr, cpu->a = mread(cpu, addr) + 1);
-		return 22;
-	case 0xB8:		/* DLD */
-		mwrite(cpu, addr, cpu->a = mread(cpu, addr) - 1);
-		return 22;
-	}
-	illegal(cpu);
-	return 20;		/* ?? */
+	uint8_t disp = get_off8(cpu);
+	/* TODO: We don't model stuff happening during the delay */
+	return 514 * disp + cpu->a + 13;
 }
 
-static unsigned int execute_op(struct ns8060 *cpu)
+static unsigned int op_jmp(struct ns8060 *cpu)
 {
-	uint8_t tmp8;
-	uint16_t tmp16;
-	unsigned int ptr;
+	cpu->p[0] = ea_jump(cpu);
+	return 11;
+}
 
-	if (cpu->trace)
-		fprintf(stderr, "%02X ", cpu->i);
+static unsigned int op_jp(struct ns8060 *cpu)
+{
+	uint16_t addr = ea_jump(cpu);
+	if (cpu->a & 0x80)
+		return 9;
+	cpu->p[0] = addr;
+	return 11;
+}
 
-	if ((cpu->i & 0xC0) == 0xC0)
-		return memop(cpu);
-	if ((cpu->i & 0x80) == 0x80)
-		return dbop(cpu);
-	/* Single byte ops */
-	switch (cpu->i) {
-	case 0x00:		/* HALT */
-		/* TODO */
-		return 8;
-	case 0x01:		/* XAE */
-		tmp8 = cpu->a;
-		cpu->a = cpu->e;
-		cpu->e = tmp8;
-		return 7;
-	case 0x02:		/* CCL */
-		cpu->s &= ~S_CL;
-		return 5;
-	case 0x03:		/* SCL */
+static unsigned int op_jz(struct ns8060 *cpu)
+{
+	uint16_t addr = ea_jump(cpu);
+	if (cpu->a)
+		return 9;
+	cpu->p[0] = addr;
+	return 11;
+}
+
+static unsigned int op_jnz(struct ns8060 *cpu)
+{
+	uint16_t addr = ea_jump(cpu);
+	if (cpu->a == 0)
+		return 9;
+	cpu->p[0] = addr;
+	return 11;
+}
+
+static unsigned int op_ild(struct ns8060 *cpu)
+{
+	uint16_t addr = ea_indexed(cpu);
+	mwrite(cpu, addr, cpu->a = mread(cpu, addr) + 1);
+	return 22;
+}
+
+static unsigned int op_dld(struct ns8060 *cpu)
+{
+	uint16_t addr = ea_indexed(cpu);
+	mwrite(cpu, addr, cpu->a = mread(cpu, addr) - 1);
+	return 22;
+}
+
+/*
+ *	Single byte instructions
+ */
+static unsigned int op_halt(struct ns8060 *cpu)
+{
+	/* TODO */
+	return 8;
+}
+
+static unsigned int op_xae(struct ns8060 *cpu)
+{
+	uint8_t tmp8 = cpu->a;
+	cpu->a = cpu->e;
+	cpu->e = tmp8;
+	return 7;
+}
+
+static unsigned int op_ccl(struct ns8060 *cpu)
+{
+	cpu->s &= ~S_CL;
+	return 5;
+}
+
+static unsigned int op_scl(struct ns8060 *cpu)
+{
+	cpu->s |= S_CL;
+	return 5;
+}
+
+static unsigned int op_dint(struct ns8060 *cpu)
+{
+	cpu->s &= ~S_IE;
+	return 6;
+}
+
+static unsigned int op_ien(struct ns8060 *cpu)
+{
+	cpu->s |= S_IE;
+	return 6;
+}
+
+static unsigned int op_csa(struct ns8060 *cpu)
+{
+	cpu->a = get_s(cpu);
+	return 5;
+}
+
+static unsigned int op_cas(struct ns8060 *cpu)
+{
+	cpu->s = cpu->a;
+	return 6;
+}
+
+static unsigned int op_nop(struct ns8060 *cpu)
+{
+	return 5;
+}
+
+static unsigned int op_sio(struct ns8060 *cpu)
+{
+	uint8_t tmp8 = cpu->e;
+	cpu->e >>= 1;
+	cpu->e |= ser_input(cpu) ? 0x80 : 0;
+	ser_output(cpu, tmp8 & 1);
+	return 5;
+}
+
+static unsigned int op_sr(struct ns8060 *cpu)
+{
+	cpu->a >>= 1;
+	return 5;
+}
+
+/* SRL and RRL behave identically here */
+static unsigned int op_srl(struct ns8060 *cpu)
+{
+	uint8_t tmp8 = cpu->a & 1;
+	cpu->a >>= 1;
+	if (cpu->s & S_CL)
+		cpu->a |= 0x80;
+	if (tmp8)
 		cpu->s |= S_CL;
-		return 5;
-	case 0x04:		/* DINT */
-		cpu->s &= ~S_IE;
-		return 6;
-	case 0x05:		/* IEN */
-		cpu->s |= S_IE;
-		return 6;
-	case 0x06:		/* CSA */
-		cpu->a = get_s(cpu);
-		return 5;
-	case 0x07:		/* CAS */
-		cpu->s = cpu->a;
-		return 6;
-	case 0x08:		/* NOP */
-		return 0;
-	case 0x19:		/* SIO */
-		tmp8 = cpu->e;
-		cpu->e >>= 1;
-		cpu->e |= ser_input(cpu) ? 0x80 : 0;
-		ser_output(cpu, tmp8 & 1);
-		return 5;
-	case 0x1C:		/* SR */
-		cpu->a >>= 1;
-		return 5;
-	case 0x1D:		/* SRL */
-		tmp8 = cpu->a & 1;
-		cpu->a >>= 1;
-		if (cpu->s & S_CL)
-			cpu->a |= 0x80;
-		if (tmp8)
-			cpu->s |= S_CL;
-		else
-			cpu->s &= ~S_CL;
-		return 5;
-	case 0x1E:		/* RR */
-		tmp8 = cpu->a & 1;
-		cpu->a >>= 1;
-		if (tmp8)
-			cpu->a |= 0x80;
-		return 5;
-	case 0x1F:		/* RRL */
-		tmp8 = cpu->a & 1;
-		cpu->a >>= 1;
-		if (cpu->s & S_CL)
-			cpu->a |= 0x80;
-		if (tmp8)
-			cpu->s |= S_CL;
-		else
-			cpu->s &= ~S_CL;
-		return 5;
+	else
+		cpu->s &= ~S_CL;
+	return 5;
+}
+
+static unsigned int op_rr(struct ns8060 *cpu)
+{
+	uint8_t tmp8 = cpu->a & 1;
+	cpu->a >>= 1;
+	if (tmp8)
+		cpu->a |= 0x80;
+	return 5;
+}
 
 #if 1				// Print I/O Hook.
-	case 0x20:		/* UNDEFINED */
-		ns8060_emu_putch(cpu->a);
-		return 5;
-	case 0x21:		/* UNDEFINED */
-		cpu->a = cpu->e = ns8060_emu_getch();
-		return 5;
+static unsigned int op_putc(struct ns8060 *cpu)
+{
+	ns8060_emu_putch(cpu->a);
+	return 5;
+}
+
+static unsigned int op_getc(struct ns8060 *cpu)
+{
+	cpu->a = cpu->e = ns8060_emu_getch();
+	return 5;
+}
 #endif
 
-	case 0x30:		/* XPAL */
-	case 0x31:
-	case 0x32:
-	case 0x33:
-		ptr = cpu->i & 3;
-		tmp8 = cpu->p[ptr];
-		cpu->p[ptr] &= 0xFF00;
-		cpu->p[ptr] |= cpu->a;
-		cpu->a = tmp8;
-		return 8;
-	case 0x34:		/* XPAH */
-	case 0x35:
-	case 0x36:
-	case 0x37:
-		ptr = cpu->i & 3;
-		tmp8 = cpu->p[ptr] >> 8;
-		cpu->p[ptr] &= 0xFF;
-		cpu->p[ptr] |= cpu->a << 8;
-		cpu->a = tmp8;
-		return 8;
-	case 0x3C:		/* XPPC */
-	case 0x3D:
-	case 0x3E:
-	case 0x3F:
-		ptr = cpu->i & 3;
-		tmp16 = cpu->p[ptr];
-		cpu->p[ptr] = cpu->p[0];
-		cpu->p[0] = tmp16;
-		return 7;
-	case 0x40:		/* LDE */
-		cpu->a = cpu->e;
-		return 6;
-	case 0x50:		/* ANE */
-		cpu->a &= cpu->e;
-		return 6;
-	case 0x58:		/* ORE */
-		cpu->a |= cpu->e;
-		return 6;
-	case 0x60:		/* XRE */
-		cpu->a ^= cpu->e;
-		return 6;
-	case 0x68:		/* DAE */
-		dad(cpu, cpu->e);
-		return 11;
-	case 0x70:		/* ADE */
-		add(cpu, cpu->e);
-		return 7;
-	case 0x78:		/* CAE */
-		add(cpu, ~cpu->e);
-		return 8;
-	default:
-		illegal(cpu);
-		return 10;
-	}
+static unsigned int op_xpal(struct ns8060 *cpu)
+{
+	unsigned int ptr = cpu->i & 3;
+	uint8_t tmp8 = cpu->p[ptr];
+	cpu->p[ptr] &= 0xFF00;
+	cpu->p[ptr] |= cpu->a;
+	cpu->a = tmp8;
+	return 8;
+}
+
+static unsigned int op_xpah(struct ns8060 *cpu)
+{
+	unsigned int ptr = cpu->i & 3;
+	uint8_t tmp8 = cpu->p[ptr] >> 8;
+	cpu->p[ptr] &= 0xFF;
+	cpu->p[ptr] |= cpu->a << 8;
+	cpu->a = tmp8;
+	return 8;
+}
+
+static unsigned int op_xppc(struct ns8060 *cpu)
+{
+	unsigned int ptr = cpu->i & 3;
+	uint16_t tmp16 = cpu->p[ptr];
+	cpu->p[ptr] = cpu->p[0];
+	cpu->p[0] = tmp16;
+	return 7;
+}
+
+static unsigned int op_lde(struct ns8060 *cpu)
+{
+	cpu->a = cpu->e;
+	return 6;
+}
+
+static unsigned int op_ane(struct ns8060 *cpu)
+{
+	cpu->a &= cpu->e;
+	return 6;
+}
+
+static unsigned int op_ore(struct ns8060 *cpu)
+{
+	cpu->a |= cpu->e;
+	return 6;
+}
+
+static unsigned int op_xre(struct ns8060 *cpu)
+{
+	cpu->a ^= cpu->e;
+	return 6;
+}
+
+static unsigned int op_dae(struct ns8060 *cpu)
+{
+	dad(cpu, cpu->e);
+	return 11;
+}
+
+static unsigned int op_ade(struct ns8060 *cpu)
+{
+	add(cpu, cpu->e);
+	return 7;
+}
+
+static unsigned int op_cae(struct ns8060 *cpu)
+{
+	add(cpu, ~cpu->e);
+	return 8;
+}
+
+typedef unsigned int (*ns8060_handler)(struct ns8060 *cpu);
+
+static ns8060_handler optab[256];
+
+static void memop_row(unsigned int base, ns8060_handler indexed,
+	ns8060_handler imm, ns8060_handler autoidx)
+{
+	unsigned int i;
+	for (i = 0; i < 4; i++)
+		optab[base + i] = indexed;
+	optab[base + 4] = imm;
+	for (i = 5; i < 8; i++)
+		optab[base + i] = autoidx;
+}
+
+static void fill(unsigned int base, unsigned int n, ns8060_handler op)
+{
+	while (n--)
+		optab[base++] = op;
+}
+
+static void build_optab(void)
+{
+	fill(0x00, 256, illegal);
+
+	optab[0x00] = op_halt;
+	optab[0x01] = op_xae;
+	optab[0x02] = op_ccl;
+	optab[0x03] = op_scl;
+	optab[0x04] = op_dint;
+	optab[0x05] = op_ien;
+	optab[0x06] = op_csa;
+	optab[0x07] = op_cas;
+	optab[0x08] = op_nop;
+	optab[0x19] = op_sio;
+	optab[0x1C] = op_sr;
+	optab[0x1D] = op_srl;
+	optab[0x1E] = op_rr;
+	optab[0x1F] = op_srl;	/* RRL */
+#if 1
+	optab[0x20] = op_putc;
+	optab[0x21] = op_getc;
+#endif
+	fill(0x30, 4, op_xpal);
+	fill(0x34, 4, op_xpah);
+	fill(0x3C, 4, op_xppc);
+	optab[0x40] = op_lde;
+	optab[0x50] = op_ane;
+	optab[0x58] = op_ore;
+	optab[0x60] = op_xre;
+	optab[0x68] = op_dae;
+	optab[0x70] = op_ade;
+	optab[0x78] = op_cae;
+
+	optab[0x8F] = op_dly;
+	fill(0x90, 4, op_jmp);
+	fill(0x94, 4, op_jp);
+	fill(0x98, 4, op_jz);
+	fill(0x9C, 4, op_jnz);
+	fill(0xA8, 4, op_ild);
+	fill(0xB8, 4, op_dld);
+
+	memop_row(0xC0, op_ld_indexed, op_ld_imm, op_ld_auto);
+	memop_row(0xC8, op_st_indexed, illegal, op_st_auto);
+	memop_row(0xD0, op_and_indexed, op_and_imm, op_and_auto);
+	memop_row(0xD8, op_or_indexed, op_or_imm, op_or_auto);
+	memop_row(0xE0, op_xor_indexed, op_xor_imm, op_xor_auto);
+	memop_row(0xE8, op_dad_indexed, op_dad_imm, op_dad_auto);
+	memop_row(0xF0, op_add_indexed, op_add_imm, op_add_auto);
+	memop_row(0xF8, op_cad_indexed, op_cad_imm, op_cad_auto);
 }
 
 unsigned int ns8060_execute_one(struct ns8060 *cpu)
@@ -473,12 +584,33 @@ unsigned int ns8060_execute_one(struct ns8060 *cpu)
 	unsigned int clocks = 0;
 	clocks += check_interrupt(cpu);
 	fetch_instruction(cpu);
-	clocks += execute_op(cpu);
+	if (cpu->trace)
+		fprintf(stderr, "%02X ", cpu->i);
+	clocks += optab[cpu->i](cpu);
 	if (cpu->trace)
 		fprintf(stderr, "\n");
 	return clocks;
 }
 
+/*
+ *	Run for at least the given number of clocks. Any overrun is taken
+ *	off the next run. Returns the clocks actually run.
+ */
+unsigned long ns8060_run(struct ns8060 *cpu, unsigned long clocks)
+{
+	unsigned long ran = 0;
+	long want = clocks + cpu->slack;
+	unsigned int n;
+
+	while (want > 0) {
+		n = ns8060_execute_one(cpu);
+		want -= n;
+		ran += n;
+	}
+	cpu->slack = want;
+	return ran;
+}
+
 void ns8060_reset(struct ns8060 *cpu)
 {
 	cpu->p[0] = 0;
@@ -498,6 +630,9 @@ struct ns8060 *ns8060_create(void)
 		exit(1);
 	}
 	cpu->trace = 0;
+	cpu->slack = 0;
+	if (optab[0] == NULL)
+		build_optab();
 	ns8060_reset(cpu);
 	return cpu;
 }
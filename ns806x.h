@@ -8,6 +8,7 @@ extern struct ns8060 *ns8060_create(void);
 extern void ns8060_reset(struct ns8060 *cpu);
 extern void ns8060_trace(struct ns8060 *cpu, unsigned int onoff);
 extern unsigned int ns8060_execute_one(struct ns8060 *cpu);
+extern unsigned long ns8060_run(struct ns8060 *cpu, unsigned long clocks);
 extern void ns8060_set_a(struct ns8060 *cpu, unsigned int a);
 extern void ns8060_set_b(struct ns8060 *cpu, unsigned int b);
 
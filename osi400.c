@@ -22,6 +22,7 @@
 #include "serialdevice.h"
 #include "ttycon.h"
 #include "acia.h"
+#include "rasterclock.h"
 
 static uint8_t mem[65536];	/* Mostly usually absent */
 static unsigned ram_mask;
@@ -35,6 +36,7 @@ static SDL_Texture *texture;
 static uint32_t texturebits[32 * CWIDTH * 32 * CHEIGHT];
 
 static unsigned fast;
+static struct rasterclock *rclock;
 volatile int emulator_done;
 struct acia *acia;
 static unsigned basic;
@@ -255,9 +257,15 @@ static void usage(void)
 	exit(EXIT_FAILURE);
 }
 
+/* exec6502 carries any overrun into the next call itself */
+static unsigned osi400_execute(void *unused, unsigned clocks)
+{
+	exec6502(clocks);
+	return clocks;
+}
+
 int main(int argc, char *argv[])
 {
-	static struct timespec tc;
 	static int tstates = 100;	/* 1MHz */
 	int opt;
 	unsigned memsize = 1;
@@ -356,11 +364,11 @@ int main(int argc, char *argv[])
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
 	SDL_RenderSetLogicalSize(render, 32 * CWIDTH,  32 * CHEIGHT);
 
-	/* 10ms - it's a balance between nice behaviour and simulation
-	   smoothness */
-
-	tc.tv_sec = 0;
-	tc.tv_nsec = 10000000L;
+	/* 10ms frames of 100 slices - it's a balance between nice behaviour
+	   and simulation smoothness */
+	rclock = rasterclock_create(tstates * 10000UL, tstates, 100);
+	rasterclock_fast(rclock, fast);
+	rasterclock_cpu(rclock, osi400_execute, NULL);
 
 	if (tcgetattr(0, &term) == 0) {
 		saved_term = term;
@@ -383,24 +391,14 @@ int main(int argc, char *argv[])
 	init6502();
 	reset6502();
 	
-	/* This is the wrong way to do it but it's easier for the moment. We
-	   should track how much real time has occurred and try to keep cycle
-	   matched with that. The scheme here works fine except when the host
-	   is loaded though */
-
 	while (!emulator_done) {
-		int i;
-		for (i = 0; i < 100; i++) {
-			exec6502(tstates);
-		}
+		rasterclock_run_frame(rclock);
 		/* We want to run UI events before we rasterize */
 		ui_event();
 		osi440_rasterize();
 		osi440_render();
 		acia_timer(acia);
-		/* Do 10ms of I/O and delays */
-		if (!fast)
-			nanosleep(&tc, NULL);
+		rasterclock_sync(rclock);
 	}
 	exit(0);
 }
@@ -67,6 +67,7 @@
 #include "ttycon.h"
 #include "acia.h"
 #include "6821.h"
+#include "rasterclock.h"
 
 static uint8_t rom[2048];	/* Pages selected by decoder in 502/5 */
 static uint8_t mem[65536]; 	/* Base RAM/ROM */
@@ -83,6 +84,7 @@ static uint32_t texturebits[64 * CWIDTH * 32 * CHEIGHT];
 static unsigned vwidth;	/* Characters per line */
 
 static unsigned fast;
+static struct rasterclock *rclock;
 volatile int emulator_done;
 struct acia *acia;
 struct m6821 *pia;
@@ -386,9 +388,15 @@ static void usage(void)
 	exit(EXIT_FAILURE);
 }
 
+/* exec6502 carries any overrun into the next call itself */
+static unsigned osi500_execute(void *unused, unsigned clocks)
+{
+	exec6502(clocks);
+	return clocks;
+}
+
 int main(int argc, char *argv[])
 {
-	static struct timespec tc;
 	static int tstates = 100;	/* 1MHz */
 	int opt;
 	unsigned romsize;
@@ -520,11 +528,11 @@ int main(int argc, char *argv[])
 		SDL_RenderSetLogicalSize(render, vwidth * CWIDTH,  32 * CHEIGHT);
 	}
 
-	/* 10ms - it's a balance between nice behaviour and simulation
-	   smoothness */
-
-	tc.tv_sec = 0;
-	tc.tv_nsec = 10000000L;
+	/* 10ms frames of 100 slices - it's a balance between nice behaviour
+	   and simulation smoothness */
+	rclock = rasterclock_create(tstates * 10000UL, tstates, 100);
+	rasterclock_fast(rclock, fast);
+	rasterclock_cpu(rclock, osi500_execute, NULL);
 
 	if (tcgetattr(0, &term) == 0) {
 		saved_term = term;
@@ -547,16 +555,8 @@ int main(int argc, char *argv[])
 	init6502();
 	reset6502();
 	
-	/* This is the wrong way to do it but it's easier for the moment. We
-	   should track how much real time has occurred and try to keep cycle
-	   matched with that. The scheme here works fine except when the host
-	   is loaded though */
-
 	while (!emulator_done) {
-		int i;
-		for (i = 0; i < 100; i++) {
-			exec6502(tstates);
-		}
+		rasterclock_run_frame(rclock);
 		/* We want to run UI events before we rasterize */
 		if (video) {
 			ui_event();
@@ -564,9 +564,7 @@ int main(int argc, char *argv[])
 			osi440_render();
 		}
 		acia_timer(acia);
-		/* Do 10ms of I/O and delays */
-		if (!fast)
-			nanosleep(&tc, NULL);
+		rasterclock_sync(rclock);
 	}
 	exit(0);
 }
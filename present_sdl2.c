@@ -0,0 +1,332 @@
+/*
+ *	Get finished frames onto an SDL2 window
+ *
+ *	SDL_RenderPresent can block for a whole display refresh with vsync
+ *	or a slow compositor. Where SDL can render away from the main thread
+ *	each window gets a thread that owns the renderer. The emulation
+ *	copies each completed raster into one of three buffers and hands it
+ *	over with an atomic exchange, so neither side ever waits for the
+ *	other. If the display falls behind frames are simply dropped.
+ *
+ *	SDL only promises rendering works from the main thread. macOS and
+ *	Windows require it so there we always render in line. Elsewhere we
+ *	use the thread only with video drivers known to cope (X11, Wayland
+ *	and the offscreen ones). Setting EMU_RENDER_THREAD=0 in the
+ *	environment renders in line everywhere. present_test exercises both
+ *	modes offscreen with SDL_VIDEODRIVER=dummy.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "present_sdl2.h"
+
+/* Set in the ready index when it holds a frame not yet displayed */
+#define FRESH		4
+
+struct frame {
+    uint32_t *pixels;
+    SDL_Rect upload;		/* Part of the texture that needs loading */
+    SDL_Rect stale;		/* Changed since this buffer was filled */
+    SDL_Rect dst;
+    unsigned has_dst;
+    uint32_t background;
+};
+
+struct present {
+    const char *name;
+    SDL_Window *window;
+    Uint32 flags;
+    unsigned width, height;
+    unsigned lwidth, lheight;
+    SDL_Renderer *render;
+    SDL_Texture *texture;
+    struct frame frame[3];
+    /* Each buffer is owned by the emulation (back), the display (front)
+       or is the most recently published one (ready) */
+    unsigned back;
+    unsigned front;
+    /* Damage since the last frame we know the display took */
+    SDL_Rect owed;
+    unsigned published;
+    SDL_atomic_t ready;
+    SDL_atomic_t quit;
+    SDL_sem *wake;
+    SDL_sem *started;
+    SDL_Thread *thread;
+    char error[256];
+};
+
+/* Grow a to cover b as well. An empty rectangle has no width */
+static void rect_union(SDL_Rect *a, const SDL_Rect *b)
+{
+    int x2, y2;
+
+    if (b->w == 0)
+        return;
+    if (a->w == 0) {
+        *a = *b;
+        return;
+    }
+    x2 = a->x + a->w;
+    y2 = a->y + a->h;
+    if (b->x < a->x)
+        a->x = b->x;
+    if (b->y < a->y)
+        a->y = b->y;
+    if (b->x + b->w > x2)
+        x2 = b->x + b->w;
+    if (b->y + b->h > y2)
+        y2 = b->y + b->h;
+    a->w = x2 - a->x;
+    a->h = y2 - a->y;
+}
+
+static int present_setup(struct present *p)
+{
+    p->render = SDL_CreateRenderer(p->window, -1, p->flags);
+    if (p->render == NULL) {
+        /* SDL errors are per thread so keep a copy */
+        snprintf(p->error, sizeof(p->error),
+            "unable to create renderer: %s", SDL_GetError());
+        return -1;
+    }
+    p->texture = SDL_CreateTexture(p->render, SDL_PIXELFORMAT_ARGB8888,
+                    SDL_TEXTUREACCESS_STREAMING, p->width, p->height);
+    if (p->texture == NULL) {
+        snprintf(p->error, sizeof(p->error),
+            "unable to create texture: %s", SDL_GetError());
+        return -1;
+    }
+    SDL_SetRenderDrawColor(p->render, 0, 0, 0, 255);
+    SDL_RenderClear(p->render);
+    SDL_RenderPresent(p->render);
+    SDL_RenderSetLogicalSize(p->render, p->lwidth, p->lheight);
+    return 0;
+}
+
+static void present_draw(struct present *p, struct frame *f)
+{
+    SDL_Rect *u = &f->upload;
+
+    if (u->w)
+        SDL_UpdateTexture(p->texture, u, f->pixels + u->y * p->width + u->x,
+            p->width * 4);
+    SDL_SetRenderDrawColor(p->render,
+                               (f->background >> 16) & 0xFF,
+                               (f->background >>  8) & 0xFF,
+                               (f->background >>  0) & 0xFF,
+                               (f->background >> 24) & 0xFF);
+    SDL_RenderClear(p->render);
+    SDL_RenderCopy(p->render, p->texture, NULL, f->has_dst ? &f->dst : NULL);
+    SDL_RenderPresent(p->render);
+}
+
+static void present_release(struct present *p)
+{
+    if (p->texture)
+        SDL_DestroyTexture(p->texture);
+    if (p->render)
+        SDL_DestroyRenderer(p->render);
+}
+
+static int present_thread(void *priv)
+{
+    struct present *p = priv;
+    int r;
+
+    r = present_setup(p);
+    /* Tell present_create how it went */
+    SDL_SemPost(p->started);
+    if (r)
+        return r;
+
+    while (1) {
+        SDL_SemWait(p->wake);
+        if (SDL_AtomicGet(&p->quit))
+            break;
+        if (!(SDL_AtomicGet(&p->ready) & FRESH))
+            continue;
+        /* Take the newest frame, leaving the one we showed last as spare */
+        p->front = SDL_AtomicSet(&p->ready, p->front) & 3;
+        present_draw(p, &p->frame[p->front]);
+    }
+    /* The renderer belongs to this thread so must be freed here */
+    present_release(p);
+    return 0;
+}
+
+/*
+ *	Hand a finished frame to the display. Only the area given (or all
+ *	of it if area is NULL) has changed since the last call; that part
+ *	is copied, along with anything this buffer missed while it was in
+ *	use, so the caller is free to start on the next frame at once.
+ */
+void present_area(struct present *p, const uint32_t *pixels, unsigned pitch,
+    const SDL_Rect *area, const SDL_Rect *dst, uint32_t background)
+{
+    struct frame *f = &p->frame[p->back];
+    SDL_Rect all, copy;
+    uint32_t *d;
+    unsigned i;
+    int y, old;
+
+    all.x = all.y = 0;
+    all.w = p->width;
+    all.h = p->height;
+    if (area == NULL)
+        area = &all;
+
+    for (i = 0; i < 3; i++)
+        rect_union(&p->frame[i].stale, area);
+    copy = f->stale;
+    f->stale.w = 0;
+
+    d = f->pixels + copy.y * p->width + copy.x;
+    pixels += copy.y * (pitch / 4) + copy.x;
+    for (y = 0; y < copy.h; y++) {
+        memcpy(d, pixels, copy.w * 4);
+        d += p->width;
+        pixels += pitch / 4;
+    }
+    f->has_dst = dst != NULL;
+    if (dst)
+        f->dst = *dst;
+    f->background = background;
+
+    /* The display may skip frames so each one carries every change since
+       the last frame we know it took */
+    rect_union(&p->owed, area);
+    f->upload = p->owed;
+    if (p->thread == NULL) {
+        present_draw(p, f);
+        p->owed.w = 0;
+        return;
+    }
+    old = SDL_AtomicSet(&p->ready, p->back | FRESH);
+    p->back = old & 3;
+    if (!(old & FRESH)) {
+        /* The display took the previous frame, if there was one */
+        if (p->published)
+            p->owed = *area;
+        p->published = 1;
+        /* Only wake the thread for the first frame it has not yet seen */
+        SDL_SemPost(p->wake);
+    }
+}
+
+void present_frame(struct present *p, const uint32_t *pixels, unsigned pitch,
+    const SDL_Rect *dst, uint32_t background)
+{
+    present_area(p, pixels, pitch, NULL, dst, background);
+}
+
+/* Can this platform and video driver render from another thread */
+static int present_can_thread(void)
+{
+#if defined(__APPLE__) || defined(_WIN32)
+    return 0;
+#else
+    static const char *drivers[] = {
+        "x11", "wayland", "dummy", "offscreen", NULL
+    };
+    const char *env = getenv("EMU_RENDER_THREAD");
+    const char *drv = SDL_GetCurrentVideoDriver();
+    unsigned i;
+
+    if (env && *env == '0')
+        return 0;
+    if (drv == NULL)
+        return 0;
+    for (i = 0; drivers[i]; i++)
+        if (strcmp(drv, drivers[i]) == 0)
+            return 1;
+    return 0;
+#endif
+}
+
+struct present *present_create(const char *name, SDL_Window *window,
+    Uint32 flags, unsigned width, unsigned height,
+    unsigned lwidth, unsigned lheight)
+{
+    struct present *p;
+    unsigned i;
+
+    p = malloc(sizeof(struct present));
+    if (p == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(1);
+    }
+    memset(p, 0, sizeof(struct present));
+    p->name = name;
+    p->window = window;
+    p->flags = flags;
+    p->width = width;
+    p->height = height;
+    p->lwidth = lwidth;
+    p->lheight = lheight;
+    for (i = 0; i < 3; i++) {
+        p->frame[i].pixels = calloc(width * height, sizeof(uint32_t));
+        if (p->frame[i].pixels == NULL) {
+            fprintf(stderr, "Out of memory.\n");
+            exit(1);
+        }
+    }
+    for (i = 0; i < 3; i++) {
+        p->frame[i].stale.w = width;
+        p->frame[i].stale.h = height;
+    }
+    /* The texture starts out undefined */
+    p->owed = p->frame[0].stale;
+    p->back = 0;
+    p->front = 1;
+    SDL_AtomicSet(&p->ready, 2);
+
+    if (!present_can_thread()) {
+        if (present_setup(p)) {
+            fprintf(stderr, "%s: %s\n", name, p->error);
+            exit(1);
+        }
+        return p;
+    }
+
+    p->wake = SDL_CreateSemaphore(0);
+    p->started = SDL_CreateSemaphore(0);
+    if (p->wake == NULL || p->started == NULL) {
+        fprintf(stderr, "%s: unable to create semaphore: %s\n",
+            name, SDL_GetError());
+        exit(1);
+    }
+    p->thread = SDL_CreateThread(present_thread, name, p);
+    if (p->thread == NULL) {
+        fprintf(stderr, "%s: unable to create render thread: %s\n",
+            name, SDL_GetError());
+        exit(1);
+    }
+    SDL_SemWait(p->started);
+    SDL_DestroySemaphore(p->started);
+    if (*p->error) {
+        fprintf(stderr, "%s: %s\n", name, p->error);
+        exit(1);
+    }
+    return p;
+}
+
+void present_free(struct present *p)
+{
+    unsigned i;
+
+    if (p->thread) {
+        SDL_AtomicSet(&p->quit, 1);
+        SDL_SemPost(p->wake);
+        SDL_WaitThread(p->thread, NULL);
+        SDL_DestroySemaphore(p->wake);
+    } else
+        present_release(p);
+    for (i = 0; i < 3; i++)
+        free(p->frame[i].pixels);
+    free(p);
+}
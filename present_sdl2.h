@@ -0,0 +1,16 @@
+#ifndef PRESENT_SDL2_H
+#define PRESENT_SDL2_H
+
+struct present;
+
+extern struct present *present_create(const char *name, SDL_Window *window,
+    Uint32 flags, unsigned width, unsigned height,
+    unsigned lwidth, unsigned lheight);
+extern void present_frame(struct present *p, const uint32_t *pixels,
+    unsigned pitch, const SDL_Rect *dst, uint32_t background);
+extern void present_area(struct present *p, const uint32_t *pixels,
+    unsigned pitch, const SDL_Rect *area, const SDL_Rect *dst,
+    uint32_t background);
+extern void present_free(struct present *p);
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ *	Offscreen check of the frame presentation layer
+ *
+ *	Publishes a run of frames each changing a random band of lines, far
+ *	faster than any display would take them, then checks the window
+ *	ends up showing exactly the final raster. This covers partial
+ *	uploads and the damage carried over frames the display dropped.
+ *	Both the render thread and the in line path are tried.
+ *
+ *	Run with SDL_VIDEODRIVER=dummy (the default if unset).
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "present_sdl2.h"
+
+#define WIDTH	64
+#define HEIGHT	48
+#define FRAMES	500
+
+static uint32_t raster[WIDTH * HEIGHT];
+
+static void paint(unsigned frame, const SDL_Rect *band)
+{
+    int x, y;
+
+    for (y = band->y; y < band->y + band->h; y++)
+        for (x = 0; x < WIDTH; x++)
+            raster[y * WIDTH + x] = 0xFF000000 |
+                ((frame * 37 + y * 11 + x) & 0xFF) << 16 |
+                ((frame >> 3) & 0xFF) << 8 | (x * 4 + y);
+}
+
+/* Does the window show the raster */
+static int shown(SDL_Window *window)
+{
+    SDL_Surface *s = SDL_GetWindowSurface(window);
+    uint8_t r, g, b;
+    uint32_t v, want;
+    int x, y;
+
+    if (s == NULL || s->w < WIDTH || s->h < HEIGHT)
+        return 0;
+    if (SDL_LockSurface(s))
+        return 0;
+    for (y = 0; y < HEIGHT; y++) {
+        for (x = 0; x < WIDTH; x++) {
+            uint8_t *p = (uint8_t *)s->pixels + y * s->pitch +
+                x * s->format->BytesPerPixel;
+            memcpy(&v, p, 4);
+            SDL_GetRGB(v, s->format, &r, &g, &b);
+            want = raster[y * WIDTH + x];
+            if (r != ((want >> 16) & 0xFF) || g != ((want >> 8) & 0xFF) ||
+                b != (want & 0xFF)) {
+                SDL_UnlockSurface(s);
+                return 0;
+            }
+        }
+    }
+    SDL_UnlockSurface(s);
+    return 1;
+}
+
+static int run(const char *mode)
+{
+    SDL_Window *window;
+    struct present *p;
+    SDL_Rect band;
+    unsigned i;
+    int ok = 0;
+
+    SDL_setenv("EMU_RENDER_THREAD", mode, 1);
+    if (SDL_Init(SDL_INIT_VIDEO)) {
+        fprintf(stderr, "present_test: SDL_Init: %s\n", SDL_GetError());
+        return 1;
+    }
+    window = SDL_CreateWindow("present_test", 0, 0, WIDTH, HEIGHT,
+        SDL_WINDOW_HIDDEN);
+    if (window == NULL) {
+        fprintf(stderr, "present_test: SDL_CreateWindow: %s\n",
+            SDL_GetError());
+        SDL_Quit();
+        return 1;
+    }
+    p = present_create("present_test", window, SDL_RENDERER_SOFTWARE,
+        WIDTH, HEIGHT, WIDTH, HEIGHT);
+
+    band.x = 0;
+    band.y = 0;
+    band.w = WIDTH;
+    band.h = HEIGHT;
+    paint(0, &band);
+    present_frame(p, raster, WIDTH * 4, NULL, 0xFF000000);
+
+    srand(1);
+    for (i = 1; i < FRAMES; i++) {
+        band.y = rand() % HEIGHT;
+        band.h = 1 + rand() % (HEIGHT - band.y);
+        paint(i, &band);
+        present_area(p, raster, WIDTH * 4, &band, NULL, 0xFF000000);
+    }
+
+    /* Let the display catch up with the last frame */
+    for (i = 0; i < 200 && !ok; i++) {
+        ok = shown(window);
+        if (!ok)
+            SDL_Delay(10);
+    }
+    present_free(p);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+
+    printf("present_test: %s: %s\n",
+        *mode == '0' ? "in line" : "threaded", ok ? "ok" : "FAILED");
+    return !ok;
+}
+
+int main(int argc, char *argv[])
+{
+    int err = 0;
+
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    err |= run("1");
+    err |= run("0");
+    return err;
+}
@@ -33,6 +33,7 @@ struct ps2 {
     unsigned int disabled;
 
     unsigned int divider;
+    unsigned int clockstep;
 
     unsigned int trace;
     uint32_t window;
@@ -71,6 +71,44 @@ static uint16_t tstate_steps = 2000000 / 900;
 
 static struct timespec tc;
 
+/*
+ *	The interval timer counts update periods up to timertarget. Rather
+ *	than count them off in system_process the expiry is scheduled as a
+ *	CPU event when the timer starts, and the count it reached is worked
+ *	out from the cycles run if it is paused.
+ */
+
+static CPUEvent timer_event;
+static word32 timer_start;
+
+static void timer_expire(word32 timestamp)
+{
+	CPU_addIRQ(IRQ_TIMER);
+	timercount = timertarget;
+	trunning = false;
+}
+
+static void timer_stop(void)
+{
+	if (trunning) {
+		timercount += (cpu_cycle_count - timer_start) / tstate_steps;
+		CPUEvent_cancel(&timer_event);
+		trunning = false;
+	}
+}
+
+static void timer_run(void)
+{
+	/* The count is 8bit so a target it has passed is 256 steps away */
+	unsigned int steps = (uint8_t)(timertarget - timercount);
+
+	if (steps == 0)
+		steps = 256;
+	timer_start = cpu_cycle_count;
+	CPUEvent_schedule(&timer_event, steps * tstate_steps, timer_expire);
+	trunning = true;
+}
+
 
 /* IO-ports */
 #define IO_PAGE			0xFE00
@@ -259,23 +297,21 @@ static void io_write(uint16_t addr, uint8_t val)
 		disk_write(val);
 		break;
 	case IO_TIMER_TARGET:
-		CPU_clearIRQ(IRQ_TIMER);
-		timercount = 0;
-		trunning = true;
-		break;
 	case IO_TIMER_RESET:
 		CPU_clearIRQ(IRQ_TIMER);
+		timer_stop();
 		timercount = 0;
-		trunning = true;
+		timer_run();
 		break;
 	case IO_TIMER_TRIG:
 		CPU_addIRQ(IRQ_TIMER);
 		break;
 	case IO_TIMER_PAUSE:
-		trunning = false;
+		timer_stop();
 		break;
 	case IO_TIMER_CONT:
-		trunning = true;
+		timer_stop();
+		timer_run();
 		CPU_clearIRQ(IRQ_TIMER);
 		break;
 	case 0xFF:
@@ -376,14 +412,6 @@ void system_process(void)
 	 */
 	if (fast == false)
 		nanosleep(&tc, NULL);
-	/* Configurable interrupt timer */
-	if (trunning == true) {
-		timercount++;
-		if (timercount == timertarget) {
-			CPU_addIRQ(IRQ_TIMER);
-			trunning = false;
-		}
-	}
 }
 
 void wdm(void)
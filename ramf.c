@@ -5,46 +5,67 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/mman.h>
 
 #include "ramf.h"
 
 /*
  *	RAMF Battery Backed RAM Disk
+ *
+ *	The image is a shared mapping of the backing file. The kernel will
+ *	write it back eventually but to survive a host crash we also msync
+ *	the part the guest has written, asynchronously whenever the board
+ *	asks and synchronously when we are freed.
  */
 
+#define RAMF_SIZE	(8192 * 1024)
+
 struct ramf {
     int fd;
 
     uint8_t *addr;
     uint8_t port[2][2];
     uint16_t count[2];
+    uint8_t *base[2];		/* Start of the currently selected sector */
+
+    /* Range written since the last msync */
+    uint32_t dirty_lo;
+    uint32_t dirty_hi;
 
     unsigned int trace;
 };
 
-static uint8_t *ramaddr(struct ramf *ramf, uint8_t high)
+/* Work out the sector the two address ports select */
+static void ramf_rebase(struct ramf *ramf, uint8_t high)
 {
     uint32_t offset = high ? 4096 * 1024 : 0;
     offset += (ramf->port[high][0] & 0x1F) << 17;
     offset += ramf->port[high][1] << 9;
-    offset += ramf->count[high]++;
-    return ramf->addr + offset;
+    ramf->base[high] = ramf->addr + offset;
+    ramf->count[high] = 0;
 }
 
 void ramf_write(struct ramf *ramf, uint8_t addr, uint8_t val)
 {
     uint8_t high = (addr & 4) ? 1 : 0;
+    uint32_t offset;
     if (ramf->trace)
         fprintf(stderr, "RAMF write %d = %d\n", addr, val);
     addr &= 3;
-    if (addr == 0)
-        *ramaddr(ramf, high) = val;
-    else if (addr == 3)
+    if (addr == 0) {
+        uint8_t *p = ramf->base[high] + ramf->count[high]++;
+        *p = val;
+        offset = p - ramf->addr;
+        if (offset < ramf->dirty_lo)
+            ramf->dirty_lo = offset;
+        if (offset >= ramf->dirty_hi)
+            ramf->dirty_hi = offset + 1;
+    } else if (addr == 3)
         return;
     else {
         ramf->port[high][addr & 1] = val;
-        ramf->count[high] = 0;
+        ramf_rebase(ramf, high);
     }
 }
 
@@ -55,14 +76,36 @@ uint8_t ramf_read(struct ramf *ramf, uint8_t addr)
         fprintf(stderr, "RAMF read %d\n", addr);
     addr &= 3;
     if (addr == 0)
-        return *ramaddr(ramf, high);
+        return ramf->base[high][ramf->count[high]++];
     if (addr == 3)
         return 0;	/* or 1 for write protected */
     return ramf->port[high][addr];
 }
 
-struct ramf *ramf_create(const char *path)
+/*
+ *	Push anything written since the last call towards the disk. With
+ *	wait set we don't return until it is there.
+ */
+void ramf_sync(struct ramf *ramf, unsigned int wait)
+{
+    uint32_t lo = ramf->dirty_lo;
+    long pagesize = sysconf(_SC_PAGESIZE);
+
+    if (lo >= ramf->dirty_hi)
+        return;
+    lo &= ~(pagesize - 1);
+    if (msync(ramf->addr + lo, ramf->dirty_hi - lo, wait ? MS_SYNC : MS_ASYNC))
+        perror("ramf: msync");
+    if (ramf->trace)
+        fprintf(stderr, "RAMF sync %X-%X%s\n", lo, ramf->dirty_hi, wait ? " (wait)" : "");
+    ramf->dirty_lo = RAMF_SIZE;
+    ramf->dirty_hi = 0;
+}
+
+struct ramf *ramf_create(const char *path, unsigned int flags)
 {
+    struct stat st;
+    int mflags = MAP_SHARED;
     struct ramf *ramf = malloc(sizeof(struct ramf));
     if (ramf == NULL) {
         fprintf(stderr, "Out of memory.\n");
@@ -76,20 +119,41 @@ struct ramf *ramf_create(const char *path)
         free(ramf);
         return NULL;
     }
-    ramf->addr = mmap(NULL, 8192 * 1024, PROT_READ|PROT_WRITE,
-        MAP_SHARED, ramf->fd, 0L);
+    /* A new or short image would fault when touched past the end */
+    if (fstat(ramf->fd, &st) == -1 ||
+        (st.st_size < RAMF_SIZE && ftruncate(ramf->fd, RAMF_SIZE) == -1)) {
+        perror(path);
+        close(ramf->fd);
+        free(ramf);
+        return NULL;
+    }
+    if (flags & RAMF_POPULATE)
+        mflags |= MAP_POPULATE;
+    ramf->addr = mmap(NULL, RAMF_SIZE, PROT_READ|PROT_WRITE,
+        mflags, ramf->fd, 0L);
     if (ramf->addr == MAP_FAILED) {
         perror("mmap");
         close(ramf->fd);
+        free(ramf);
         return NULL;
     }
+#ifdef MADV_HUGEPAGE
+    /* Only a hint: it depends on the filesystem the image is on */
+    if (flags & RAMF_HUGEPAGE)
+        madvise(ramf->addr, RAMF_SIZE, MADV_HUGEPAGE);
+#endif
+    ramf->dirty_lo = RAMF_SIZE;
+    ramf_rebase(ramf, 0);
+    ramf_rebase(ramf, 1);
     return ramf;
 }
 
 void ramf_free(struct ramf *ramf)
 {
-    if (ramf->addr)
-        munmap(ramf->addr, 8192 * 1024);
+    if (ramf->addr) {
+        ramf_sync(ramf, 1);
+        munmap(ramf->addr, RAMF_SIZE);
+    }
     if (ramf->fd)
         close(ramf->fd);
     free(ramf);
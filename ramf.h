@@ -2,7 +2,10 @@ struct ramf;
 
 void ramf_write(struct ramf *ramf, uint8_t addr, uint8_t val);
 uint8_t ramf_read(struct ramf *ramf, uint8_t addr);
-struct ramf *ramf_create(const char *path);
+struct ramf *ramf_create(const char *path, unsigned int flags);
+#define RAMF_POPULATE	1	/* Fault the whole image in at startup */
+#define RAMF_HUGEPAGE	2	/* Ask for huge pages if the host can */
+void ramf_sync(struct ramf *ramf, unsigned int wait);
 void ramf_free(struct ramf *ramf);
 void ramf_trace(struct ramf *ramf, unsigned int onoff);
 
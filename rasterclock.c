@@ -0,0 +1,178 @@
+/*
+ *	Frame timing for video boards
+ *
+ *	A frame is a fixed number of scan lines each of a fixed number of
+ *	CPU clocks. We run the CPU a line at a time carrying any overrun
+ *	from the last instruction into the next line so the long term rate
+ *	is exact. The board gets a callback at vertical sync and optionally
+ *	one per line for interrupts and beam effects.
+ *
+ *	Pacing is against an absolute monotonic deadline rather than a
+ *	fixed sleep per frame so the time spent emulating and rendering is
+ *	not added on top of the frame time. If the host falls badly behind
+ *	we resynchronise rather than trying to run a burst to catch up.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "rasterclock.h"
+
+/* How many frames behind we tolerate before giving up on catching up */
+#define MAX_BEHIND	4
+
+struct rasterclock {
+	unsigned line_clocks;
+	unsigned lines;
+	unsigned first_visible;
+	unsigned visible;
+
+	unsigned line;		/* Line currently being run */
+	int slack;		/* Clocks owed (+) or overrun (-) */
+	uint64_t clocks;	/* Clocks run before the current line */
+
+	unsigned (*execute)(void *priv, unsigned clocks);
+	void *cpu_priv;
+	void (*vblank)(void *priv);
+	void *vblank_priv;
+	void (*line_fn)(void *priv, unsigned line);
+	void *line_priv;
+
+	uint64_t frame_ns;
+	uint64_t deadline;	/* Monotonic ns the current frame ends */
+	int fast;
+	int trace;
+};
+
+static uint64_t rasterclock_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void rasterclock_run_frame(struct rasterclock *rc)
+{
+	unsigned l;
+	int want;
+	unsigned ran;
+
+	if (rc->vblank)
+		rc->vblank(rc->vblank_priv);
+
+	for (l = 0; l < rc->lines; l++) {
+		rc->line = l;
+		if (rc->line_fn)
+			rc->line_fn(rc->line_priv, l);
+		want = rc->line_clocks + rc->slack;
+		/* A long instruction may have eaten the whole line */
+		if (want <= 0) {
+			rc->slack = want;
+			continue;
+		}
+		ran = rc->execute(rc->cpu_priv, want);
+		rc->slack = want - (int)ran;
+		rc->clocks += ran;
+	}
+}
+
+void rasterclock_sync(struct rasterclock *rc)
+{
+	struct timespec ts;
+	uint64_t now;
+
+	if (rc->fast)
+		return;
+
+	now = rasterclock_now();
+	if (rc->deadline == 0 || now > rc->deadline + MAX_BEHIND * rc->frame_ns) {
+		if (rc->trace && rc->deadline)
+			fprintf(stderr, "rasterclock: %llu ms behind, resynchronising.\n",
+				(unsigned long long)(now - rc->deadline) / 1000000ULL);
+		rc->deadline = now;
+	}
+	rc->deadline += rc->frame_ns;
+	if (rc->deadline <= now)
+		return;
+
+	ts.tv_sec = rc->deadline / 1000000000ULL;
+	ts.tv_nsec = rc->deadline % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+unsigned rasterclock_line(struct rasterclock *rc)
+{
+	return rc->line;
+}
+
+/* Line within the visible window or -1 if in the border or blanking */
+int rasterclock_display_line(struct rasterclock *rc)
+{
+	if (rc->line < rc->first_visible || rc->line >= rc->first_visible + rc->visible)
+		return -1;
+	return rc->line - rc->first_visible;
+}
+
+uint64_t rasterclock_clocks(struct rasterclock *rc)
+{
+	return rc->clocks;
+}
+
+void rasterclock_cpu(struct rasterclock *rc, unsigned (*execute)(void *priv, unsigned clocks), void *priv)
+{
+	rc->execute = execute;
+	rc->cpu_priv = priv;
+}
+
+void rasterclock_vblank_handler(struct rasterclock *rc, void (*vblank)(void *priv), void *priv)
+{
+	rc->vblank = vblank;
+	rc->vblank_priv = priv;
+}
+
+void rasterclock_line_handler(struct rasterclock *rc, void (*line)(void *priv, unsigned line), void *priv)
+{
+	rc->line_fn = line;
+	rc->line_priv = priv;
+}
+
+void rasterclock_visible(struct rasterclock *rc, unsigned first, unsigned count)
+{
+	rc->first_visible = first;
+	rc->visible = count;
+}
+
+void rasterclock_fast(struct rasterclock *rc, int onoff)
+{
+	rc->fast = onoff;
+	rc->deadline = 0;
+}
+
+void rasterclock_trace(struct rasterclock *rc, int onoff)
+{
+	rc->trace = onoff;
+}
+
+struct rasterclock *rasterclock_create(unsigned long clock, unsigned line_clocks, unsigned lines)
+{
+	struct rasterclock *rc = malloc(sizeof(struct rasterclock));
+	if (rc == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+	memset(rc, 0, sizeof(struct rasterclock));
+	rc->line_clocks = line_clocks;
+	rc->lines = lines;
+	rc->visible = lines;
+	rc->frame_ns = (uint64_t)line_clocks * lines * 1000000000ULL / clock;
+	return rc;
+}
+
+void rasterclock_free(struct rasterclock *rc)
+{
+	free(rc);
+}
@@ -0,0 +1,22 @@
+struct rasterclock;
+
+extern struct rasterclock *rasterclock_create(unsigned long clock, unsigned line_clocks, unsigned lines);
+extern void rasterclock_free(struct rasterclock *rc);
+extern void rasterclock_trace(struct rasterclock *rc, int onoff);
+extern void rasterclock_visible(struct rasterclock *rc, unsigned first, unsigned count);
+extern void rasterclock_fast(struct rasterclock *rc, int onoff);
+
+/* The CPU runner is asked for a number of clocks and returns how many it ran */
+extern void rasterclock_cpu(struct rasterclock *rc, unsigned (*execute)(void *priv, unsigned clocks), void *priv);
+/* Called at the start of each frame (vertical sync) */
+extern void rasterclock_vblank_handler(struct rasterclock *rc, void (*vblank)(void *priv), void *priv);
+/* Called before each scan line is run */
+extern void rasterclock_line_handler(struct rasterclock *rc, void (*line)(void *priv, unsigned line), void *priv);
+
+extern void rasterclock_run_frame(struct rasterclock *rc);
+extern void rasterclock_sync(struct rasterclock *rc);
+
+/* Beam position */
+extern unsigned rasterclock_line(struct rasterclock *rc);
+extern int rasterclock_display_line(struct rasterclock *rc);
+extern uint64_t rasterclock_clocks(struct rasterclock *rc);
@@ -251,9 +251,16 @@ static void exit_cleanup(void)
     tcsetattr(0, TCSADRAIN, &saved_term);
 }
 
+/* Make sure the RAM disk is on the host disk whichever way we leave */
+static void ramf_cleanup(void)
+{
+    ramf_free(ramf);
+    ramf = NULL;
+}
+
 static void usage(void)
 {
-    fprintf(stderr, "rcbv2: [-1] [-f] [-r rompath] [-i idepath] [-t] [-p] [-s sdcardpath] [-d tracemask] [-R]\n");
+    fprintf(stderr, "rcbv2: [-1] [-f] [-r rompath] [-i idepath] [-t] [-p] [-s sdcardpath] [-d tracemask] [-R ramfpath] [-P]\n");
     exit(EXIT_FAILURE);
 }
 
@@ -268,8 +275,10 @@ int main(int argc, char *argv[])
     int i;
     char *ramfpath = NULL;
     unsigned int prop = 0;
+    unsigned int ramf_flags = 0;
+    unsigned int ramf_tick = 0;
 
-    while((opt = getopt(argc, argv, "1r:i:s:ptd:fR:w")) != -1) {
+    while((opt = getopt(argc, argv, "1r:i:s:ptd:fR:Pw")) != -1) {
         switch(opt) {
             case '1':
                 ram_mask = 0x03;	/* 4 x 32K banks only */
@@ -300,6 +309,9 @@ int main(int argc, char *argv[])
             case 'R':
                 ramfpath = optarg;
                 break;
+            case 'P':
+                ramf_flags = RAMF_POPULATE | RAMF_HUGEPAGE;
+                break;
             case 'w':
                 wiznet = 1;
                 break;
@@ -353,8 +365,11 @@ int main(int argc, char *argv[])
         propio_trace(propio, trace & TRACE_PROP);
     }
 
-    if (ramfpath)
-        ramf = ramf_create(ramfpath);
+    if (ramfpath) {
+        ramf = ramf_create(ramfpath, ramf_flags);
+        if (ramf)
+            atexit(ramf_cleanup);
+    }
 
     for (i = 0; i < 5; i++) {
         uart[i] = uart16x50_create();
@@ -382,6 +397,7 @@ int main(int argc, char *argv[])
 	signal(SIGINT, cleanup);
 	signal(SIGQUIT, cleanup);
 	signal(SIGPIPE, cleanup);
+	signal(SIGTERM, cleanup);
 	term.c_lflag &= ~(ICANON|ECHO);
 	term.c_cc[VMIN] = 1;
 	term.c_cc[VTIME] = 0;
@@ -419,6 +435,11 @@ int main(int argc, char *argv[])
             w5100_process(wiz);
         if (uart16x50_irq_pending(uart[0]))
             Z80INT(&cpu_z80, 0xFF);
+        /* Start writing back the RAM disk once a second of emulated time */
+        if (ramf && ++ramf_tick == 10) {
+            ramf_sync(ramf, 0);
+            ramf_tick = 0;
+        }
     }
     exit(0);
 }
@@ -28,12 +28,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
-#include <signal.h>
-#include <termios.h>
 #include <time.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/select.h>
+#include <sys/ioctl.h>
 
 #include "system.h"
 #include "event.h"
@@ -65,16 +64,10 @@
 #include "z80dis.h"
 #include "sasi.h"
 #include "ncr5380.h"
+#include "rc2014.h"
 
-static uint8_t ramrom[2048 * 1024];	/* Covers the banked card and ZRC */
 
-static unsigned int bankreg[4];
-static uint8_t bankenable;
 
-static uint8_t bank512 = 0;
-static uint8_t switchrom = 1;
-static uint32_t romsize = 65536;
-static uint8_t extreme;
 
 #define CPUBOARD_Z80		0		/* Standard setup */
 #define CPUBOARD_SC108		1		/* Like paged but 0x38 bit 7 controls RAM A16 */
@@ -94,72 +87,29 @@ static uint8_t extreme;
 #define CPUBOARD_TP128		15		/* Tadeusz 128K 32K/32K banked memory */
 #define CPUBOARD_EASY512	16		/* 512K EasyZ80 with KIO */
 
-static uint8_t cpuboard = CPUBOARD_Z80;
-
-static uint8_t have_ctc;
-static uint8_t have_pio;
-static uint8_t have_ps2;
-static uint8_t have_kio;
-static uint8_t have_wiznet;
-static uint8_t have_cpld_serial;
-static uint8_t have_im2;
-static uint8_t have_16x50;
-static uint8_t have_copro;
-static uint8_t have_tms;
-static uint8_t have_ef9345;
-static uint8_t have_kio_ext;	/* Extreme config KIO at C0-DF */
-static uint8_t have_busstop;
-
-static uint8_t port30 = 0;
-static uint8_t port38 = 0;
-static uint8_t fast = 0;
-static uint8_t is_z512;
-static uint8_t z512_control = 0;
-static uint8_t ef_latch = 0;
-static uint16_t bs_latch;
-static unsigned rom_mapped = 1;
-
-static struct ppide *ppide;
-static struct sdcard *sdcard;
-static struct z180copro *copro;
-static FDC_PTR fdc;
-static FDRV_PTR drive_a, drive_b;
-static struct tms9918a *vdp;
-static struct tms9918a_renderer *vdprend;
-static struct amd9511 *amd9511;
-static struct ef9345 *ef9345;
-static struct ef9345_renderer *ef9345rend;
-static struct tft_dumb *tft;
-static struct tft_renderer *tftrend;
-static struct uart16x50 *uart;
-static struct z80_sio *sio;
-static struct sasi_bus *sasi;
-static struct ncr5380 *ncr;
-
-static uint8_t ef9345_vram[16384];
-static uint8_t ef9345_rom[8192];
-
-struct ps2 *ps2;
-
-struct zxkey *zxkey;
-
-static uint16_t tstate_steps = 365;	/* RC2014 speed */
+
+
+
+/* I/O base of each co-processor card (8 ports each). The first is the
+   usual 0x08, the rest go in gaps no other emulated card decodes: 0x18
+   above the CF adapter, 0x50 below the NCR5380 and 0x60 below the PIO.
+   Only the first card has the SD card interface wired (-S). */
+static const uint8_t copro_port[MAX_COPRO] = { 0x08, 0x18, 0x50, 0x60 };
+
+
+
+
 
 /* IRQ source that is live in IM2 */
-static uint8_t live_irq;
-static uint8_t intvec;		/* Current vector for IM2 */
 
 #define IRQ_SIO		1
 #define IRQ_CTC		3	/* 3 4 5 6 */
 
-static uint8_t live_nonim2;
 
 #define IRQM_VDP	1
 #define IRQM_ACIA	2
 #define IRQM_16X50	4
 
-static Z80Context cpu_z80;
-static nic_w5100_t *wiz;
 
 volatile int emulator_done;
 
@@ -188,47 +138,244 @@ volatile int emulator_done;
 #define TRACE_PS2	0x200000
 #define TRACE_ACIA	0x400000
 #define TRACE_SCSI	0x800000
+#define TRACE_SVC	0x1000000
+#define TRACE_DMA	0x2000000
+
+
+struct z84c15 {
+	uint8_t scrp;
+	uint8_t wcr;
+	uint8_t mwbr;
+	uint8_t csbr;
+	uint8_t mcr;
+	uint8_t intpr;
+};
+
+struct z80_ctc {
+	uint16_t count;
+	uint16_t reload;
+	uint8_t vector;
+	uint8_t ctrl;
+#define CTC_IRQ		0x80
+#define CTC_COUNTER	0x40
+#define CTC_PRESCALER	0x20
+#define CTC_RISING	0x10
+#define CTC_PULSE	0x08
+#define CTC_TCONST	0x04
+#define CTC_RESET	0x02
+#define CTC_CONTROL	0x01
+	uint8_t irq;		/* Only valid for channel 0, so we know
+				   if we must wait for a RETI before doing
+				   a further interrupt */
+};
+
+#define CTC_STOPPED(c)	(((c)->ctrl & (CTC_TCONST|CTC_RESET)) == (CTC_TCONST|CTC_RESET))
+
+struct z80_pio {
+	uint8_t data[2];
+	uint8_t mask[2];
+	uint8_t mode[2];
+	uint8_t intmask[2];
+	uint8_t icw[2];
+	uint8_t mpend[2];
+	uint8_t irq[2];
+	uint8_t vector[2];
+	uint8_t in[2];
+};
 
-static int trace = 0;
+/*
+ *	Everything that makes up one machine. The core can run any number
+ *	of these (see batchrun.c), and rc is the one the calling thread is
+ *	running now. Each entry point sets it, and the callbacks from the
+ *	CPU and devices, which have no context of their own, rely on it.
+ */
+
+struct rc2014 {
+	uint8_t ramrom[2048 * 1024];	/* Covers the banked card and ZRC */
+
+	unsigned int bankreg[4];
+	uint8_t bankenable;
+
+	uint8_t bank512;
+	uint8_t switchrom;
+	uint32_t romsize;
+	uint8_t extreme;
+
+	uint8_t cpuboard;
+
+	uint8_t have_ctc;
+	uint8_t have_pio;
+	uint8_t have_ps2;
+	uint8_t have_kio;
+	uint8_t have_wiznet;
+	uint8_t have_cpld_serial;
+	uint8_t have_im2;
+	uint8_t have_16x50;
+	uint8_t have_copro;
+	uint8_t have_tms;
+	uint8_t have_ef9345;
+	uint8_t have_kio_ext;	/* Extreme config KIO at C0-DF */
+	uint8_t have_busstop;
+	uint8_t have_dma;
+
+	uint8_t port30;
+	uint8_t port38;
+	uint8_t fast;
+	uint8_t is_z512;
+	uint8_t z512_control;
+	uint8_t ef_latch;
+	uint16_t bs_latch;
+	unsigned rom_mapped;
+
+	struct ppide *ppide;
+	struct sdcard *sdcard;
+	struct z180copro *copro[MAX_COPRO];
+	unsigned ncopro;
+	uint8_t copro_threads;
+	FDC_PTR fdc;
+	FDRV_PTR drive_a, drive_b;
+	struct tms9918a *vdp;
+	struct tms9918a_renderer *vdprend;
+	struct amd9511 *amd9511;
+	struct ef9345 *ef9345;
+	struct ef9345_renderer *ef9345rend;
+	struct tft_dumb *tft;
+	struct tft_renderer *tftrend;
+	struct uart16x50 *uart;
+	struct z80_sio *sio;
+	struct sasi_bus *sasi;
+	struct ncr5380 *ncr;
+	struct z80dma *dma;
+
+	uint8_t ef9345_vram[16384];
+	uint8_t ef9345_rom[8192];
+
+	struct ps2 *ps2;
+	struct zxkey *zxkey;
+
+	uint16_t tstate_steps;
+
+	/* IRQ source that is live in IM2 */
+	uint8_t live_irq;
+	uint8_t intvec;		/* Current vector for IM2 */
+	uint8_t live_nonim2;
+	unsigned last_nim2;
+	uint8_t rstate;		/* Where we are in spotting a RETI */
+
+	Z80Context cpu_z80;
+	nic_w5100_t *wiz;
+
+	int trace;
+	uint32_t lastpc;
+	unsigned int nbytes;
+
+	struct z84c15 z84c15;
+	uint8_t pick_bank;
+	uint32_t ez512_base;
+	unsigned ez512_portc;
+
+	/* Idle detection, see idle_slice_begin */
+	uint8_t idle_detect;
+	unsigned idle_count;
+	uint16_t idle_lo, idle_hi;
+	uint8_t idle_dirty;
+	int idle_port;
+	uint8_t idle_val;
+	int idle_last_port;
+	uint8_t idle_last_val;
+	uint16_t idle_last_lo;
+
+	struct acia *acia;
+	uint8_t acia_narrow;
+
+	int ide;
+	struct ide_controller *ide0;
+	struct rtc *rtc;
+
+	struct z80_ctc ctc[4];
+	uint8_t ctc_irqmask;
+
+	uint8_t sd_clock;	/* Bit masks */
+	uint8_t sd_mosi;
+	uint8_t sd_miso;
+	uint8_t sd_port;	/* Channel for data in */
+	uint8_t spi_old;
+	uint8_t spi_oldcs;
+	uint8_t spi_bits;
+	uint8_t spi_bitct;
+	uint8_t spi_rxbits;
+
+	struct z80_pio pio[1];
+	uint8_t pio_cs;
+
+	uint8_t sbc64_cpld_status;
+	uint8_t sbc64_cpld_char;
+	uint16_t cpld_txbits;
+	uint8_t cpld_txcount;
+
+	uint32_t z512_wdog;
+
+	unsigned prop_curcmd;
+	unsigned prop_cmdcnt;
+	unsigned prop_cmdsize;
+	unsigned propdata[4];
+
+	uint8_t svc_port;		/* 0 = disabled */
+	unsigned svc_cost;		/* T-states per byte moved */
+	uint8_t svc_reg[16];
+	uint8_t svc_index;
+	uint8_t svc_status;
+
+	/* The console and the view of it the UARTs get */
+	struct serial_device *con;
+	struct serial_device idle_console;
+	uint8_t con_unread;
+	uint8_t con_eof;
+	uint64_t deadline;		/* Of the current frame */
+
+	int save_fd;			/* Z80SBC64 RAM image to save on exit */
+};
+
+static _Thread_local struct rc2014 *rc;
 
 static void reti_event(void);
 static void poll_irq_nonim2(void);
 
 static uint8_t mem_read0(uint16_t addr)
 {
-	if (bankenable) {
+	if (rc->bankenable) {
 		unsigned int bank = (addr & 0xC000) >> 14;
-		if (trace & TRACE_MEM)
-			fprintf(stderr, "R %04x[%02X] = %02X\n", addr, (unsigned int) bankreg[bank], (unsigned int) ramrom[(bankreg[bank] << 14) + (addr & 0x3FFF)]);
+		if (rc->trace & TRACE_MEM)
+			fprintf(stderr, "R %04x[%02X] = %02X\n", addr, (unsigned int) rc->bankreg[bank], (unsigned int) rc->ramrom[(rc->bankreg[bank] << 14) + (addr & 0x3FFF)]);
 		addr &= 0x3FFF;
-		return ramrom[(bankreg[bank] << 14) + addr];
+		return rc->ramrom[(rc->bankreg[bank] << 14) + addr];
 	}
-	if (bank512 && !bankenable)
+	if (rc->bank512 && !rc->bankenable)
 		addr &= 0x3FFF;
-	if (trace & TRACE_MEM)
-		fprintf(stderr, "R %04X = %02X\n", addr, ramrom[addr]);
-	return ramrom[addr];
+	if (rc->trace & TRACE_MEM)
+		fprintf(stderr, "R %04X = %02X\n", addr, rc->ramrom[addr]);
+	return rc->ramrom[addr];
 }
 
 static void mem_write0(uint16_t addr, uint8_t val)
 {
-	if (bankenable) {
+	if (rc->bankenable) {
 		unsigned int bank = (addr & 0xC000) >> 14;
-		if (trace & TRACE_MEM)
-			fprintf(stderr, "W %04x[%02X] = %02X\n", (unsigned int) addr, (unsigned int) bankreg[bank], (unsigned int) val);
-		if (bankreg[bank] >= 32) {
+		if (rc->trace & TRACE_MEM)
+			fprintf(stderr, "W %04x[%02X] = %02X\n", (unsigned int) addr, (unsigned int) rc->bankreg[bank], (unsigned int) val);
+		if (rc->bankreg[bank] >= 32) {
 			addr &= 0x3FFF;
-			ramrom[(bankreg[bank] << 14) + addr] = val;
+			rc->ramrom[(rc->bankreg[bank] << 14) + addr] = val;
 		}
 		/* ROM writes go nowhere */
-		else if (trace & TRACE_MEM)
+		else if (rc->trace & TRACE_MEM)
 			fprintf(stderr, "[Discarded: ROM]\n");
 	} else {
-		if (trace & TRACE_MEM)
+		if (rc->trace & TRACE_MEM)
 			fprintf(stderr, "W: %04X = %02X\n", addr, val);
-		if (addr >= 8192 && !bank512)
-			ramrom[addr] = val;
-		else if (trace & TRACE_MEM)
+		if (addr >= 8192 && !rc->bank512)
+			rc->ramrom[addr] = val;
+		else if (rc->trace & TRACE_MEM)
 			fprintf(stderr, "[Discarded: ROM]\n");
 	}
 }
@@ -236,63 +383,63 @@ static void mem_write0(uint16_t addr, uint8_t val)
 static uint8_t mem_read108(uint16_t addr)
 {
 	uint32_t aphys;
-	if (addr < 0x8000 && !(port38 & 0x01))
+	if (addr < 0x8000 && !(rc->port38 & 0x01))
 		aphys = addr;
-	else if (port38 & 0x80)
+	else if (rc->port38 & 0x80)
 		aphys = addr + 131072;
 	else
 		aphys = addr + 65536;
-	if (trace & TRACE_MEM)
-		fprintf(stderr, "R %05X = %02X\n", aphys, ramrom[aphys]);
-	return ramrom[aphys];
+	if (rc->trace & TRACE_MEM)
+		fprintf(stderr, "R %05X = %02X\n", aphys, rc->ramrom[aphys]);
+	return rc->ramrom[aphys];
 }
 
 static void mem_write108(uint16_t addr, uint8_t val)
 {
 	uint32_t aphys;
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "W: %04X = %02X\n", addr, val);
-	if (addr < 0x8000 && !(port38 & 0x01)) {
-		if (trace & TRACE_MEM)
+	if (addr < 0x8000 && !(rc->port38 & 0x01)) {
+		if (rc->trace & TRACE_MEM)
 			fprintf(stderr, "[Discarded: ROM]\n");
 		return;
-	} else if (port38 & 0x80)
+	} else if (rc->port38 & 0x80)
 		aphys = addr + 131072;
 	else
 		aphys = addr + 65536;
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "W: aphys %05X\n", aphys);
-	ramrom[aphys] = val;
+	rc->ramrom[aphys] = val;
 }
 
 static uint8_t mem_read114(uint16_t addr)
 {
 	uint32_t aphys;
-	if (addr < 0x8000 && !(port38 & 0x01))
+	if (addr < 0x8000 && !(rc->port38 & 0x01))
 		aphys = addr;
-	else if (port30 & 0x01)
+	else if (rc->port30 & 0x01)
 		aphys = addr + 131072;
 	else
 		aphys = addr + 65536;
-	if (trace & TRACE_MEM)
-		fprintf(stderr, "R %04X = %02X\n", addr, ramrom[aphys]);
-	return ramrom[aphys];
+	if (rc->trace & TRACE_MEM)
+		fprintf(stderr, "R %04X = %02X\n", addr, rc->ramrom[aphys]);
+	return rc->ramrom[aphys];
 }
 
 static void mem_write114(uint16_t addr, uint8_t val)
 {
 	uint32_t aphys;
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "W: %04X = %02X\n", addr, val);
-	if (addr < 0x8000 && !(port38 & 0x01)) {
-		if (trace & TRACE_MEM)
+	if (addr < 0x8000 && !(rc->port38 & 0x01)) {
+		if (rc->trace & TRACE_MEM)
 			fprintf(stderr, "[Discarded: ROM]\n");
 		return;
-	} else if (port30 & 0x01)
+	} else if (rc->port30 & 0x01)
 		aphys = addr + 131072;
 	else
 		aphys = addr + 65536;
-	ramrom[aphys] = val;
+	rc->ramrom[aphys] = val;
 }
 
 /* I think this right
@@ -308,28 +455,28 @@ static uint8_t mem_read64(uint16_t addr)
 {
 	uint8_t r;
 	if (addr >= 0x8000)
-		r = ramrom[addr];
+		r = rc->ramrom[addr];
 	else
-		r = ramrom[bankreg[0] * 0x8000 + addr];
-	if (trace & TRACE_MEM)
+		r = rc->ramrom[rc->bankreg[0] * 0x8000 + addr];
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "R %04x = %02X\n", addr, r);
 	return r;
 }
 
 static void mem_write64(uint16_t addr, uint8_t val)
 {
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "W %04x = %02X\n", addr, val);
 	if (addr >= 0x8000)	/* Top 32K is common */
-		ramrom[addr] = val;
+		rc->ramrom[addr] = val;
 	else
-		ramrom[bankreg[0] * 0x8000 + addr] = val;
+		rc->ramrom[rc->bankreg[0] * 0x8000 + addr] = val;
 }
 
 /* ZRCC is a close relative of SBC64, but instead of a magic loader has
    a 64byte built in boot rom */
 
-static uint8_t zrcc_irom[64] = {
+static const uint8_t zrcc_irom[64] = {
 	0x3C,
 	0x3C,
 	0x3C,
@@ -429,59 +576,59 @@ static uint8_t zrcc_irom[64] = {
 static uint8_t mem_readzrcc(uint16_t addr)
 {
 	uint8_t r;
-	if (addr < 0x40 && bankreg[1] == 0)
+	if (addr < 0x40 && rc->bankreg[1] == 0)
 		r = zrcc_irom[addr];
 	else if (addr >= 0x8000)
-		r = ramrom[addr + 65536];	/* Top 32K is common */
+		r = rc->ramrom[addr + 65536];	/* Top 32K is common */
 	else
-		r = ramrom[bankreg[0] * 0x8000 + addr];
-	if (trace & TRACE_MEM)
+		r = rc->ramrom[rc->bankreg[0] * 0x8000 + addr];
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "R %04x = %02X\n", addr, r);
 	return r;
 }
 
 static void mem_writezrcc(uint16_t addr, uint8_t val)
 {
-	if (addr <= 0x40 && bankreg[1] == 0) {
-		if (trace & TRACE_MEM)
+	if (addr <= 0x40 && rc->bankreg[1] == 0) {
+		if (rc->trace & TRACE_MEM)
 			fprintf(stderr, "W %04X = %02X [ROM]\n", addr, val);
 		return;
 	}
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "W %04X = %02X\n", addr, val);
 	if (addr >= 0x8000)
-		ramrom[addr + 65536] = val;
+		rc->ramrom[addr + 65536] = val;
 	else
-		ramrom[bankreg[0] * 0x8000 + addr] = val;
+		rc->ramrom[rc->bankreg[0] * 0x8000 + addr] = val;
 }
 
 static uint8_t mem_readzrc(uint16_t addr)
 {
 	uint8_t r;
-	if (addr < 0x40 && rom_mapped)
+	if (addr < 0x40 && rc->rom_mapped)
 		r = zrcc_irom[addr];
 	else if (addr >= 0x8000)
-		r = ramrom[addr | 0x1F8000];	/* Top 32K is common */
+		r = rc->ramrom[addr | 0x1F8000];	/* Top 32K is common */
 	else
-		r = ramrom[bankreg[1] * 0x8000 + addr];
-	if (trace & TRACE_MEM)
+		r = rc->ramrom[rc->bankreg[1] * 0x8000 + addr];
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "R %04x = %02X\n", addr, r);
 	return r;
 }
 
 static void mem_writezrc(uint16_t addr, uint8_t val)
 {
-	if (addr <= 0x40 && rom_mapped) {
-		if (trace & TRACE_MEM)
+	if (addr <= 0x40 && rc->rom_mapped) {
+		if (rc->trace & TRACE_MEM)
 			fprintf(stderr, "W %04X = %02X [ROM]\n", addr, val);
 		return;
 	}
-	if ((trace & TRACE_MEM) || addr == 0xB058)
+	if ((rc->trace & TRACE_MEM) || addr == 0xB058)
 		fprintf(stderr, "W %04X = %02X\n", addr, val);
 	if (addr >= 0x8000)
-		ramrom[addr | 0x1F8000] = val;
+		rc->ramrom[addr | 0x1F8000] = val;
 	else
-		ramrom[bankreg[1] * 0x8000 + addr] = val;
+		rc->ramrom[rc->bankreg[1] * 0x8000 + addr] = val;
 }
 
 static uint8_t mem_read_sc720(uint16_t addr)
@@ -489,10 +636,10 @@ static uint8_t mem_read_sc720(uint16_t addr)
 	uint8_t r;
 	/* Top 32K always */
 	if (addr & 0x8000)
-		r = ramrom[(addr & 0x7FFF) + 0x78000];
+		r = rc->ramrom[(addr & 0x7FFF) + 0x78000];
 	else
-		r = ramrom[(addr & 0x7FFF) + bankreg[0] * 0x8000];
-	if (trace & TRACE_MEM)
+		r = rc->ramrom[(addr & 0x7FFF) + rc->bankreg[0] * 0x8000];
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "R %04x = %02X\n", addr, r);
 	return r;
 }
@@ -501,13 +648,13 @@ static void mem_write_sc720(uint16_t addr, uint8_t val)
 {
 	/* Top 32K always */
 	if (addr & 0x8000)
-		ramrom[(addr & 0x7FFF) + 0x78000] = val;
-	else if (bankreg[0] < 0x10) {
+		rc->ramrom[(addr & 0x7FFF) + 0x78000] = val;
+	else if (rc->bankreg[0] < 0x10) {
 		fprintf(stderr, "W %04X = %02X ***ROM***\n", addr, val);
 		return;
 	} else
-		ramrom[(addr & 0x7FFF) + bankreg[0] * 0x8000] = val;
-	if (trace & TRACE_MEM)
+		rc->ramrom[(addr & 0x7FFF) + rc->bankreg[0] * 0x8000] = val;
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "W %04x = %02X\n", addr, val);
 }
 
@@ -515,34 +662,34 @@ static uint8_t mem_read_sc707(uint16_t addr)
 {
 	uint32_t aphys;
 	/* ROM - can be banked */
-	if (addr < 0x8000 && !(port38 & 0x01)) {
-		aphys = addr + bankreg[0] * 0x8000;
+	if (addr < 0x8000 && !(rc->port38 & 0x01)) {
+		aphys = addr + rc->bankreg[0] * 0x8000;
 	}
-	else if (port38 & 0x01)
+	else if (rc->port38 & 0x01)
 		aphys = addr + 0x30000;
 	else
 		aphys = addr + 0x20000;
-	if (trace & TRACE_MEM)
-		fprintf(stderr, "R %05X = %02X\n", aphys, ramrom[aphys]);
-	return ramrom[aphys];
+	if (rc->trace & TRACE_MEM)
+		fprintf(stderr, "R %05X = %02X\n", aphys, rc->ramrom[aphys]);
+	return rc->ramrom[aphys];
 }
 
 static void mem_write_sc707(uint16_t addr, uint8_t val)
 {
 	uint32_t aphys;
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "W: %04X = %02X\n", addr, val);
-	if (addr < 0x8000 && !(port38 & 0x01)) {
-		if (trace & TRACE_MEM)
+	if (addr < 0x8000 && !(rc->port38 & 0x01)) {
+		if (rc->trace & TRACE_MEM)
 			fprintf(stderr, "[Discarded: ROM]\n");
 		return;
-	} else if (port38 & 0x80)
+	} else if (rc->port38 & 0x80)
 		aphys = addr + 0x30000;
 	else
 		aphys = addr + 0x20000;
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "W: aphys %05X\n", aphys);
-	ramrom[aphys] = val;
+	rc->ramrom[aphys] = val;
 }
 
 /* We use RAMROM in 32K chunks where 0-7FFF are the ROM and
@@ -551,11 +698,11 @@ static uint32_t mmu_tp128(uint16_t addr, unsigned is_wr)
 {
 	if (addr < 0x8000) {
 		/* Bank 0 */
-		if (port38 || is_wr)
+		if (rc->port38 || is_wr)
 			return 0x10000 + addr;
 		return addr;
 	}
-	switch(port38) {
+	switch(rc->port38) {
 	case 0:
 	case 1:	/* Bank 1 18000-1FFFF in our mapping */
 		return 0x10000 + addr;
@@ -571,38 +718,29 @@ static uint32_t mmu_tp128(uint16_t addr, unsigned is_wr)
 static uint8_t mem_read_tp128(uint16_t addr)
 {
 	uint32_t aphys = mmu_tp128(addr, 0);
-	if (trace & TRACE_MEM)
-		fprintf(stderr, "R %05X = %02X\n", aphys, ramrom[aphys]);
-	return ramrom[aphys];
+	if (rc->trace & TRACE_MEM)
+		fprintf(stderr, "R %05X = %02X\n", aphys, rc->ramrom[aphys]);
+	return rc->ramrom[aphys];
 }
 
 static void mem_write_tp128(uint16_t addr, uint8_t val)
 {
 	uint32_t aphys = mmu_tp128(addr, 1);
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "W: %04X = %02X\n", addr, val);
-	ramrom[aphys] = val;
+	rc->ramrom[aphys] = val;
 }
 
-struct z84c15 {
-	uint8_t scrp;
-	uint8_t wcr;
-	uint8_t mwbr;
-	uint8_t csbr;
-	uint8_t mcr;
-	uint8_t intpr;
-};
 
-struct z84c15 z84c15;
 
 static void z84c15_init(void)
 {
-	z84c15.scrp = 0;
-	z84c15.wcr = 0;		/* Really it's 0xFF for 15 instructions then 0 */
-	z84c15.mwbr = 0xF0;
-	z84c15.csbr = 0x0F;
-	z84c15.mcr = 0x01;
-	z84c15.intpr = 0;
+	rc->z84c15.scrp = 0;
+	rc->z84c15.wcr = 0;		/* Really it's 0xFF for 15 instructions then 0 */
+	rc->z84c15.mwbr = 0xF0;
+	rc->z84c15.csbr = 0x0F;
+	rc->z84c15.mcr = 0x01;
+	rc->z84c15.intpr = 0;
 }
 
 /*
@@ -613,18 +751,18 @@ static uint8_t *mmu_micro80_z84c15(uint16_t addr, int write)
 {
 	uint8_t cs0 = 0, cs1 = 0;
 	uint8_t page = addr >> 12;
-	if (page <= (z84c15.csbr & 0x0F))
+	if (page <= (rc->z84c15.csbr & 0x0F))
 		cs0 = 1;
-	else if (page <= (z84c15.csbr >> 4))
+	else if (page <= (rc->z84c15.csbr >> 4))
 		cs1 = 1;
-	if (!(z84c15.mcr & 0x01))
+	if (!(rc->z84c15.mcr & 0x01))
 		cs0 = 0;
-	if (!(z84c15.mcr & 0x02))
+	if (!(rc->z84c15.mcr & 0x02))
 		cs1 = 0;
 	/* Depending upon final flash wiring. PIO might control
 	   this and it might be 32K */
 	/* CS0 low selects ROM always */
-	if (trace & TRACE_MEM) {
+	if (rc->trace & TRACE_MEM) {
 		if (cs0)
 			fprintf(stderr, "R");
 		if (cs1)
@@ -636,18 +774,18 @@ static uint8_t *mmu_micro80_z84c15(uint16_t addr, int write)
 		if (write)
 			return NULL;
 		else
-			return &ramrom[(addr & 0x3FFF)];
+			return &rc->ramrom[(addr & 0x3FFF)];
 	}
 	/* CS1 low forces A16 low */
 	if (cs1)
-		return &ramrom[0x20000 + addr];
-	return &ramrom[0x30000 + addr];
+		return &rc->ramrom[0x20000 + addr];
+	return &rc->ramrom[0x30000 + addr];
 }
 
 static uint8_t mem_read_micro80(uint16_t addr)
 {
 	uint8_t val = *mmu_micro80_z84c15(addr, 0);
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "R %04x = %02X\n", addr, val);
 	return val;
 }
@@ -655,7 +793,7 @@ static uint8_t mem_read_micro80(uint16_t addr)
 static void mem_write_micro80(uint16_t addr, uint8_t val)
 {
 	uint8_t *p = mmu_micro80_z84c15(addr, 1);
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "W %04x = %02X\n", addr, val);
 	if (p == NULL)
 		fprintf(stderr, "%04x: write to ROM of %02X attempted.\n", addr, val);
@@ -677,26 +815,25 @@ static void mem_write_micro80(uint16_t addr, uint8_t val)
  *
  */
 
-static uint8_t pick_bank;
 
 static uint8_t *mmu_pickled128(uint16_t addr, uint8_t wr)
 {
-	uint8_t b = pick_bank;
+	uint8_t b = rc->pick_bank;
 	if (addr & 0x8000) {
 		b >>= 4;
 		addr &= 0x7FFF;
 	}
 	if (b & 0x08)
-		return &ramrom[addr + 131072 + ((pick_bank & 7) << 15)];
+		return &rc->ramrom[addr + 131072 + ((rc->pick_bank & 7) << 15)];
 	if (wr)
 		return NULL;
-	return &ramrom[addr + (pick_bank << 15)];
+	return &rc->ramrom[addr + (rc->pick_bank << 15)];
 }
 
 static uint8_t mem_read_pickled128(uint16_t addr)
 {
 	uint8_t *p = mmu_pickled128(addr, 0);
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "R %04X = %02X\n", addr, *p);
 	return *p;
 }
@@ -708,7 +845,7 @@ static void mem_write_pickled128(uint16_t addr, uint8_t val)
 		fprintf(stderr, "%04X: write to ROM of %02X attempted.\n", addr, val);
 		return;
 	}
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "%04X = %02X\n", addr, val);
 	*p = val;
 }
@@ -717,18 +854,18 @@ static uint8_t *mmu_pickled512(uint16_t addr, uint8_t wr)
 {
 	/* Top 32K of RAM bank */
 	if (addr & 0x8000)
-		return &ramrom[addr + 0x100000 - 0x8000];
-	if (pick_bank & 0x80)
-		return &ramrom[addr + 524288 + (pick_bank << 15)];
+		return &rc->ramrom[addr + 0x100000 - 0x8000];
+	if (rc->pick_bank & 0x80)
+		return &rc->ramrom[addr + 524288 + (rc->pick_bank << 15)];
 	if (wr)
 		return NULL;
-	return &ramrom[addr + (pick_bank << 15)];
+	return &rc->ramrom[addr + (rc->pick_bank << 15)];
 }
 
 static uint8_t mem_read_pickled512(uint16_t addr)
 {
 	uint8_t *p = mmu_pickled512(addr, 0);
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "R %04X = %02X\n", addr, *p);
 	return *p;
 }
@@ -740,49 +877,47 @@ static void mem_write_pickled512(uint16_t addr, uint8_t val)
 		fprintf(stderr, "%04X: write to ROM of %02X attempted.\n", addr, val);
 		return;
 	}
-	if (trace & TRACE_MEM)
+	if (rc->trace & TRACE_MEM)
 		fprintf(stderr, "%04X = %02X\n", addr, val);
 	*p = val;
 }
 
 static uint8_t mem_read_micro80w(uint16_t addr)
 {
-	if (bankenable) {
+	if (rc->bankenable) {
 		unsigned int bank = (addr & 0xC000) >> 14;
-		if (trace & TRACE_MEM)
-			fprintf(stderr, "R %04x[%02X] = %02X\n", addr, (unsigned int) bankreg[bank], (unsigned int) ramrom[(bankreg[bank] << 14) + (addr & 0x3FFF)]);
+		if (rc->trace & TRACE_MEM)
+			fprintf(stderr, "R %04x[%02X] = %02X\n", addr, (unsigned int) rc->bankreg[bank], (unsigned int) rc->ramrom[(rc->bankreg[bank] << 14) + (addr & 0x3FFF)]);
 		addr &= 0x3FFF;
-		return ramrom[(bankreg[bank] << 14) + addr];
+		return rc->ramrom[(rc->bankreg[bank] << 14) + addr];
 	}
 	addr &= 0x3FFF;
-	if (trace & TRACE_MEM)
-		fprintf(stderr, "R %04X = %02X\n", addr, ramrom[addr]);
-	return ramrom[addr];
+	if (rc->trace & TRACE_MEM)
+		fprintf(stderr, "R %04X = %02X\n", addr, rc->ramrom[addr]);
+	return rc->ramrom[addr];
 }
 
 static void mem_write_micro80w(uint16_t addr, uint8_t val)
 {
-	if (bankenable) {
+	if (rc->bankenable) {
 		unsigned int bank = (addr & 0xC000) >> 14;
-		if (trace & TRACE_MEM)
-			fprintf(stderr, "W %04x[%02X] = %02X\n", (unsigned int) addr, (unsigned int) bankreg[bank], (unsigned int) val);
-		if (bankreg[bank] >= 32) {
+		if (rc->trace & TRACE_MEM)
+			fprintf(stderr, "W %04x[%02X] = %02X\n", (unsigned int) addr, (unsigned int) rc->bankreg[bank], (unsigned int) val);
+		if (rc->bankreg[bank] >= 32) {
 			addr &= 0x3FFF;
-			ramrom[(bankreg[bank] << 14) + addr] = val;
+			rc->ramrom[(rc->bankreg[bank] << 14) + addr] = val;
 		}
 		/* ROM writes go nowhere */
-		else if (trace & TRACE_MEM)
+		else if (rc->trace & TRACE_MEM)
 			fprintf(stderr, "[Discarded: ROM]\n");
 	} else {
-		if (trace & TRACE_MEM) {
+		if (rc->trace & TRACE_MEM) {
 			fprintf(stderr, "W: %04X = %02X\n", addr, val);
 			fprintf(stderr, "[Discarded: ROM]\n");
 		}
 	}
 }
 
-static uint32_t ez512_base;
-static unsigned ez512_portc;
 
 static uint32_t ez512_xlat(uint16_t addr)
 {
@@ -790,17 +925,17 @@ static uint32_t ez512_xlat(uint16_t addr)
 	if (addr >= 0x8000)
 		raddr = addr | 0x78000;
 	else
-		raddr =  addr | ez512_base;
+		raddr =  addr | rc->ez512_base;
 	return raddr + 0x10000;	/* low 64K of ramrom is the ROM */
 }
 
 static uint8_t mem_read_ez512(uint16_t addr)
 {
 	uint32_t paddr = ez512_xlat(addr);
-	if ((ez512_portc & 0x20) == 0)
-		return ramrom[paddr];
-	if ((ez512_portc & 0x80) == 0)
-		return ramrom[addr & 0xFFFF];
+	if ((rc->ez512_portc & 0x20) == 0)
+		return rc->ramrom[paddr];
+	if ((rc->ez512_portc & 0x80) == 0)
+		return rc->ramrom[addr & 0xFFFF];
 	/* Warn on 0xA0 == 0 clash error ? */
 	return 0xFF;
 }
@@ -808,14 +943,67 @@ static uint8_t mem_read_ez512(uint16_t addr)
 static void mem_write_ez512(uint16_t addr, uint8_t val)
 {
 	uint32_t paddr = ez512_xlat(addr);
-	ramrom[paddr] = val;
+	rc->ramrom[paddr] = val;
+}
+
+/*
+ *	Idle detection
+ *
+ *	A guest spinning on a UART status register looks like a slice in which
+ *	the PC stays in a few bytes, nothing is written and every I/O read is
+ *	the same port returning the same value. When we see that for a couple
+ *	of slices in a row (and -L was given) we stop running the CPU until the
+ *	devices have been polled again. This is not cycle exact so it is opt in.
+ */
+
+
+#define IDLE_SPAN	16	/* Largest loop we consider */
+#define IDLE_SLICES	2	/* Matching slices before we call it idle */
+
+static void idle_slice_begin(void)
+{
+	rc->idle_lo = 0xFFFF;
+	rc->idle_hi = 0;
+	rc->idle_dirty = 0;
+	rc->idle_port = -1;
+}
+
+static void idle_slice_end(void)
+{
+	if (rc->idle_dirty || rc->idle_port < 0 || rc->idle_hi - rc->idle_lo >= IDLE_SPAN ||
+	    rc->idle_port != rc->idle_last_port || rc->idle_val != rc->idle_last_val ||
+	    rc->idle_lo != rc->idle_last_lo)
+		rc->idle_count = 0;
+	else
+		rc->idle_count++;
+	rc->idle_last_port = rc->idle_dirty ? -1 : rc->idle_port;
+	rc->idle_last_val = rc->idle_val;
+	rc->idle_last_lo = rc->idle_lo;
+}
+
+static void idle_track_pc(uint16_t pc)
+{
+	if (pc < rc->idle_lo)
+		rc->idle_lo = pc;
+	if (pc > rc->idle_hi)
+		rc->idle_hi = pc;
+}
+
+static uint8_t idle_track_io(uint16_t addr, uint8_t val)
+{
+	if (rc->idle_port == -1) {
+		rc->idle_port = addr & 0xFF;
+		rc->idle_val = val;
+	} else if (rc->idle_port != (addr & 0xFF) || rc->idle_val != val)
+		rc->idle_dirty = 1;
+	return val;
 }
 
 uint8_t do_mem_read(uint16_t addr, int quiet)
 {
 	uint8_t r;
 
-	switch (cpuboard) {
+	switch (rc->cpuboard) {
 	case CPUBOARD_Z80:
 		r = mem_read0(addr);
 		break;
@@ -874,31 +1062,31 @@ uint8_t do_mem_read(uint16_t addr, int quiet)
 
 uint8_t mem_read(int unused, uint16_t addr)
 {
-	static uint8_t rstate = 0;
 	uint8_t r = do_mem_read(addr, 0);
 
-	if (cpu_z80.M1) {
+	if (rc->cpu_z80.M1) {
 		/* DD FD CB see the Z80 interrupt manual */
 		if (r == 0xDD || r == 0xFD || r == 0xCB) {
-			rstate = 2;
+			rc->rstate = 2;
 			return r;
 		}
 		/* Look for ED with M1, followed directly by 4D and if so trigger
 		   the interrupt chain */
-		if (r == 0xED && rstate == 0) {
-			rstate = 1;
+		if (r == 0xED && rc->rstate == 0) {
+			rc->rstate = 1;
 			return r;
 		}
 	}
-	if (r == 0x4D && rstate == 1)
+	if (r == 0x4D && rc->rstate == 1)
 		reti_event();
-	rstate = 0;
+	rc->rstate = 0;
 	return r;
 }
 
 void mem_write(int unused, uint16_t addr, uint8_t val)
 {
-	switch (cpuboard) {
+	rc->idle_dirty = 1;
+	switch (rc->cpuboard) {
 	case CPUBOARD_Z80:
 		mem_write0(addr, val);
 		break;
@@ -954,13 +1142,72 @@ void mem_write(int unused, uint16_t addr, uint8_t val)
 	}
 }
 
-static unsigned int nbytes;
+/*
+ *	Direct mapping for the Z80 block instruction fast path. We only
+ *	describe the simple boards and return NULL for anything with side
+ *	effects or when memory tracing is wanted.
+ */
+static uint8_t *mem_map(int unused, uint16_t addr, int wr)
+{
+	uint32_t aphys;
+
+	/* Stores through the pointer bypass mem_write so count them here */
+	if (wr)
+		rc->idle_dirty = 1;
+	if (rc->trace & TRACE_MEM)
+		return NULL;
+	switch (rc->cpuboard) {
+	case CPUBOARD_Z80:
+	case CPUBOARD_EASYZ80:
+	case CPUBOARD_TINYZ80:
+		if (rc->bankenable) {
+			unsigned int bank = rc->bankreg[(addr & 0xC000) >> 14];
+			if (wr && bank < 32)
+				return NULL;
+			return &rc->ramrom[(bank << 14) + (addr & 0x3FFF)];
+		}
+		if (rc->bank512)
+			return wr ? NULL : &rc->ramrom[addr & 0x3FFF];
+		if (wr && addr < 8192)
+			return NULL;
+		return &rc->ramrom[addr];
+	case CPUBOARD_SC108:
+	case CPUBOARD_SC114:
+	case CPUBOARD_SC121:
+		if (addr < 0x8000 && !(rc->port38 & 0x01)) {
+			if (wr)
+				return NULL;
+			return &rc->ramrom[addr];
+		}
+		if (rc->cpuboard == CPUBOARD_SC108)
+			aphys = (rc->port38 & 0x80) ? 131072 : 65536;
+		else
+			aphys = (rc->port30 & 0x01) ? 131072 : 65536;
+		return &rc->ramrom[addr + aphys];
+	case CPUBOARD_Z80SBC64:
+		if (addr >= 0x8000)
+			return &rc->ramrom[addr];
+		return &rc->ramrom[rc->bankreg[0] * 0x8000 + addr];
+	case CPUBOARD_PDOG128:
+		return mmu_pickled128(addr, wr);
+	case CPUBOARD_PDOG512:
+		return mmu_pickled512(addr, wr);
+	case CPUBOARD_EASY512:
+		if (wr || (rc->ez512_portc & 0x20) == 0)
+			return &rc->ramrom[ez512_xlat(addr)];
+		if ((rc->ez512_portc & 0x80) == 0)
+			return &rc->ramrom[addr];
+		return NULL;
+	}
+	return NULL;
+}
+
 
 uint8_t z80dis_byte(uint16_t addr)
 {
 	uint8_t r = do_mem_read(addr, 1);
 	fprintf(stderr, "%02X ", r);
-	nbytes++;
+	rc->nbytes++;
 	return r;
 }
 
@@ -971,71 +1218,43 @@ uint8_t z80dis_byte_quiet(uint16_t addr)
 
 static void z80_trace(unsigned unused)
 {
-	static uint32_t lastpc = -1;
 	char buf[256];
 
-	if ((trace & TRACE_CPU) == 0)
+	if (rc->idle_detect)
+		idle_track_pc(rc->cpu_z80.M1PC);
+	if ((rc->trace & TRACE_CPU) == 0)
 		return;
-	nbytes = 0;
+	rc->nbytes = 0;
 	/* Spot XXXR repeating instructions and squash the trace */
-	if (cpu_z80.M1PC == lastpc && z80dis_byte_quiet(lastpc) == 0xED &&
-		(z80dis_byte_quiet(lastpc + 1) & 0xF4) == 0xB0) {
+	if (rc->cpu_z80.M1PC == rc->lastpc && z80dis_byte_quiet(rc->lastpc) == 0xED &&
+		(z80dis_byte_quiet(rc->lastpc + 1) & 0xF4) == 0xB0) {
 		return;
 	}
-	lastpc = cpu_z80.M1PC;
-	fprintf(stderr, "%04X: ", lastpc);
-	z80_disasm(buf, lastpc);
-	while(nbytes++ < 6)
+	rc->lastpc = rc->cpu_z80.M1PC;
+	fprintf(stderr, "%04X: ", rc->lastpc);
+	z80_disasm(buf, rc->lastpc);
+	while(rc->nbytes++ < 6)
 		fprintf(stderr, "   ");
 	fprintf(stderr, "%-16s ", buf);
 	fprintf(stderr, "[ %02X:%02X %04X %04X %04X %04X %04X %04X ]\n",
-		cpu_z80.R1.br.A, cpu_z80.R1.br.F,
-		cpu_z80.R1.wr.BC, cpu_z80.R1.wr.DE, cpu_z80.R1.wr.HL,
-		cpu_z80.R1.wr.IX, cpu_z80.R1.wr.IY, cpu_z80.R1.wr.SP);
+		rc->cpu_z80.R1.br.A, rc->cpu_z80.R1.br.F,
+		rc->cpu_z80.R1.wr.BC, rc->cpu_z80.R1.wr.DE, rc->cpu_z80.R1.wr.HL,
+		rc->cpu_z80.R1.wr.IX, rc->cpu_z80.R1.wr.IY, rc->cpu_z80.R1.wr.SP);
 }
 
 
 
+/* The CPLD serial has no device model and talks to the console directly */
 unsigned int check_chario(void)
 {
-	fd_set i, o;
-	struct timeval tv;
-	unsigned int r = 0;
-
-	FD_ZERO(&i);
-	FD_SET(0, &i);
-	FD_ZERO(&o);
-	FD_SET(1, &o);
-	tv.tv_sec = 0;
-	tv.tv_usec = 0;
-
-	if (select(2, &i, &o, NULL, &tv) == -1) {
-		if (errno == EINTR)
-			return 0;
-		perror("select");
-		exit(1);
-	}
-	if (FD_ISSET(0, &i))
-		r |= 1;
-	if (FD_ISSET(1, &o))
-		r |= 2;
-	return r;
+	return rc->con->ready(rc->con);
 }
 
 unsigned int next_char(void)
 {
-	char c;
-	if (read(0, &c, 1) != 1) {
-		printf("(tty read without ready byte)\n");
-		return 0xFF;
-	}
-	if (c == 0x0A)
-		c = '\r';
-	return c;
+	return rc->con->get(rc->con);
 }
 
-struct acia *acia;
-static uint8_t acia_narrow;
 
 /* Nothing to do */
 void uart16x50_signal_change(struct uart16x50 *uart, uint8_t mcr)
@@ -1043,52 +1262,29 @@ void uart16x50_signal_change(struct uart16x50 *uart, uint8_t mcr)
 }
 
 
-static int ide = 0;
-struct ide_controller *ide0;
 
 static uint8_t my_ide_read(uint16_t addr)
 {
-	uint8_t r =  ide_read8(ide0, addr);
-	if (trace & TRACE_IDE)
+	uint8_t r =  ide_read8(rc->ide0, addr);
+	if (rc->trace & TRACE_IDE)
 		fprintf(stderr, "ide read %d = %02X\n", addr, r);
 	return r;
 }
 
 static void my_ide_write(uint16_t addr, uint8_t val)
 {
-	if (trace & TRACE_IDE)
+	if (rc->trace & TRACE_IDE)
 		fprintf(stderr, "ide write %d = %02X\n", addr, val);
-	ide_write8(ide0, addr, val);
+	ide_write8(rc->ide0, addr, val);
 }
 
-struct rtc *rtc;
 
 /*
  *	Z80 CTC
  */
 
-struct z80_ctc {
-	uint16_t count;
-	uint16_t reload;
-	uint8_t vector;
-	uint8_t ctrl;
-#define CTC_IRQ		0x80
-#define CTC_COUNTER	0x40
-#define CTC_PRESCALER	0x20
-#define CTC_RISING	0x10
-#define CTC_PULSE	0x08
-#define CTC_TCONST	0x04
-#define CTC_RESET	0x02
-#define CTC_CONTROL	0x01
-	uint8_t irq;		/* Only valid for channel 0, so we know
-				   if we must wait for a RETI before doing
-				   a further interrupt */
-};
 
-#define CTC_STOPPED(c)	(((c)->ctrl & (CTC_TCONST|CTC_RESET)) == (CTC_TCONST|CTC_RESET))
 
-struct z80_ctc ctc[4];
-uint8_t ctc_irqmask;
 
 static void ctc_reset(struct z80_ctc *c)
 {
@@ -1098,19 +1294,19 @@ static void ctc_reset(struct z80_ctc *c)
 
 static void ctc_init(void)
 {
-	ctc_reset(ctc);
-	ctc_reset(ctc + 1);
-	ctc_reset(ctc + 2);
-	ctc_reset(ctc + 3);
+	ctc_reset(rc->ctc);
+	ctc_reset(rc->ctc + 1);
+	ctc_reset(rc->ctc + 2);
+	ctc_reset(rc->ctc + 3);
 }
 
 static void ctc_interrupt(struct z80_ctc *c)
 {
-	int i = c - ctc;
+	int i = c - rc->ctc;
 	if (c->ctrl & CTC_IRQ) {
-		if (!(ctc_irqmask & (1 << i))) {
-			ctc_irqmask |= 1 << i;
-			if (trace & TRACE_CTC)
+		if (!(rc->ctc_irqmask & (1 << i))) {
+			rc->ctc_irqmask |= 1 << i;
+			if (rc->trace & TRACE_CTC)
 				fprintf(stderr, "CTC %d wants to interrupt.\n", i);
 		}
 	}
@@ -1118,9 +1314,9 @@ static void ctc_interrupt(struct z80_ctc *c)
 
 static void ctc_reti(int ctcnum)
 {
-	if (ctc_irqmask & (1 << ctcnum)) {
-		ctc_irqmask &= ~(1 << ctcnum);
-		if (trace & TRACE_IRQ)
+	if (rc->ctc_irqmask & (1 << ctcnum)) {
+		rc->ctc_irqmask &= ~(1 << ctcnum);
+		if (rc->trace & TRACE_IRQ)
 			fprintf(stderr, "Acked interrupt from CTC %d.\n", ctcnum);
 	}
 }
@@ -1130,16 +1326,16 @@ static void ctc_reti(int ctcnum)
 
 static int ctc_check_im2(void)
 {
-	if (ctc_irqmask) {
+	if (rc->ctc_irqmask) {
 		int i;
 		for (i = 0; i < 4; i++) {	/* FIXME: correct order ? */
-			if (ctc_irqmask & (1 << i)) {
-				uint8_t vector = ctc[0].vector & 0xF8;
+			if (rc->ctc_irqmask & (1 << i)) {
+				uint8_t vector = rc->ctc[0].vector & 0xF8;
 				vector += 2 * i;
-				if (trace & TRACE_IRQ)
+				if (rc->trace & TRACE_IRQ)
 					fprintf(stderr, "New live interrupt is from CTC %d vector %x.\n", i, vector);
-				live_irq = IRQ_CTC + i;
-				intvec = vector;
+				rc->live_irq = IRQ_CTC + i;
+				rc->intvec = vector;
 				return 1;
 			}
 		}
@@ -1152,7 +1348,7 @@ static void ctc_receive_pulse(int i);
 
 static void ctc_pulse(int i)
 {
-	if (cpuboard != CPUBOARD_SC121) {
+	if (rc->cpuboard != CPUBOARD_SC121) {
 		/* Model CTC 2 chained into CTC 3 */
 		if (i == 2)
 			ctc_receive_pulse(3);
@@ -1163,7 +1359,7 @@ static void ctc_pulse(int i)
 /* We don't worry about edge directions just a logical pulse model */
 static void ctc_receive_pulse(int i)
 {
-	struct z80_ctc *c = ctc + i;
+	struct z80_ctc *c = rc->ctc + i;
 	if (c->ctrl & CTC_COUNTER) {
 		if (CTC_STOPPED(c))
 			return;
@@ -1183,7 +1379,7 @@ static void ctc_receive_pulse(int i)
 /* Model counters */
 static void ctc_tick(unsigned int clocks)
 {
-	struct z80_ctc *c = ctc;
+	struct z80_ctc *c = rc->ctc;
 	int i;
 	int n;
 	int decby;
@@ -1217,40 +1413,40 @@ static void ctc_tick(unsigned int clocks)
 
 static void ctc_write(uint8_t channel, uint8_t val)
 {
-	struct z80_ctc *c = ctc + channel;
+	struct z80_ctc *c = rc->ctc + channel;
 	if (c->ctrl & CTC_TCONST) {
-		if (trace & TRACE_CTC)
+		if (rc->trace & TRACE_CTC)
 			fprintf(stderr, "CTC %d constant loaded with %02X\n", channel, val);
 		c->reload = val;
 		if ((c->ctrl & (CTC_TCONST|CTC_RESET)) == (CTC_TCONST|CTC_RESET)) {
 			c->count = (c->reload - 1) << 8;
-			if (trace & TRACE_CTC)
+			if (rc->trace & TRACE_CTC)
 				fprintf(stderr, "CTC %d constant reloaded with %02X\n", channel, val);
 		}
 		c->ctrl &= ~CTC_TCONST|CTC_RESET;
 	} else if (val & CTC_CONTROL) {
 		/* We don't yet model the weirdness around edge wanted
 		   toggling and clock starts */
-		if (trace & TRACE_CTC)
+		if (rc->trace & TRACE_CTC)
 			fprintf(stderr, "CTC %d control loaded with %02X\n", channel, val);
 		c->ctrl = val;
 		if ((c->ctrl & (CTC_TCONST|CTC_RESET)) == CTC_RESET) {
 			c->count = (c->reload - 1) << 8;
-			if (trace & TRACE_CTC)
+			if (rc->trace & TRACE_CTC)
 				fprintf(stderr, "CTC %d constant reloaded with %02X\n", channel, val);
 		}
 		/* Undocumented */
-		if (!(c->ctrl & CTC_IRQ) && (ctc_irqmask & (1 << channel))) {
-			ctc_irqmask &= ~(1 << channel);
-			if (ctc_irqmask == 0) {
-				if (trace & TRACE_IRQ)
+		if (!(c->ctrl & CTC_IRQ) && (rc->ctc_irqmask & (1 << channel))) {
+			rc->ctc_irqmask &= ~(1 << channel);
+			if (rc->ctc_irqmask == 0) {
+				if (rc->trace & TRACE_IRQ)
 					fprintf(stderr, "CTC %d irq reset.\n", channel);
-				if (live_irq == IRQ_CTC + channel)
-					live_irq = 0;
+				if (rc->live_irq == IRQ_CTC + channel)
+					rc->live_irq = 0;
 			}
 		}
 	} else {
-		if (trace & TRACE_CTC)
+		if (rc->trace & TRACE_CTC)
 			fprintf(stderr, "CTC %d vector loaded with %02X\n", channel, val);
 		/* Only works on channel 0 */
 		if (channel == 0)
@@ -1260,40 +1456,23 @@ static void ctc_write(uint8_t channel, uint8_t val)
 
 static uint8_t ctc_read(uint8_t channel)
 {
-	uint8_t val = ctc[channel].count >> 8;
-	if (trace & TRACE_CTC)
+	uint8_t val = rc->ctc[channel].count >> 8;
+	if (rc->trace & TRACE_CTC)
 		fprintf(stderr, "CTC %d reads %02x\n", channel, val);
 	return val;
 }
 
-static uint8_t sd_clock = 0x10;	/* Bit masks */
-static uint8_t sd_mosi = 0x01;
-static uint8_t sd_miso = 0x80;
 
-static uint8_t sd_port = 1;	/* Channel for data in */
 
-struct z80_pio {
-	uint8_t data[2];
-	uint8_t mask[2];
-	uint8_t mode[2];
-	uint8_t intmask[2];
-	uint8_t icw[2];
-	uint8_t mpend[2];
-	uint8_t irq[2];
-	uint8_t vector[2];
-	uint8_t in[2];
-};
 
-static struct z80_pio pio[1];
 
-static uint8_t pio_cs;
 
 /* Software SPI test: one device for now */
 
 static uint8_t spi_byte_sent(uint8_t val)
 {
-	uint8_t r = sd_spi_in(sdcard, val);
-	if (trace & TRACE_SPI)
+	uint8_t r = sd_spi_in(rc->sdcard, val);
+	if (rc->trace & TRACE_SPI)
 		fprintf(stderr,	"[SPI %02X:%02X]\n", val, r);
 	return r;
 }
@@ -1301,48 +1480,43 @@ static uint8_t spi_byte_sent(uint8_t val)
 /* Bit 2: CLK, 1: MOSI, 0: MISO */
 static void bitbang_spi(uint8_t val)
 {
-	static uint8_t old = 0xFF;
-	static uint8_t oldcs = 1;
-	static uint8_t bits;
-	static uint8_t bitct;
-	static uint8_t rxbits = 0xFF;
-	uint8_t delta = old ^ val;
+	uint8_t delta = rc->spi_old ^ val;
 
-	old = val;
+	rc->spi_old = val;
 
-	if (!sdcard)
+	if (!rc->sdcard)
 		return;
 
-	if ((pio_cs & 0x03) == 0x01) {		/* CS high - deselected */
-		if (!oldcs) {
-			if (trace & TRACE_SPI)
+	if ((rc->pio_cs & 0x03) == 0x01) {		/* CS high - deselected */
+		if (!rc->spi_oldcs) {
+			if (rc->trace & TRACE_SPI)
 				fprintf(stderr,	"[Raised \\CS]\n");
-			bits = 0;
-			oldcs = 1;
-			sd_spi_raise_cs(sdcard);
+			rc->spi_bits = 0;
+			rc->spi_oldcs = 1;
+			sd_spi_raise_cs(rc->sdcard);
 		}
-	} else if (oldcs) {
-		if (trace & TRACE_SPI)
+	} else if (rc->spi_oldcs) {
+		if (rc->trace & TRACE_SPI)
 			fprintf(stderr, "[Lowered \\CS]\n");
-		oldcs = 0;
-		sd_spi_lower_cs(sdcard);
+		rc->spi_oldcs = 0;
+		sd_spi_lower_cs(rc->sdcard);
 	}
 	/* Capture clock edge */
-	if (delta & sd_clock) {		/* Clock edge */
-		if (val & sd_clock) {	/* Rising - capture in SPI0 */
-			bits <<= 1;
-			bits |= (val & sd_mosi) ? 1 : 0;
-			bitct++;
-			if (bitct == 8) {
-				rxbits = spi_byte_sent(bits);
-				bitct = 0;
+	if (delta & rc->sd_clock) {		/* Clock edge */
+		if (val & rc->sd_clock) {	/* Rising - capture in SPI0 */
+			rc->spi_bits <<= 1;
+			rc->spi_bits |= (val & rc->sd_mosi) ? 1 : 0;
+			rc->spi_bitct++;
+			if (rc->spi_bitct == 8) {
+				rc->spi_rxbits = spi_byte_sent(rc->spi_bits);
+				rc->spi_bitct = 0;
 			}
 		} else {
 			/* Falling edge */
-			pio->in[sd_port] &= ~sd_miso;
-			pio->in[sd_port] |= (rxbits & 0x80) ? sd_miso : 0x00;
-			rxbits <<= 1;
-			rxbits |= 0x01;
+			rc->pio->in[rc->sd_port] &= ~rc->sd_miso;
+			rc->pio->in[rc->sd_port] |= (rc->spi_rxbits & 0x80) ? rc->sd_miso : 0x00;
+			rc->spi_rxbits <<= 1;
+			rc->spi_rxbits |= 0x01;
 		}
 	}
 }
@@ -1351,14 +1525,14 @@ static void bitbang_spi(uint8_t val)
 
 void pio_data_write(struct z80_pio *pio, uint8_t port, uint8_t val)
 {
-	if (cpuboard == CPUBOARD_MICRO80 || cpuboard == CPUBOARD_MICRO80W) {
+	if (rc->cpuboard == CPUBOARD_MICRO80 || rc->cpuboard == CPUBOARD_MICRO80W) {
 		if (port == 0)
 			bitbang_spi(val);
 		else if (port == 1)
-			pio_cs = val & 7;
+			rc->pio_cs = val & 7;
 	} else {
 		if (port == 1) {
-			pio_cs = (val & 0x08) >> 3;
+			rc->pio_cs = (val & 0x08) >> 3;
 			bitbang_spi(val);
 		}
 	}
@@ -1389,48 +1563,48 @@ static void pio_write(uint8_t addr, uint8_t val)
 	uint8_t pio_ctrl = addr & 1;
 
 	if (pio_ctrl) {
-		if (pio->icw[pio_port] & 1) {
-			pio->intmask[pio_port] = val;
-			pio->icw[pio_port] &= ~1;
+		if (rc->pio->icw[pio_port] & 1) {
+			rc->pio->intmask[pio_port] = val;
+			rc->pio->icw[pio_port] &= ~1;
 			pio_recalc();
 			return;
 		}
-		if (pio->mpend[pio_port]) {
-			pio->mask[pio_port] = val;
+		if (rc->pio->mpend[pio_port]) {
+			rc->pio->mask[pio_port] = val;
 			pio_recalc();
-			pio->mpend[pio_port] = 0;
+			rc->pio->mpend[pio_port] = 0;
 			return;
 		}
 		if (!(val & 1)) {
-			pio->vector[pio_port] = val;
+			rc->pio->vector[pio_port] = val;
 			return;
 		}
 		if ((val & 0x0F) == 0x0F) {
-			pio->mode[pio_port] = val >> 6;
-			if (pio->mode[pio_port] == 3)
-				pio->mpend[pio_port] = 1;
+			rc->pio->mode[pio_port] = val >> 6;
+			if (rc->pio->mode[pio_port] == 3)
+				rc->pio->mpend[pio_port] = 1;
 			pio_recalc();
 			return;
 		}
 		if ((val & 0x0F) == 0x07) {
-			pio->icw[pio_port] = val >> 4;
+			rc->pio->icw[pio_port] = val >> 4;
 			return;
 		}
 		return;
 	} else {
-		pio->data[pio_port] = val;
-		switch(pio->mode[pio_port]) {
+		rc->pio->data[pio_port] = val;
+		switch(rc->pio->mode[pio_port]) {
 		case 0:
 		case 2:	/* Not really emulated */
-			pio_data_write(pio, pio_port, val);
-			pio_strobe(pio, pio_port);
+			pio_data_write(rc->pio, pio_port, val);
+			pio_strobe(rc->pio, pio_port);
 			break;
 		case 1:
 			break;
 		case 3:
 			/* Force input lines to floating high */
-			val |= pio->mask[pio_port];
-			pio_data_write(pio, pio_port, val);
+			val |= rc->pio->mask[pio_port];
+			pio_data_write(rc->pio, pio_port, val);
 			break;
 		}
 	}
@@ -1443,10 +1617,10 @@ static uint8_t pio_read(uint8_t addr)
 	uint8_t rx;
 
 	/* Output lines */
-	val = pio->data[pio_port];
-	rx = pio_data_read(pio, pio_port);
+	val = rc->pio->data[pio_port];
+	rx = pio_data_read(rc->pio, pio_port);
 
-	switch(pio->mode[pio_port]) {
+	switch(rc->pio->mode[pio_port]) {
 	case 0:
 		/* Write only */
 		break;
@@ -1458,14 +1632,14 @@ static uint8_t pio_read(uint8_t addr)
 		/* Bidirectional (not really emulated) */
 	case 3:
 		/* Control mode */
-		val &= ~pio->mask[pio_port];
-		val |= rx & pio->mask[pio_port];
+		val &= ~rc->pio->mask[pio_port];
+		val |= rx & rc->pio->mask[pio_port];
 		break;
 	}
 	return val;
 }
 
-static uint8_t pio_remap[4] = {
+static const uint8_t pio_remap[4] = {
 	0,
 	2,
 	1,
@@ -1486,23 +1660,23 @@ static uint8_t pio_read2(uint8_t addr)
 static void pio_reset(void)
 {
 	/* Input mode */
-	pio->mask[0] = 0xFF;
-	pio->mask[1] = 0xFF;
+	rc->pio->mask[0] = 0xFF;
+	rc->pio->mask[1] = 0xFF;
 	/* Mode 1 */
-	pio->mode[0] = 1;
-	pio->mode[1] = 1;
+	rc->pio->mode[0] = 1;
+	rc->pio->mode[1] = 1;
 	/* No output data value */
-	pio->data[0] = 0;
-	pio->data[1] = 0;
+	rc->pio->data[0] = 0;
+	rc->pio->data[1] = 0;
 	/* Nothing pending */
-	pio->mpend[0] = 0;
-	pio->mpend[1] = 0;
+	rc->pio->mpend[0] = 0;
+	rc->pio->mpend[1] = 0;
 	/* Clear icw */
-	pio->icw[0] = 0;
-	pio->icw[1] = 0;
+	rc->pio->icw[0] = 0;
+	rc->pio->icw[1] = 0;
 	/* No interrupt */
-	pio->irq[0] = 0;
-	pio->irq[1] = 0;
+	rc->pio->irq[0] = 0;
+	rc->pio->irq[1] = 0;
 }
 
 
@@ -1514,16 +1688,16 @@ static void pio_reset(void)
  */
 static void toggle_rom(void)
 {
-	if (bankreg[0] == 0) {
-		if (trace & TRACE_ROM)
+	if (rc->bankreg[0] == 0) {
+		if (rc->trace & TRACE_ROM)
 			fprintf(stderr, "[ROM out]\n");
-		bankreg[0] = 34;
-		bankreg[1] = 35;
+		rc->bankreg[0] = 34;
+		rc->bankreg[1] = 35;
 	} else {
-		if (trace & TRACE_ROM)
+		if (rc->trace & TRACE_ROM)
 			fprintf(stderr, "[ROM in]\n");
-		bankreg[0] = 0;
-		bankreg[1] = 1;
+		rc->bankreg[0] = 0;
+		rc->bankreg[1] = 1;
 	}
 }
 
@@ -1532,88 +1706,83 @@ static void toggle_rom(void)
  *	but ZRCC has an additional ROM control bits
  */
 
-static uint8_t sbc64_cpld_status;
-static uint8_t sbc64_cpld_char;
 
 static void sbc64_cpld_timer(void)
 {
 	/* Don't allow overruns - hack for convenience when pasting hex files */
-	if (!(sbc64_cpld_status & 1)) {
+	if (!(rc->sbc64_cpld_status & 1)) {
 		if (check_chario() & 1) {
-			sbc64_cpld_status |= 1;
-			sbc64_cpld_char = next_char();
+			rc->sbc64_cpld_status |= 1;
+			rc->sbc64_cpld_char = next_char();
 		}
 	}
 }
 
 static uint8_t sbc64_cpld_uart_rx(void)
 {
-	sbc64_cpld_status &= ~1;
-	if (trace & TRACE_CPLD)
-		fprintf(stderr, "CPLD rx %02X.\n", sbc64_cpld_char);
-	return sbc64_cpld_char;
+	rc->sbc64_cpld_status &= ~1;
+	if (rc->trace & TRACE_CPLD)
+		fprintf(stderr, "CPLD rx %02X.\n", rc->sbc64_cpld_char);
+	return rc->sbc64_cpld_char;
 }
 
 static uint8_t sbc64_cpld_uart_status(void)
 {
 //	if (trace & TRACE_CPLD)
 //		fprintf(stderr, "CPLD status %02X.\n", sbc64_cpld_status);
-	return sbc64_cpld_status;
+	return rc->sbc64_cpld_status;
 }
 
 static void sbc64_cpld_uart_ctrl(uint8_t val)
 {
-	if (trace & TRACE_CPLD)
+	if (rc->trace & TRACE_CPLD)
 		fprintf(stderr, "CPLD control %02X.\n", val);
 }
 
 static void sbc64_cpld_uart_tx(uint8_t val)
 {
-	static uint16_t bits;
-	static uint8_t bitcount;
 	/* This is umm... fun. We should do a clock based analysis and
 	   bit recovery. For the moment cheat to get it tested */
 	val &= 1;
-	if (bitcount == 0) {
+	if (rc->cpld_txcount == 0) {
 		if (val & 1)
 			return;
 		/* Look mummy a start a bit */
-		bitcount = 1;
-		bits = 0;
-		if (trace & TRACE_CPLD)
+		rc->cpld_txcount = 1;
+		rc->cpld_txbits = 0;
+		if (rc->trace & TRACE_CPLD)
 			fprintf(stderr, "[start]");
 		return;
 	}
 	/* This works because all the existing code does one write per bit */
-	if (bitcount == 9) {
+	if (rc->cpld_txcount == 9) {
 		if (val & 1) {
-			if (trace & TRACE_CPLD)
+			if (rc->trace & TRACE_CPLD)
 				fprintf(stderr, "[stop]");
-			putchar(bits);
-			fflush(stdout);
+			rc->con->put(rc->con, rc->cpld_txbits);
 		} else	/* Framing error should be a stop bit */
-			putchar('?');
-		bitcount = 0;
-		bits = 0;
+			rc->con->put(rc->con, '?');
+		rc->cpld_txcount = 0;
+		rc->cpld_txbits = 0;
 		return;
 	}
-	bits >>= 1;
-	bits |= val ? 0x80: 0x00;
-	if (trace & TRACE_CPLD)
+	rc->cpld_txbits >>= 1;
+	rc->cpld_txbits |= val ? 0x80: 0x00;
+	if (rc->trace & TRACE_CPLD)
 		fprintf(stderr, "[%d]", val);
-	bitcount++;
+	rc->cpld_txcount++;
 }
 
 static void sbc64_cpld_bankreg(uint8_t val)
 {
-	if (cpuboard == CPUBOARD_ZRCC)
-		bankreg[1] |=  val & 0x10;
+	if (rc->cpuboard == CPUBOARD_ZRCC)
+		rc->bankreg[1] |=  val & 0x10;
 	/* Bit 2 is the LED */
 	val &= 3;
-	if (bankreg[0] != val) {
-		if (trace & TRACE_CPLD)
+	if (rc->bankreg[0] != val) {
+		if (rc->trace & TRACE_CPLD)
 			fprintf(stderr, "Bank set to %02X\n", val);
-		bankreg[0] = val;
+		rc->bankreg[0] = val;
 	}
 }
 
@@ -1621,19 +1790,19 @@ static uint8_t z84c15_read(uint8_t port)
 {
 	switch(port) {
 	case 0xEE:
-		return z84c15.scrp;
+		return rc->z84c15.scrp;
 	case 0xEF:
-		switch(z84c15.scrp) {
+		switch(rc->z84c15.scrp) {
 		case 0:
-			return z84c15.wcr;
+			return rc->z84c15.wcr;
 		case 1:
-			return z84c15.mwbr;
+			return rc->z84c15.mwbr;
 		case 2:
-			return z84c15.csbr;
+			return rc->z84c15.csbr;
 		case 3:
-			return z84c15.mcr;
+			return rc->z84c15.mcr;
 		default:
-			fprintf(stderr, "Read invalid SCRP  %d\n", z84c15.scrp);
+			fprintf(stderr, "Read invalid SCRP  %d\n", rc->z84c15.scrp);
 			return 0xFF;
 		}
 		break;
@@ -1648,29 +1817,29 @@ static uint8_t z84c15_read(uint8_t port)
 
 static void z84c15_write(uint8_t port, uint8_t val)
 {
-	if (trace & TRACE_Z84C15)
+	if (rc->trace & TRACE_Z84C15)
 		fprintf(stderr, "z84c15: write %02X <- %02X\n",
 			port, val);
 	switch(port) {
 	case 0xEE:
-		z84c15.scrp = val;
+		rc->z84c15.scrp = val;
 		break;
 	case 0xEF:
-		switch(z84c15.scrp) {
+		switch(rc->z84c15.scrp) {
 		case 0:
-			z84c15.wcr = val;
+			rc->z84c15.wcr = val;
 			break;
 		case 1:
-			z84c15.mwbr = val;
+			rc->z84c15.mwbr = val;
 			break;
 		case 2:
-			z84c15.csbr = val;
+			rc->z84c15.csbr = val;
 			break;
 		case 3:
-			z84c15.mcr = val;
+			rc->z84c15.mcr = val;
 			break;
 		default:
-			fprintf(stderr, "Read invalid SCRP  %d\n", z84c15.scrp);
+			fprintf(stderr, "Read invalid SCRP  %d\n", rc->z84c15.scrp);
 		}
 		break;
 	/* Watchdog: not yet emulated */
@@ -1678,12 +1847,12 @@ static void z84c15_write(uint8_t port, uint8_t val)
 	case 0xF1:
 		return;
 	case 0xF4:
-		z84c15.intpr = val;
+		rc->z84c15.intpr = val;
 		break;
 	}
 }
 
-static uint8_t sio_kport[4] = {
+static const uint8_t sio_kport[4] = {
 	SIOA_D,
 	SIOA_C,
 	SIOB_D,
@@ -1698,7 +1867,7 @@ static uint8_t kio_read(uint8_t addr)
 	if (addr < 0x08)
 		return ctc_read(addr & 3);
 	if (addr < 0x0C)
-		return sio_read(sio, sio_kport[addr & 3]);
+		return sio_read(rc->sio, sio_kport[addr & 3]);
 	/* PIA and KIO control - TODO */
 	return 0xFF;
 }
@@ -1710,13 +1879,13 @@ static void kio_write(uint8_t addr, uint8_t val)
 	else if (addr < 0x08)
 		ctc_write(addr & 3, val);
 	else if (addr < 0x0C)
-		sio_write(sio, sio_kport[addr & 3], val);
+		sio_write(rc->sio, sio_kport[addr & 3], val);
 	/* PIA and KIO control - TODO */
 }
 
 static void fdc_log(int debuglevel, char *fmt, va_list ap)
 {
-	if ((trace & TRACE_FDC) || debuglevel == 0)
+	if ((rc->trace & TRACE_FDC) || debuglevel == 0)
 		vfprintf(stderr, "fdc: ", ap);
 }
 
@@ -1725,7 +1894,7 @@ static void fdc_write(uint8_t addr, uint8_t val)
 	switch(addr) {
 	case 1:	/* Data */
 		fprintf(stderr, "FDC Data: %02X\n", val);
-		fdc_write_data(fdc, val);
+		fdc_write_data(rc->fdc, val);
 		break;
 	case 2:	/* DOR */
 		fprintf(stderr, "FDC DOR %02X [", val);
@@ -1748,14 +1917,14 @@ static void fdc_write(uint8_t addr, uint8_t val)
 		else
 			fprintf(stderr, "DSEL0");
 		fprintf(stderr, "]\n");
-		fdc_write_dor(fdc, val);
+		fdc_write_dor(rc->fdc, val);
 #if 0		
 		if ((val & 0x21) == 0x21)
-			fdc_set_motor(fdc, 2);
+			fdc_set_motor(rc->fdc, 2);
 		else if ((val & 0x11) == 0x10)
-			fdc_set_motor(fdc, 1);
+			fdc_set_motor(rc->fdc, 1);
 		else
-			fdc_set_motor(fdc, 0);
+			fdc_set_motor(rc->fdc, 0);
 #endif			
 		break;
 	case 3:	/* DCR */
@@ -1776,11 +1945,11 @@ static void fdc_write(uint8_t addr, uint8_t val)
 			fprintf(stderr, "INVALID");
 		}
 		fprintf(stderr, "]\n");
-		fdc_write_drr(fdc, val & 3);	/* TODO: review */
+		fdc_write_drr(rc->fdc, val & 3);	/* TODO: review */
 		break;
 	case 4:	/* TC */
-		fdc_set_terminal_count(fdc, 0);
-		fdc_set_terminal_count(fdc, 1);
+		fdc_set_terminal_count(rc->fdc, 0);
+		fdc_set_terminal_count(rc->fdc, 1);
 		fprintf(stderr, "FDC TC\n");
 		break;
 	case 5:	/* RESET */
@@ -1797,11 +1966,11 @@ static uint8_t fdc_read(uint8_t addr)
 	switch(addr) {
 	case 0:	/* Status*/
 		fprintf(stderr, "FDC Read Status: ");
-		val = fdc_read_ctrl(fdc);
+		val = fdc_read_ctrl(rc->fdc);
 		break;
 	case 1:	/* Data */
 		fprintf(stderr, "FDC Read Data: ");
-		val = fdc_read_data(fdc);
+		val = fdc_read_data(rc->fdc);
 		break;
 	case 4:	/* TC */
 		fprintf(stderr, "FDC TC: ");
@@ -1817,17 +1986,16 @@ static uint8_t fdc_read(uint8_t addr)
 }
 
 
-static uint32_t z512_wdog;
 
 static uint8_t z512_read(uint8_t addr)
 {
-	return z512_control;
+	return rc->z512_control;
 }
 
 static void z512_write(uint8_t addr, uint8_t val)
 {
-	uint8_t old = z512_control;
-	z512_control = val;
+	uint8_t old = rc->z512_control;
+	rc->z512_control = val;
 	if ((old & 0x1F) != (val & 0x1f)) {
 		unsigned int b = 7372800;
 		if (val & 0x10)
@@ -1840,7 +2008,7 @@ static void z512_write(uint8_t addr, uint8_t val)
 			b >>= 2;
 		if (val & 0x01)
 			b >>= 1;
-		if (trace & TRACE_SIO)
+		if (rc->trace & TRACE_SIO)
 			fprintf(stderr, "Z512 SIO serial clock: %d\n", b);
 	}
 }
@@ -1848,7 +2016,7 @@ static void z512_write(uint8_t addr, uint8_t val)
 static void z512_write_wd(uint8_t addr, uint8_t val)
 {
 	/* 1.6 seconds */
-	z512_wdog = 3200;
+	rc->z512_wdog = 3200;
 }
 
 /* PS/2 keyboard and mouse - only keyboard bits for now */
@@ -1856,122 +2024,118 @@ static void z512_write_wd(uint8_t addr, uint8_t val)
 static uint8_t ps2_read(void)
 {
 	uint8_t r = 0x00;
-	if (ps2_get_clock(ps2))
+	if (ps2_get_clock(rc->ps2))
 		r |= 0x04;
-	if (ps2_get_data(ps2))
+	if (ps2_get_data(rc->ps2))
 		r |= 0x08;
 	return r;
 }
 
 static void ps2_write(uint8_t val)
 {
-	ps2_set_lines(ps2, !!(val & 0x01) , !!(val & 0x02));
+	ps2_set_lines(rc->ps2, !!(val & 0x01) , !!(val & 0x02));
 }
 
-static unsigned prop_curcmd;
-static unsigned prop_cmdcnt;
-static unsigned prop_cmdsize;
-static unsigned propdata[4];
 
 static void propgfx_write(unsigned cmd, uint8_t data)
 {
 	if (cmd == 0) {
-		prop_cmdcnt = 0;
-		prop_curcmd = data;
+		rc->prop_cmdcnt = 0;
+		rc->prop_curcmd = data;
 		switch(data) {
 		case 0x00:
 			fprintf(stderr, "\nV:MODE ");
-			prop_cmdsize = 3;
+			rc->prop_cmdsize = 3;
 			break;
 		case 0x01:
 			fprintf(stderr, "\nV:SETPIXEL");
-			prop_cmdsize = 3;
+			rc->prop_cmdsize = 3;
 			break;
 		case 0x03:
 			fprintf(stderr, "\nV:HSCROLL ");
-			prop_cmdsize = 2;
+			rc->prop_cmdsize = 2;
 			break;
 		case 0x04:
 			fprintf(stderr, "\nV:VSCROLL ");
-			prop_cmdsize = 2;
+			rc->prop_cmdsize = 2;
 			break;
 		case 0x06:
 			fprintf(stderr, "\nV:SET_TILEMAP ");
-			prop_cmdsize = 2;
+			rc->prop_cmdsize = 2;
 			break;
 		case 0x07:
 			fprintf(stderr, "\nV:SET_SPRITEMAP ");
-			prop_cmdsize = 2;
+			rc->prop_cmdsize = 2;
 			break;
 		case 0x09:
 			fprintf(stderr, "\nV:CLR ");
 			break;
 		case 0x0B:
 			fprintf(stderr, "\nV:PALETTE ");
-			prop_cmdsize = 2;
+			rc->prop_cmdsize = 2;
 			break;
 		case 0x0C:
 			fprintf(stderr, "\nV:SRPITEDATA ");
-			prop_cmdsize = 3;
+			rc->prop_cmdsize = 3;
 			break;
 		case 0x0D:
 			fprintf(stderr, "\nV:TILEMAP/RBW ");
-			prop_cmdsize = 2;
+			rc->prop_cmdsize = 2;
 			break;
 		case 0x0E:
 			fprintf(stderr, "\nV:TILEBIT ");
-			prop_cmdsize = 2;
+			rc->prop_cmdsize = 2;
 			break;
 		default:
 			fprintf(stderr, "\nV:UNK %02X ", data);
-			prop_cmdsize = 0;
+			rc->prop_cmdsize = 0;
 		}
 		return;
 	}
-	if (prop_cmdcnt < prop_cmdsize) {
-		propdata[prop_cmdcnt] = data;
-		prop_cmdcnt++;
+	if (rc->prop_cmdcnt < rc->prop_cmdsize) {
+		rc->propdata[rc->prop_cmdcnt] = data;
+		rc->prop_cmdcnt++;
 	}
-	if (prop_cmdcnt == prop_cmdsize) {
-		prop_cmdcnt++;
-		switch(prop_curcmd) {
+	if (rc->prop_cmdcnt == rc->prop_cmdsize) {
+		rc->prop_cmdcnt++;
+		switch(rc->prop_curcmd) {
 		case 0x00:
 			fprintf(stderr, "%02X %02X %02X\n",
-				propdata[0], propdata[1], propdata[2]);
+				rc->propdata[0], rc->propdata[1], rc->propdata[2]);
 			break;
 		case 0x01:
 			fprintf(stderr, "Y %0d X %d C %d\n",
-				propdata[0], propdata[1], propdata[2]);
+				rc->propdata[0], rc->propdata[1], rc->propdata[2]);
 			break;
 		case 0x03:
 		case 0x04:
 			fprintf(stderr, "%d\n",
-				(propdata[1] << 8) | propdata[0]);
+				(rc->propdata[1] << 8) | rc->propdata[0]);
 			break;
 		case 0x06:
 		case 0x07:
 			fprintf(stderr, "%04X\n",
-				(propdata[1] << 8) | propdata[0]);
+				(rc->propdata[1] << 8) | rc->propdata[0]);
 			break;
 		case 0x09:
 			break;
 		case 0x0B:
-			fprintf(stderr, "%d to %02X\n", propdata[0],
-				propdata[1]);
+			fprintf(stderr, "%d to %02X\n", rc->propdata[0],
+				rc->propdata[1]);
 			break;
 		case 0x0C:
 			fprintf(stderr, "%d\n",
-				propdata[0]);
+				rc->propdata[0]);
 			break;
 		case 0x0D: {
-			uint16_t off = propdata[0] | (propdata[1] << 8);
+			uint16_t off = rc->propdata[0] | (rc->propdata[1] << 8);
 			fprintf(stderr, "Y %d X %d\n",
 				off / 80, off % 80);
 			}
 			break;
 		case 0x0E:
 			fprintf(stderr, "Tile %d\n",
-				(propdata[0] | (propdata[1] << 8)) >> 6);
+				(rc->propdata[0] | (rc->propdata[1] << 8)) >> 6);
 			break;
 		}
 		return;
@@ -1979,7 +2143,7 @@ static void propgfx_write(unsigned cmd, uint8_t data)
 	fprintf(stderr, "D%02X ", data);
 }
 
-static uint8_t sio_port[4] = {
+static const uint8_t sio_port[4] = {
 	SIOA_C,
 	SIOA_D,
 	SIOB_C,
@@ -1988,79 +2152,84 @@ static uint8_t sio_port[4] = {
 
 static uint8_t io_read_2014(uint16_t addr)
 {
-	if (trace & TRACE_IO)
+	unsigned n;
+
+	if (rc->trace & TRACE_IO)
 		fprintf(stderr, "read %02x\n", addr);
 	/* Sort out an address TODO */
-	if (copro && (addr & 0xF8) == 0x8)
-		return z180copro_ioread(copro, addr);
+	for (n = 0; n < rc->ncopro; n++)
+		if ((addr & 0xF8) == copro_port[n])
+			return z180copro_ioread(rc->copro[n], addr);
 	if ((addr & 0xFF) == 0xBA) {
 		return 0xCC;
 	}
-	if (zxkey && (addr & 0xFC) == 0xFC)
-		return zxkey_scan(zxkey, addr);
+	if (rc->zxkey && (addr & 0xFC) == 0xFC)
+		return zxkey_scan(rc->zxkey, addr);
 
-	if (have_busstop && (addr & 0xFF) >= 0xE0) {
-		bs_latch = addr;
-		Z80NMI(&cpu_z80);
+	if (rc->have_busstop && (addr & 0xFF) >= 0xE0) {
+		rc->bs_latch = addr;
+		Z80NMI(&rc->cpu_z80);
 		/* The I/O still happens before the NMI hits */
 	}
 	addr &= 0xFF;
 
-	if (addr >= 0x80 && addr <= 0x9F && have_kio)
+	if (addr >= 0x80 && addr <= 0x9F && rc->have_kio)
 		return kio_read(addr & 0x1F);
 	if (addr >= 0x48 && addr < 0x50) 
 		return fdc_read(addr & 7);
-	if (addr == 0x46 && ef9345 && (ef_latch & 0xF0) == 0x20 && !extreme)
-		return ef9345_read(ef9345, ef_latch);
-	if ((addr == 0x42 || addr == 0x43) && amd9511)
-		return amd9511_read(amd9511, addr);
-	if ((addr >= 0xA0 && addr <= 0xA7) && acia && acia_narrow == 1)
-		return acia_read(acia, addr & 1);
-	if ((addr >= 0x80 && addr <= 0x87) && acia && acia_narrow == 2)
-		return acia_read(acia, addr & 1);
-	if ((addr >= 0x80 && addr <= 0xBF) && acia && !acia_narrow)
-		return acia_read(acia, addr & 1);
-	if ((addr >= 0x80 && addr <= 0x87) && sio && !have_kio)
-		return sio_read(sio, sio_port[addr & 3]);
-	if ((addr >= 0x10 && addr <= 0x17) && ide == 1)
+	if (addr == 0x46 && rc->ef9345 && (rc->ef_latch & 0xF0) == 0x20 && !rc->extreme)
+		return ef9345_read(rc->ef9345, rc->ef_latch);
+	if ((addr == 0x42 || addr == 0x43) && rc->amd9511)
+		return amd9511_read(rc->amd9511, addr);
+	if ((addr >= 0xA0 && addr <= 0xA7) && rc->acia && rc->acia_narrow == 1)
+		return acia_read(rc->acia, addr & 1);
+	if ((addr >= 0x80 && addr <= 0x87) && rc->acia && rc->acia_narrow == 2)
+		return acia_read(rc->acia, addr & 1);
+	if ((addr >= 0x80 && addr <= 0xBF) && rc->acia && !rc->acia_narrow)
+		return acia_read(rc->acia, addr & 1);
+	if ((addr >= 0x80 && addr <= 0x87) && rc->sio && !rc->have_kio)
+		return sio_read(rc->sio, sio_port[addr & 3]);
+	if ((addr >= 0x10 && addr <= 0x17) && rc->ide == 1)
 		return my_ide_read(addr & 7);
-	if (addr >= 0x20 && addr <= 0x27 && ide == 2)
-		return ppide_read(ppide, addr & 3);
-	if (addr >= 0x28 && addr <= 0x2C && have_wiznet && !extreme)
-		return nic_w5100_read(wiz, addr & 3);
-	if (addr >= 0x68 && addr <= 0x6F && have_pio)
+	if (addr >= 0x20 && addr <= 0x27 && rc->ide == 2)
+		return ppide_read(rc->ppide, addr & 3);
+	if (addr >= 0x28 && addr <= 0x2C && rc->have_wiznet && !rc->extreme)
+		return nic_w5100_read(rc->wiz, addr & 3);
+	if (addr >= 0x68 && addr <= 0x6F && rc->have_pio)
 		return pio_read2(addr & 3);
 
-	if (addr == 0xBB && ps2)
+	if (addr == 0xBB && rc->ps2)
 		return ps2_read();
-	if (addr == 0xC0 && rtc && !extreme)
-		return rtc_read(rtc);
+	if (addr == 0x04 && rc->dma)
+		return z80dma_read(rc->dma);
+	if (addr == 0xC0 && rc->rtc && !rc->extreme)
+		return rtc_read(rc->rtc);
 	/* Scott Baker is 0x90-93, suggested defaults for the
 	   Stephen Cousins boards at 0x88-0x8B. No doubt we'll get
 	   an official CTC board at another address  */
-	if (addr >= 0x88 && addr <= 0x8B && have_ctc)
+	if (addr >= 0x88 && addr <= 0x8B && rc->have_ctc)
 		return ctc_read(addr & 3);
-	if ((addr == 0x98 || addr == 0x99) && vdp) {
+	if ((addr == 0x98 || addr == 0x99) && rc->vdp) {
 		/* This can change the interrupt state and if so we need
 		   to pick it up */
-		uint8_t r = tms9918a_read(vdp, addr & 1);
+		uint8_t r = tms9918a_read(rc->vdp, addr & 1);
 		poll_irq_nonim2();
 		return r;
 	}
-	if (addr >= 0xA0 && addr <= 0xA7 && have_16x50)
-		return uart16x50_read(uart, addr & 7);
-	if (addr == 0x6D && is_z512)
+	if (addr >= 0xA0 && addr <= 0xA7 && rc->have_16x50)
+		return uart16x50_read(rc->uart, addr & 7);
+	if (addr == 0x6D && rc->is_z512)
 		return z512_read(addr);
-	if (addr >= 0x58 && addr <= 0x5F && ncr && !extreme)
-		return ncr5380_read(ncr, addr & 7);
-	if (have_busstop && addr >= 0xDC && addr <= 0xDF) {
-		Z80NMI_Clear(&cpu_z80);
+	if (addr >= 0x58 && addr <= 0x5F && rc->ncr && !rc->extreme)
+		return ncr5380_read(rc->ncr, addr & 7);
+	if (rc->have_busstop && addr >= 0xDC && addr <= 0xDF) {
+		Z80NMI_Clear(&rc->cpu_z80);
 		if (addr & 1)
-			return bs_latch >> 8;
+			return rc->bs_latch >> 8;
 		else
-			return bs_latch;
+			return rc->bs_latch;
 	}
-	if (trace & TRACE_UNK)
+	if (rc->trace & TRACE_UNK)
 		fprintf(stderr, "Unknown read from port %04X\n", addr);
 	return 0x78;	/* 78 is what my actual board floats at */
 }
@@ -2070,107 +2239,113 @@ static uint8_t io_read_2014_x(uint16_t addr)
 	/* RC2014 extreme with bus extender at B8 */
 	if ((addr & 0xFF) == 0xB8) {
 		addr >>= 8;
-		if (addr >= 0x28 && addr <= 0x2C && have_wiznet)
-			return nic_w5100_read(wiz, addr & 3);
-		if (addr == 0xC0 && rtc)
-			return rtc_read(rtc);
-		if (addr == 0x46 && ef9345 && (ef_latch & 0xF0) == 0x20)
-			return ef9345_read(ef9345, ef_latch);
-		if (addr >= 0x58 && addr <= 0x5F && ncr)
-			return ncr5380_read(ncr, addr & 7);
+		if (addr >= 0x28 && addr <= 0x2C && rc->have_wiznet)
+			return nic_w5100_read(rc->wiz, addr & 3);
+		if (addr == 0xC0 && rc->rtc)
+			return rtc_read(rc->rtc);
+		if (addr == 0x46 && rc->ef9345 && (rc->ef_latch & 0xF0) == 0x20)
+			return ef9345_read(rc->ef9345, rc->ef_latch);
+		if (addr >= 0x58 && addr <= 0x5F && rc->ncr)
+			return ncr5380_read(rc->ncr, addr & 7);
 		return 0x78;
 	}
 	/* KIO at 0xC0-0xDF */
-	if ((addr  & 0xE0) == 0xC0 && have_kio_ext)
+	if ((addr  & 0xE0) == 0xC0 && rc->have_kio_ext)
 		return kio_read(addr & 0x1F);
 	return io_read_2014(addr);
 }
 
 static void io_write_2014(uint16_t addr, uint8_t val, uint8_t known)
 {
-	if (trace & TRACE_IO)
+	unsigned n;
+
+	if (rc->trace & TRACE_IO)
 		fprintf(stderr, "write %02x <- %02x\n", addr, val);
 
-	if (copro && (addr & 0xF8) == 0x8) {
-		z180copro_iowrite(copro, addr, val);
-		return;
+	for (n = 0; n < rc->ncopro; n++) {
+		if ((addr & 0xF8) == copro_port[n]) {
+			z180copro_iowrite(rc->copro[n], addr, val);
+			return;
+		}
 	}
 	if ((addr & 0xFF) == 0xBA) {
 		/* Quart */
 		return;
 	}
 	addr &= 0xFF;
-	if (addr >= 0x80 && addr <= 0x9F && have_kio)
+	if (addr >= 0x80 && addr <= 0x9F && rc->have_kio)
 		kio_write(addr & 0x1F, val);
-	else if (addr == 0x44 && ef9345 && !extreme)
-		ef_latch = val;
-	else if (addr == 0x46 && ef9345 && ((ef_latch & 0xF0) == 0x20) && !extreme)
-		ef9345_write(ef9345, ef_latch, val);
+	else if (addr == 0x44 && rc->ef9345 && !rc->extreme)
+		rc->ef_latch = val;
+	else if (addr == 0x46 && rc->ef9345 && ((rc->ef_latch & 0xF0) == 0x20) && !rc->extreme)
+		ef9345_write(rc->ef9345, rc->ef_latch, val);
 	else if (addr >= 0x48 && addr < 0x50)
 		fdc_write(addr & 7, val);
-	else if ((addr == 0x42 || addr == 0x43) && amd9511)
-		amd9511_write(amd9511, addr, val);
+	else if ((addr == 0x42 || addr == 0x43) && rc->amd9511)
+		amd9511_write(rc->amd9511, addr, val);
 	else if (addr >= 0x40 && addr <= 0x41)
 		propgfx_write(addr & 1, val);
-	else if ((addr >= 0xA0 && addr <= 0xA7) && acia && acia_narrow == 1)
-		acia_write(acia, addr & 1, val);
-	else if ((addr >= 0x80 && addr <= 0x87) && acia && acia_narrow == 2)
-		acia_write(acia, addr & 1, val);
-	else if ((addr >= 0x80 && addr <= 0xBF) && acia && !acia_narrow)
-		acia_write(acia, addr & 1, val);
-	else if ((addr >= 0x80 && addr <= 0x87) && sio && !have_kio)
-		sio_write(sio, sio_port[addr & 3], val);
-	else if ((addr >= 0x10 && addr <= 0x17) && ide == 1)
+	else if ((addr >= 0xA0 && addr <= 0xA7) && rc->acia && rc->acia_narrow == 1)
+		acia_write(rc->acia, addr & 1, val);
+	else if ((addr >= 0x80 && addr <= 0x87) && rc->acia && rc->acia_narrow == 2)
+		acia_write(rc->acia, addr & 1, val);
+	else if ((addr >= 0x80 && addr <= 0xBF) && rc->acia && !rc->acia_narrow)
+		acia_write(rc->acia, addr & 1, val);
+	else if ((addr >= 0x80 && addr <= 0x87) && rc->sio && !rc->have_kio)
+		sio_write(rc->sio, sio_port[addr & 3], val);
+	else if ((addr >= 0x10 && addr <= 0x17) && rc->ide == 1)
 		my_ide_write(addr & 7, val);
-	else if (addr >= 0x20 && addr <= 0x27 && ide == 2)
-		ppide_write(ppide, addr & 3, val);
-	else if (addr >= 0x28 && addr <= 0x2C && have_wiznet && !extreme)
-		nic_w5100_write(wiz, addr & 3, val);
-	else if (addr >= 0x68 && addr <= 0x6F && have_pio)
+	else if (addr >= 0x20 && addr <= 0x27 && rc->ide == 2)
+		ppide_write(rc->ppide, addr & 3, val);
+	else if (addr >= 0x28 && addr <= 0x2C && rc->have_wiznet && !rc->extreme)
+		nic_w5100_write(rc->wiz, addr & 3, val);
+	else if (addr >= 0x68 && addr <= 0x6F && rc->have_pio)
 		pio_write2(addr & 3, val);
 	/* FIXME: real bank512 alias at 0x70-77 for 78-7F */
-	else if (bank512 && addr >= 0x78 && addr <= 0x7B) {
-		bankreg[addr & 3] = val & 0x3F;
-		if (trace & TRACE_512)
+	else if (rc->bank512 && addr >= 0x78 && addr <= 0x7B) {
+		rc->bankreg[addr & 3] = val & 0x3F;
+		if (rc->trace & TRACE_512)
 			fprintf(stderr, "Bank %d set to %d\n", addr & 3, val);
-	} else if (bank512 && addr >= 0x7C && addr <= 0x7F) {
-		if (trace & TRACE_512)
+	} else if (rc->bank512 && addr >= 0x7C && addr <= 0x7F) {
+		if (rc->trace & TRACE_512)
 			fprintf(stderr, "Banking %sabled.\n", (val & 1) ? "en" : "dis");
-		bankenable = val & 1;
-	} else if (addr == 0xBB && ps2)
+		rc->bankenable = val & 1;
+	} else if (addr == 0x04 && rc->dma)
+		z80dma_write(rc->dma, val);
+	else if (addr == 0xBB && rc->ps2)
 		ps2_write(val);
-	else if (addr == 0xC0 && rtc && !extreme)
-		rtc_write(rtc, val);
-	else if (addr >= 0x88 && addr <= 0x8B && have_ctc)
+	else if (addr == 0xC0 && rc->rtc && !rc->extreme)
+		rtc_write(rc->rtc, val);
+	else if (addr >= 0x88 && addr <= 0x8B && rc->have_ctc)
 		ctc_write(addr & 3, val);
-	else if ((addr == 0x98 || addr == 0x99) && vdp)
-		tms9918a_write(vdp, addr & 1, val);
-	else if (addr >= 0xA0 && addr <= 0xA7 && have_16x50)
-		uart16x50_write(uart, addr & 7, val);
-	else if (addr == 0x6D && is_z512)
+	else if ((addr == 0x98 || addr == 0x99) && rc->vdp)
+		tms9918a_write(rc->vdp, addr & 1, val);
+	else if (addr >= 0xA0 && addr <= 0xA7 && rc->have_16x50)
+		uart16x50_write(rc->uart, addr & 7, val);
+	else if (addr == 0x6D && rc->is_z512)
 		z512_write(addr, val);
-	else if (addr == 0x6F && is_z512)
+	else if (addr == 0x6F && rc->is_z512)
 		z512_write_wd(addr, val);
 	else if (addr == 0x32 || addr == 0x33) {
-		if (tft == NULL) {
-			tft = tft_create(0);
-			tftrend = tft_renderer_create(tft);
+		if (rc->tft == NULL) {
+			rc->tft = tft_create(0);
+			rc->tftrend = tft_renderer_create(rc->tft);
 		}
-		tft_write(tft, addr & 1, val);
-	} else if (addr >= 0x58 && addr <= 0x5F && ncr && !extreme)
-		ncr5380_write(ncr, addr & 7, val);
+		tft_write(rc->tft, addr & 1, val);
+	} else if (addr >= 0x58 && addr <= 0x5F && rc->ncr && !rc->extreme)
+		ncr5380_write(rc->ncr, addr & 7, val);
 	/* The switchable/pageable ROM is not very well decoded */
-	else if (switchrom && (addr & 0x7F) >= 0x38 && (addr & 0x7F) <= 0x3F)
+	else if (rc->switchrom && (addr & 0x7F) >= 0x38 && (addr & 0x7F) <= 0x3F)
 		toggle_rom();
 	else if (addr == 0xFD) {
-		trace &= 0xFF00;
-		trace |= val;
-		fprintf(stderr, "trace set to %04X\n", trace);
+		rc->trace &= 0xFF00;
+		rc->trace |= val;
+		fprintf(stderr, "trace set to %04X\n", rc->trace);
 	} else if (addr == 0xFE) {
-		trace &= 0xFF;
-		trace |= val << 8;
-		fprintf(stderr, "trace set to %d\n", trace);
-	} else if (!known && (trace & TRACE_UNK))
+		rc->trace &= 0xFF;
+		rc->trace |= val << 8;
+		fprintf(stderr, "trace set to %d\n", rc->trace);
+	} else if (!known && (rc->trace & TRACE_UNK))
 		fprintf(stderr, "Unknown write to port %04X of %02X\n", addr, val);
 }
 
@@ -2179,29 +2354,29 @@ static void io_write_2014_x(uint16_t addr, uint8_t val, uint8_t known)
 	/* RC2014 extreme with bus extender at B8 */
 	if ((addr & 0xFF) == 0xB8) {
 		addr >>= 8;
-		if (addr >= 0x28 && addr <= 0x2C && have_wiznet)
-			nic_w5100_write(wiz, addr & 3, val);
-		else if (addr == 0xC0 && rtc)
-			rtc_write(rtc, val);
+		if (addr >= 0x28 && addr <= 0x2C && rc->have_wiznet)
+			nic_w5100_write(rc->wiz, addr & 3, val);
+		else if (addr == 0xC0 && rc->rtc)
+			rtc_write(rc->rtc, val);
 		else if (addr >= 0x40 && addr <= 0x41)
 			propgfx_write(addr & 1, val);
-		else if (addr == 0x44 && ef9345)
-			ef_latch = val;
-		else if (addr == 0x46 && ef9345 && (ef_latch & 0xF0) == 0x20)
-			ef9345_write(ef9345, ef_latch, val);
-		else if (addr >= 0x58 && addr <= 0x5F && ncr)
-			ncr5380_write(ncr, addr & 7, val);
+		else if (addr == 0x44 && rc->ef9345)
+			rc->ef_latch = val;
+		else if (addr == 0x46 && rc->ef9345 && (rc->ef_latch & 0xF0) == 0x20)
+			ef9345_write(rc->ef9345, rc->ef_latch, val);
+		else if (addr >= 0x58 && addr <= 0x5F && rc->ncr)
+			ncr5380_write(rc->ncr, addr & 7, val);
 		return;
 	}
 	/* KIO at 0xC0-0xDF */
-	if ((addr  & 0xE0) == 0xC0 && have_kio_ext) {
+	if ((addr  & 0xE0) == 0xC0 && rc->have_kio_ext) {
 		kio_write(addr & 0x1F, val);
 		return;
 	}
 	io_write_2014(addr, val, known);
 }
 
-static uint8_t sio_port4[4] = {
+static const uint8_t sio_port4[4] = {
 	SIOA_D,
 	SIOA_C,
 	SIOB_D,
@@ -2210,46 +2385,46 @@ static uint8_t sio_port4[4] = {
 
 static uint8_t io_read_4(uint16_t addr)
 {
-	if (trace & TRACE_IO)
+	if (rc->trace & TRACE_IO)
 		fprintf(stderr, "read %02x\n", addr);
 	addr &= 0xFF;
 	if (addr >= 0x80 && addr <= 0x83)
-		return sio_read(sio, sio_port4[addr & 3]);
-	if ((addr >= 0x10 && addr <= 0x17) && ide == 1)
+		return sio_read(rc->sio, sio_port4[addr & 3]);
+	if ((addr >= 0x10 && addr <= 0x17) && rc->ide == 1)
 		return my_ide_read(addr & 7);
-	if (addr >= 0x28 && addr <= 0x2C && have_wiznet)
-		return nic_w5100_read(wiz, addr & 3);
-	if (addr == 0xC0 && rtc)
-		return rtc_read(rtc);
+	if (addr >= 0x28 && addr <= 0x2C && rc->have_wiznet)
+		return nic_w5100_read(rc->wiz, addr & 3);
+	if (addr == 0xC0 && rc->rtc)
+		return rtc_read(rc->rtc);
 	if (addr >= 0x88 && addr <= 0x8B)
 		return ctc_read(addr & 3);
-	if (trace & TRACE_UNK)
+	if (rc->trace & TRACE_UNK)
 		fprintf(stderr, "Unknown read from port %04X\n", addr);
 	return 0xFF;
 }
 
 static void io_write_4(uint16_t addr, uint8_t val)
 {
-	if (trace & TRACE_IO)
+	if (rc->trace & TRACE_IO)
 		fprintf(stderr, "write %02x <- %02x\n", addr, val);
 	addr &= 0xFF;
 	if (addr >= 0x80 && addr <= 0x83)
-		sio_write(sio, sio_port4[addr & 3], val);
-	else if ((addr >= 0x10 && addr <= 0x17) && ide == 1)
+		sio_write(rc->sio, sio_port4[addr & 3], val);
+	else if ((addr >= 0x10 && addr <= 0x17) && rc->ide == 1)
 		my_ide_write(addr & 7, val);
-	else if (addr >= 0x28 && addr <= 0x2C && have_wiznet)
-		nic_w5100_write(wiz, addr & 3, val);
+	else if (addr >= 0x28 && addr <= 0x2C && rc->have_wiznet)
+		nic_w5100_write(rc->wiz, addr & 3, val);
 	/* FIXME: real bank512 alias at 0x70-77 for 78-7F */
-	else if (bank512 && addr >= 0x78 && addr <= 0x7B) {
-		bankreg[addr & 3] = val & 0x3F;
-		if (trace & TRACE_512)
+	else if (rc->bank512 && addr >= 0x78 && addr <= 0x7B) {
+		rc->bankreg[addr & 3] = val & 0x3F;
+		if (rc->trace & TRACE_512)
 			fprintf(stderr, "Bank %d set to %d\n", addr & 3, val);
-	} else if (bank512 && addr >= 0x7C && addr <= 0x7F) {
-		if (trace & TRACE_512)
+	} else if (rc->bank512 && addr >= 0x7C && addr <= 0x7F) {
+		if (rc->trace & TRACE_512)
 			fprintf(stderr, "Banking %sabled.\n", (val & 1) ? "en" : "dis");
-		bankenable = val & 1;
-	} else if (addr == 0xC0 && rtc)
-		rtc_write(rtc, val);
+		rc->bankenable = val & 1;
+	} else if (addr == 0xC0 && rc->rtc)
+		rtc_write(rc->rtc, val);
 	else if (addr >= 0x88 && addr <= 0x8B)
 		ctc_write(addr & 3, val);
 	else if (addr == 0xFC) {
@@ -2257,57 +2432,57 @@ static void io_write_4(uint16_t addr, uint8_t val)
 		fflush(stdout);
 	} else if (addr == 0xFD) {
 		fprintf(stderr, "trace set to %d\n", val);
-		trace = val;
-	} else if (trace & TRACE_UNK)
+		rc->trace = val;
+	} else if (rc->trace & TRACE_UNK)
 		fprintf(stderr, "Unknown write to port %04X of %02X\n", addr, val);
 }
 
 static uint8_t io_read_5(uint16_t addr)
 {
-	if (trace & TRACE_IO)
+	if (rc->trace & TRACE_IO)
 		fprintf(stderr, "read %02x\n", addr);
 	addr &= 0xFF;
 	if (addr >= 0x18 && addr <= 0x1B)
-		return sio_read(sio, sio_port4[addr & 3]);
-	if ((addr >= 0x90 && addr <= 0x97) && ide == 1)
+		return sio_read(rc->sio, sio_port4[addr & 3]);
+	if ((addr >= 0x90 && addr <= 0x97) && rc->ide == 1)
 		return my_ide_read(addr & 7);
-	if (addr >= 0x28 && addr <= 0x2C && have_wiznet)
-		return nic_w5100_read(wiz, addr & 3);
-	if (addr == 0xC0 && rtc)
-		return rtc_read(rtc);
+	if (addr >= 0x28 && addr <= 0x2C && rc->have_wiznet)
+		return nic_w5100_read(rc->wiz, addr & 3);
+	if (addr == 0xC0 && rc->rtc)
+		return rtc_read(rc->rtc);
 	if (addr >= 0x10 && addr <= 0x13)
 		return ctc_read(addr & 3);
 	if (addr >= 0xEE && addr <= 0xF1)
 		return z84c15_read(addr);
 	if (addr >= 0x1C && addr <= 0x1F)
 		return pio_read(addr & 3);
-	if (trace & TRACE_UNK)
+	if (rc->trace & TRACE_UNK)
 		fprintf(stderr, "Unknown read from port %04X\n", addr);
 	return 0xFF;
 }
 
 static void io_write_5(uint16_t addr, uint8_t val)
 {
-	if (trace & TRACE_IO)
+	if (rc->trace & TRACE_IO)
 		fprintf(stderr, "write %02x <- %02x\n", addr, val);
 	addr &= 0xFF;
 	if (addr >= 0x18 && addr <= 0x1B)
-		sio_write(sio, sio_port4[addr & 3], val);
-	else if ((addr >= 0x90 && addr <= 0x97) && ide == 1)
+		sio_write(rc->sio, sio_port4[addr & 3], val);
+	else if ((addr >= 0x90 && addr <= 0x97) && rc->ide == 1)
 		my_ide_write(addr & 7, val);
-	else if (addr >= 0x28 && addr <= 0x2C && have_wiznet)
-		nic_w5100_write(wiz, addr & 3, val);
+	else if (addr >= 0x28 && addr <= 0x2C && rc->have_wiznet)
+		nic_w5100_write(rc->wiz, addr & 3, val);
 	/* FIXME: real bank512 alias at 0x70-77 for 78-7F */
-	else if (bank512 && addr >= 0x78 && addr <= 0x7B) {
-		bankreg[addr & 3] = val & 0x3F;
-		if (trace & TRACE_512)
+	else if (rc->bank512 && addr >= 0x78 && addr <= 0x7B) {
+		rc->bankreg[addr & 3] = val & 0x3F;
+		if (rc->trace & TRACE_512)
 			fprintf(stderr, "Bank %d set to %d\n", addr & 3, val);
-	} else if (bank512 && addr >= 0x7C && addr <= 0x7F) {
-		if (trace & TRACE_512)
+	} else if (rc->bank512 && addr >= 0x7C && addr <= 0x7F) {
+		if (rc->trace & TRACE_512)
 			fprintf(stderr, "Banking %sabled.\n", (val & 1) ? "en" : "dis");
-		bankenable = val & 1;
-	} else if (addr == 0xC0 && rtc)
-		rtc_write(rtc, val);
+		rc->bankenable = val & 1;
+	} else if (addr == 0xC0 && rc->rtc)
+		rtc_write(rc->rtc, val);
 	else if (addr >= 0x10 && addr <= 0x13)
 		ctc_write(addr & 3, val);
 	else if (addr >= 0x1C && addr <= 0x1F)
@@ -2319,8 +2494,8 @@ static void io_write_5(uint16_t addr, uint8_t val)
 		fflush(stdout);
 	} else if (addr == 0xFD) {
 		fprintf(stderr, "trace set to %d\n", val);
-		trace = val;
-	} else if (trace & TRACE_UNK)
+		rc->trace = val;
+	} else if (rc->trace & TRACE_UNK)
 		fprintf(stderr, "Unknown write to port %04X of %02X\n", addr, val);
 }
 
@@ -2328,9 +2503,9 @@ static void io_write_1(uint16_t addr, uint8_t val)
 {
 	if ((addr & 0xFF) == 0x38) {
 		val &= 0x81;
-		if (val != port38 && (trace & TRACE_ROM))
+		if (val != rc->port38 && (rc->trace & TRACE_ROM))
 			fprintf(stderr, "Bank set to %02X\n", val);
-		port38 = val;
+		rc->port38 = val;
 		return;
 	}
 	io_write_2014(addr, val, 0);
@@ -2389,7 +2564,7 @@ static void io_write_2(uint16_t addr, uint8_t val)
 			printf("[LED on]\n");
 		return;
 	case 0x20:
-		if (trace & TRACE_UART) {
+		if (rc->trace & TRACE_UART) {
 			if (val & 1)
 				fprintf(stderr, "[RTS high]\n");
 			else
@@ -2401,14 +2576,14 @@ static void io_write_2(uint16_t addr, uint8_t val)
 		known = 1;
 		break;
 	case 0x30:
-		if (trace & TRACE_ROM)
+		if (rc->trace & TRACE_ROM)
 			fprintf(stderr, "RAM Bank set to %02X\n", val);
-		port30 = val;
+		rc->port30 = val;
 		return;
 	case 0x38:
-		if (trace & TRACE_ROM)
+		if (rc->trace & TRACE_ROM)
 			fprintf(stderr, "ROM Bank set to %02X\n", val);
-		port38 = val;
+		rc->port38 = val;
 		return;
 	}
 	io_write_2014(addr, val, known);
@@ -2420,14 +2595,14 @@ static uint8_t io_read_micro80(uint16_t addr)
 	if (r >= 0x10 && r <= 0x13)
 		return ctc_read(addr & 3);
 	else if (r >= 0x18 && r <= 0x1B)
-		return sio_read(sio, sio_port4[r & 3]);
+		return sio_read(rc->sio, sio_port4[r & 3]);
 	else if (r >= 0x1C && r <= 0x1F)
 		return pio_read(r & 3);
 	else if (r >= 0xEE && r <= 0xF1)
 		return z84c15_read(r);
-	else if (ide0 && r >= 0x90 && r <= 0x97)
+	else if (rc->ide0 && r >= 0x90 && r <= 0x97)
 		return my_ide_read(r & 7);
-	else if (trace & TRACE_UNK)
+	else if (rc->trace & TRACE_UNK)
 		fprintf(stderr, "Unknown read from port %04X\n", addr);
 	return 0xFF;
 }
@@ -2438,17 +2613,17 @@ static void io_write_micro80(uint16_t addr, uint8_t val)
 	if (r >= 0x10 && r <= 0x13)
 		ctc_write(addr & 3, val);
 	else if (r >= 0x18 && r <= 0x1B)
-		sio_write(sio, sio_port4[r & 3], val);
+		sio_write(rc->sio, sio_port4[r & 3], val);
 	else if (r >= 0x1C && r <= 0x1F)
 		pio_write(r & 3, val);
 	else if ((r >= 0xEE && r <= 0xF1) || r == 0xF4)
 		z84c15_write(r, val);
-	else if (ide0 && r >= 0x90 && r <= 0x97)
+	else if (rc->ide0 && r >= 0x90 && r <= 0x97)
 		my_ide_write(r & 0x07, val);
 	else if (addr == 0xFD) {
 		fprintf(stderr, "trace set to %d\n", val);
-		trace = val;
-	} else if (trace & TRACE_UNK)
+		rc->trace = val;
+	} else if (rc->trace & TRACE_UNK)
 		fprintf(stderr, "Unknown write to port %04X of %02X\n", addr, val);
 }
 
@@ -2461,15 +2636,15 @@ static void io_write_micro80w(uint16_t addr, uint8_t val)
 {
 	uint16_t r = addr & 0xFF;
 	if (r >= 0x78 && r <= 0x7B) {
-		bankreg[r & 3] = val & 0x3F;
-		if (trace & TRACE_512)
+		rc->bankreg[r & 3] = val & 0x3F;
+		if (rc->trace & TRACE_512)
 			fprintf(stderr, "Bank %d set to %d\n", r & 3, val);
 		return;
 	}
 	if (r >= 0x7C && r <= 0x7F) {
-		if (trace & TRACE_512)
+		if (rc->trace & TRACE_512)
 			fprintf(stderr, "Banking %sabled.\n", (val & 1) ? "en" : "dis");
-		bankenable = val & 1;
+		rc->bankenable = val & 1;
 		return;
 	}
 	io_write_micro80(addr, val);
@@ -2478,9 +2653,9 @@ static void io_write_micro80w(uint16_t addr, uint8_t val)
 static void io_write_pdog(uint16_t addr, uint8_t val)
 {
 	if ((addr & 0xFB) == 0x78) {	/* 78 or 7C */
-		if (cpuboard == CPUBOARD_PDOG512)
+		if (rc->cpuboard == CPUBOARD_PDOG512)
 			val &= 0x8F;
-		pick_bank = val;
+		rc->pick_bank = val;
 	} else
 		io_write_2014(addr, val, 0);
 }
@@ -2493,9 +2668,9 @@ static void io_write_pdog(uint16_t addr, uint8_t val)
 static void io_write_zrc(uint16_t addr, uint8_t val)
 {
 	if ((addr & 0xFF) == 0x1F) {
-		bankreg[1] = val & 0x3F;
+		rc->bankreg[1] = val & 0x3F;
 		if (val & 0x80)
-			rom_mapped = 0;
+			rc->rom_mapped = 0;
 	} else
 		io_write_2014(addr, val, 0);
 }
@@ -2512,9 +2687,9 @@ static void io_write_sc720(uint16_t addr, uint8_t val)
 		break;
 	case 0x78:
 		/* 0x78/79 - MMU fakery */
-		bankreg[0] = (val >> 1) & 0x1F;
-		if (trace & TRACE_512)
-			fprintf(stderr, "*** Lower bank now %02X\n", bankreg[0]);
+		rc->bankreg[0] = (val >> 1) & 0x1F;
+		if (rc->trace & TRACE_512)
+			fprintf(stderr, "*** Lower bank now %02X\n", rc->bankreg[0]);
 		return;
 	}
 	io_write_2014(addr, val, known);
@@ -2532,21 +2707,21 @@ static void io_write_sc707(uint16_t addr, uint8_t val)
 		break;
 	/* 10/18 not wired */
 	case 0x20:	/* ROM A15 */
-		bankreg[0] &= 2;
-		bankreg[0] |= val & 1;
+		rc->bankreg[0] &= 2;
+		rc->bankreg[0] |= val & 1;
 		known = 1;
 		break;
 	case 0x28:	/* ROM A16 */
-		bankreg[0] &= 1;
-		bankreg[0] |= (val & 1) << 1;
+		rc->bankreg[0] &= 1;
+		rc->bankreg[0] |= (val & 1) << 1;
 		known = 1;
 		break;
 	case 0x30:	/* RAM A16 */
-		port30 = val & 1;
+		rc->port30 = val & 1;
 		known = 1;
 		break;
 	case 0x38:	/* ROM / RAM low */
-		port38 = val & 1;
+		rc->port38 = val & 1;
 		known = 1;
 		break;
 	}
@@ -2556,7 +2731,7 @@ static void io_write_sc707(uint16_t addr, uint8_t val)
 static void io_write_tp128(uint16_t addr, uint8_t val)
 {
 	if ((addr & 0x00F0) == 0x30) {
-		port38 = val & 3;
+		rc->port38 = val & 3;
 		io_write_2014(addr, val, 1);
 	} else
 		io_write_2014(addr, val, 0);
@@ -2579,7 +2754,7 @@ static uint8_t io_read_ez512(uint16_t addr)
 		return io_read_2014(addr);
 	addr &= 0x0F;
 	if (addr == 0x0C)
-		return ez512_portc;
+		return rc->ez512_portc;
 	return kio_read(addr);
 }
 
@@ -2593,23 +2768,225 @@ static void io_write_ez512(uint16_t addr, uint8_t val)
 	/* 0x0C is the KIO port C for the bank reg */
 	/* Until emulate the KIO port bits properly */
 	if (addr == 0x0C) {
-		if (trace & TRACE_512)
-			fprintf(stderr, "Port C: %02X to %02X ", ez512_portc, val);
-		ez512_portc = val;
-		ez512_base = (val & 7) << 15;
-		ez512_base |= (val & 0x40) ? 0x40000 : 0;
-		if (trace & TRACE_512)
-			fprintf(stderr, "base now %05X ", ez512_base);
+		if (rc->trace & TRACE_512)
+			fprintf(stderr, "Port C: %02X to %02X ", rc->ez512_portc, val);
+		rc->ez512_portc = val;
+		rc->ez512_base = (val & 7) << 15;
+		rc->ez512_base |= (val & 0x40) ? 0x40000 : 0;
+		if (rc->trace & TRACE_512)
+			fprintf(stderr, "base now %05X ", rc->ez512_base);
 		
 	}
 	kio_write(addr, val);
 }
 
+/*
+ *	Emulator services
+ *
+ *	An optional paravirtual port block (off unless -V is given) that lets
+ *	guest code ask the host to do block copies and fills. There is no such
+ *	hardware so it is never enabled by default.
+ *
+ *	base + 0	W: command	R: status (0x80 busy never seen, 0x01 error)
+ *	base + 1	W: register index
+ *	base + 2	RW: register data (index auto increments)
+ *
+ *	Registers
+ *	0-2	source address (low first)
+ *	3-5	destination address
+ *	6-7	length
+ *	8	fill byte
+ *	9	mode: bit 0 source physical, bit 1 destination physical
+ *	C-F	signature 'E' 'S' 'V' version (read only)
+ *
+ *	Logical addresses go through the current memory map, physical ones are
+ *	offsets into ramrom. On completion the addresses are advanced and the
+ *	length is zero, as with LDIR.
+ */
+
+#define SVC_CMD_COPY	0x01
+#define SVC_CMD_FILL	0x02
+
+#define SVC_PHYS_SRC	0x01
+#define SVC_PHYS_DST	0x02
+
+#define SVC_ST_ERROR	0x01
+
+
+static const uint8_t svc_sig[4] = { 'E', 'S', 'V', 1 };
+
+/* Lowest physical address that is RAM on this board */
+static uint32_t svc_ram_base(void)
+{
+	switch (rc->cpuboard) {
+	case CPUBOARD_Z80:
+	case CPUBOARD_EASYZ80:
+	case CPUBOARD_TINYZ80:
+		if (rc->bank512)
+			return 524288;
+		return 8192;
+	case CPUBOARD_SC108:
+	case CPUBOARD_SC114:
+	case CPUBOARD_SC121:
+	case CPUBOARD_TP128:
+	case CPUBOARD_EASY512:
+		return 65536;
+	case CPUBOARD_MICRO80:
+	case CPUBOARD_SC707:
+		return 0x20000;
+	case CPUBOARD_PDOG128:
+		return 131072;
+	case CPUBOARD_PDOG512:
+	case CPUBOARD_SC720:
+		return 524288;
+	case CPUBOARD_MICRO80W:
+		return 32 << 14;
+	default:
+		/* ZRC, ZRCC and SBC64 are all RAM */
+		return 0;
+	}
+}
+
+static uint32_t svc_addr(unsigned r)
+{
+	return rc->svc_reg[r] | (rc->svc_reg[r + 1] << 8) | (rc->svc_reg[r + 2] << 16);
+}
+
+static void svc_set_addr(unsigned r, uint32_t addr)
+{
+	rc->svc_reg[r] = addr;
+	rc->svc_reg[r + 1] = addr >> 8;
+	rc->svc_reg[r + 2] = addr >> 16;
+}
+
+/* Check a physical range lies within ramrom (and RAM if writing) */
+static int svc_phys_ok(uint32_t addr, unsigned len, unsigned wr)
+{
+	if (addr + len > sizeof(rc->ramrom))
+		return 0;
+	if (wr && addr < svc_ram_base())
+		return 0;
+	return 1;
+}
+
+static void svc_command(uint8_t cmd)
+{
+	uint32_t src = svc_addr(0);
+	uint32_t dst = svc_addr(3);
+	unsigned len = rc->svc_reg[6] | (rc->svc_reg[7] << 8);
+	uint8_t mode = rc->svc_reg[9];
+	unsigned i;
+
+	rc->svc_status = 0;
+	rc->svc_index = 0;
+	/* The physical paths store straight into ramrom */
+	rc->idle_dirty = 1;
+
+	if (cmd != SVC_CMD_COPY && cmd != SVC_CMD_FILL) {
+		rc->svc_status = SVC_ST_ERROR;
+		return;
+	}
+	if (cmd == SVC_CMD_FILL)
+		mode &= ~SVC_PHYS_SRC;
+	if (rc->trace & TRACE_SVC)
+		fprintf(stderr, "svc: %s %06X%s -> %06X%s len %04X\n",
+			cmd == SVC_CMD_COPY ? "copy" : "fill",
+			src, (mode & SVC_PHYS_SRC) ? "P" : "",
+			dst, (mode & SVC_PHYS_DST) ? "P" : "", len);
+
+	if (((mode & SVC_PHYS_SRC) && !svc_phys_ok(src, len, 0)) ||
+	    ((mode & SVC_PHYS_DST) && !svc_phys_ok(dst, len, 1))) {
+		rc->svc_status = SVC_ST_ERROR;
+		return;
+	}
+
+	if (cmd == SVC_CMD_FILL) {
+		if (mode & SVC_PHYS_DST)
+			memset(rc->ramrom + dst, rc->svc_reg[8], len);
+		else for (i = 0; i < len; i++)
+			mem_write(0, dst + i, rc->svc_reg[8]);
+	} else if ((mode & (SVC_PHYS_SRC | SVC_PHYS_DST)) == (SVC_PHYS_SRC | SVC_PHYS_DST))
+		memmove(rc->ramrom + dst, rc->ramrom + src, len);
+	else if ((mode & SVC_PHYS_SRC) == 0 && (mode & SVC_PHYS_DST) == 0 &&
+		 dst > src && dst < src + len) {
+		/* Overlapping logical copy upwards, work backwards like memmove */
+		for (i = len; i > 0; i--)
+			mem_write(0, dst + i - 1, do_mem_read(src + i - 1, 1));
+	} else {
+		for (i = 0; i < len; i++) {
+			uint8_t c;
+			if (mode & SVC_PHYS_SRC)
+				c = rc->ramrom[src + i];
+			else
+				c = do_mem_read(src + i, 1);
+			if (mode & SVC_PHYS_DST)
+				rc->ramrom[dst + i] = c;
+			else
+				mem_write(0, dst + i, c);
+		}
+	}
+	/* Logical addresses wrap in the 64K space like the CPU */
+	if (mode & SVC_PHYS_SRC)
+		src += len;
+	else
+		src = (src + len) & 0xFFFF;
+	if (mode & SVC_PHYS_DST)
+		dst += len;
+	else
+		dst = (dst + len) & 0xFFFF;
+	if (cmd == SVC_CMD_COPY)
+		svc_set_addr(0, src);
+	svc_set_addr(3, dst);
+	rc->svc_reg[6] = 0;
+	rc->svc_reg[7] = 0;
+	/* Charge the guest for the work */
+	rc->cpu_z80.tstates += len * rc->svc_cost;
+}
+
+static uint8_t svc_read(uint8_t addr)
+{
+	uint8_t r;
+	switch (addr & 3) {
+	case 0:
+		return rc->svc_status;
+	case 2:
+		if (rc->svc_index >= 12)
+			r = svc_sig[rc->svc_index - 12];
+		else
+			r = rc->svc_reg[rc->svc_index];
+		rc->svc_index = (rc->svc_index + 1) & 15;
+		return r;
+	}
+	return 0xFF;
+}
+
+static void svc_write(uint8_t addr, uint8_t val)
+{
+	switch (addr & 3) {
+	case 0:
+		svc_command(val);
+		break;
+	case 1:
+		rc->svc_index = val & 15;
+		break;
+	case 2:
+		if (rc->svc_index < 12)
+			rc->svc_reg[rc->svc_index] = val;
+		rc->svc_index = (rc->svc_index + 1) & 15;
+		break;
+	}
+}
+
 void io_write(int unused, uint16_t addr, uint8_t val)
 {
-	switch (cpuboard) {
+	rc->idle_dirty = 1;
+	if (rc->svc_port && (addr & 0xFC) == rc->svc_port) {
+		svc_write(addr, val);
+		return;
+	}
+	switch (rc->cpuboard) {
 	case CPUBOARD_Z80:
-		if (extreme)
+		if (rc->extreme)
 			io_write_2014_x(addr, val, 0);
 		else
 			io_write_2014(addr, val, 0);
@@ -2663,9 +3040,11 @@ void io_write(int unused, uint16_t addr, uint8_t val)
 	}
 }
 
-uint8_t io_read(int unused, uint16_t addr)
+static uint8_t do_io_read(uint16_t addr)
 {
-	switch (cpuboard) {
+	if (rc->svc_port && (addr & 0xFC) == rc->svc_port)
+		return svc_read(addr);
+	switch (rc->cpuboard) {
 	case CPUBOARD_Z80:
 	case CPUBOARD_SC108:
 	case CPUBOARD_PDOG128:
@@ -2674,7 +3053,7 @@ uint8_t io_read(int unused, uint16_t addr)
 	case CPUBOARD_SC720:
 	case CPUBOARD_SC707:
 	case CPUBOARD_TP128:
-		if (extreme)
+		if (rc->extreme)
 			return io_read_2014_x(addr);
 		else
 			return io_read_2014(addr);
@@ -2701,34 +3080,40 @@ uint8_t io_read(int unused, uint16_t addr)
 	}
 }
 
+uint8_t io_read(int unused, uint16_t addr)
+{
+	if (rc->idle_detect)
+		return idle_track_io(addr, do_io_read(addr));
+	return do_io_read(addr);
+}
+
 /* Work out what our interrupt should look like */
 static void set_interrupt(void)
 {
-	static unsigned last_nim2 = 0x100;
-	if (live_irq) {
-		Z80INT(&cpu_z80, intvec);
+	if (rc->live_irq) {
+		Z80INT(&rc->cpu_z80, rc->intvec);
 		return;
 	}
-	if (last_nim2 != live_nonim2 && (trace & TRACE_IRQ)) {
-		fprintf(stderr, "nonim2 now %x\n", live_nonim2);
-		last_nim2 = live_nonim2;
+	if (rc->last_nim2 != rc->live_nonim2 && (rc->trace & TRACE_IRQ)) {
+		fprintf(stderr, "nonim2 now %x\n", rc->live_nonim2);
+		rc->last_nim2 = rc->live_nonim2;
 	}
-	if (live_nonim2)
-		Z80INT(&cpu_z80, 0x78);	/* Really rather random */
+	if (rc->live_nonim2)
+		Z80INT(&rc->cpu_z80, 0x78);	/* Really rather random */
 	else
-		Z80NOINT(&cpu_z80);
+		Z80NOINT(&rc->cpu_z80);
 }
 
 /* Generic style interrupts */
 static void poll_irq_nonim2(void)
 {
-	live_nonim2 = 0;
-	if (acia && acia_irq_pending(acia))
-		live_nonim2 |= IRQM_ACIA;
-	if (uart && uart16x50_irq_pending(uart))
-		live_nonim2 |= IRQM_16X50;
-	if (vdp && tms9918a_irq_pending(vdp))
-		live_nonim2 |= IRQM_VDP;
+	rc->live_nonim2 = 0;
+	if (rc->acia && acia_irq_pending(rc->acia))
+		rc->live_nonim2 |= IRQM_ACIA;
+	if (rc->uart && uart16x50_irq_pending(rc->uart))
+		rc->live_nonim2 |= IRQM_16X50;
+	if (rc->vdp && tms9918a_irq_pending(rc->vdp))
+		rc->live_nonim2 |= IRQM_VDP;
 	set_interrupt();
 }
 
@@ -2736,23 +3121,23 @@ static void poll_irq_nonim2(void)
 static void poll_irq_event(void)
 {
 	int v = -1;
-	if (have_im2) {
-		if (!live_irq) {
-			if (sio)
-				v = sio_check_im2(sio);
+	if (rc->have_im2) {
+		if (!rc->live_irq) {
+			if (rc->sio)
+				v = sio_check_im2(rc->sio);
 			if (v == -1)
 				ctc_check_im2();
 			else {
-				intvec = v;
-				live_irq = IRQ_SIO;
+				rc->intvec = v;
+				rc->live_irq = IRQ_SIO;
 			}
 		}
 	} else {
-		if (sio)
-			v = sio_check_im2(sio);
+		if (rc->sio)
+			v = sio_check_im2(rc->sio);
 		if (v != -1) {
-			intvec = v;
-			live_irq = IRQ_SIO;
+			rc->intvec = v;
+			rc->live_irq = IRQ_SIO;
 		}
 		ctc_check_im2();
 	}
@@ -2767,18 +3152,18 @@ void recalc_interrupts(void)
 
 static void reti_event(void)
 {
-	if (live_irq && (trace & TRACE_IRQ))
+	if (rc->live_irq && (rc->trace & TRACE_IRQ))
 		fprintf(stderr, "RETI\n");
-	if (have_im2) {
-		switch(live_irq) {
+	if (rc->have_im2) {
+		switch(rc->live_irq) {
 		case IRQ_SIO:
-			sio_reti(sio);
+			sio_reti(rc->sio);
 			break;
 		case IRQ_CTC:
 		case IRQ_CTC + 1:
 		case IRQ_CTC + 2:
 		case IRQ_CTC + 3:
-			ctc_reti(live_irq - IRQ_CTC);
+			ctc_reti(rc->live_irq - IRQ_CTC);
 			break;
 		}
 	} else {
@@ -2787,45 +3172,204 @@ static void reti_event(void)
 		   that */
 		/* TODO: KIO internally is consistent for IEI/IEO even if
 		   IM2 isn't being used */
-		if (sio || have_kio || have_kio_ext) {
-			sio_reti(sio);
+		if (rc->sio || rc->have_kio || rc->have_kio_ext) {
+			sio_reti(rc->sio);
 		}
-		if (have_ctc || have_kio || have_kio_ext) {
+		if (rc->have_ctc || rc->have_kio || rc->have_kio_ext) {
 			ctc_reti(0);
 			ctc_reti(1);
 			ctc_reti(2);
 			ctc_reti(3);
 		}
 	}
-	live_irq = 0;
+	rc->live_irq = 0;
 	poll_irq_event();
 }
 
-static struct termios saved_term, term;
+/* Run the per slice device work */
+static void slice_devices(void)
+{
+	unsigned c;
+
+	if (rc->ef9345)
+		ef9345_cycles(rc->ef9345, 200);
+	for (c = 0; c < rc->ncopro; c++)
+		z180copro_run(rc->copro[c]);
+	if (rc->ps2)
+		ps2_event(rc->ps2, (rc->tstate_steps + 5) / 10);
+	if (rc->acia)
+		acia_timer(rc->acia);
+	if (rc->sio)
+		sio_timer(rc->sio);
+	if (rc->have_16x50)
+		uart16x50_event(rc->uart);
+	if (rc->have_cpld_serial)
+		sbc64_cpld_timer();
+	poll_irq_nonim2();
+}
+
+/* Run a slice of CPU time less whatever the DMA controller takes */
+static void cpu_slice(unsigned tstates)
+{
+	if (rc->dma && z80dma_busy(rc->dma)) {
+		/* It may be writing memory the CPU is polling */
+		rc->idle_dirty = 1;
+		tstates = z80_dma_run(rc->dma, tstates);
+	}
+	Z80ExecuteTStates(&rc->cpu_z80, tstates);
+}
+
+/* Is the CPU waiting on an external event */
+static int cpu_idle(void)
+{
+	if (rc->dma && z80dma_busy(rc->dma))
+		return 0;
+	/* Halted and the interrupt that will wake it is not yet here */
+	if (rc->cpu_z80.halted && rc->cpu_z80.IFF1 && !rc->cpu_z80.int_req &&
+	    !rc->cpu_z80.nmi_req)
+		return 1;
+	return rc->idle_detect && rc->idle_count >= IDLE_SLICES;
+}
+
+/* Run an idle slice. A halted CPU is still run (libz80 skips the HALT
+   cycles in one go) so R and timing stay exact, a polling loop is not.
+   The devices are serviced every slice as usual so serial and timers
+   keep their rate. This calls the CPU directly rather than via
+   cpu_slice() which is only safe because cpu_idle() never reports idle
+   while the DMA is busy */
+static void idle_run(void)
+{
+	if (rc->cpu_z80.halted)
+		Z80ExecuteTStates(&rc->cpu_z80, (rc->tstate_steps + 5) / 10);
+	slice_devices();
+}
+
+/*
+ *	The console as the UARTs see it. The UART models leave a byte in the
+ *	host fd until the guest reads it, so we note when input has been seen
+ *	but not yet taken. Waking for the console then would just spin.
+ */
+
+static unsigned idle_con_ready(struct serial_device *d)
+{
+	struct rc2014 *m = d->private;
+	unsigned r = m->con->ready(m->con);
+	if (r & 1)
+		m->con_unread = 1;
+	return r;
+}
+
+static uint8_t idle_con_get(struct serial_device *d)
+{
+	struct rc2014 *m = d->private;
+	m->con_unread = 0;
+	return m->con->get(m->con);
+}
 
-static void cleanup(int sig)
+static void idle_con_put(struct serial_device *d, uint8_t c)
 {
-	tcsetattr(0, TCSADRAIN, &saved_term);
-	emulator_done = 1;
+	struct rc2014 *m = d->private;
+	m->con->put(m->con, c);
 }
 
-static void exit_cleanup(void)
+
+/* Can a byte of host input reach the guest right now */
+static int console_can_accept(void)
 {
-	tcsetattr(0, TCSADRAIN, &saved_term);
+	if (rc->con_eof)
+		return 0;
+	if (rc->have_cpld_serial)
+		return !(rc->sbc64_cpld_status & 1);
+	return !rc->con_unread;
+}
+
+#define FRAME_NS	20000000ULL
+
+static uint64_t host_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Pace each frame against an absolute deadline so emulation time is not
+   added on top of the frame time. If the CPU is waiting for something we
+   also wake early when the console or network has input for it, but only
+   when we are not already ahead of the wall clock, so a console at EOF or
+   a flood of input can never make us run faster than real time. */
+static void frame_sync(int idle)
+{
+	uint64_t now = host_ns();
+	uint64_t left;
+	fd_set rd, wr;
+	struct timeval tv;
+	int max_fd;
+	int n;
+
+	if (rc->deadline == 0 || now > rc->deadline + 4 * FRAME_NS)
+		rc->deadline = now;
+	rc->deadline += FRAME_NS;
+	if (now + FRAME_NS < rc->deadline)
+		idle = 0;
+
+	while ((now = host_ns()) < rc->deadline) {
+		left = rc->deadline - now;
+		FD_ZERO(&rd);
+		FD_ZERO(&wr);
+		max_fd = -1;
+		if (idle && console_can_accept()) {
+			FD_SET(0, &rd);
+			max_fd = 0;
+		}
+		if (idle && rc->have_wiznet) {
+			n = w5100_add_fds(rc->wiz, &rd, &wr);
+			if (n > max_fd)
+				max_fd = n;
+		}
+		tv.tv_sec = left / 1000000000ULL;
+		tv.tv_usec = (left % 1000000000ULL) / 1000;
+		n = select(max_fd + 1, &rd, &wr, NULL, &tv);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("select");
+			exit(1);
+		}
+		if (n == 0)
+			break;
+		/* Readable with nothing to read is end of file */
+		if (FD_ISSET(0, &rd)) {
+			int avail = 0;
+			if (ioctl(0, FIONREAD, &avail) == -1 || avail == 0) {
+				rc->con_eof = 1;
+				n--;
+			}
+		}
+		if (n > 0)
+			break;
+	}
 }
 
 static void usage(void)
 {
-	fprintf(stderr, "rc2014: [-a] [-A] [-b] [-c] [-f] [-i idepath] [-R] [-m mainboard] [-r rompath] [-e rombank] [-s] [-w] [-d debug]\n");
+	fprintf(stderr, "rc2014: [-a] [-A] [-b] [-c] [-D] [-f] [-i idepath] [-R] [-m mainboard] [-r rompath] [-e rombank] [-s] [-w] [-d debug] [-L] [-C] [-t] [-V port[,cost]]\n"
+		"  -C adds a Z180 co-processor card, up to four at 0x08, 0x18, 0x50, 0x60.\n"
+		"     With -S the SD card is attached to the first card only.\n");
 	exit(EXIT_FAILURE);
 }
 
-int main(int argc, char *argv[])
+
+/*
+ *	Build a machine from the rc2014 command line options. The primary
+ *	serial port is wired to con, the others get vtcon terminals. Bad
+ *	options are reported and exit as they always have.
+ */
+struct rc2014 *rc2014_create(int argc, char *argv[], struct serial_device *con)
 {
-	static struct timespec tc;
-	static const char *sasipath = NULL;
+	const char *sasipath = NULL;
 	int opt;
 	int fd;
+	unsigned n;
 	int rom = 1;
 	int rombank = 0;
 	char *rompath = "rc2014.rom";
@@ -2843,26 +3387,59 @@ int main(int argc, char *argv[])
 #define INDEV_16C550A	4
 #define INDEV_KIO	5
 
-	uint8_t *p = ramrom;
-	while (p < ramrom + sizeof(ramrom))
+	uint8_t *p;
+
+	rc = calloc(1, sizeof(struct rc2014));
+	if (rc == NULL) {
+		fprintf(stderr, "rc2014: out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	rc->switchrom = 1;
+	rc->romsize = 65536;
+	rc->rom_mapped = 1;
+	rc->tstate_steps = 365;	/* RC2014 speed */
+	rc->last_nim2 = 0x100;
+	rc->lastpc = -1;
+	rc->idle_last_port = -1;
+	rc->sd_clock = 0x10;
+	rc->sd_mosi = 0x01;
+	rc->sd_miso = 0x80;
+	rc->sd_port = 1;
+	rc->spi_old = 0xFF;
+	rc->spi_oldcs = 1;
+	rc->spi_rxbits = 0xFF;
+	rc->svc_cost = 1;
+	rc->save_fd = -1;
+
+	rc->con = con;
+	rc->idle_console.name = "Console";
+	rc->idle_console.private = rc;
+	rc->idle_console.get = idle_con_get;
+	rc->idle_console.put = idle_con_put;
+	rc->idle_console.ready = idle_con_ready;
+
+	p = rc->ramrom;
+	while (p < rc->ramrom + sizeof(rc->ramrom))
 		*p++= rand();
 
-	while ((opt = getopt(argc, argv, "19Aabcd:e:EfF:i:I:km:nN:pPr:sRS:Tuw8CZz:X")) != -1) {
+	/* We may be asked for several machines */
+	optind = 1;
+	while ((opt = getopt(argc, argv, "19AabcDd:e:EfF:i:I:kLm:nN:pPr:sRS:tTuw8CV:Zz:X")) != -1) {
 		switch (opt) {
 		case 'a':
 			have_acia = 1;
 			indev = INDEV_ACIA;
-			acia_narrow = 0;
+			rc->acia_narrow = 0;
 			sio2 = 0;
 			break;
 		case 'A':
 			have_acia = 1;
-			acia_narrow = 1;
+			rc->acia_narrow = 1;
 			indev = INDEV_ACIA;
 			break;
 		case '8':
 			have_acia = 1;
-			acia_narrow = 2;
+			rc->acia_narrow = 2;
 			indev = INDEV_ACIA;
 			sio2 = 0;
 			break;
@@ -2872,196 +3449,196 @@ int main(int argc, char *argv[])
 		case 's':
 			sio2 = 1;
 			indev = INDEV_SIO;
-			if (!acia_narrow)
+			if (!rc->acia_narrow)
 				have_acia = 0;
 			break;
 		case 'S':
 			sdpath = optarg;
-			have_pio = 1;
+			rc->have_pio = 1;
 			break;
 		case 'e':
 			rombank = atoi(optarg);
 			break;
 		case 'E':
-			have_ef9345 = 1;
+			rc->have_ef9345 = 1;
 			break;
 		case 'b':
-			bank512 = 1;
-			switchrom = 0;
+			rc->bank512 = 1;
+			rc->switchrom = 0;
 			rom = 0;
 			break;
 		case 'p':
-			bankenable = 1;
+			rc->bankenable = 1;
 			break;
 		case 'P':
-			have_ps2 = 1;
+			rc->have_ps2 = 1;
 			break;
 		case 'i':
-			ide = 1;
+			rc->ide = 1;
 			idepath = optarg;
 			break;
 		case 'I':
-			ide = 2;
+			rc->ide = 2;
 			idepath = optarg;
 			break;
 		case 'c':
-			have_ctc = 1;
+			rc->have_ctc = 1;
 			break;
 		case 'u':
 		case '1':
-			have_16x50 = 1;
+			rc->have_16x50 = 1;
 			indev = INDEV_16C550A;
 			break;
 		case 'k':
-			have_kio = 1;
+			rc->have_kio = 1;
 			break;
 		case 'm':
 			/* Default Z80 board */
 			if (strcmp(optarg, "z80") == 0)
-				cpuboard = CPUBOARD_Z80;
+				rc->cpuboard = CPUBOARD_Z80;
 			else if (strcmp(optarg, "sc108") == 0) {
-				switchrom = 0;
-				bank512 = 0;
-				cpuboard = CPUBOARD_SC108;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
+				rc->cpuboard = CPUBOARD_SC108;
 			} else if (strcmp(optarg, "sc114") == 0) {
-				switchrom = 0;
-				bank512 = 0;
-				cpuboard = CPUBOARD_SC114;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
+				rc->cpuboard = CPUBOARD_SC114;
 			} else if (strcmp(optarg, "sc516") == 0) {
-				switchrom = 0;
-				bank512 = 0;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
 				/* Same as the 114 but on z50bus */
-				cpuboard = CPUBOARD_SC114;
+				rc->cpuboard = CPUBOARD_SC114;
 			} else if (strcmp(optarg, "z80sbc64") == 0) {
-				switchrom = 0;
-				bank512 = 0;
-				cpuboard = CPUBOARD_Z80SBC64;
-				bankreg[0] = 3;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
+				rc->cpuboard = CPUBOARD_Z80SBC64;
+				rc->bankreg[0] = 3;
 			} else if (strcmp(optarg, "z80mb64") == 0) {
-				switchrom = 0;
-				bank512 = 0;
-				cpuboard = CPUBOARD_Z80SBC64;
-				bankreg[0] = 3;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
+				rc->cpuboard = CPUBOARD_Z80SBC64;
+				rc->bankreg[0] = 3;
 				/* Triple RC2014 rate */
-				tstate_steps *= 3;
+				rc->tstate_steps *= 3;
 			} else if (strcmp(optarg, "easyz80") == 0) {
-				bank512 = 1;
-				cpuboard = CPUBOARD_EASYZ80;
-				switchrom = 0;
+				rc->bank512 = 1;
+				rc->cpuboard = CPUBOARD_EASYZ80;
+				rc->switchrom = 0;
 				rom = 0;
 				have_acia = 0;
-				have_ctc = 1;
+				rc->have_ctc = 1;
 				sio2 = 1;
 				indev = INDEV_SIO;
-				have_im2 = 1;
-				tstate_steps = 400;
+				rc->have_im2 = 1;
+				rc->tstate_steps = 400;
 			} else if (strcmp(optarg, "sc121") == 0) {
-				switchrom = 0;
-				bank512 = 0;
-				cpuboard = CPUBOARD_SC121;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
+				rc->cpuboard = CPUBOARD_SC121;
 				sio2 = 1;
 				indev = INDEV_SIO;
-				have_ctc = 1;
+				rc->have_ctc = 1;
 				rom = 0;
 				have_acia = 0;
-				have_im2 = 1;
+				rc->have_im2 = 1;
 				/* FIXME: SC122 is four ports */
 			} else if (strcmp(optarg, "micro80") == 0) {
-				cpuboard = CPUBOARD_MICRO80;
-				have_ctc = 1;
+				rc->cpuboard = CPUBOARD_MICRO80;
+				rc->have_ctc = 1;
 				sio2 = 1;
 				indev = INDEV_SIO;
-				have_im2 = 1;
+				rc->have_im2 = 1;
 				have_acia = 0;
 				rom = 1;
-				switchrom = 0;
-				tstate_steps = 800;	/* 16MHz */
+				rc->switchrom = 0;
+				rc->tstate_steps = 800;	/* 16MHz */
 			} else if (strcmp(optarg, "zrcc") == 0) {
-				switchrom = 0;
-				bank512 = 0;
-				cpuboard = CPUBOARD_ZRCC;
-				bankreg[0] = 3;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
+				rc->cpuboard = CPUBOARD_ZRCC;
+				rc->bankreg[0] = 3;
 				/* 22MHz CPU */
-				tstate_steps *= 3;
+				rc->tstate_steps *= 3;
 			} else if (strcmp(optarg, "tinyz80") == 0) {
-				bank512 = 1;
-				cpuboard = CPUBOARD_TINYZ80;
-				switchrom = 0;
+				rc->bank512 = 1;
+				rc->cpuboard = CPUBOARD_TINYZ80;
+				rc->switchrom = 0;
 				rom = 0;
 				have_acia = 0;
-				have_ctc = 1;
+				rc->have_ctc = 1;
 				sio2 = 1;
 				indev = INDEV_SIO;
-				have_im2 = 1;
-				tstate_steps = 500;
+				rc->have_im2 = 1;
+				rc->tstate_steps = 500;
 				indev = INDEV_SIO;
 			} else if (strcmp(optarg, "pdog128") == 0) {
-				cpuboard = CPUBOARD_PDOG128;
-				switchrom = 0;
-				bank512 = 0;
-				romsize = 131072;
+				rc->cpuboard = CPUBOARD_PDOG128;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
+				rc->romsize = 131072;
 				rom = 1;
 			} else if (strcmp(optarg, "pdog512") == 0) {
-				cpuboard = CPUBOARD_PDOG512;
-				switchrom = 0;
-				bank512 = 0;
-				romsize = 524288;
+				rc->cpuboard = CPUBOARD_PDOG512;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
+				rc->romsize = 524288;
 				rom = 1;
 			} else if (strcmp(optarg, "micro80w") == 0) {
-				cpuboard = CPUBOARD_MICRO80W;
-				have_ctc = 1;
+				rc->cpuboard = CPUBOARD_MICRO80W;
+				rc->have_ctc = 1;
 				sio2 = 1;
 				indev = INDEV_SIO;
-				have_im2 = 1;
+				rc->have_im2 = 1;
 				have_acia = 0;
 				rom = 1;
-				switchrom = 0;
-				tstate_steps = 1100;	/* 22MHz */
+				rc->switchrom = 0;
+				rc->tstate_steps = 1100;	/* 22MHz */
 			} else if (strcmp(optarg, "zrc") == 0) {
-				switchrom = 0;
-				bank512 = 0;
-				cpuboard = CPUBOARD_ZRC;
-				bankreg[1] = 0x3F;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
+				rc->cpuboard = CPUBOARD_ZRC;
+				rc->bankreg[1] = 0x3F;
 				/* 14MHz CPU */
-				tstate_steps *= 2;
+				rc->tstate_steps *= 2;
 				have_acia = 1;
 				indev = INDEV_ACIA;
 			} else if (strcmp(optarg, "sc720") == 0) {
-				switchrom = 0;
-				bank512 = 1;	/* Its 512/512 but a subset */
-				cpuboard = CPUBOARD_SC720;
+				rc->switchrom = 0;
+				rc->bank512 = 1;	/* Its 512/512 but a subset */
+				rc->cpuboard = CPUBOARD_SC720;
 				sio2 = 1;
 				indev = INDEV_SIO;
 				have_acia = 0;
 			} else if (strcmp(optarg, "sc707") == 0) {
-				switchrom = 0;
-				bank512 = 0;
-				cpuboard = CPUBOARD_SC707;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
+				rc->cpuboard = CPUBOARD_SC707;
 			} else if (strcmp(optarg, "sc519") == 0) {
 				/* Same as 707 on Z50bus */
-				switchrom = 0;
-				bank512 = 0;
-				cpuboard = CPUBOARD_SC707;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
+				rc->cpuboard = CPUBOARD_SC707;
 			} else if (strcmp(optarg, "tp128") == 0) {
-				switchrom = 0;
-				bank512 = 0;
+				rc->switchrom = 0;
+				rc->bank512 = 0;
 				rom = 1;
-				romsize = 32768;
-				cpuboard = CPUBOARD_TP128;
+				rc->romsize = 32768;
+				rc->cpuboard = CPUBOARD_TP128;
 			} else if (strcmp(optarg, "easy512") == 0) {
-				switchrom = 0;
-				have_kio_ext = 1;
-				bank512 = 0;
+				rc->switchrom = 0;
+				rc->have_kio_ext = 1;
+				rc->bank512 = 0;
 				rom = 1;
 				indev = INDEV_SIO;
 				sio2 = 1;
 				have_acia = 0;
-				tstate_steps = 1100;	/* 22MHz TODO */
-				cpuboard = CPUBOARD_EASY512;
+				rc->tstate_steps = 1100;	/* 22MHz TODO */
+				rc->cpuboard = CPUBOARD_EASY512;
 				/* FIXME: actually 0 and pulled up but need
 				   to finish KIO emulation to sort */
-				ez512_portc = 0x20;
-				have_im2 = 1;
+				rc->ez512_portc = 0x20;
+				rc->have_im2 = 1;
 				indev = INDEV_SIO;
 			} else {
 				fputs(
@@ -3073,25 +3650,35 @@ int main(int argc, char *argv[])
 			}
 			break;
 		case 'n':
-			have_busstop = 1;
+			rc->have_busstop = 1;
 			break;
 		case 'N':
 			sasipath = optarg;
 			break;
 		case 'd':
-			trace = atoi(optarg);
+			rc->trace = atoi(optarg);
+			break;
+		case 'D':
+			rc->have_dma = 1;
 			break;
 		case 'f':
-			fast = 1;
+			rc->fast = 1;
 			break;
 		case 'R':
-			rtc = rtc_create();
+			rc->rtc = rtc_create();
 			break;
 		case 'w':
-			have_wiznet = 1;
+			rc->have_wiznet = 1;
 			break;
 		case 'C':
-			have_copro = 1;
+			if (rc->have_copro == MAX_COPRO) {
+				fprintf(stderr, "rc2014: too many co-processor cards.\n");
+				exit(EXIT_FAILURE);
+			}
+			rc->have_copro++;
+			break;
+		case 't':
+			rc->copro_threads = 1;
 			break;
 		case 'F':
 			if (pathb) {
@@ -3104,22 +3691,37 @@ int main(int argc, char *argv[])
 				patha = optarg;
 			break;
 		case 'Z':
-			is_z512 = 1;
+			rc->is_z512 = 1;
 			break;
 		case 'z':
-			zxkey = zxkey_create(atoi(optarg));
+			rc->zxkey = zxkey_create(atoi(optarg));
 			break;
 		case 'T':
-			have_tms = 1;
+			rc->have_tms = 1;
 			break;
 		case '9':
-			if (amd9511 == NULL)
-				amd9511 = amd9511_create();
+			if (rc->amd9511 == NULL)
+				rc->amd9511 = amd9511_create();
 			break;
 		case 'X':
-			extreme = 1;
-			have_kio_ext = 1;
+			rc->extreme = 1;
+			rc->have_kio_ext = 1;
+			break;
+		case 'L':
+			rc->idle_detect = 1;
+			break;
+		case 'V':
+		{
+			char *ep;
+			rc->svc_port = strtoul(optarg, &ep, 0) & 0xFC;
+			if (*ep == ',')
+				rc->svc_cost = strtoul(ep + 1, NULL, 0);
+			if (rc->svc_port == 0) {
+				fprintf(stderr, "rc2014: emulator services cannot be at port 0.\n");
+				exit(EXIT_FAILURE);
+			}
 			break;
+		}
 		default:
 			usage();
 		}
@@ -3127,46 +3729,59 @@ int main(int argc, char *argv[])
 	if (optind < argc)
 		usage();
 
-	ui_init();
+	/* The co-processor cards are decoded first and would hide anything
+	   else in their range */
+	if (rc->svc_port) {
+		for (n = 0; n < rc->have_copro; n++) {
+			if ((rc->svc_port & 0xF8) == copro_port[n]) {
+				fprintf(stderr, "rc2014: emulator services port clashes with co-processor card %u.\n", n);
+				exit(EXIT_FAILURE);
+			}
+		}
+		if (rc->have_dma && rc->svc_port == 0x04) {
+			fprintf(stderr, "rc2014: emulator services port clashes with the Z80 DMA at 0x04.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
 
-	if (have_kio) {
+	if (rc->have_kio) {
 		sio2 = 1;
-		have_ctc = 0;
-		have_pio = 0;
-		have_im2 = 1;
+		rc->have_ctc = 0;
+		rc->have_pio = 0;
+		rc->have_im2 = 1;
 		indev = INDEV_SIO;
 	}
-	if (cpuboard == CPUBOARD_Z80SBC64 || cpuboard == CPUBOARD_ZRCC) {
-		have_cpld_serial = 1;
+	if (rc->cpuboard == CPUBOARD_Z80SBC64 || rc->cpuboard == CPUBOARD_ZRCC) {
+		rc->have_cpld_serial = 1;
 		indev = INDEV_CPLD;
-	} else if (have_acia == 0 && sio2 == 0 && have_16x50 == 0 ) {
-		if (cpuboard != 3) {
+	} else if (have_acia == 0 && sio2 == 0 && rc->have_16x50 == 0 ) {
+		if (rc->cpuboard != 3) {
 			fprintf(stderr, "rc2014: no UART selected, defaulting to 68B50\n");
 			have_acia = 1;
 			indev = INDEV_ACIA;
 		}
 	}
-	if (rom == 0 && bank512 == 0) {
+	if (rom == 0 && rc->bank512 == 0) {
 		fprintf(stderr, "rc2014: no ROM\n");
 		exit(EXIT_FAILURE);
 	}
 
-	if (rom && cpuboard != CPUBOARD_Z80SBC64 && cpuboard != CPUBOARD_ZRCC 
-		&& cpuboard != CPUBOARD_ZRC) {
+	if (rom && rc->cpuboard != CPUBOARD_Z80SBC64 && rc->cpuboard != CPUBOARD_ZRCC 
+		&& rc->cpuboard != CPUBOARD_ZRC) {
 		fd = open(rompath, O_RDONLY);
 		if (fd == -1) {
 			perror(rompath);
 			exit(EXIT_FAILURE);
 		}
-		bankreg[0] = 0;
-		bankreg[1] = 1;
-		bankreg[2] = 32;
-		bankreg[3] = 33;
+		rc->bankreg[0] = 0;
+		rc->bankreg[1] = 1;
+		rc->bankreg[2] = 32;
+		rc->bankreg[3] = 33;
 		if (lseek(fd, 8192 * rombank, SEEK_SET) < 0) {
 			perror("lseek");
 			exit(1);
 		}
-		if (read(fd, ramrom, romsize) < 8192) {
+		if (read(fd, rc->ramrom, rc->romsize) < 8192) {
 			fprintf(stderr, "rc2014: short rom '%s'.\n", rompath);
 			exit(EXIT_FAILURE);
 		}
@@ -3187,7 +3802,7 @@ int main(int argc, char *argv[])
 
 	   Mark states read only with chmod and it won't save back */
 
-	if (cpuboard == CPUBOARD_Z80SBC64) {
+	if (rc->cpuboard == CPUBOARD_Z80SBC64) {
 		int len;
 		save = 1;
 		fd = open(rompath, O_RDWR);
@@ -3201,204 +3816,213 @@ int main(int argc, char *argv[])
 		}
 		/* Could be a short bank 3 save for bootstrapping or a full
 		   save from the emulator exit */
-		len = read(fd, ramrom, 4 * 0x8000);
+		len = read(fd, rc->ramrom, 4 * 0x8000);
 		if (len < 4 * 0x8000) {
 			if (len < 255) {
 				fprintf(stderr, "rc2014:short ram '%s'.\n", rompath);
 				exit(EXIT_FAILURE);
 			}
-			memmove(ramrom + 3 * 0x8000, ramrom, 32768);
+			memmove(rc->ramrom + 3 * 0x8000, rc->ramrom, 32768);
 			printf("[loaded bank 3 only]\n");
 		}
+		if (save)
+			rc->save_fd = fd;
 	}
 
-	if (cpuboard == CPUBOARD_MICRO80 || cpuboard == CPUBOARD_MICRO80W || cpuboard == CPUBOARD_TINYZ80)
+	if (rc->cpuboard == CPUBOARD_MICRO80 || rc->cpuboard == CPUBOARD_MICRO80W || rc->cpuboard == CPUBOARD_TINYZ80)
 		z84c15_init();
 
-	if (bank512) {
+	if (rc->bank512) {
 		fd = open(rompath, O_RDONLY);
 		if (fd == -1) {
 			perror(rompath);
 			exit(EXIT_FAILURE);
 		}
-		if (read(fd, ramrom, 524288) != 524288) {
+		if (read(fd, rc->ramrom, 524288) != 524288) {
 			fprintf(stderr, "rc2014: banked rom image should be 512K.\n");
 			exit(EXIT_FAILURE);
 		}
-		bankenable = 1;
+		rc->bankenable = 1;
 		close(fd);
 	}
 
-	if (have_copro) {
-		copro = z180copro_create();
-		z180copro_trace(copro, (trace >> 17) & 3);
+	/* Z80 DMA card at 0x04 */
+	if (rc->have_dma) {
+		rc->dma = z80dma_create();
+		z80dma_map(rc->dma, mem_map);
+		z80dma_trace(rc->dma, !!(rc->trace & TRACE_DMA));
 	}
 
-	if (ide == 1 ) {
-		ide0 = ide_allocate("cf");
-		if (ide0) {
+	for (rc->ncopro = 0; rc->ncopro < rc->have_copro; rc->ncopro++) {
+		rc->copro[rc->ncopro] = z180copro_create();
+		z180copro_trace(rc->copro[rc->ncopro], (rc->trace >> 17) & 3);
+	}
+
+	if (rc->ide == 1 ) {
+		rc->ide0 = ide_allocate("cf");
+		if (rc->ide0) {
 			int ide_fd = open(idepath, O_RDWR);
 			if (ide_fd == -1) {
 				perror(idepath);
-				ide = 0;
+				rc->ide = 0;
 			}
-			if (ide_attach(ide0, 0, ide_fd) == 0) {
-				ide = 1;
-				ide_reset_begin(ide0);
+			if (ide_attach(rc->ide0, 0, ide_fd) == 0) {
+				rc->ide = 1;
+				ide_reset_begin(rc->ide0);
 			}
 		} else
-			ide = 0;
+			rc->ide = 0;
 	}
 
 	/* FIXME: merge IDE handling once cf is a driver */
-	if (ide == 2) {
-		ppide = ppide_create("ppide");
+	if (rc->ide == 2) {
+		rc->ppide = ppide_create("ppide");
 		int ide_fd = open(idepath, O_RDWR);
 		if (ide_fd == -1) {
 			perror(idepath);
-			ide = 0;
+			rc->ide = 0;
 		} else
-			ppide_attach(ppide, 0, ide_fd);
-		if (trace & TRACE_PPIDE)
-			ppide_trace(ppide, 1);
+			ppide_attach(rc->ppide, 0, ide_fd);
+		if (rc->trace & TRACE_PPIDE)
+			ppide_trace(rc->ppide, 1);
 	}
 
 	if (sasipath) {
-		sasi = sasi_bus_create();
-		sasi_disk_attach(sasi, 0, sasipath, 512);
-		sasi_bus_reset(sasi);
-		ncr = ncr5380_create(sasi);
-		ncr5380_trace(ncr, !!(trace & TRACE_SCSI));
+		rc->sasi = sasi_bus_create();
+		sasi_disk_attach(rc->sasi, 0, sasipath, 512);
+		sasi_bus_reset(rc->sasi);
+		rc->ncr = ncr5380_create(rc->sasi);
+		ncr5380_trace(rc->ncr, !!(rc->trace & TRACE_SCSI));
 	}
 
 	/* SD mapping */
-	if (cpuboard == CPUBOARD_MICRO80 || cpuboard == CPUBOARD_MICRO80W) {
-		sd_clock = 0x04;
-		sd_mosi = 0x02;
-		sd_port = 1;
-		sd_miso = 1;
-	}
-	if (cpuboard == CPUBOARD_EASY512) {
-		sd_clock = 0x10;
-		sd_mosi = 0x01;
-		sd_miso = 0x80;
-		sd_port = 1;
+	if (rc->cpuboard == CPUBOARD_MICRO80 || rc->cpuboard == CPUBOARD_MICRO80W) {
+		rc->sd_clock = 0x04;
+		rc->sd_mosi = 0x02;
+		rc->sd_port = 1;
+		rc->sd_miso = 1;
+	}
+	if (rc->cpuboard == CPUBOARD_EASY512) {
+		rc->sd_clock = 0x10;
+		rc->sd_mosi = 0x01;
+		rc->sd_miso = 0x80;
+		rc->sd_port = 1;
 	}
 	if (sdpath) {
-		if (!have_copro)
-			sdcard = sd_create("sd0");
+		if (!rc->have_copro)
+			rc->sdcard = sd_create("sd0");
 		fd = open(sdpath, O_RDWR);
 		if (fd == -1) {
 			perror(sdpath);
 			exit(1);
 		}
-		if (have_copro)
-			z180copro_attach_sd(copro, fd);
+		if (rc->have_copro)
+			z180copro_attach_sd(rc->copro[0], fd);
 		else {
-			sd_attach(sdcard, fd);
-			if (trace & TRACE_SD)
-				sd_trace(sdcard, 1);
+			sd_attach(rc->sdcard, fd);
+			if (rc->trace & TRACE_SD)
+				sd_trace(rc->sdcard, 1);
 		}
 	}
 
 	if (have_acia) {
-		acia = acia_create();
-		if (trace & TRACE_ACIA)
-			acia_trace(acia, 1);
+		rc->acia = acia_create();
+		if (rc->trace & TRACE_ACIA)
+			acia_trace(rc->acia, 1);
 		if (indev == INDEV_ACIA)
-			acia_attach(acia, &console);
+			acia_attach(rc->acia, &rc->idle_console);
 		else
-			acia_attach(acia, vt_create("ACIA", CON_VT52));
+			acia_attach(rc->acia, vt_create("ACIA", CON_VT52));
 	}
-	if (rtc && (trace & TRACE_RTC))
-		rtc_trace(rtc, 1);
-	if (sio2 || have_kio) {
-		sio = sio_create();
-		sio_reset(sio);
-		if (trace & TRACE_UART) {
-			sio_trace(sio, 0, 1);
-			sio_trace(sio, 1, 1);
+	if (rc->rtc && (rc->trace & TRACE_RTC))
+		rtc_trace(rc->rtc, 1);
+	if (sio2 || rc->have_kio) {
+		rc->sio = sio_create();
+		sio_reset(rc->sio);
+		if (rc->trace & TRACE_UART) {
+			sio_trace(rc->sio, 0, 1);
+			sio_trace(rc->sio, 1, 1);
 		}
 		if (indev == INDEV_SIO)
-			sio_attach(sio, 0, &console);
+			sio_attach(rc->sio, 0, &rc->idle_console);
 		else
-			sio_attach(sio, 0, vt_create("SIOA", CON_VT52));
-		sio_attach(sio, 1, vt_create("SIOB", CON_VT52));
+			sio_attach(rc->sio, 0, vt_create("SIOA", CON_VT52));
+		sio_attach(rc->sio, 1, vt_create("SIOB", CON_VT52));
 	}
-	if (have_ctc)
+	if (rc->have_ctc)
 		ctc_init();
-	if (have_pio)
+	if (rc->have_pio)
 		pio_reset();
-	if (have_kio) {
+	if (rc->have_kio) {
 		ctc_init();
 		pio_reset();
 	}
-	if (have_16x50) {
-		uart = uart16x50_create();
+	if (rc->have_16x50) {
+		rc->uart = uart16x50_create();
 		if (indev == INDEV_16C550A)
-			uart16x50_attach(uart, &console);
+			uart16x50_attach(rc->uart, &rc->idle_console);
 		else
-			uart16x50_attach(uart, vt_create("16x50", CON_VT52));
+			uart16x50_attach(rc->uart, vt_create("16x50", CON_VT52));
 	}
-	if (have_tms) {
-		vdp = tms9918a_create();
-		tms9918a_trace(vdp, !!(trace & TRACE_TMS9918A));
-		vdprend = tms9918a_renderer_create(vdp);
+	if (rc->have_tms) {
+		rc->vdp = tms9918a_create();
+		tms9918a_trace(rc->vdp, !!(rc->trace & TRACE_TMS9918A));
+		rc->vdprend = tms9918a_renderer_create(rc->vdp);
 	}
-	if (have_ef9345) {
+	if (rc->have_ef9345) {
 		fd = open("ef9345_font.rom", O_RDONLY);
 		if (fd == -1) {
 			perror("ef9345_font.rom");
 			exit(EXIT_FAILURE);
 		}
-		if (read(fd, ef9345_rom, 8192) != 8192) {
+		if (read(fd, rc->ef9345_rom, 8192) != 8192) {
 			fprintf(stderr, "rc2014: expected 932 byte font ROM image.\n");
 			exit(EXIT_FAILURE);
 		}
 		close(fd);
 		/* 16K RAM */
-		ef9345 = ef9345_create(EF9345, ef9345_vram, ef9345_rom, 0x3FFF);
-		ef9345_trace(ef9345, !!(trace & TRACE_EF9345));
-		ef9345rend = ef9345_renderer_create(ef9345);
+		rc->ef9345 = ef9345_create(EF9345, rc->ef9345_vram, rc->ef9345_rom, 0x3FFF);
+		ef9345_trace(rc->ef9345, !!(rc->trace & TRACE_EF9345));
+		rc->ef9345rend = ef9345_renderer_create(rc->ef9345);
 	}
-	if (have_ps2) {
-		ps2 = ps2_create(7);
-		ps2_trace(ps2, trace & TRACE_PS2);
-		ps2_add_events(ps2, 0);
+	if (rc->have_ps2) {
+		rc->ps2 = ps2_create(7);
+		ps2_trace(rc->ps2, rc->trace & TRACE_PS2);
+		ps2_add_events(rc->ps2, 0);
 	}
 
-	if (have_wiznet) {
-		wiz = nic_w5100_alloc();
-		nic_w5100_reset(wiz);
+	if (rc->have_wiznet) {
+		rc->wiz = nic_w5100_alloc();
+		nic_w5100_reset(rc->wiz);
 	}
 
-	fdc = fdc_new();
+	rc->fdc = fdc_new();
 
 	lib765_register_error_function(fdc_log);
 
 	if (patha) {
-		drive_a = fd_newdsk();
-		fd_settype(drive_a, FD_35);
-		fd_setheads(drive_a, 2);
-		fd_setcyls(drive_a, 80);
-		fdd_setfilename(drive_a, patha);
+		rc->drive_a = fd_newdsk();
+		fd_settype(rc->drive_a, FD_35);
+		fd_setheads(rc->drive_a, 2);
+		fd_setcyls(rc->drive_a, 80);
+		fdd_setfilename(rc->drive_a, patha);
 	} else
-		drive_a = fd_new();
+		rc->drive_a = fd_new();
 
 	if (pathb) {
-		drive_b = fd_newdsk();
-		fd_settype(drive_a, FD_35);
-		fd_setheads(drive_a, 2);
-		fd_setcyls(drive_a, 80);
-		fdd_setfilename(drive_a, pathb);
+		rc->drive_b = fd_newdsk();
+		fd_settype(rc->drive_a, FD_35);
+		fd_setheads(rc->drive_a, 2);
+		fd_setcyls(rc->drive_a, 80);
+		fdd_setfilename(rc->drive_a, pathb);
 	} else
-		drive_b = fd_new();
+		rc->drive_b = fd_new();
 
-	fdc_reset(fdc);
-	fdc_setisr(fdc, NULL);
+	fdc_reset(rc->fdc);
+	fdc_setisr(rc->fdc, NULL);
 
-	fdc_setdrive(fdc, 0, drive_a);
-	fdc_setdrive(fdc, 1, drive_b);
+	fdc_setdrive(rc->fdc, 0, rc->drive_a);
+	fdc_setdrive(rc->fdc, 1, rc->drive_b);
 
 
 	switch(indev) {
@@ -3413,144 +4037,191 @@ int main(int argc, char *argv[])
 
 	pio_reset();
 
-	/* 2.5ms - it's a balance between nice behaviour and simulation
-	   smoothness */
-	tc.tv_sec = 0;
-	tc.tv_nsec = 20000000L;
-
-	if (tcgetattr(0, &term) == 0) {
-		saved_term = term;
-		atexit(exit_cleanup);
-		signal(SIGINT, cleanup);
-		signal(SIGQUIT, cleanup);
-		signal(SIGPIPE, cleanup);
-		term.c_lflag &= ~(ICANON | ECHO);
-		term.c_cc[VMIN] = 0;
-		term.c_cc[VTIME] = 1;
-		term.c_cc[VINTR] = 0;
-		term.c_cc[VSUSP] = 0;
-		term.c_cc[VSTOP] = 0;
-		tcsetattr(0, TCSADRAIN, &term);
-	}
-
-	Z80RESET(&cpu_z80);
-	cpu_z80.ioRead = io_read;
-	cpu_z80.ioWrite = io_write;
-	cpu_z80.memRead = mem_read;
-	cpu_z80.memWrite = mem_write;
-	cpu_z80.trace = z80_trace;
-
-	/* This is the wrong way to do it but it's easier for the moment. We
-	   should track how much real time has occurred and try to keep cycle
-	   matched with that. The scheme here works fine except when the host
-	   is loaded though */
-
-	/* We run 7372000 t-states per second */
-	/* We run 365 cycles per I/O check, do that 50 times then poll the
-	   slow stuff and nap for 20ms to get 50Hz on the TMS99xx */
-	while (!emulator_done) {
-		if (cpu_z80.halted && ! cpu_z80.IFF1) {
-			/* HALT with interrupts disabled, so nothing left
-			   to do, so exit simulation. If NMI was supported,
-			   this might have to change. */
-			emulator_done = 1;
-			break;
-		}
-		int i;
-		/* 36400 T states for base RC2014 - varies for others */
-		for (i = 0; i < 40; i++) {
-			int j;
-			for (j = 0; j < 100; j++) {
-				Z80ExecuteTStates(&cpu_z80, (tstate_steps + 5)/ 10);
-				if (ef9345)
-					ef9345_cycles(ef9345, 200);
-				if (copro)
-					z180copro_run(copro);
-				if (ps2)
-					ps2_event(ps2, (tstate_steps + 5) / 10);
-				if (acia)
-					acia_timer(acia);
-				if (sio)
-					sio_timer(sio);
-				if (have_16x50)
-					uart16x50_event(uart);
-				if (have_cpld_serial)
-					sbc64_cpld_timer();
-				poll_irq_nonim2();
-			}
-			if (have_ctc || have_kio || have_kio_ext) {
-				if (cpuboard != CPUBOARD_MICRO80 && cpuboard != CPUBOARD_MICRO80W)
-					ctc_tick(tstate_steps * 10);
-				else	/* Micro80 it's not off the CPU clock  but
-					   the 1.8MHz clock */
-					ctc_tick(921);
+	/* Each co-processor gets a host thread and swaps mailbox state with
+	   us every batch of 100 slices */
+	if (rc->copro_threads)
+		for (n = 0; n < rc->ncopro; n++)
+			z180copro_threaded(rc->copro[n], 100);
+
+	Z80RESET(&rc->cpu_z80);
+	rc->cpu_z80.ioRead = io_read;
+	rc->cpu_z80.ioWrite = io_write;
+	rc->cpu_z80.memRead = mem_read;
+	rc->cpu_z80.memWrite = mem_write;
+	rc->cpu_z80.memMap = mem_map;
+	rc->cpu_z80.trace = z80_trace;
+	return rc;
+}
+
+/*
+ *	Run the machine for one 50Hz frame, in step with real time unless
+ *	-f was given. Returns 0 once it has stopped for good.
+ */
+/* This is the wrong way to do it but it's easier for the moment. We
+   should track how much real time has occurred and try to keep cycle
+   matched with that. The scheme here works fine except when the host
+   is loaded though */
+
+/* We run 7372000 t-states per second */
+/* We run 365 cycles per I/O check, do that 50 times then poll the
+   slow stuff and nap for 20ms to get 50Hz on the TMS99xx */
+int rc2014_run_frame(struct rc2014 *m)
+{
+	int i;
+
+	rc = m;
+	/* HALT with interrupts disabled, so nothing left to do, so exit
+	   simulation. If NMI was supported, this might have to change. */
+	if (rc->cpu_z80.halted && ! rc->cpu_z80.IFF1)
+		return 0;
+	/* 36400 T states for base RC2014 - varies for others */
+	for (i = 0; i < 40; i++) {
+		int j;
+		/* Requalify as idle at least once per batch */
+		if (rc->idle_count > IDLE_SLICES - 1)
+			rc->idle_count = IDLE_SLICES - 1;
+		for (j = 0; j < 100; j++) {
+			/* If we are waiting for something only the
+			   devices need to run */
+			if (cpu_idle()) {
+				idle_run();
+				continue;
 			}
-			if (cpuboard == CPUBOARD_EASYZ80 || cpuboard == CPUBOARD_TINYZ80) {
-				/* Feed the uart clock into the CTC */
-				int c;
-				/* 10Mhz so calculate for 500 tstates.
-				   CTC 2 runs at half uart clock */
-				for (c = 0; c < 46; c++) {
-					ctc_receive_pulse(0);
-					ctc_receive_pulse(1);
-					ctc_receive_pulse(2);
-					ctc_receive_pulse(0);
-					ctc_receive_pulse(1);
-				}
+			idle_slice_begin();
+			cpu_slice((rc->tstate_steps + 5) / 10);
+			idle_slice_end();
+			slice_devices();
+		}
+		if (rc->have_ctc || rc->have_kio || rc->have_kio_ext) {
+			if (rc->cpuboard != CPUBOARD_MICRO80 && rc->cpuboard != CPUBOARD_MICRO80W)
+				ctc_tick(rc->tstate_steps * 10);
+			else	/* Micro80 it's not off the CPU clock  but
+				   the 1.8MHz clock */
+				ctc_tick(921);
+		}
+		if (rc->cpuboard == CPUBOARD_EASYZ80 || rc->cpuboard == CPUBOARD_TINYZ80) {
+			/* Feed the uart clock into the CTC */
+			int c;
+			/* 10Mhz so calculate for 500 tstates.
+			   CTC 2 runs at half uart clock */
+			for (c = 0; c < 46; c++) {
+				ctc_receive_pulse(0);
+				ctc_receive_pulse(1);
+				ctc_receive_pulse(2);
+				ctc_receive_pulse(0);
+				ctc_receive_pulse(1);
 			}
-			fdc_tick(fdc);
-			/* We want to run UI events regularly it seems */
-			if (ui_event())
-				emulator_done = 1;
 		}
+		fdc_tick(rc->fdc);
+		/* We want to run UI events regularly it seems */
+		if (ui_event())
+			emulator_done = 1;
+	}
 
-		if (is_z512 && (z512_control & 0x20)) {
-			if (z512_wdog <= 5) {
-				fprintf(stderr, "Watchdog reset.\n");
-				emulator_done = 1;
-				break;
-			}
-			z512_wdog -= 5;
-		}
-		/* TODO: coprocessor int to main if we implement it */
-
-		/* 50Hz which is near enough */
-		if (vdp) {
-			tms9918a_rasterize(vdp);
-			tms9918a_render(vdprend);
-		}
-		if (ef9345) {
-			ef9345_rasterize(ef9345);
-			ef9345_render(ef9345rend);
-		}
-		if (tft) {
-			tft_rasterize(tft);
-			tft_render(tftrend);
-		}
-		if (have_wiznet)
-			w5100_process(wiz);
-		/* Do 20ms of I/O and delays */
-		if (!fast)
-			nanosleep(&tc, NULL);
-		/* Non IM2 devices just hold interrupt */
-		/* If there is no pending Z80 vector IRQ but we think
-		   there now might be one we use the same logic as for
-		   reti */
-		if (!live_irq || !have_im2)
-			poll_irq_event();
-	}
-	if (cpuboard == 3 && save) {
-		lseek(fd, 0L, SEEK_SET);
-		if (write(fd, ramrom, 0x8000 * 4) != 0x8000 * 4) {
+	if (rc->is_z512 && (rc->z512_control & 0x20)) {
+		if (rc->z512_wdog <= 5) {
+			fprintf(stderr, "Watchdog reset.\n");
+			return 0;
+		}
+		rc->z512_wdog -= 5;
+	}
+	/* TODO: coprocessor int to main if we implement it */
+
+	/* 50Hz which is near enough */
+	if (rc->vdp) {
+		tms9918a_rasterize(rc->vdp);
+		tms9918a_render(rc->vdprend);
+	}
+	if (rc->ef9345) {
+		ef9345_rasterize(rc->ef9345);
+		ef9345_render(rc->ef9345rend);
+	}
+	if (rc->tft) {
+		tft_rasterize(rc->tft);
+		tft_render(rc->tftrend);
+	}
+	if (rc->have_wiznet)
+		w5100_process(rc->wiz);
+	/* Do 20ms of I/O and delays. If the CPU is waiting for
+	   something then sleep until the host has input for us */
+	if (!rc->fast)
+		frame_sync(cpu_idle());
+	/* Non IM2 devices just hold interrupt */
+	/* If there is no pending Z80 vector IRQ but we think
+	   there now might be one we use the same logic as for
+	   reti */
+	if (!rc->live_irq || !rc->have_im2)
+		poll_irq_event();
+
+	return 1;
+}
+
+/* Stop a machine, saving the Z80SBC64 RAM if asked, and free it */
+void rc2014_free(struct rc2014 *m)
+{
+	unsigned n;
+
+	rc = m;
+	if (rc->save_fd != -1) {
+		lseek(rc->save_fd, 0L, SEEK_SET);
+		if (write(rc->save_fd, rc->ramrom, 0x8000 * 4) != 0x8000 * 4) {
 			fprintf(stderr, "rc2014: state save failed.\n");
 			exit(1);
 		}
-		close(fd);
+		close(rc->save_fd);
+	}
+	for (n = 0; n < rc->ncopro; n++)
+		z180copro_free(rc->copro[n]);
+	if (rc->dma)
+		z80dma_free(rc->dma);
+	fd_eject(rc->drive_a);
+	fd_eject(rc->drive_b);
+	fdc_destroy(&rc->fdc);
+	fd_destroy(&rc->drive_a);
+	fd_destroy(&rc->drive_b);
+	if (rc->acia)
+		acia_free(rc->acia);
+	if (rc->uart)
+		uart16x50_free(rc->uart);
+	if (rc->sio)
+		sio_destroy(rc->sio);
+	if (rc->ide0)
+		ide_free(rc->ide0);
+	if (rc->ppide)
+		ppide_free(rc->ppide);
+	if (rc->sdcard)
+		sd_free(rc->sdcard);
+	if (rc->ncr)
+		ncr5380_free(rc->ncr);
+	if (rc->sasi)
+		sasi_bus_free(rc->sasi);
+	if (rc->rtc)
+		rtc_free(rc->rtc);
+	if (rc->vdp) {
+		tms9918a_renderer_free(rc->vdprend);
+		tms9918a_free(rc->vdp);
 	}
-	fd_eject(drive_a);
-	fd_eject(drive_b);
-	fdc_destroy(&fdc);
-	fd_destroy(&drive_a);
-	fd_destroy(&drive_b);
-	exit(0);
+	if (rc->ef9345) {
+		ef9345_renderer_free(rc->ef9345rend);
+		ef9345_free(rc->ef9345);
+	}
+	if (rc->tft) {
+		tft_renderer_free(rc->tftrend);
+		tft_free(rc->tft);
+	}
+	if (rc->amd9511)
+		amd9511_free(rc->amd9511);
+	if (rc->ps2)
+		ps2_free(rc->ps2);
+	if (rc->wiz)
+		nic_w5100_free(rc->wiz);
+	free(rc);
+	rc = NULL;
+}
+
+/* Store into physical memory, for loading test code */
+void rc2014_poke(struct rc2014 *m, uint32_t addr, uint8_t val)
+{
+	if (addr < sizeof(m->ramrom))
+		m->ramrom[addr] = val;
 }
@@ -0,0 +1,11 @@
+/*
+ *	The RC2014 emulator core. Each machine is self contained so several
+ *	can be run in one process, one thread at a time per machine.
+ */
+struct rc2014;
+struct serial_device;
+
+extern struct rc2014 *rc2014_create(int argc, char *argv[], struct serial_device *con);
+extern int rc2014_run_frame(struct rc2014 *m);
+extern void rc2014_poke(struct rc2014 *m, uint32_t addr, uint8_t val);
+extern void rc2014_free(struct rc2014 *m);
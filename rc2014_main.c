@@ -0,0 +1,58 @@
+/*
+ *	The rc2014 command: one machine on the host terminal
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "system.h"
+#include "event.h"
+#include "serialdevice.h"
+#include "ttycon.h"
+#include "rc2014.h"
+
+static struct termios saved_term, term;
+
+static void cleanup(int sig)
+{
+	tcsetattr(0, TCSADRAIN, &saved_term);
+	emulator_done = 1;
+}
+
+static void exit_cleanup(void)
+{
+	tcsetattr(0, TCSADRAIN, &saved_term);
+}
+
+int main(int argc, char *argv[])
+{
+	struct rc2014 *m;
+
+	ui_init();
+
+	m = rc2014_create(argc, argv, &console);
+
+	if (tcgetattr(0, &term) == 0) {
+		saved_term = term;
+		atexit(exit_cleanup);
+		signal(SIGINT, cleanup);
+		signal(SIGQUIT, cleanup);
+		signal(SIGPIPE, cleanup);
+		term.c_lflag &= ~(ICANON | ECHO);
+		term.c_cc[VMIN] = 0;
+		term.c_cc[VTIME] = 1;
+		term.c_cc[VINTR] = 0;
+		term.c_cc[VSUSP] = 0;
+		term.c_cc[VSTOP] = 0;
+		tcsetattr(0, TCSADRAIN, &term);
+	}
+
+	while (!emulator_done && rc2014_run_frame(m));
+
+	rc2014_free(m);
+	return 0;
+}
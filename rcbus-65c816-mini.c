@@ -120,6 +120,64 @@ void via_handshake_b(struct via6522 *via)
 {
 }
 
+/*
+ *	The VIA counts at half the CPU clock. Rather than tick it on every
+ *	update it is brought up to date when it is accessed and when its
+ *	next timer is due to expire, which it schedules for itself.
+ */
+
+static CPUEvent via_event;
+static word32 via_synced;
+
+static void via_expire(word32 timestamp);
+
+static void via_sync(void)
+{
+	word32 clocks = (cpu_cycle_count - via_synced) / 2;
+
+	via_synced += clocks * 2;
+	if (clocks)
+		via_tick(via, clocks);
+}
+
+static void via_update(void)
+{
+	unsigned int n = via_next_event(via);
+
+	if (via_irq_pending(via))
+		CPU_addIRQ(IRQ_VIA);
+	else
+		CPU_clearIRQ(IRQ_VIA);
+	if (n)
+		CPUEvent_schedule(&via_event, via_synced + n * 2 - cpu_cycle_count,
+			via_expire);
+	else
+		CPUEvent_cancel(&via_event);
+}
+
+static void via_expire(word32 timestamp)
+{
+	via_sync();
+	via_update();
+}
+
+static uint8_t via_access_read(uint8_t addr)
+{
+	uint8_t r;
+
+	via_sync();
+	r = via_read(via, addr);
+	via_update();
+	return r;
+}
+
+static void via_access_write(uint8_t addr, uint8_t val)
+{
+	via_sync();
+	via_write(via, addr, val);
+	via_update();
+}
+
 uint8_t mmio_read_65c816(uint8_t addr)
 {
 	if (trace & TRACE_IO)
@@ -133,7 +191,7 @@ uint8_t mmio_read_65c816(uint8_t addr)
 	if (addr >= 0x28 && addr <= 0x2C && wiznet)
 		return nic_w5100_read(wiz, addr & 3);
 	if (addr >= 0x60 && addr <= 0x6F)
-		return via_read(via, addr & 0x0F);
+		return via_access_read(addr & 0x0F);
 	if (addr == 0x0C && rtc)
 		return rtc_read(rtc);
 	if (addr >= 0xC0 && addr <= 0xCF && uart)
@@ -156,7 +214,7 @@ void mmio_write_65c816(uint8_t addr, uint8_t val)
 	else if (addr >= 0x28 && addr <= 0x2C && wiznet)
 		nic_w5100_write(wiz, addr & 3, val);
 	else if (addr >= 0x60 && addr <= 0x6F)
-		via_write(via, addr & 0x0F, val);
+		via_access_write(addr & 0x0F, val);
 	/* FIXME: real bank512 alias at 0x70-77 for 78-7F */
 	else if (addr >= 0x78 && addr <= 0x7B && !bankhigh) {
 		bankreg[addr & 3] = val & 0x3F;
@@ -311,7 +369,6 @@ void system_process(void)
 		acia_timer(acia);
 	if (uart)
 		uart16x50_event(uart);
-	via_tick(via, 100);
 
 	if (acia) {
 		if (acia_irq_pending(acia))
@@ -319,10 +376,6 @@ void system_process(void)
 		else
 			CPU_clearIRQ(IRQ_ACIA);
 	}
-	if (via_irq_pending(via))
-		CPU_addIRQ(IRQ_VIA);
-	else
-		CPU_clearIRQ(IRQ_VIA);
 
 	if (uart) {
 		if (uart16x50_irq_pending(uart))
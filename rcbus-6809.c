@@ -42,6 +42,8 @@
 
 static uint8_t ramrom[1024 * 1024];	/* Covers the banked card */
 
+static struct e6809 cpu;
+
 static unsigned int bankreg[4];
 static uint8_t bankenable;
 
@@ -102,6 +104,8 @@ static void int_set(unsigned int irq)
 	live_irq |= 1 << irq;
 }
 
+static void remap(void);
+
 void recalc_interrupts(void)
 {
 	if (uart16x50_irq_pending(uart))
@@ -256,6 +260,7 @@ void m6809_outport(uint8_t addr, uint8_t val)
 		fprintf(stderr, "write %02x <- %02x\n", addr, val);
 	if (addr == 0xFF && bankhigh) {
 		mmureg = val;
+		remap();
 		if (trace & TRACE_512)
 			fprintf(stderr, "MMUreg set to %02X\n", val);
 	}
@@ -278,17 +283,21 @@ void m6809_outport(uint8_t addr, uint8_t val)
 	/* FIXME: real bank512 alias at 0x70-77 for 78-7F */
 	else if (bank512 && addr >= 0x78 && addr <= 0x7B) {
 		bankreg[addr & 3] = val & 0x3F;
+		remap();
 		if (trace & TRACE_512)
 			fprintf(stderr, "Bank %d set to %d\n", addr & 3, val);
 	} else if (bank512 && addr >= 0x7C && addr <= 0x7F) {
 		if (trace & TRACE_512)
 			fprintf(stderr, "Banking %sabled.\n", (val & 1) ? "en" : "dis");
 		bankenable = val & 1;
+		remap();
 	} else if (addr == 0x0C && rtc)
 		rtc_write(rtcdev, val);
 	else if (addr == 0xFD) {
 		printf("trace set to %d\n", val);
 		trace = val;
+		cpu.debug = trace & TRACE_CPU;
+		remap();
 	} else if (trace & TRACE_UNK)
 		fprintf(stderr, "Unknown write to port %04X of %02X\n", addr, val);
 }
@@ -331,7 +340,7 @@ unsigned char do_e6809_read8(unsigned addr, unsigned debug)
 	return ramrom[addr];
 }
 
-unsigned char e6809_read8(unsigned addr)
+unsigned char e6809_read8(struct e6809 *cpu, unsigned addr)
 {
 	return do_e6809_read8(addr, 0);
 }
@@ -341,7 +350,7 @@ unsigned char e6809_read8_debug(unsigned addr)
 	return do_e6809_read8(addr, 1);
 }
 
-void e6809_write8(unsigned addr, unsigned char val)
+void e6809_write8(struct e6809 *cpu, unsigned addr, unsigned char val)
 {
 	if (addr >> 8 == 0xFE) {
 		m6809_outport(addr & 0xFF, val);
@@ -390,6 +399,40 @@ void e6809_write8(unsigned addr, unsigned char val)
 	}
 }
 
+/* Point the CPU page tables at whatever the banking currently selects.
+   The I/O page and memory tracing need to go via e6809_read8/write8 */
+static void remap(void)
+{
+	unsigned int page;
+	unsigned int addr;
+
+	for (page = 0; page < 256; page++) {
+		addr = page << 8;
+		if (page == 0xFE || (trace & TRACE_MEM))
+			e6809_map(&cpu, addr, 0x100, NULL, 0);
+		else if (bankhigh) {
+			uint8_t reg = mmureg;
+			uint32_t higha;
+			if (addr < 0xE000)
+				reg >>= 1;
+			higha = (reg & 0x40) ? 1 : 0;
+			higha |= (reg & 0x10) ? 2 : 0;
+			higha |= (reg & 0x4) ? 4 : 0;
+			higha |= (reg & 0x01) ? 8 : 0;	/* ROM/RAM */
+			e6809_map(&cpu, addr, 0x100, ramrom + (higha << 16) + addr, higha & 8);
+		} else if (bankenable) {
+			unsigned int bank = page >> 6;
+			e6809_map(&cpu, addr, 0x100, ramrom + (bankreg[bank] << 14) + (addr & 0x3FFF), bankreg[bank] >= 32);
+		} else
+			e6809_map(&cpu, addr, 0x100, ramrom + addr, addr < 32768 && !bank512);
+	}
+}
+
+static unsigned irq_lines(struct e6809 *cpu)
+{
+	return live_irq ? E6809_IRQ : 0;
+}
+
 static const char *make_flags(uint8_t cc)
 {
 	static char buf[9];
@@ -409,10 +452,10 @@ static const char *make_flags(uint8_t cc)
 }
 
 /* Called each new instruction issue */
-void e6809_instruction(unsigned pc)
+void e6809_instruction(struct e6809 *cpu, unsigned pc)
 {
 	char buf[80];
-	struct reg6809 *r = e6809_get_regs();
+	struct reg6809 *r = e6809_get_regs(cpu);
 	if (trace & TRACE_CPU) {
                 /*
                  * The PC reported by e6809 can have garbage in the upper
@@ -618,7 +661,8 @@ int main(int argc, char *argv[])
 		tcsetattr(0, TCSADRAIN, &term);
 	}
 
-	e6809_reset(trace & TRACE_CPU);
+	remap();
+	e6809_reset(&cpu, trace & TRACE_CPU);
 
 	/* This is the wrong way to do it but it's easier for the moment. We
 	   should track how much real time has occurred and try to keep cycle
@@ -629,8 +673,7 @@ int main(int argc, char *argv[])
 		unsigned int i, j;
 		/* 36400 T states for base rcbus - varies for others */
 		for (i = 0; i < 100; i++) {
-			while(cycles < clockrate)
-				cycles += e6809_sstep(live_irq, 0);
+			cycles += e6809_run(&cpu, clockrate - cycles, irq_lines);
 			m6840_tick(ptm, cycles);
 			for (j = 0; j < cycles; j++)
 				m6840_external_clock(ptm, 2);
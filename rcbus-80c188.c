@@ -1,7 +1,7 @@
 /*
  *	Platform features
  *
- *	80C188 at 12MHz
+ *	80C188 at 7.37MHz (on chip timers, interrupt controller and DMA)
  *	IDE at 0x10-0x17 no high or control access (mirrored at 0x90-97)
  *	First 512K RAM Second 512K ROM
  *	RTC at 0x0C
@@ -13,6 +13,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
@@ -22,6 +23,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include "80x86/e8086.h"
+#include "i80188_io.h"
 #include "serialdevice.h"
 #include "ttycon.h"
 #include "16x50.h"
@@ -37,21 +39,21 @@ static uint8_t fast = 0;
 static uint8_t wiznet = 0;
 
 e8086_t *cpu;
+struct i80188_io *io;
 struct ppide *ppide;
 struct rtc *rtcdev;
 static nic_w5100_t *wiz;
 struct uart16x50 *uart;
 
-static uint16_t tstate_steps = 369;	/* rcbus speed (7.4MHz)  for now */
+/* rcbus speed for now */
+#define CPU_CLOCK	7372800
+/* Slow devices are serviced and the wall clock caught up every 5ms */
+#define SLICE		(CPU_CLOCK / 200)
+/* The 16x50 is polled at about the character rate of a 115200 baud line */
+#define UART_POLL	(CPU_CLOCK / 11520)
 
 static volatile int done;
 
-/* Who is pulling on the interrupt line */
-static uint8_t live_irq;
-
-#define IRQ_16550A	1
-
-
 #define TRACE_MEM	1
 #define TRACE_IO	2
 #define TRACE_ROM	4
@@ -61,6 +63,7 @@ static uint8_t live_irq;
 #define TRACE_CPU	64
 #define TRACE_IRQ	128
 #define TRACE_UART	256
+#define TRACE_188	512
 
 static int trace = 0;
 
@@ -111,31 +114,10 @@ void i808x_write16(void *mem, unsigned long addr, uint16_t val)
 	do_i808x_write(addr + 1, val >> 8);
 }
 
-extern void recalc_interrupts(void);
-
-static void int_set(int src)
-{
-	live_irq |= (1 << src);
-	recalc_interrupts();
-}
-
-static void int_clear(int src)
-{
-	live_irq &= ~(1 << src);
-	recalc_interrupts();
-}
-
-/* FIXME: we really need to do the right 80C188 vectoring */
+/* The 16x50 drives INT0, the on chip controller does the vectoring */
 void recalc_interrupts(void)
 {
-	if (uart16x50_irq_pending(uart))
-		int_set(live_irq);
-	else
-		int_clear(live_irq);
-	if (live_irq)
-		e86_irq(cpu, 0x20);
-	else
-		e86_irq(cpu, 0);
+	i80188_int_pin(io, 0, uart16x50_irq_pending(uart));
 }
 
 static int ide = 0;
@@ -163,6 +145,8 @@ static uint8_t i808x_inport(uint16_t addr)
 {
 	if (trace & TRACE_IO)
 		fprintf(stderr, "read %04x\n", addr);
+	if (i80188_iospace(io, addr))
+		return i80188_read8(io, addr);
 	addr &= 0xFF;
 	if ((addr >= 0x10 && addr <= 0x17) && ide == 1)
 		return my_ide_read(addr & 7);
@@ -188,6 +172,10 @@ static void i808x_outport(uint16_t addr, uint8_t val)
 {
 	if (trace & TRACE_IO)
 		fprintf(stderr, "write %04x <- %02x\n", addr, val);
+	if (i80188_iospace(io, addr)) {
+		i80188_write8(io, addr, val);
+		return;
+	}
 	addr &= 0xFF;
 	if ((addr >= 0x10 && addr <= 0x17) && ide == 1)
 		my_ide_write(addr & 7, val);
@@ -214,9 +202,13 @@ static uint8_t i808x_in8(void *mem, unsigned long addr)
 	return i808x_inport(addr & 0xFFFF);
 }
 
+/* The PCB is internal and takes word accesses directly */
 static uint16_t i808x_in16(void *mem, unsigned long addr)
 {
-	uint16_t r = i808x_inport(addr);
+	uint16_t r;
+	if (!(addr & 1) && i80188_iospace(io, addr))
+		return i80188_read(io, addr);
+	r = i808x_inport(addr);
 	r |= i808x_inport(addr + 1) << 8;
 	return r;
 }
@@ -228,12 +220,32 @@ static void i808x_out8(void *mem, unsigned long addr, uint8_t val)
 
 static void i808x_out16(void *mem, unsigned long addr, uint16_t val)
 {
+	if (!(addr & 1) && i80188_iospace(io, addr)) {
+		i80188_write(io, addr, val);
+		return;
+	}
 	i808x_outport(addr, val);
 	i808x_outport(addr + 1, val >> 8);
 }
 
-static void poll_irq_event(void)
+/* Pace against an absolute deadline so the time spent emulating is not
+   added on top of each slice. If we fall badly behind start again */
+static void sync_slice(void)
 {
+	static uint64_t deadline;
+	struct timespec ts;
+	uint64_t now;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	if (deadline == 0 || now > deadline + 20000000ULL)
+		deadline = now;
+	deadline += 5000000ULL;
+	if (deadline <= now)
+		return;
+	ts.tv_sec = deadline / 1000000000ULL;
+	ts.tv_nsec = deadline % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
 }
 
 static struct termios saved_term, term;
@@ -257,7 +269,9 @@ static void usage(void)
 
 int main(int argc, char *argv[])
 {
-	static struct timespec tc;
+	unsigned long now, until, next;
+	unsigned long slice_end = SLICE;
+	unsigned long uart_poll = UART_POLL;
 	int opt;
 	int fd;
 	char *rompath = "rcbus-808x.rom";
@@ -351,11 +365,6 @@ int main(int argc, char *argv[])
 			rtc_trace(rtcdev, 1);
 	}
 
-	/* 5ms - it's a balance between nice behaviour and simulation
-	   smoothness */
-	tc.tv_sec = 0;
-	tc.tv_nsec = 5000000L;
-
 	if (tcgetattr(0, &term) == 0) {
 		saved_term = term;
 		atexit(exit_cleanup);
@@ -377,7 +386,8 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 	e86_init(cpu);
-	/* FIXME: no 80C188 emulation so need to tweak emulator later */
+	/* The core has the 80186 instruction set, the on chip peripherals
+	   are modelled separately */
 	e86_set_80186(cpu);
 	/* Bus interfaces */
 	e86_set_mem(cpu, NULL, i808x_read8, i808x_write8, i808x_read16, i808x_write16);
@@ -387,31 +397,41 @@ int main(int argc, char *argv[])
 	/* Reset the CPU */	
 	e86_reset(cpu);
 
+	io = i80188_create(cpu);
+	i80188_trace(io, !!(trace & TRACE_188));
+
 	if (trace & TRACE_CPU) {
 //		i808x_log = stderr;
 	}
 
-	/* This is the wrong way to do it but it's easier for the moment. We
-	   should track how much real time has occurred and try to keep cycle
-	   matched with that. The scheme here works fine except when the host
-	   is loaded though */
-
-	/* We run 7372000 t-states per second */
-	/* We run 369 cycles per I/O check, do that 100 times then poll the
-	   slow stuff and nap for 5ms. */
+	/* Run the CPU straight through to whichever comes first of the next
+	   on chip timer event, the next UART poll or the end of the 5ms
+	   slice. A write to the PCB cuts the run short so we can pick up
+	   the new timer settings. */
 	while (!done) {
-		int i;
-		/* 36400 T states for base rcbus - varies for others */
-		for (i = 0; i < 100; i++) {
-			e86_clock(cpu, tstate_steps);
+		now = e86_get_clock(cpu);
+		until = slice_end;
+		if ((long)(uart_poll - until) < 0)
+			until = uart_poll;
+		next = i80188_next_event(io);
+		if (next < until - now)
+			until = now + next;
+		e86_run_until(cpu, until);
+		i80188_sync(io);
+
+		now = e86_get_clock(cpu);
+		if ((long)(now - uart_poll) >= 0) {
 			uart16x50_event(uart);
+			recalc_interrupts();
+			uart_poll += UART_POLL;
+		}
+		if ((long)(now - slice_end) >= 0) {
+			if (wiznet)
+				w5100_process(wiz);
+			if (!fast)
+				sync_slice();
+			slice_end += SLICE;
 		}
-		if (wiznet)
-			w5100_process(wiz);
-		/* Do 5ms of I/O and delays */
-		if (!fast)
-			nanosleep(&tc, NULL);
-		poll_irq_event();
 	}
 	exit(0);
 }
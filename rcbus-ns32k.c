@@ -15,6 +15,8 @@
 #include <errno.h>
 
 #include "ns32k/32016.h"
+#include "serialdevice.h"
+#include "ttycon.h"
 #include "16x50.h"
 #include "ide.h"
 #include "ppide.h"
@@ -331,7 +333,7 @@ int main(int argc, char *argv[])
 	uart = uart16x50_create();
 	if (trace & TRACE_UART)
 		uart16x50_trace(uart, 1);
-	uart16x50_set_input(uart, 1);
+	uart16x50_attach(uart, &console);
 
 	if (wiznet) {
 		wiz = nic_w5100_alloc();
@@ -366,6 +368,12 @@ int main(int argc, char *argv[])
 	}
 
 	ns32016_init();
+	/* Let the CPU get at RAM directly unless we are tracing it. The
+	   bottom 32K is ROM and the I/O space starts at 0xF00000 */
+	if (!(trace & TRACE_MEM)) {
+		ns32016_set_ram(ramrom, sizeof(ramrom), 0x8001);
+		ns32016_set_io(0xF00000);
+	}
 	ns32016_reset_addr(0);
 
 	ns32016_trace((trace & TRACE_CPU) ? 3 : 0);
@@ -37,6 +37,7 @@ static uint8_t bankhigh = 0;
 static uint8_t mmureg = 0;
 static uint8_t rtc;
 static uint8_t fast = 0;
+static uint8_t fastcpu = 0;
 static uint8_t wiznet = 0;
 
 struct ppide *ppide;
@@ -344,7 +345,7 @@ static void exit_cleanup(void)
 
 static void usage(void)
 {
-	fprintf(stderr, "rcbus-tms9995-6809: [-b] [-f] [-R] [-i idepath] [-I ppidepath] [-r rompath] [-w] [-d debug]\n");
+	fprintf(stderr, "rcbus-tms9995-6809: [-b] [-f] [-F] [-R] [-i idepath] [-I ppidepath] [-r rompath] [-w] [-d debug]\n");
 	exit(EXIT_FAILURE);
 }
 
@@ -358,7 +359,7 @@ int main(int argc, char *argv[])
 	char *idepath;
 	int tmsin = 0;
 
-	while ((opt = getopt(argc, argv, "1abBd:fi:I:r:Rw")) != -1) {
+	while ((opt = getopt(argc, argv, "1abBd:fFi:I:r:Rw")) != -1) {
 		switch (opt) {
 		case 'r':
 			rompath = optarg;
@@ -387,6 +388,9 @@ int main(int argc, char *argv[])
 		case 'f':
 			fast = 1;
 			break;
+		case 'F':
+			fastcpu = 1;
+			break;
 		case 'R':
 			rtc = 1;
 			break;
@@ -507,6 +511,7 @@ int main(int argc, char *argv[])
 	/* B step 9995 */
 	tms = tms9995_create(false, true);
 	tms9995_trace(tms, trace & TRACE_CPU);
+	tms9995_set_fast(tms, fastcpu);
 	tms9995_ready_line(tms, true);
 	tms9995_reset_line(tms, true);
 	tms9995_reset_line(tms, false);
@@ -151,6 +151,30 @@ void z180_phys_write(int unused, uint32_t addr, uint8_t val)
 		fprintf(stderr, "[%06X: write to ROM from %04X.]\n", addr, cpu_z180.M1PC);
 }
 
+/*
+ *	The same decode for the DMA engine burst path and the CPU page
+ *	cache. Banking and the DIP wrap are both on 16K or larger boundaries
+ *	so the pointer is good to the end of the 4K page.
+ */
+static uint8_t *z180_phys_map(int unused, uint32_t addr, int wr)
+{
+	/* Memory tracing needs every access to go via mem_read/write */
+	if (trace & TRACE_MEM)
+		return NULL;
+	if (banked)
+		addr = bank_translate(addr);
+	addr &= 0xFFFFF;
+	if (mem_map == 1) {
+		addr &= 0x7FFFF;
+		if (addr & 0x40000)
+			addr &= 0x5FFFF;
+	}
+	/* Let the slow path report ROM writes */
+	if (wr && addr < ram_base)
+		return NULL;
+	return ramrom + addr;
+}
+
 /*
  *	Model CPU accesses starting with a virtual address
  */
@@ -158,8 +182,6 @@ static uint8_t do_mem_read0(uint16_t addr, int quiet)
 {
 	uint32_t pa = z180_mmu_translate(io, addr);
 	uint8_t r;
-	if (banked)
-		pa = bank_translate(pa);
 	r = z180_phys_read(0, pa);
 	if (!quiet && (trace & TRACE_MEM))
 		fprintf(stderr, "R %04X[%06X] -> %02X\n", addr, pa, r);
@@ -169,8 +191,6 @@ static uint8_t do_mem_read0(uint16_t addr, int quiet)
 static void mem_write0(uint16_t addr, uint8_t val)
 {
 	uint32_t pa = z180_mmu_translate(io, addr);
-	if (banked)
-		pa = bank_translate(pa);
 	if (trace & TRACE_MEM)
 		fprintf(stderr, "W: %04X[%06X] <- %02X\n", addr, pa, val);
 	z180_phys_write(0, pa, val);
@@ -555,10 +575,12 @@ static void io_write_2014(uint16_t addr, uint8_t val, uint8_t known)
 		bankreg[addr & 3] = val & 0x3F;
 		if (trace & TRACE_512)
 			fprintf(stderr, "Bank %d set to %d\n", addr & 3, val);
+		z180_mem_remap(io);
 	} else if (banked && addr >= 0x7C && addr <=0x7F) {
 		if (trace & TRACE_512)
 			fprintf(stderr, "Banking %sabled.\n", (val & 1) ? "en" : "dis");
 		bankenable = val & 1;
+		z180_mem_remap(io);
 	} else if (addr == 0x0D)
 		diag_write(val);
 	else if ((addr == 0x98 || addr == 0x99) && vdp)
@@ -567,10 +589,12 @@ static void io_write_2014(uint16_t addr, uint8_t val, uint8_t known)
 		trace &= 0xFF00;
 		trace |= val;
 		printf("trace set to %04X\n", trace);
+		z180_mem_remap(io);
 	} else if (addr == 0xFE) {
 		trace &= 0xFF;
 		trace |= val << 8;
 		printf("trace set to %d\n", trace);
+		z180_mem_remap(io);
 	} else if (!known && (trace & TRACE_UNK))
 		fprintf(stderr, "Unknown write to port %04X of %02X\n", addr, val);
 }
@@ -944,6 +968,7 @@ int main(int argc, char *argv[])
 
 	io = z180_create(&cpu_z180);
 	z180_trace(io, trace & TRACE_CPU_IO);
+	z180_mem_map(io, z180_phys_map);
 	if (tstate_steps == 294)
 		z180_set_clock(io, 6144000);
 	else
@@ -1061,7 +1086,7 @@ int main(int argc, char *argv[])
 			for (j = 0; j < 10; j++) {
 				while (states < tstate_steps) {
 					unsigned int used;
-					used = z180_dma(io);
+					used = z180_dma(io, tstate_steps - states);
 					if (used == 0)
 						used = Z180Execute(&cpu_z180);
 					states += used;
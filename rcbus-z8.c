@@ -842,10 +842,7 @@ int main(int argc, char *argv[])
 		int i;
 		/* 36400 T states for base rcbus - varies for others */
 		for (i = 0; i < 100; i++) {
-			/* TODO: need to loop for the desired tstates */
-			cpu->cycles = 0;
-			while(cpu->cycles < mcycles)
-				z8_execute(cpu);
+			z8_run(cpu, mcycles);
 			if (uart_16550a)
 				uart_event(&uart);
 			else {
@@ -220,7 +220,7 @@ int main(int argc, char *argv[])
 	
 	while (!done) {
 		/* TODO: timing, ints etc */
-		ns8060_execute_one(cpu);
+		ns8060_run(cpu, 1000);
 #if 0
 		static uint8_t pendc;			/* Pending char */
 		if (check_chario() & 1) {
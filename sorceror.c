@@ -72,6 +72,7 @@
 #include <SDL2/SDL.h>
 #include "event.h"
 #include "keymatrix.h"
+#include "rasterclock.h"
 
 static SDL_Window *window;
 static SDL_Renderer *render;
@@ -104,6 +105,7 @@ static unsigned mem = 8;	/* First byte above RAM (defaults to 8K) */
 
 static volatile int emulator_done;
 static unsigned fast;
+static struct rasterclock *rclock;
 static unsigned int_recalc;
 static unsigned live_irq;
 
@@ -612,9 +614,29 @@ static struct diskgeom *guess_format(const char *path)
 	exit(1);
 }
 
+static unsigned sorc_execute(void *unused, unsigned tstates)
+{
+	return Z80ExecuteTStates(&cpu_z80, tstates);
+}
+
+/* Runs every 2ms slice of the frame */
+static void sorc_slice(void *unused, unsigned line)
+{
+	if (int_recalc) {
+		/* If there is no pending Z80 vector IRQ but we think
+		   there now might be one we use the same logic as for
+		   reti */
+		poll_irq_event();
+		/* Clear this after because reti_event may set the
+		   flags to indicate there is more happening. We will
+		   pick up the next state changes on the reti if so */
+		if (!(cpu_z80.IFF1 | cpu_z80.IFF2))
+			int_recalc = 0;
+	}
+}
+
 int main(int argc, char *argv[])
 {
-	static struct timespec tc;
 	unsigned cycles = 421;	/* 2.106MHz */
 	int opt;
 	int fd;
@@ -808,9 +830,11 @@ int main(int argc, char *argv[])
 	keymatrix_add_events(matrix);
 	keymatrix_translator(matrix, keytranslate);
 
-	/* TODO */
-	tc.tv_sec = 0;
-	tc.tv_nsec = 2000000L;	/* 2ms */
+	/* 50Hz frames made of ten 2ms slices */
+	rclock = rasterclock_create(cycles * 5000UL, cycles * 10, 10);
+	rasterclock_fast(rclock, fast);
+	rasterclock_cpu(rclock, sorc_execute, NULL);
+	rasterclock_line_handler(rclock, sorc_slice, NULL);
 
 	if (tcgetattr(0, &term) == 0) {
 		saved_term = term;
@@ -836,40 +860,17 @@ int main(int argc, char *argv[])
 
 	romlatch = 1;
 
-	/* This is the wrong way to do it but it's easier for the moment. We
-	   should track how much real time has occurred and try to keep cycle
-	   matched with that. The scheme here works fine except when the host
-	   is loaded though */
-
 	/* 2MHz processor */
 	while (!emulator_done) {
-		int l;
-		for (l = 0; l < 10; l++) {
-			int i;
-			for (i = 0; i < 10; i++)
-				Z80ExecuteTStates(&cpu_z80, cycles);
-			ui_event();
-			/* Do a small block of I/O and delays */
-			if (!fast)
-				nanosleep(&tc, NULL);
-			if (int_recalc) {
-				/* If there is no pending Z80 vector IRQ but we think
-				   there now might be one we use the same logic as for
-				   reti */
-				poll_irq_event();
-				/* Clear this after because reti_event may set the
-				   flags to indicate there is more happening. We will
-				   pick up the next state changes on the reti if so */
-				if (!(cpu_z80.IFF1 | cpu_z80.IFF2))
-					int_recalc = 0;
-			}
-		}
+		rasterclock_run_frame(rclock);
+		ui_event();
 		/* 50 Hz refresh */
 		if (fdc)
 			wd17xx_tick(fdc, 20);
 		sorc_rasterize();
 		sorc_render();
 		poll_irq_event();
+		rasterclock_sync(rclock);
 	}
 	exit(0);
 }
@@ -26,11 +26,13 @@
 
 #include <SDL2/SDL.h>
 #include "event.h"
+#include "present_sdl2.h"
 #include "keymatrix.h"
+#include "zxtape.h"
+#include "rasterclock.h"
 
 static SDL_Window *window;
-static SDL_Renderer *render;
-static SDL_Texture *texture;
+static struct present *present;
 
 #define BORDER	32
 #define WIDTH	(256 + 2 * BORDER)
@@ -69,7 +71,8 @@ static FDC_PTR fdc;
 static FDRV_PTR drive_a, drive_b;
 static struct ide_controller *ide;
 
-static int tape = -1;		/* Tape file handle */
+static struct zxtape *tape;	/* Tape image if any */
+static struct rasterclock *rclock;
 static unsigned mem = 48;	/* First byte above RAM (defaults to 48K) */
 static uint8_t ula;		/* ULA state */
 static uint8_t frames;		/* Flash counter */
@@ -78,8 +81,16 @@ static uint8_t p3latch;
 static unsigned map[4] = { ROM(0), RAM(5), RAM(2), RAM(0) };
 static unsigned vram = RAM(5);
 
-static unsigned drawline;	/* If rasterising */
-static unsigned blanked;	/* True if blanked */
+/* Screen cells (8x1 pixels) that need re-rendering. One word per raster
+   line with a bit per byte column */
+static uint32_t scrdirty[192];
+static unsigned scrdirty_any;
+static uint8_t flash_shown;	/* Flash phase the texture holds */
+static unsigned band_lo = 192;	/* Raster lines redrawn this frame */
+static unsigned band_hi;
+static unsigned border_colour = 0xFF;	/* Border the texture holds */
+static unsigned border_dirty = 1;
+static uint32_t pixmask[256][8];	/* Byte to per pixel ink mask */
 
 static uint8_t divmem[524288];/* Full 512K emulated */
 static uint8_t divrom[524288];
@@ -110,10 +121,12 @@ static unsigned int_recalc;
 #define TRACE_KEY	8
 #define TRACE_CPU	16
 #define TRACE_FDC	32
+#define TRACE_TAPE	64
 
 static int trace = 0;
 
 static void reti_event(void);
+static unsigned tape_load_trap(void);
 
 static uint8_t *divbank(unsigned bank, unsigned page, unsigned off)
 {
@@ -179,6 +192,29 @@ static uint8_t divide_read(uint16_t addr)
 	return *divide_getmap(addr, 0);
 }
 
+/* Note that a byte of the display file or attributes changed */
+static void screen_dirty(unsigned off)
+{
+	unsigned y;
+	uint32_t bit = 1U << (off & 31);
+
+	if (off < 0x1800) {
+		y = ((off >> 5) & 0xC0) | ((off >> 2) & 0x38) | ((off >> 8) & 7);
+		scrdirty[y] |= bit;
+	} else {
+		y = ((off - 0x1800) >> 5) * 8;
+		for (off = 0; off < 8; off++)
+			scrdirty[y++] |= bit;
+	}
+	scrdirty_any = 1;
+}
+
+static void screen_invalidate(void)
+{
+	memset(scrdirty, 0xFF, sizeof(scrdirty));
+	scrdirty_any = 1;
+}
+
 /* TODO: memory contention */
 static uint8_t do_mem_read(uint16_t addr, unsigned debug)
 {
@@ -201,8 +237,12 @@ static void mem_write(int unused, uint16_t addr, uint8_t val)
 		return;
 	}
 	/* ROM is read only */
-	if (bank >= RAM(0))
-		ram[bank][addr & 0x3FFF] = val;
+	if (bank >= RAM(0)) {
+		uint8_t *p = &ram[bank][addr & 0x3FFF];
+		if (bank == vram && *p != val && (addr & 0x3FFF) < 0x1B00)
+			screen_dirty(addr & 0x3FFF);
+		*p = val;
+	}
 }
 
 static uint8_t mem_read(int unused, uint16_t addr)
@@ -225,6 +265,9 @@ static uint8_t mem_read(int unused, uint16_t addr)
 	/* Look for ED with M1, followed directly by 4D and if so trigger
 	   the interrupt chain */
 	if (cpu_z80.M1) {
+		/* Tape loader trap. If taken we hand the CPU a RET */
+		if (addr == 0x0556 && cpu_z80.M1PC == 0x0556 && tape && tape_load_trap())
+			r = 0xC9;
 		if (!(divplus_latch & 0xC0)) {
 			/* ROM paging logic */
 			if (divide && addr >= 0x1FF8 && addr <= 0x1FFF)
@@ -253,11 +296,15 @@ static uint8_t mem_read(int unused, uint16_t addr)
 
 static void recalc_mmu(void)
 {
+	unsigned oldvram = vram;
+
 	map[3] = RAM(mlatch & 7);
 	if (mlatch & 0x08)
 		vram = RAM(7);
 	else
 		vram = RAM(5);
+	if (vram != oldvram)
+		screen_invalidate();
 	if (model == ZX_128K) {
 		if (mlatch & 0x10)
 			map[0] = ROM(1);
@@ -304,6 +351,13 @@ static void repaint_border(unsigned colour)
 	unsigned x,y;
 	uint32_t border = palette[colour];
 
+	/* The beeper and tape bits share the port so most writes leave the
+	   border alone */
+	if (colour == border_colour)
+		return;
+	border_colour = colour;
+	border_dirty = 1;
+
 	for(y = 0; y < BORDER; y++)
 		for(x = 0; x < WIDTH; x++)
 			*p++ = border;
@@ -327,6 +381,11 @@ static void fdc_log(int debuglevel, char *fmt, va_list ap)
 	}
 }
 
+static uint64_t tstates_now(void)
+{
+	return rasterclock_clocks(rclock) + cpu_z80.tstates;
+}
+
 static void ula_write(uint8_t v)
 {
 	/* ear is bit 4 mic is bit 3, border low bits */
@@ -338,7 +397,10 @@ static uint8_t ula_read(uint16_t addr)
 {
 	uint8_t r = 0xA0;	/* Fixed bits */
 
-	if (model != ZX_PLUS3) {
+	if (tape && zxtape_playing(tape)) {
+		if (zxtape_ear(tape, tstates_now()))
+			r |= 0x40;
+	} else if (model != ZX_PLUS3) {
 		if (ula & 0x10)		/* Issue 3 and later */
 			r |= 0x40;
 		if (model == ZX_48K_2 && (ula & 0x08))
@@ -352,12 +414,13 @@ static uint8_t ula_read(uint16_t addr)
 static uint8_t floating(void)
 {
 	unsigned n;
-	if (blanked || model == ZX_PLUS3)
+	int line = rasterclock_display_line(rclock);
+	if (line < 0 || model == ZX_PLUS3)
 		return 0xFF;
 	n = cpu_z80.tstates;
 	n /= 4;
 	if (n < 32)
-		return ram[vram][0x1800 + 32 * drawline + n];
+		return ram[vram][0x1800 + 32 * (line >> 3) + n];
 	return 0xFF;
 }
 
@@ -523,6 +586,92 @@ static void z80_trace(unsigned unused)
 }
 
 
+/*
+ *	Tape loading. If the ROM LD-BYTES routine is entered and the next
+ *	block on the tape is a standard one we do the load directly and
+ *	return as the ROM would. On entry A is the flag byte, IX the
+ *	destination, DE the length and carry set for load, clear for verify.
+ *	Anything else (turbo blocks, custom loaders) gets the tape played
+ *	in real time through the EAR bit.
+ */
+
+/* Check the ROM mapped is one with LD-BYTES where we expect */
+static unsigned tape_rom_check(void)
+{
+	static const uint8_t ld_bytes[4] = { 0x14, 0x08, 0x15, 0xF3 };
+	unsigned i;
+	for (i = 0; i < 4; i++)
+		if (do_mem_read(0x0556 + i, 1) != ld_bytes[i])
+			return 0;
+	return 1;
+}
+
+static unsigned tape_load_trap(void)
+{
+	const uint8_t *data;
+	unsigned len;
+	unsigned i = 1;
+	unsigned ok = 0;
+	uint16_t ix = cpu_z80.R1.wr.IX;
+	uint16_t de = cpu_z80.R1.wr.DE;
+	uint8_t parity;
+	uint8_t last = 0;
+	unsigned verify = !(cpu_z80.R1.br.F & 0x01);
+
+	if (!tape_rom_check())
+		return 0;
+	if (!zxtape_rom_ready(tape)) {
+		zxtape_play(tape, tstates_now());
+		return 0;
+	}
+	data = zxtape_rom_block(tape, &len);
+
+	/* A block with the wrong flag is skipped */
+	if (len && data[0] == cpu_z80.R1.br.A) {
+		parity = data[0];
+		while (de && i < len) {
+			last = data[i++];
+			parity ^= last;
+			if (verify) {
+				if (do_mem_read(ix, 1) != last)
+					break;
+			} else
+				mem_write(0, ix, last);
+			ix++;
+			de--;
+		}
+		/* Then the checksum */
+		if (de == 0 && i < len) {
+			parity ^= data[i];
+			ok = (parity == 0);
+		}
+		cpu_z80.R1.wr.IX = ix;
+		cpu_z80.R1.wr.DE = de;
+		cpu_z80.R1.br.H = parity;
+		cpu_z80.R1.br.L = last;
+		cpu_z80.R1.br.A = parity;
+	}
+	if (ok)
+		cpu_z80.R1.br.F |= 0x01;
+	else
+		cpu_z80.R1.br.F &= ~0x01;
+
+	if (trace & TRACE_TAPE)
+		fprintf(stderr, "[tape: %s block of %u bytes %s]\n",
+			verify ? "verify" : "load", len, ok ? "ok" : "failed");
+
+	/* The ROM exits via SA/LD-RET which puts the border back and
+	   enables interrupts */
+	ula_write((do_mem_read(0x5C48, 1) >> 3) & 7);
+	cpu_z80.IFF1 = cpu_z80.IFF2 = 1;
+
+	/* If there is no more the ROM can read then start the tape for
+	   whatever loader comes next */
+	if (!zxtape_rom_ready(tape))
+		zxtape_play(tape, tstates_now());
+	return 1;
+}
+
 static void poll_irq_event(void)
 {
 }
@@ -531,9 +680,20 @@ static void reti_event(void)
 {
 }
 
+static void raster_init(void)
+{
+	unsigned b, x;
+	for (b = 0; b < 256; b++)
+		for (x = 0; x < 8; x++)
+			pixmask[b][x] = (b & (0x80 >> x)) ? 0xFFFFFFFF : 0;
+	screen_invalidate();
+}
+
 static void raster_byte(unsigned lines, unsigned cols, uint8_t byte, uint8_t attr)
 {
 	uint32_t *pixp;
+	const uint32_t *mask = pixmask[byte];
+	uint32_t pv, diff;
 	unsigned x;
 	unsigned paper = (attr >> 3) & 0x0F;
 	unsigned ink = attr & 7;
@@ -548,48 +708,71 @@ static void raster_byte(unsigned lines, unsigned cols, uint8_t byte, uint8_t att
 	}
 
 	pixp = texturebits + (lines + BORDER) * WIDTH + cols * 8 + BORDER;
+	pv = palette[paper];
+	diff = pv ^ palette[ink];
 
-	for (x = 0; x < 8; x++) {
-		if (byte & 0x80)
-			*pixp++ = palette[ink];
-		else
-			*pixp++ = palette[paper];
-		byte <<= 1;
-	}
+	for (x = 0; x < 8; x++)
+		pixp[x] = pv ^ (diff & mask[x]);
 }
 
-static void raster_block(unsigned ybase, unsigned off, unsigned aoff)
+/*
+ *	Only redraw the cells written since the last frame, plus any
+ *	flashing cells when the flash phase changes.
+ */
+static void spectrum_rasterize(void)
 {
-	unsigned c,l,w;
-	uint8_t *ptr = ram[vram] + off;
-	uint8_t *aptr = ram[vram] + aoff;
-	for (l = 0; l < 8; l++) {
-		for (c = 0; c < 8; c++)
-			for (w = 0; w < 32; w++)
-				raster_byte(ybase + c * 8 + l, w, *ptr++, *aptr++);
-		aptr -= 0x100;
+	uint8_t *vp = ram[vram];
+	unsigned y, c;
+
+	if ((frames ^ flash_shown) & 0x10) {
+		flash_shown = frames & 0x10;
+		for (c = 0; c < 768; c++)
+			if (vp[0x1800 + c] & 0x80)
+				screen_dirty(0x1800 + c);
 	}
-}
+	if (!scrdirty_any)
+		return;
 
-static void spectrum_rasterize(void)
-{
-	raster_block(0, 0x0000, 0x1800);
-	raster_block(64, 0x0800, 0x1900);
-	raster_block(128, 0x1000, 0x1A00);
+	for (y = 0; y < 192; y++) {
+		uint32_t bits = scrdirty[y];
+		uint8_t *ptr, *aptr;
+		if (bits == 0)
+			continue;
+		scrdirty[y] = 0;
+		if (y < band_lo)
+			band_lo = y;
+		band_hi = y;
+		ptr = vp + (((y & 0xC0) << 5) | ((y & 7) << 8) | ((y & 0x38) << 2));
+		aptr = vp + 0x1800 + (y >> 3) * 32;
+		for (c = 0; bits; c++, bits >>= 1)
+			if (bits & 1)
+				raster_byte(y, c, ptr[c], aptr[c]);
+	}
+	scrdirty_any = 0;
 }
 
+/* Hand over only the band of lines that changed, or nothing at all if
+   the screen is static */
 static void spectrum_render(void)
 {
-	SDL_Rect rect;
+	SDL_Rect rect, area;
 
 	rect.x = rect.y = 0;
 	rect.w = WIDTH;
 	rect.h = HEIGHT;
 
-	SDL_UpdateTexture(texture, NULL, texturebits, WIDTH * 4);
-	SDL_RenderClear(render);
-	SDL_RenderCopy(render, texture, NULL, &rect);
-	SDL_RenderPresent(render);
+	if (border_dirty)
+		present_frame(present, texturebits, WIDTH * 4, &rect, 0xFF000000);
+	else if (band_lo <= band_hi) {
+		area.x = 0;
+		area.y = BORDER + band_lo;
+		area.w = WIDTH;
+		area.h = band_hi - band_lo + 1;
+		present_area(present, texturebits, WIDTH * 4, &area, &rect, 0xFF000000);
+	}
+	border_dirty = 0;
+	band_lo = 192;
+	band_hi = 0;
 }
 
 /*
@@ -608,24 +791,22 @@ static SDL_Keycode keyboard[] = {
 	SDLK_SPACE, SDLK_RSHIFT, SDLK_m, SDLK_n, SDLK_b
 };
 
-static void run_scanlines(unsigned lines, unsigned blank)
+static unsigned spectrum_execute(void *unused, unsigned tstates)
 {
-	unsigned i;
-	unsigned n = 224;	/* T States per op */
-
-	blanked = blank;
+	return Z80ExecuteTStates(&cpu_z80, tstates);
+}
 
-	if (!blanked)
-		drawline = 0;
-	/* Run scanlines */
-	for (i = 0; i < lines; i++) {
-		n = 224 + 224 - Z80ExecuteTStates(&cpu_z80, n);
-		if (!blanked)
-			drawline++;
-	}
+/* Called at the top of each frame as the ULA raises the interrupt */
+static void spectrum_vblank(void *unused)
+{
 	if (ui_event())
 		emulator_done = 1;
 
+	spectrum_rasterize();
+	spectrum_render();
+	Z80INT(&cpu_z80, 0xFF);
+	frames++;
+
 	if (int_recalc) {
 		/* If there is no pending Z80 vector IRQ but we think
 		   there now might be one we use the same logic as for
@@ -642,13 +823,12 @@ static void run_scanlines(unsigned lines, unsigned blank)
 static void usage(void)
 {
 	fprintf(stderr, "spectrum: [-f] [-r path] [-d debug] [-A disk] [-B disk]\n"
-			"          [-i idedisk] [-I dividerom]\n");
+			"          [-i idedisk] [-I dividerom] [-t tape]\n");
 	exit(EXIT_FAILURE);
 }
 
 int main(int argc, char *argv[])
 {
-	static struct timespec tc;
 	int opt;
 	int fd;
 	int l;
@@ -659,7 +839,7 @@ int main(int argc, char *argv[])
 	char *patha = NULL;
 	char *pathb = NULL;
 
-	while ((opt = getopt(argc, argv, "d:f:r:m:i:I:A:B:")) != -1) {
+	while ((opt = getopt(argc, argv, "d:f:r:m:i:I:A:B:t:")) != -1) {
 		switch (opt) {
 		case 'r':
 			rompath = optarg;
@@ -756,9 +936,9 @@ int main(int argc, char *argv[])
 	}
 
 	if (tapepath) {
-		tape = open(tapepath, O_RDONLY);	/* No writes for now just minimal stuff */
-		if (tape == -1)
-			perror(tapepath);
+		tape = zxtape_create(tapepath);	/* No writes for now just minimal stuff */
+		if (tape)
+			zxtape_trace(tape, trace & TRACE_TAPE);
 	}
 
 	if (idepath) {
@@ -803,36 +983,21 @@ int main(int argc, char *argv[])
 			SDL_GetError());
 		exit(1);
 	}
-	render = SDL_CreateRenderer(window, -1, 0);
-	if (render == NULL) {
-		fprintf(stderr,
-			"spectrum: unable to create renderer: %s\n",
-			SDL_GetError());
-		exit(1);
-	}
-	texture =
-	    SDL_CreateTexture(render,
-			      SDL_PIXELFORMAT_ARGB8888,
-			      SDL_TEXTUREACCESS_STREAMING,
-			      WIDTH, HEIGHT);
-	if (texture == NULL) {
-		fprintf(stderr,
-			"spectrum: unable to create texture: %s\n",
-			SDL_GetError());
-		exit(1);
-	}
-	SDL_SetRenderDrawColor(render, 0, 0, 0, 255);
-	SDL_RenderClear(render);
-	SDL_RenderPresent(render);
+	present = present_create("spectrum", window, 0, WIDTH, HEIGHT, WIDTH, HEIGHT);
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-	SDL_RenderSetLogicalSize(render, WIDTH, HEIGHT);
 
 	matrix = keymatrix_create(8, 5, keyboard);
 	keymatrix_trace(matrix, trace & TRACE_KEY);
 	keymatrix_add_events(matrix);
 
-	tc.tv_sec = 0;
-	tc.tv_nsec = 20000000L;	/* 20ms (50Hz frame rate) */
+	/* 3.5MHz, 312 lines of 224 T states of which 192 are the display
+	   after 64 lines of top border. TODO: later machines are 228 T
+	   states a line and slightly different numbers of lines */
+	rclock = rasterclock_create(3500000, 224, 312);
+	rasterclock_visible(rclock, 64, 192);
+	rasterclock_fast(rclock, fast);
+	rasterclock_cpu(rclock, spectrum_execute, NULL);
+	rasterclock_vblank_handler(rclock, spectrum_vblank, NULL);
 
 	Z80RESET(&cpu_z80);
 	cpu_z80.ioRead = io_read;
@@ -841,24 +1006,13 @@ int main(int argc, char *argv[])
 	cpu_z80.memWrite = mem_write;
 	cpu_z80.trace = z80_trace;
 
+	raster_init();
+
 	while (!emulator_done) {
-		/* TODO: later machines are 228 bytes a line and slightly
-		   different numbers of lines */
-		run_scanlines(192, 1);
-		/* and border */
-		run_scanlines(56, 0);
-		spectrum_rasterize();
-		spectrum_render();
-		Z80INT(&cpu_z80, 0xFF);
-		/* 64 scan lines of 224 T states for vblank etc */
-		run_scanlines(64, 0);
-		poll_irq_event();
-		frames++;
-		/* Do a small block of I/O and delays */
-		if (!fast)
-			nanosleep(&tc, NULL);
+		rasterclock_run_frame(rclock);
 		if (fdc)
 			fdc_tick(fdc);
+		rasterclock_sync(rclock);
 	}
 	exit(0);
 }
@@ -14,27 +14,45 @@ struct sram_mmu {
     uint8_t map[32768];
     uint8_t map_valid[32768];	/* Not present in real hw just a debug aid */
     uint8_t latch;
+    /* Cache of successful translations for the current latch, indexed by
+       page | super << 6 | write << 7. NULL means not cached */
+    uint8_t *tlb[256];
 
     unsigned int trace;
 };
 
 #define MAP_UNINIT	0xFFFF
 
+static void sram_mmu_flush(struct sram_mmu *mmu)
+{
+    memset(mmu->tlb, 0, sizeof(mmu->tlb));
+}
+
 void sram_mmu_set_latch(struct sram_mmu *mmu, uint8_t latch)
 {
     mmu->latch = latch;
+    sram_mmu_flush(mmu);
 }
 
 uint8_t *sram_mmu_translate(struct sram_mmu *mmu, uint32_t addr, unsigned int wr,
                             unsigned int silent, unsigned int super, unsigned int *berr)
 {
     unsigned int  page;
+    unsigned int tlbent;
     uint16_t map;
+    uint8_t *base;
 
     *berr = 0;
 
     addr &= 0x7FFFF;
     page = addr >> 13;
+
+    /* Fast path: we've already looked this one up */
+    tlbent = page | (super ? 0x40 : 0) | (wr ? 0x80 : 0);
+    base = mmu->tlb[tlbent];
+    if (base)
+        return base + (addr & 0x1FFF);
+
     page |= (mmu->latch & 0x7F) << 8;
     if (super)
         page |= (1 << 7);
@@ -43,6 +61,7 @@ uint8_t *sram_mmu_translate(struct sram_mmu *mmu, uint32_t addr, unsigned int wr
         if (wr) {
             /* Remember maps we've written to at least once */
             mmu->map_valid[page] = 1;
+            sram_mmu_flush(mmu);
             return mmu->map + page;
         }
         return NULL;
@@ -69,7 +88,9 @@ uint8_t *sram_mmu_translate(struct sram_mmu *mmu, uint32_t addr, unsigned int wr
             return NULL;
         }
     }
-    return mmu->ram + ((map & 0x3F) << 13) + (addr & 0x1FFF);
+    base = mmu->ram + ((map & 0x3F) << 13);
+    mmu->tlb[tlbent] = base;
+    return base + (addr & 0x1FFF);
 }            
     
 struct sram_mmu *sram_mmu_create(void)
@@ -61,6 +61,7 @@ static uint16_t rombase = 0xFC00;
 static uint16_t rommask = 0x03FF;
 static uint8_t ram[1024 * 1024];
 static uint8_t dat[16];
+static struct e6809 cpu;
 static struct slot slot[16];
 
 static unsigned fast;
@@ -426,6 +427,30 @@ void recalc_interrupts(void)
 	live_irq = !!irq;
 }
 
+static unsigned irq_lines(struct e6809 *cpu)
+{
+	return live_irq ? E6809_IRQ : 0;
+}
+
+/* Map the CPU straight onto whatever the DAT selects. The I/O slots, the
+   DAT registers and memory tracing have to go via e6809_read8/write8 */
+static void remap(void)
+{
+	unsigned page;
+	unsigned addr;
+	uint8_t *ap;
+
+	for (page = 0; page < 256; page++) {
+		addr = page << 8;
+		if (is_slot(addr) || is_slot(addr + 0xFF) || (trace & TRACE_MEM))
+			e6809_map(&cpu, addr, 0x100, NULL, 0);
+		else if ((ap = dat_xlate(addr, 1)) != NULL)
+			e6809_map(&cpu, addr, 0x100, ap, 1);
+		else
+			e6809_map(&cpu, addr, 0x100, dat_xlate(addr, 0), 0);
+	}
+}
+
 unsigned char do_e6809_read8(unsigned addr, unsigned debug)
 {
 	unsigned char r = 0xFF;
@@ -446,7 +471,7 @@ unsigned char do_e6809_read8(unsigned addr, unsigned debug)
 	return r;
 }
 
-unsigned char e6809_read8(unsigned addr)
+unsigned char e6809_read8(struct e6809 *cpu, unsigned addr)
 {
 	return do_e6809_read8(addr, 0);
 }
@@ -458,7 +483,7 @@ unsigned char e6809_read8_debug(unsigned addr)
 
 /* FIXME: the actual hardware DAT maps everything but forces FFxx to
 the top 1K of ROM (0xF0) */
-void e6809_write8(unsigned addr, unsigned char val)
+void e6809_write8(struct e6809 *cpu, unsigned addr, unsigned char val)
 {
 	if (trace & TRACE_MEM)
 		fprintf(stderr, "W [%02X]%04X = %02X\n", dat_page(addr), addr, val);
@@ -469,6 +494,7 @@ void e6809_write8(unsigned addr, unsigned char val)
 		if (trace & TRACE_DAT)
 			fprintf(stderr, "DAT %1X: %2X\n", addr & 0x0F, val);
 		dat[addr & 0x0F] = val;
+		remap();
 	} else {
 		uint8_t *ap = dat_xlate(addr, 1);
 		if (ap)
@@ -495,10 +521,10 @@ static const char *make_flags(uint8_t cc)
 }
 
 /* Called each new instruction issue */
-void e6809_instruction(unsigned pc)
+void e6809_instruction(struct e6809 *cpu, unsigned pc)
 {
 	char buf[80];
-	struct reg6809 *r = e6809_get_regs();
+	struct reg6809 *r = e6809_get_regs(cpu);
 	if (trace & TRACE_CPU) {
 		d6809_disassemble(buf, pc);
 		fprintf(stderr, "%04X: %-16.16s | ", pc, buf);
@@ -685,7 +711,8 @@ int main(int argc, char *argv[])
 		tcsetattr(0, TCSADRAIN, &term);
 	}
 
-	e6809_reset(trace & TRACE_CPU);
+	remap();
+	e6809_reset(&cpu, trace & TRACE_CPU);
 
 	/* This is the wrong way to do it but it's easier for the moment. We
 	   should track how much real time has occurred and try to keep cycle
@@ -695,8 +722,7 @@ int main(int argc, char *argv[])
 	while (!done) {
 		unsigned int i;
 		for (i = 0; i < 100; i++) {
-			while (cycles < clockrate)
-				cycles += e6809_sstep(live_irq, 0);
+			cycles += e6809_run(&cpu, clockrate - cycles, irq_lines);
 			cycles -= clockrate;
 			recalc_interrupts();
 		}
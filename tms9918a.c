@@ -600,6 +600,11 @@ struct tms9918a *tms9918a_create(void)
     return vdp;
 }
 
+void tms9918a_free(struct tms9918a *vdp)
+{
+    free(vdp);
+}
+
 void tms9918a_trace(struct tms9918a *vdp, int onoff)
 {
     vdp->trace = onoff;
@@ -10,6 +10,7 @@
 
 #include "tms9918a.h"
 #include "tms9918a_render.h"
+#include "present_sdl2.h"
 
 static uint32_t vdp_ctab[16] = {
     0xFF000000,		/* transparent (we render as black) */
@@ -35,8 +36,7 @@ static uint32_t vdp_ctab[16] = {
 
 struct tms9918a_renderer {
     struct tms9918a *vdp;
-    SDL_Renderer *render;
-    SDL_Texture *texture;
+    struct present *present;
     SDL_Window *window;
 };
 
@@ -48,23 +48,14 @@ void tms9918a_render(struct tms9918a_renderer *render)
     sr.y = (240-192)/2;
     sr.w = 256;
     sr.h = 192;
-    SDL_UpdateTexture(render->texture, NULL, tms9918a_get_raster(render->vdp), 1024);
-    uint32_t colour = tms9918a_get_background(render->vdp);
-    SDL_SetRenderDrawColor(render->render,
-                               (colour >> 16) & 0xFF, // red
-                               (colour >>  8) & 0xFF, // green
-                               (colour >>  0) & 0xFF, // blue
-                               (colour >> 24) & 0xFF  // alpha
-                           );
-    SDL_RenderClear(render->render);
-    SDL_RenderCopy(render->render, render->texture, NULL, &sr);
-    SDL_RenderPresent(render->render);
+    present_frame(render->present, tms9918a_get_raster(render->vdp), 1024,
+        &sr, tms9918a_get_background(render->vdp));
 }
 
 void tms9918a_renderer_free(struct tms9918a_renderer *render)
 {
-    if (render->texture)
-        SDL_DestroyTexture(render->texture);
+    if (render->present)
+        present_free(render->present);
     free(render);
 }
 
@@ -90,24 +81,8 @@ struct tms9918a_renderer *tms9918a_renderer_create(struct tms9918a *vdp)
         fprintf(stderr, "Unable to create window: %s.\n", SDL_GetError());
         exit(1);
     }
-    render->render = SDL_CreateRenderer(render->window, -1, SDL_RENDERER_ACCELERATED);
-    if (render->render == NULL) {
-        fprintf(stderr, "Unable to create renderer: %s.\n", SDL_GetError());
-        exit(1);
-    }
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-    SDL_RenderSetLogicalSize(render->render, 320, 240);
-
-    render->texture = SDL_CreateTexture(render->render,
-                        SDL_PIXELFORMAT_ARGB8888,
-                        SDL_TEXTUREACCESS_STREAMING,
-                        256, 192);
-    if (render->render == NULL) {
-        fprintf(stderr, "Unable to create renderer: %s.\n", SDL_GetError());
-        exit(1);
-    }
-    SDL_SetRenderDrawColor(render->render, 0, 0, 0, 255);
-    SDL_RenderClear(render->render);
-    SDL_RenderPresent(render->render);
+    render->present = present_create("TMS9918A", render->window,
+        SDL_RENDERER_ACCELERATED, 256, 192, 320, 240);
     return render;
 }
@@ -138,6 +138,10 @@ static void tms9995_command_completed(struct tms9995 *tms);
 static void tms9995_trigger_decrementer(struct tms9995 *tms);
 static void tms9995_build_command_lookup_table(struct tms9995 *tms);
 static void tms9995_disassemble(struct tms9995 *tms);
+static void tms9995_execute_fast(struct tms9995 *tms, unsigned int cycles);
+
+/* Flat decode table used by the fast interpreter */
+static int16_t *fast_decode;
 
 /****************************************************************************
     Some small helpers
@@ -970,6 +974,11 @@ static void tms9995_build_command_lookup_table(struct tms9995 *tms)
 */
 void tms9995_execute_run(struct tms9995 *tms, unsigned int cycles)
 {
+	if (tms->fast)
+	{
+		tms9995_execute_fast(tms, cycles);
+		return;
+	}
 
 	tms->icount = cycles;
 
@@ -1190,15 +1199,12 @@ void tms9995_set_hold_state(struct tms9995 *tms, bool state)
     Decode the instruction. This is done in parallel to other operations
     so we just do it together with the prefetch.
 */
-static void tms9995_decode(struct tms9995 *tms, uint16_t inst)
+static int tms9995_lookup(struct tms9995 *tms, uint16_t inst)
 {
 	int ix = 0;
 	struct tms_decode *table = decode_root;
 	uint16_t opcode = inst;
 	bool complete = false;
-	int program_index;
-
-	tms->mid_active = false;
 
 	while (!complete)
 	{
@@ -1211,8 +1217,16 @@ static void tms9995_decode(struct tms9995 *tms, uint16_t inst)
 		}
 		else complete = true;
 	}
+	return table->index[ix];
+}
+
+static void tms9995_decode(struct tms9995 *tms, uint16_t inst)
+{
+	int program_index;
+
+	tms->mid_active = false;
 
-	program_index = table->index[ix];
+	program_index = tms->fast ? fast_decode[inst] : tms9995_lookup(tms, inst);
 	if (program_index == NOPRG)
 	{
 		// not found
@@ -1419,6 +1433,7 @@ static void tms9995_service_interrupt(struct tms9995 *tms)
 		tms->intmask = 0;  // clear interrupt mask
 
 		tms->nmi_state = false;
+		tms->idle_state = false;
 		tms->hold_requested = false;
 		tms->hold_state = false;
 		tms->mem_phase = 1;
@@ -3309,6 +3324,822 @@ static const ophandler s_microoperation[45] =
 	tms9995_alu_int
 };
 
+/**************************************************************************
+    Fast interpreter
+
+    The microprogram engine above dispatches through a table for every
+    step of every instruction and keeps a good deal of bookkeeping so
+    that it can stop anywhere. The fast interpreter runs each
+    microprogram as straight line code instead, calling the same ALU
+    operations in the same order with the same memory accesses, so the
+    results, the cycle counts, the decrementer and the points at which
+    interrupts are sampled all come out as before.
+
+    The differences are that an instruction is always run to completion,
+    so a time slice may overrun by a few cycles (which is carried into
+    the next one), and that the READY and HOLD lines are not sampled.
+    Automatic wait states are still counted. The microprogram engine
+    remains the reference and is used unless tms9995_set_fast is called.
+**************************************************************************/
+
+typedef void (*fasthandler)(struct tms9995 *);
+
+static fasthandler fast_op[sizeof(s_command) / sizeof(s_command[0])];
+
+/*
+    Advance the decrementer by a number of its input clocks; the same as
+    calling tms9995_trigger_decrementer that many times.
+*/
+static void fast_decrement(struct tms9995 *tms, unsigned int n)
+{
+	unsigned int steps;
+
+	if (tms->starting_count_storage_register == 0)
+		return;
+	while (n)
+	{
+		steps = tms->decrementer_value ? tms->decrementer_value : 0x10000;
+		if (n < steps)
+		{
+			tms->decrementer_value -= n;
+			return;
+		}
+		n -= steps;
+		tms->decrementer_value = tms->starting_count_storage_register;
+		if (tms->flag[1]==true)
+			tms->flag[3] = true;
+	}
+}
+
+/*
+    The equivalent of tms9995_pulse_clock for count cycles
+*/
+static void fast_clock(struct tms9995 *tms, int count)
+{
+	tms->icount -= count;
+	if (tms->flag[0] == false && tms->flag[1] == true)
+	{
+		count += tms->decrementer_clkdiv;
+		tms->decrementer_clkdiv = count & 3;
+		fast_decrement(tms, count >> 2);
+	}
+}
+
+/*
+    Memory accesses. These follow tms9995_mem_read and tms9995_mem_write
+    including the order of the bus cycles and the clock, but perform the
+    whole access in one call. Each external byte takes one cycle, or two
+    with automatic wait states.
+*/
+static void fast_read(struct tms9995 *tms, bool word)
+{
+	int wait = tms->auto_wait ? 2 : 1;
+
+	if ((tms->address & 0xfffe)==0xfffa && !tms->mp9537)
+	{
+		tms->current_value = tms->decrementer_value;
+		if (tms->byteop)
+		{
+			if ((tms->address & 1)==1) tms->current_value <<= 8;
+			tms->current_value &= 0xff00;
+		}
+		fast_clock(tms, 1);
+		return;
+	}
+
+	if (is_onchip(tms, tms->address))
+	{
+		uint16_t intaddr;
+
+		if (word) tms->address &= 0xfffe;
+		intaddr = tms->address & 0x00fe;
+		tms->current_value = (tms->onchip_memory[intaddr] << 8) | tms->onchip_memory[intaddr + 1];
+		if (!word)
+		{
+			if ((tms->address & 1)==1) tms->current_value = tms->current_value << 8;
+			tms->current_value &= 0xff00;
+		}
+		fast_clock(tms, 1);
+		return;
+	}
+
+	fast_clock(tms, wait);
+	if (word)
+	{
+		tms->current_value = tms9995_readb(tms, tms->address & 0xfffe) << 8;
+		fast_clock(tms, wait);
+		tms->current_value |= tms9995_readb(tms, tms->address | 1);
+	}
+	else
+		tms->current_value = tms9995_readb(tms, tms->address) << 8;
+}
+
+static void fast_mem_read(struct tms9995 *tms)
+{
+	fast_read(tms, !tms->byteop);
+}
+
+static void fast_word_read(struct tms9995 *tms)
+{
+	fast_read(tms, true);
+}
+
+static void fast_write(struct tms9995 *tms, bool word)
+{
+	int wait = tms->auto_wait ? 2 : 1;
+
+	if ((tms->address & 0xfffe)==0xfffa && !tms->mp9537)
+	{
+		if (tms->byteop && tms->address == 0xfffb)
+			tms->current_value >>= 8;
+		tms->starting_count_storage_register = tms->decrementer_value = tms->current_value;
+		fast_clock(tms, 1);
+		return;
+	}
+
+	if (is_onchip(tms, tms->address))
+	{
+		if (word) tms->address &= 0xfffe;
+		tms->onchip_memory[tms->address & 0x00ff] = (tms->current_value >> 8) & 0xff;
+		if (word)
+			tms->onchip_memory[(tms->address & 0x00ff)+1] = tms->current_value & 0xff;
+		fast_clock(tms, 1);
+		return;
+	}
+
+	if (word)
+	{
+		tms9995_writeb(tms, tms->address & 0xfffe, (tms->current_value >> 8) & 0xff);
+		fast_clock(tms, wait);
+		tms9995_writeb(tms, tms->address | 1, tms->current_value & 0xff);
+	}
+	else
+		tms9995_writeb(tms, tms->address, (tms->current_value >> 8) & 0xff);
+	fast_clock(tms, wait);
+}
+
+static void fast_mem_write(struct tms9995 *tms)
+{
+	fast_write(tms, !tms->byteop);
+}
+
+static void fast_word_write(struct tms9995 *tms)
+{
+	fast_write(tms, true);
+}
+
+/*
+    Operand address derivation, as tms9995_operand_address_subprogram
+    followed by the matching part of operand_address_derivation.
+*/
+static void fast_operand_address(struct tms9995 *tms)
+{
+	uint16_t ircopy = tms->IR;
+	uint16_t index;
+
+	if (tms->get_destination) ircopy = ircopy >> 6;
+	tms->get_destination = true;
+
+	tms->regnumber = (ircopy & 0x000f);
+	tms->address = (tms->WP + (tms->regnumber<<1)) & 0xffff;
+	tms->source_value = tms->current_value;
+	tms->current_value = tms->address;
+
+	switch (ircopy & 0x0030)
+	{
+	case 0x0000:
+		// Register direct
+		break;
+	case 0x0010:
+		// Register indirect
+		fast_word_read(tms);
+		tms->address = tms->current_value;
+		break;
+	case 0x0020:
+		if (tms->regnumber != 0)
+		{
+			// Indexed
+			fast_word_read(tms);
+			index = tms->current_value;
+			fast_clock(tms, 1);
+			tms->address = tms->PC;
+			tms->PC = (tms->PC + 2) & 0xfffe;
+			fast_word_read(tms);
+			tms->address = tms->current_value + index;
+		}
+		else
+		{
+			// Symbolic
+			tms->address = tms->PC;
+			tms->PC = (tms->PC + 2) & 0xfffe;
+			fast_word_read(tms);
+			tms->address = tms->current_value;
+		}
+		break;
+	case 0x0030:
+		// Register indirect auto-increment
+		fast_word_read(tms);
+		tms->address_saved = tms->current_value;
+		tms->current_value += tms->byteop? 1 : 2;
+		tms->address = (tms->WP + (tms->regnumber<<1)) & 0xffff;
+		fast_clock(tms, 1);
+		fast_word_write(tms);
+		tms->address = tms->address_saved;
+		break;
+	}
+}
+
+/*
+    Interrupt checks in the same place and with the same rules as
+    tms9995_int_prefetch_and_decode. When IDLE the clock is run on to the
+    next decrementer interrupt or the end of the time slice, in which case
+    we return false and are called again on the next run.
+*/
+static bool fast_int_check(struct tms9995 *tms)
+{
+	int intmask = tms->ST & 0x000f;
+	int n, cycles;
+
+	while (1)
+	{
+		if (tms->nmi_active)
+		{
+			tms->int_pending |= PENDING_NMI;
+			tms->idle_state = false;
+			tms->PC = (tms->PC + 2) & 0xfffe;
+			return true;
+		}
+		tms->int_pending = 0;
+		if (tms->command != XOP && tms->command != BLWP)
+		{
+			if ((tms->int1_active || tms->flag[2]) && intmask >= 1) tms->int_pending |= PENDING_LEVEL1;
+			if (tms->int_overflow && intmask >= 2) tms->int_pending |= PENDING_OVERFLOW;
+			if (tms->flag[3] && intmask >= 3) tms->int_pending |= PENDING_DECR;
+			if ((tms->int4_active || tms->flag[4]) && intmask >= 4) tms->int_pending |= PENDING_LEVEL4;
+		}
+		if (tms->int_pending != 0)
+		{
+			tms->idle_state = false;
+			tms->PC = tms->PC + 2;
+			return true;
+		}
+		if (!tms->idle_state)
+			return true;
+		if (tms->icount <= 0)
+			return false;
+		// Nothing else can raise an interrupt until the next run
+		n = tms->icount;
+		if (tms->flag[0] == false && tms->flag[1] == true && tms->starting_count_storage_register)
+		{
+			cycles = 4 - tms->decrementer_clkdiv;
+			cycles += ((tms->decrementer_value ? tms->decrementer_value : 0x10000) - 1) * 4;
+			if (cycles < n)
+				n = cycles;
+		}
+		fast_clock(tms, n);
+	}
+}
+
+static void fast_prefetch_and_decode(struct tms9995 *tms)
+{
+	uint16_t address = tms->address;
+	uint16_t value = tms->current_value;
+
+	tms->iaq = true;
+	tms->address = tms->PC;
+	fast_word_read(tms);
+	tms9995_decode(tms, tms->current_value);
+	tms->address = address;
+	tms->current_value = value;
+	tms->PC = (tms->PC + 2) & 0xfffe;
+	tms->iaq = false;
+}
+
+static bool fast_prefetch(struct tms9995 *tms)
+{
+	if (!fast_int_check(tms))
+		return false;
+	if (tms->int_pending == 0)
+		fast_prefetch_and_decode(tms);
+	return true;
+}
+
+/*
+    CRU transfers repeat until the bit count is used up
+*/
+static void fast_cru_output(struct tms9995 *tms)
+{
+	do
+		tms9995_cru_output_operation(tms);
+	while (tms->count > 0);
+}
+
+static void fast_cru_input(struct tms9995 *tms)
+{
+	do
+		tms9995_cru_input_operation(tms);
+	while (--tms->pass > 0);
+	tms->pass = 1;
+}
+
+/*
+    The instructions. Each one is its microprogram written out.
+*/
+static void fast_add_s_sxc(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	tms9995_alu_add_s_sxc(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_b(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_b(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_bl(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_b(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	fast_mem_write(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_blwp(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	tms9995_alu_blwp(tms);
+	fast_mem_write(tms);
+	tms9995_alu_blwp(tms);
+	fast_mem_write(tms);
+	tms9995_alu_blwp(tms);
+	fast_mem_write(tms);
+	tms9995_alu_blwp(tms);
+	fast_mem_read(tms);
+	tms9995_alu_blwp(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_c(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	tms9995_alu_c(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_ci(struct tms9995 *tms)
+{
+	fast_mem_read(tms);
+	tms9995_set_immediate(tms);
+	fast_mem_read(tms);
+	tms9995_alu_ci(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_coc_czc(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	tms9995_alu_f3(tms);
+	fast_mem_read(tms);
+	tms9995_alu_f3(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_clr_seto(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_clr_seto(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+/* On overflow the divides stop early, prefetching the next instruction */
+static void fast_divide_abort(struct tms9995 *tms)
+{
+	fast_prefetch(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_divide(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	tms9995_alu_divide(tms);
+	fast_mem_read(tms);
+	tms9995_alu_divide(tms);
+	if (tms->ST & ST_OV)
+	{
+		fast_divide_abort(tms);
+		return;
+	}
+	fast_mem_read(tms);
+	tms9995_alu_divide(tms);
+	fast_mem_write(tms);
+	tms9995_alu_divide(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_divide_signed(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	tms9995_alu_divide_signed(tms);
+	fast_mem_read(tms);
+	tms9995_alu_divide_signed(tms);
+	fast_mem_read(tms);
+	tms9995_alu_divide_signed(tms);
+	if (tms->ST & ST_OV)
+	{
+		fast_divide_abort(tms);
+		return;
+	}
+	tms9995_alu_divide_signed(tms);
+	fast_mem_write(tms);
+	tms9995_alu_divide_signed(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+/* IDLE may stop in the prefetch, in which case the run loop resumes here */
+static void fast_external_tail(struct tms9995 *tms)
+{
+	if (!fast_prefetch(tms))
+		return;
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_external(struct tms9995 *tms)
+{
+	tms9995_alu_nop(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_external(tms);
+	fast_external_tail(tms);
+}
+
+static void fast_imm_arithm(struct tms9995 *tms)
+{
+	fast_mem_read(tms);
+	tms9995_set_immediate(tms);
+	fast_mem_read(tms);
+	tms9995_alu_imm_arithm(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_jump(struct tms9995 *tms)
+{
+	tms9995_alu_nop(tms);
+	tms9995_alu_jump(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_ldcr(struct tms9995 *tms)
+{
+	tms9995_alu_ldcr(tms);
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	tms9995_alu_ldcr(tms);
+	fast_word_read(tms);
+	tms9995_alu_ldcr(tms);
+	fast_cru_output(tms);
+	tms9995_alu_nop(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_li(struct tms9995 *tms)
+{
+	tms9995_set_immediate(tms);
+	fast_mem_read(tms);
+	tms9995_alu_li(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_limi_lwpi(struct tms9995 *tms)
+{
+	tms9995_set_immediate(tms);
+	fast_mem_read(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_limi_lwpi(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_lst_lwp(struct tms9995 *tms)
+{
+	fast_mem_read(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_lst_lwp(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_mov(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	fast_operand_address(tms);
+	tms9995_alu_mov(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_multiply(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	tms9995_alu_multiply(tms);
+	fast_mem_read(tms);
+	tms9995_alu_multiply(tms);
+	fast_mem_write(tms);
+	tms9995_alu_multiply(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_rtwp(struct tms9995 *tms)
+{
+	tms9995_alu_rtwp(tms);
+	fast_mem_read(tms);
+	tms9995_alu_rtwp(tms);
+	fast_mem_read(tms);
+	tms9995_alu_rtwp(tms);
+	fast_mem_read(tms);
+	tms9995_alu_rtwp(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_sbo_sbz(struct tms9995 *tms)
+{
+	tms9995_alu_sbo_sbz(tms);
+	fast_word_read(tms);
+	tms9995_alu_sbo_sbz(tms);
+	fast_cru_output(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_shift(struct tms9995 *tms)
+{
+	fast_mem_read(tms);
+	tms9995_alu_shift(tms);
+	// A zero count in the instruction takes the count from R0
+	if ((tms->IR & 0x00f0) == 0)
+		fast_mem_read(tms);
+	tms9995_alu_shift(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_single_arithm(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	tms9995_alu_single_arithm(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_stcr(struct tms9995 *tms)
+{
+	tms9995_alu_stcr(tms);
+	fast_operand_address(tms);
+	tms9995_alu_stcr(tms);
+	fast_word_read(tms);
+	tms9995_alu_stcr(tms);
+	fast_cru_input(tms);
+	tms9995_alu_stcr(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_stst_stwp(struct tms9995 *tms)
+{
+	tms9995_alu_stst_stwp(tms);
+	tms9995_alu_nop(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_tb(struct tms9995 *tms)
+{
+	tms9995_alu_tb(tms);
+	fast_word_read(tms);
+	tms9995_alu_tb(tms);
+	fast_cru_input(tms);
+	tms9995_alu_tb(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+/* The run loop picks up the instruction that X sets up */
+static void fast_x(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	tms9995_alu_x(tms);
+}
+
+static void fast_xop(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	tms9995_alu_xop(tms);
+	fast_mem_read(tms);
+	tms9995_alu_xop(tms);
+	fast_mem_write(tms);
+	tms9995_alu_xop(tms);
+	fast_mem_write(tms);
+	tms9995_alu_xop(tms);
+	fast_mem_write(tms);
+	tms9995_alu_xop(tms);
+	fast_mem_write(tms);
+	tms9995_alu_xop(tms);
+	fast_mem_read(tms);
+	tms9995_alu_xop(tms);
+	fast_prefetch(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_xor(struct tms9995 *tms)
+{
+	fast_operand_address(tms);
+	fast_mem_read(tms);
+	tms9995_alu_f3(tms);
+	fast_mem_read(tms);
+	tms9995_alu_f3(tms);
+	fast_prefetch(tms);
+	fast_mem_write(tms);
+	tms9995_command_completed(tms);
+}
+
+static void fast_int(struct tms9995 *tms)
+{
+	tms9995_alu_int(tms);
+	fast_mem_read(tms);
+	tms9995_alu_int(tms);
+	fast_mem_write(tms);
+	tms9995_alu_int(tms);
+	fast_mem_write(tms);
+	tms9995_alu_int(tms);
+	fast_mem_write(tms);
+	tms9995_alu_int(tms);
+	fast_mem_read(tms);
+	tms9995_alu_int(tms);
+	fast_prefetch_and_decode(tms);
+	tms9995_alu_nop(tms);
+	tms9995_alu_nop(tms);
+	tms9995_command_completed(tms);
+}
+
+static const struct {
+	microprogram prog;
+	fasthandler op;
+} fast_map[] = {
+	{ add_s_sxc_mp, fast_add_s_sxc },
+	{ b_mp, fast_b },
+	{ bl_mp, fast_bl },
+	{ blwp_mp, fast_blwp },
+	{ c_mp, fast_c },
+	{ ci_mp, fast_ci },
+	{ coc_czc_mp, fast_coc_czc },
+	{ clr_seto_mp, fast_clr_seto },
+	{ divide_mp, fast_divide },
+	{ divide_signed_mp, fast_divide_signed },
+	{ external_mp, fast_external },
+	{ imm_arithm_mp, fast_imm_arithm },
+	{ jump_mp, fast_jump },
+	{ ldcr_mp, fast_ldcr },
+	{ li_mp, fast_li },
+	{ limi_lwpi_mp, fast_limi_lwpi },
+	{ lst_lwp_mp, fast_lst_lwp },
+	{ mov_mp, fast_mov },
+	{ multiply_mp, fast_multiply },
+	{ rtwp_mp, fast_rtwp },
+	{ sbo_sbz_mp, fast_sbo_sbz },
+	{ shift_mp, fast_shift },
+	{ single_arithm_mp, fast_single_arithm },
+	{ stcr_mp, fast_stcr },
+	{ stst_stwp_mp, fast_stst_stwp },
+	{ tb_mp, fast_tb },
+	{ x_mp, fast_x },
+	{ xop_mp, fast_xop },
+	{ xor_mp, fast_xor },
+	{ int_mp, fast_int },
+	{ NULL, NULL }
+};
+
+/*
+    Build the handler table and a flat decode table from the decode tree
+*/
+static void fast_build_tables(struct tms9995 *tms)
+{
+	unsigned int i, j;
+
+	if (fast_decode)
+		return;
+
+	fast_decode = malloc(0x10000 * sizeof(*fast_decode));
+	if (fast_decode == NULL)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+	for (i = 0; i < 0x10000; i++)
+		fast_decode[i] = tms9995_lookup(tms, i);
+
+	for (i = 0; i < sizeof(s_command) / sizeof(s_command[0]); i++)
+	{
+		for (j = 0; fast_map[j].prog; j++)
+			if (fast_map[j].prog == s_command[i].prog)
+				fast_op[i] = fast_map[j].op;
+	}
+}
+
+/*
+    Select the fast interpreter. This must be done before the first run
+    or when the CPU is between instructions.
+*/
+void tms9995_set_fast(struct tms9995 *tms, bool onoff)
+{
+	if (onoff)
+		fast_build_tables(tms);
+	tms->fast = onoff;
+}
+
+static void tms9995_execute_fast(struct tms9995 *tms, unsigned int cycles)
+{
+	// Anything we ran over by last time comes out of this run
+	tms->icount += cycles;
+
+	if (tms->reset) tms9995_service_interrupt(tms);
+
+	while (tms->icount > 0 && !tms->reset)
+	{
+		if (tms->idle_state)
+			fast_external_tail(tms);
+		else
+			fast_op[tms->index](tms);
+	}
+}
+
 /* Disassembler */
 
 /* Op decode table */
@@ -229,6 +229,9 @@ struct tms9995 {
 	// Tracing
 	bool	trace;
 	bool	itrace;
+
+	// Use the fast interpreter
+	bool	fast;
 };
 
 /* The decode tables. Each node has 16 entries which can point to a subtable
@@ -254,6 +257,7 @@ extern void tms9995_write_cru(struct tms9995 *tms, uint16_t addr, uint8_t val);
 extern void tms9995_device_start(struct tms9995 *tms);
 extern struct tms9995 *tms9995_create(bool is_mp9537, bool bstep);
 extern void tms9995_trace(struct tms9995 *tms, bool onoff);
+extern void tms9995_set_fast(struct tms9995 *tms, bool onoff);
 
 extern void tms9995_execute_run(struct tms9995 *tms, unsigned int cycles);
 extern void tms9995_execute_set_input(struct tms9995 *tms, int irqline, bool state);
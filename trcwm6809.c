@@ -50,6 +50,7 @@
 static uint8_t rom[4096];
 static uint8_t ram[1024 * 1024];
 static uint8_t page;
+static struct e6809 cpu;
 static uint8_t sd_out;
 static uint8_t sd_in;
 
@@ -158,6 +159,25 @@ void uart16x50_signal_change(struct uart16x50 *uart, uint8_t mcr)
 	/* Modem lines changed - don't care */
 }
 
+static unsigned irq_lines(struct e6809 *cpu)
+{
+	return live_irq ? E6809_IRQ : 0;
+}
+
+/* Map the CPU straight onto RAM and ROM. The I/O window at E000 and
+   memory tracing have to go via e6809_read8/write8 */
+static void remap(void)
+{
+	if (trace & TRACE_MEM) {
+		e6809_map(&cpu, 0x0000, 0x10000, NULL, 0);
+		return;
+	}
+	e6809_map(&cpu, 0x0000, 0x8000, ram + (page << 15), 1);
+	e6809_map(&cpu, 0x8000, 0x6000, ram + 0x8000, 1);
+	e6809_map(&cpu, 0xE000, 0x1000, NULL, 0);
+	e6809_map(&cpu, 0xF000, 0x1000, rom, 0);
+}
+
 unsigned char do_e6809_read8(unsigned addr, unsigned debug)
 {
         unsigned char r = 0xFF;
@@ -181,7 +201,7 @@ unsigned char do_e6809_read8(unsigned addr, unsigned debug)
 	return r;
 }
 
-unsigned char e6809_read8(unsigned addr)
+unsigned char e6809_read8(struct e6809 *cpu, unsigned addr)
 {
 	return do_e6809_read8(addr, 0);
 }
@@ -191,7 +211,7 @@ unsigned char e6809_read8_debug(unsigned addr)
 	return do_e6809_read8(addr, 1);
 }
 
-void e6809_write8(unsigned addr, unsigned char val)
+void e6809_write8(struct e6809 *cpu, unsigned addr, unsigned char val)
 {
 	if (trace & TRACE_MEM)
 		fprintf(stderr, "W %04X = %02X\n", addr, val);
@@ -211,6 +231,7 @@ void e6809_write8(unsigned addr, unsigned char val)
         }
         else if ((addr & 0xF800) == 0xE800) {
             page = val & 0x1F;
+            remap();
             return;
         }
         else if (addr & 0x8000)
@@ -238,10 +259,10 @@ static const char *make_flags(uint8_t cc)
 }
 
 /* Called each new instruction issue */
-void e6809_instruction(unsigned pc)
+void e6809_instruction(struct e6809 *cpu, unsigned pc)
 {
 	char buf[80];
-	struct reg6809 *r = e6809_get_regs();
+	struct reg6809 *r = e6809_get_regs(cpu);
 	if (trace & TRACE_CPU) {
 		d6809_disassemble(buf, pc);
 		fprintf(stderr, "%04X: %-16.16s | ", pc, buf);
@@ -349,7 +370,8 @@ int main(int argc, char *argv[])
 		tcsetattr(0, TCSADRAIN, &term);
 	}
 
-	e6809_reset(trace & TRACE_CPU);
+	remap();
+	e6809_reset(&cpu, trace & TRACE_CPU);
 
 	/* This is the wrong way to do it but it's easier for the moment. We
 	   should track how much real time has occurred and try to keep cycle
@@ -359,8 +381,7 @@ int main(int argc, char *argv[])
 	while (!done) {
 		unsigned int i;
 		for (i = 0; i < 100; i++) {
-			while(cycles < clockrate)
-				cycles += e6809_sstep(live_irq, 0);
+			cycles += e6809_run(&cpu, clockrate - cycles, irq_lines);
 			cycles -= clockrate;
 			recalc_interrupts();
 		}
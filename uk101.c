@@ -23,6 +23,7 @@
 #include "ttycon.h"
 #include "acia.h"
 #include "keymatrix.h"
+#include "rasterclock.h"
 
 #define CWIDTH 8
 #define CHEIGHT 16
@@ -41,6 +42,7 @@ static uint8_t font[2048];
 static unsigned int video_upgrade;
 
 static uint8_t fast;
+static struct rasterclock *rclock;
 volatile int emulator_done;
 
 #define TRACE_MEM	0x000001
@@ -251,9 +253,15 @@ static void usage(void)
 	exit(EXIT_FAILURE);
 }
 
+/* exec6502 carries any overrun into the next call itself */
+static unsigned uk101_execute(void *unused, unsigned clocks)
+{
+	exec6502(clocks);
+	return clocks;
+}
+
 int main(int argc, char *argv[])
 {
-	static struct timespec tc;
 	static int tstates = 100;	/* 2MHz */
 	int opt;
 	char *rom_path = "uk101mon.rom";
@@ -344,11 +352,11 @@ int main(int argc, char *argv[])
 	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
 	SDL_RenderSetLogicalSize(render, 48 * CWIDTH,  16 * CHEIGHT);
 
-	/* 10ms - it's a balance between nice behaviour and simulation
-	   smoothness */
-
-	tc.tv_sec = 0;
-	tc.tv_nsec = 10000000L;
+	/* 10ms frames of 100 slices - it's a balance between nice behaviour
+	   and simulation smoothness */
+	rclock = rasterclock_create(tstates * 10000UL, tstates, 100);
+	rasterclock_fast(rclock, fast);
+	rasterclock_cpu(rclock, uk101_execute, NULL);
 
 	if (tcgetattr(0, &term) == 0) {
 		saved_term = term;
@@ -371,24 +379,14 @@ int main(int argc, char *argv[])
 	init6502();
 	reset6502();
 	
-	/* This is the wrong way to do it but it's easier for the moment. We
-	   should track how much real time has occurred and try to keep cycle
-	   matched with that. The scheme here works fine except when the host
-	   is loaded though */
-
 	while (!emulator_done) {
-		int i;
-		for (i = 0; i < 100; i++) {
-			exec6502(tstates);
-		}
+		rasterclock_run_frame(rclock);
 		/* We want to run UI events before we rasterize */
 		ui_event();
 		uk101_rasterize();
 		uk101_render();
 		acia_timer(acia);
-		/* Do 10ms of I/O and delays */
-		if (!fast)
-			nanosleep(&tc, NULL);
+		rasterclock_sync(rclock);
 	}
 	exit(0);
 }
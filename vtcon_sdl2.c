@@ -15,6 +15,7 @@
 #include "event.h"
 #include "asciikbd.h"
 #include "vtcon.h"
+#include "present_sdl2.h"
 
 #define CWIDTH	8
 #define CHEIGHT 16
@@ -28,47 +29,106 @@ struct vtcon {
     uint8_t s1, s2;
     unsigned y, x;
     SDL_Window *window;
-    SDL_Renderer *render;
-    SDL_Texture *texture;
+    struct present *present;
     uint32_t bitmap[80 * CWIDTH * 24 * CHEIGHT];
+    /* What each cell of the bitmap last showed: char | cursor << 8, or
+       0xFFFF if it has not been drawn */
+    uint16_t drawn[80 * 24];
+    SDL_Rect dirty;
     const char *name;
 };
 
+#define CELL_CURSOR	0x100
+
+/* Each glyph pre-expanded to pixels, normal and as the cursor */
+static uint32_t vtglyph[2][256][CWIDTH * CHEIGHT];
+static unsigned vtglyph_done;
+
 /* FIXME: We should have some kind of ui_event timer chain for this ! */
 
-static void vtchar(struct vtcon *v, unsigned y, unsigned x, uint8_t c)
+static void vtglyph_init(void)
 {
-    const uint8_t *fp = vtfont + 8 * c;	/* We make a 16 pixel char from 8 */
-    uint32_t *pixp = v->bitmap + x * CWIDTH + 80 * y * CHEIGHT * CWIDTH;
-    unsigned rows, pixels;
+    unsigned c, inv, rows, pixels;
+    const uint8_t *fp;
+    uint32_t *pixp;
+    uint8_t bits;
 
-    for (rows = 0; rows < CHEIGHT / 2; rows ++) {
-        uint8_t bits = *fp;
-        if (y == v->y && x == v->x)
-            bits ^= 0xFF;
-        for (pixels = 0; pixels < CWIDTH; pixels++) {
-            if (bits & 0x80)
-                *pixp++ = 0xFFFFBB0A;
-            else
-                *pixp++ = 0xFF0A0A0A;
-            bits <<= 1;
+    if (vtglyph_done)
+        return;
+    for (inv = 0; inv < 2; inv++) {
+        for (c = 0; c < 256; c++) {
+            fp = vtfont + 8 * c;	/* We make a 16 pixel char from 8 */
+            pixp = vtglyph[inv][c];
+            for (rows = 0; rows < CHEIGHT / 2; rows ++) {
+                bits = *fp;
+                if (inv)
+                    bits ^= 0xFF;
+                for (pixels = 0; pixels < CWIDTH; pixels++) {
+                    if (bits & 0x80)
+                        *pixp++ = 0xFFFFBB0A;
+                    else
+                        *pixp++ = 0xFF0A0A0A;
+                    bits <<= 1;
+                }
+                bits = *fp++;
+                if (inv)
+                    bits ^= 0xFF;
+                for (pixels = 0; pixels < CWIDTH; pixels++) {
+                    if (bits & 0x80)
+                        *pixp++ = 0xFFCCA20A;
+                    else
+                        *pixp++ = 0xFF060606;
+                    bits <<= 1;
+                }
+            }
         }
-        /* To next line */
-        pixp += 79 * CWIDTH;
+    }
+    vtglyph_done = 1;
+}
 
-        bits = *fp++;
-        if (y == v->y && x == v->x)
-            bits ^= 0xFF;
-        for (pixels = 0; pixels < CWIDTH; pixels++) {
-            if (bits & 0x80)
-                *pixp++ = 0xFFCCA20A;
-            else
-                *pixp++ = 0xFF060606;
-            bits <<= 1;
-        }
-        /* To next line */
-        pixp += 79 * CWIDTH;
+/* Note that cells x0 to x1 of row y need to go to the display */
+static void vtdamage(struct vtcon *v, unsigned y, unsigned x0, unsigned x1)
+{
+    int px0 = x0 * CWIDTH, px1 = (x1 + 1) * CWIDTH;
+    int py0 = y * CHEIGHT, py1 = (y + 1) * CHEIGHT;
+
+    if (v->dirty.w) {
+        if (v->dirty.x < px0)
+            px0 = v->dirty.x;
+        if (v->dirty.y < py0)
+            py0 = v->dirty.y;
+        if (v->dirty.x + v->dirty.w > px1)
+            px1 = v->dirty.x + v->dirty.w;
+        if (v->dirty.y + v->dirty.h > py1)
+            py1 = v->dirty.y + v->dirty.h;
     }
+    v->dirty.x = px0;
+    v->dirty.y = py0;
+    v->dirty.w = px1 - px0;
+    v->dirty.h = py1 - py0;
+}
+
+static void vtchar(struct vtcon *v, unsigned y, unsigned x, uint8_t c)
+{
+    unsigned cell = c;
+    const uint32_t *gp;
+    uint32_t *pixp;
+    unsigned rows;
+
+    if (y == v->y && x == v->x)
+        cell |= CELL_CURSOR;
+    if (v->drawn[80 * y + x] == cell)
+        return;
+    v->drawn[80 * y + x] = cell;
+
+    gp = vtglyph[!!(cell & CELL_CURSOR)][c];
+    pixp = v->bitmap + x * CWIDTH + 80 * y * CHEIGHT * CWIDTH;
+    for (rows = 0; rows < CHEIGHT; rows++) {
+        memcpy(pixp, gp, CWIDTH * sizeof(uint32_t));
+        gp += CWIDTH;
+        pixp += 80 * CWIDTH;
+    }
+    vtdamage(v, y, x, x);
 }
 
 static void vtrender(struct vtcon *v)
@@ -79,10 +139,24 @@ static void vtrender(struct vtcon *v)
     rect.w = 80 * CWIDTH;
     rect.h = 24 * CHEIGHT;
 
-    SDL_UpdateTexture(v->texture, NULL, v->bitmap, 80 * CWIDTH * 4);
-    SDL_RenderClear(v->render);
-    SDL_RenderCopy(v->render, v->texture, NULL, &rect);
-    SDL_RenderPresent(v->render);
+    v->dirty.w = 0;
+    present_frame(v->present, v->bitmap, 80 * CWIDTH * 4, &rect, 0xFF000000);
+}
+
+/* Send just what changed, if anything did */
+static void vtflush(struct vtcon *v)
+{
+    SDL_Rect rect;
+
+    if (v->dirty.w == 0)
+        return;
+    rect.x = rect.y = 0;
+    rect.w = 80 * CWIDTH;
+    rect.h = 24 * CHEIGHT;
+
+    present_area(v->present, v->bitmap, 80 * CWIDTH * 4, &v->dirty,
+        &rect, 0xFF000000);
+    v->dirty.w = 0;
 }
 
 static void vtraster(struct vtcon *v)
@@ -93,7 +167,7 @@ static void vtraster(struct vtcon *v)
         for (x = 0; x < 80; x++)
             vtchar(v, y, x, *p++);
 
-    vtrender(v);
+    vtflush(v);
 }
 
 /* Wipe helper for dumb console */
@@ -157,22 +231,9 @@ static void vtcon_init(struct vtcon *v)
         fprintf(stderr, "vt: unable to open window: %s\n", SDL_GetError());
         exit(1);
     }
-    v->render = SDL_CreateRenderer(v->window, -1, 0);
-    if (v->render == NULL) {
-        fprintf(stderr, "vt: unable to create renderer: %s\n", SDL_GetError());
-        exit(1);
-    }
-    v->texture = SDL_CreateTexture(v->render, SDL_PIXELFORMAT_ARGB8888,
-                    SDL_TEXTUREACCESS_STREAMING,
-                    80 * CWIDTH, 24 * CHEIGHT);
-    if (v->texture == NULL) {
-        fprintf(stderr, "vt: unable to create texture: %s\n", SDL_GetError());
-        exit(1);
-    }
-    SDL_SetRenderDrawColor(v->render, 0, 0, 0, 255);
-    SDL_RenderClear(v->render);
-    SDL_RenderPresent(v->render);
-    SDL_RenderSetLogicalSize(v->render, 80 * CWIDTH, 24 * CHEIGHT);
+    v->present = present_create(v->name, v->window, 0,
+                    80 * CWIDTH, 24 * CHEIGHT, 80 * CWIDTH, 24 * CHEIGHT);
+    vtglyph_init();
     asciikbd_bind(v->kbd, SDL_GetWindowID(v->window));
     add_ui_handler(vtcon_refresh, v);
     if (v->type == CON_DUMB) {
@@ -261,8 +322,8 @@ static void vtcon_put_dumb(struct serial_device *dev, uint8_t c)
         if (v->y == 24) {
             vtscroll_dumb(v);
             v->y = 23;
+            vtrender(v);
         }
-        vtrender(v);
         return;
     }
     if (c == 8) {
@@ -273,6 +334,8 @@ static void vtcon_put_dumb(struct serial_device *dev, uint8_t c)
 
     vtput(v, c);
     vtchar_dumb(v, c);
+    /* The ink bleeds a pixel into the cells either side */
+    vtdamage(v, v->y, v->x ? v->x - 1 : 0, v->x < 79 ? v->x + 1 : 79);
     v->x++;
     if (v->x == 80) {
         v->x = 0;
@@ -280,9 +343,11 @@ static void vtcon_put_dumb(struct serial_device *dev, uint8_t c)
         if (v->y == 24) {
             vtscroll_dumb(v);
             v->y = 23;
+            vtrender(v);
+            return;
         }
     }
-    vtrender(v);
+    vtflush(v);
 }
 
 static void vt52_clearacross(struct vtcon *v)
@@ -447,6 +512,8 @@ struct serial_device *vt_create(const char *name, unsigned type)
     dev->x = 0;
     dev->y = 0;
     memset(dev->video, ' ', sizeof(dev->video));
+    memset(dev->drawn, 0xFF, sizeof(dev->drawn));
+    dev->dirty.w = 0;
     dev->window = NULL;
     dev->name = name;
     dev->type = type;
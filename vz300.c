@@ -56,6 +56,7 @@
 #include "event.h"
 #include "keymatrix.h"
 #include "sdcard.h"
+#include "rasterclock.h"
 
 #include "event.h"
 
@@ -94,7 +95,7 @@ volatile int emulator_done;
 
 static int trace = 0;
 
-static unsigned video_line;		/* Scan line of the 262 NTSC we have */
+static struct rasterclock *rclock;	/* NTSC frame and beam position */
 
 static uint8_t *mmu(uint16_t addr, bool write)
 {
@@ -123,7 +124,7 @@ static uint8_t *mmu(uint16_t addr, bool write)
 	/* For 7000 to 77FF we should generate noise based upon the cycle
 	   position relative to screen if we are outside blanking TODO */
 	if (addr < 0x7800) {
-		m6847_sparkle(video, video_line, cpu_z80.tstates);	
+		m6847_sparkle(video, rasterclock_line(rclock), cpu_z80.tstates);
 		if (hires == 0 || vdcbank == 0)
 			return mem + addr;
 		/* Graphics expander mods : we put the extra above 128K in our
@@ -523,15 +524,23 @@ static void select_vzfile(void)
 	load_vzfile(buf);
 }
 
+static unsigned vz300_execute(void *unused, unsigned tstates)
+{
+	return Z80ExecuteTStates(&cpu_z80, tstates);
+}
+
+static void vz300_vblank(void *unused)
+{
+	m6847_rasterize(video);
+	Z80INT(&cpu_z80, 0xFF);
+}
+
 int main(int argc, char *argv[])
 {
-	static struct timespec tc;
 	int opt;
 	char *rom_path = "vz300.rom";
 	char *sdrom_path = "vz300sdload.rom";
 	char *sd_path = NULL;
-	int tstates_per_line = 227;
-	int tstates = 227;
 
 	while ((opt = getopt(argc, argv, "ar:R:d:fs:23")) != -1) {
 		switch (opt) {
@@ -583,11 +592,14 @@ int main(int argc, char *argv[])
 	m6847_reset(video);
 	render = m6847_renderer_create(video);
 
-	/* 10ms - it's a balance between nice behaviour and simulation
-	   smoothness */
-
-	tc.tv_sec = 0;
-	tc.tv_nsec = 16666667L;		/* 20ms - 50Hz, 16.67ms - 60Hz */
+	/* For the moment these are NTSC timings. Need to add PAL machines.
+	   Roughly right - need to tweak this to get 50Hz and the right speed
+	   plus 1 wait state */
+	rclock = rasterclock_create(3579545, 227, 262);
+	rasterclock_visible(rclock, 0, 192);
+	rasterclock_fast(rclock, fast);
+	rasterclock_cpu(rclock, vz300_execute, NULL);
+	rasterclock_vblank_handler(rclock, vz300_vblank, NULL);
 
 	if (tcgetattr(0, &term) == 0) {
 		saved_term = term;
@@ -611,29 +623,10 @@ int main(int argc, char *argv[])
 	cpu_z80.memWrite = mem_write;
 	cpu_z80.trace = vz300_trace;
 
-	/* This is the wrong way to do it but it's easier for the moment. We
-	   should track how much real time has occurred and try to keep cycle
-	   matched with that. The scheme here works fine except when the host
-	   is loaded though */
-
-	/* For the moment these are NTSC timings. Need to add PAL machines. We
-	   don't do line by line rastering at this point. We do need to do sparkle
-	   computation eventually */
+	/* We don't do line by line rastering at this point. We do need to do
+	   sparkle computation eventually */
 	while (!emulator_done) {
-		int i;
-		/* Roughly right - need to tweak this to get 50Hz and the
-		   right speed plus 1 wait state */
-		for (i = 0; i < 262; i++) {
-			if (i == 0) {
-				m6847_rasterize(video);
-				Z80INT(&cpu_z80, 0xFF);
-			}
-			video_line = i;
-			/* Keep track of the odd cycles from instructions going
-			   over the 227 */
-			tstates += tstates_per_line;
-			tstates -= Z80ExecuteTStates(&cpu_z80, tstates);
-		}
+		rasterclock_run_frame(rclock);
 		/* We are just about to go back into blank which means we've
 		   sparklified the raster image nicely ready to draw */
 		/* We want to run UI events before we rasterize */
@@ -641,9 +634,7 @@ int main(int argc, char *argv[])
 			Z80NMI(&cpu_z80);
 
 		m6847_render(render);
-		/* Do 16.66ms of I/O and delays */
-		if (!fast)
-			nanosleep(&tc, NULL);
+		rasterclock_sync(rclock);
 		if (check_chario() & 1) {
 			next_char();
 			tcsetattr(0, TCSADRAIN, &saved_term);
@@ -1230,3 +1230,17 @@ nic_w5100_write( nic_w5100_t *self, uint16_t reg, uint8_t b )
                      "w5100: writing 0x%02x to unsupported register 0x%03x\n",
                      b, reg );
 }
+
+/* Add the descriptors we are waiting on to a caller's select() sets so that
+   an idle emulator can sleep until the network has something for us. Returns
+   the highest descriptor added or -1 */
+int w5100_add_fds(nic_w5100_t *self, fd_set *readfds, fd_set *writefds)
+{
+  int i;
+  int max_fd = -1;
+
+  for( i = 0; i < 4; i++ )
+    nic_w5100_socket_add_to_sets( &self->socket[i], readfds, writefds,
+      &max_fd );
+  return max_fd;
+}
@@ -38,4 +38,5 @@ void nic_w5100_reset( nic_w5100_t *self );
 uint8_t nic_w5100_read( nic_w5100_t *self, uint16_t reg);
 void nic_w5100_write( nic_w5100_t *self, uint16_t reg, uint8_t b );
 void w5100_process(nic_w5100_t *self);
+int w5100_add_fds(nic_w5100_t *self, fd_set *readfds, fd_set *writefds);
 
@@ -160,6 +160,26 @@ void z180_phys_write(int unused, uint32_t addr, uint8_t val)
 		ram[addr] = val;
 }
 
+/*
+ *	The same decode for the DMA engine burst path and the CPU page
+ *	cache. The pointer is good to the end of the 4K page.
+ */
+static uint8_t *z180_phys_map(int unused, uint32_t addr, int wr)
+{
+	/* Memory tracing needs every access to go via mem_read/write */
+	if (trace & TRACE_MEM)
+		return NULL;
+	addr &= 0xFFFFF;
+	if (addr & 0x80000) {
+		if (port_c & 0x08)
+			return ram + addr;
+		return NULL;
+	}
+	if (port_a & 0x08)
+		return wr ? NULL : rom + (addr & 0x7FFFF);
+	return ram + addr;
+}
+
 /*
  *	Model CPU accesses starting with a virtual address
  */
@@ -429,6 +449,9 @@ void i82c55a_output(struct i82c55a *ppi, int port, uint8_t data)
 		port_c = data;
 		break;
 	}
+	/* ROM and upper RAM enables */
+	if (io)
+		z180_mem_remap(io);
 	if (trace & TRACE_PPI)
 		fprintf(stderr,"[PPI %02X %02X %02X]\n", port_a, port_b, port_c);
 	ppi_recalc();
@@ -516,10 +539,12 @@ void io_write(int unused, uint16_t addr, uint8_t val)
 		trace &= 0xFF00;
 		trace |= val;
 		printf("trace set to %04X\n", trace);
+		z180_mem_remap(io);
 	} else if (addr == 0xFE) {
 		trace &= 0xFF;
 		trace |= val << 8;
 		printf("trace set to %d\n", trace);
+		z180_mem_remap(io);
 	} else if (trace & TRACE_UNK)
 		fprintf(stderr, "Unknown write to port %04X of %02X\n", addr, val);
 }
@@ -665,6 +690,7 @@ int main(int argc, char *argv[])
 
 	io = z180_create(&cpu_z180);
 	z180_trace(io, trace & TRACE_CPU_IO);
+	z180_mem_map(io, z180_phys_map);
 	z180_ser_attach(io, 0, &console);
 	z180_ser_attach(io, 1, &console_wo);
 
@@ -758,7 +784,7 @@ int main(int argc, char *argv[])
 			for (j = 0; j < 100; j++) {
 				while (states < tstate_steps) {
 					unsigned int used;
-					used = z180_dma(io);
+					used = z180_dma(io, tstate_steps - states);
 					if (used == 0)
 						used = Z180Execute(&cpu_z180);
 					states += used;
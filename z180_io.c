@@ -74,6 +74,8 @@ struct z180_io {
 
     /* Internal used for steal mode */
     uint8_t dma_state0;
+    /* Direct physical memory access for burst DMA and the CPU page cache */
+    uint8_t *(*map)(int context, uint32_t addr, int wr);
 
     /* CPU internal context */
     Z180Context *cpu;
@@ -728,13 +730,16 @@ void z180_write(struct z180_io *io, uint8_t addr, uint8_t val)
     /* MMU */
     case 0x38:
         io->cbr = val;
+        z180_mem_remap(io);
         break;
     case 0x39:
         io->bbr = val;
+        z180_mem_remap(io);
         break;
     case 0x3A:
         /* Should we check for BA < CA ? */
         io->cbar = val;
+        z180_mem_remap(io);
         break;
     /* IO Control */
     case 0x3F:	/* ICR */
@@ -759,6 +764,29 @@ uint32_t z180_mmu_translate(struct z180_io *io, uint16_t addr)
     return addr + (io->bbr << 12);
 }
 
+/*
+ *	Fill in the CPU's per 4K page host pointers from the MMU and the
+ *	board's physical map. Pages the board doesn't map (ROM for writing,
+ *	memory mapped I/O and so on) are left NULL and go via mem_read and
+ *	mem_write. Boards must call this when their own decode changes.
+ */
+void z180_mem_remap(struct z180_io *io)
+{
+    unsigned int page;
+    uint32_t pa;
+
+    for (page = 0; page < 16; page++) {
+        if (io->map == NULL) {
+            io->cpu->readMap[page] = NULL;
+            io->cpu->writeMap[page] = NULL;
+            continue;
+        }
+        pa = z180_mmu_translate(io, page << 12);
+        io->cpu->readMap[page] = io->map(io->cpu->ioParam, pa, 0);
+        io->cpu->writeMap[page] = io->map(io->cpu->ioParam, pa, 1);
+    }
+}
+
 void z180_event(struct z180_io *io, unsigned int clocks)
 {
     z180_asci_event(io, io->asci);
@@ -785,9 +813,83 @@ void z180_event(struct z180_io *io, unsigned int clocks)
  *	NMI halting DMA
  *
  *	Our cycle stealing isn't quite correct
+ *
+ *	Memory to memory burst transfers hold the bus until they finish so
+ *	if the board gives us a direct mapping we do as many bytes as fit
+ *	in the caller's clock budget at once.
  */
 
-static unsigned int z180_dma_0(struct z180_io *io)
+/* Step a DMA address, returning the extra clocks for crossing 64K */
+static unsigned int z180_dma_step(uint32_t *addr, int dir)
+{
+    *addr = (*addr + dir) & 0xFFFFF;
+    if (dir > 0 && (*addr & 0xFFFF) == 0)
+        return 4;
+    if (dir < 0 && (*addr & 0xFFFF) == 0xFFFF)
+        return 4;
+    return 0;
+}
+
+/* Bytes left in the 4K page of an address going in direction dir */
+static unsigned int z180_dma_span(uint32_t addr, int dir)
+{
+    if (dir > 0)
+        return 4096 - (addr & 0xFFF);
+    if (dir < 0)
+        return (addr & 0xFFF) + 1;
+    return 65536;
+}
+
+static unsigned int z180_dma_0_burst(struct z180_io *io, unsigned int budget)
+{
+    static const int dirs[4] = { 1, -1, 0, 0 };
+    int sdir = dirs[(io->dmode >> 2) & 3];
+    int ddir = dirs[(io->dmode >> 4) & 3];
+    unsigned int cost = 0;
+    unsigned int left = io->bcr0 ? io->bcr0 : 65536;
+    unsigned int len, i;
+    uint8_t *sp, *dp;
+
+    while (left && cost < budget) {
+        sp = io->map(io->cpu->ioParam, io->sar0, 0);
+        dp = io->map(io->cpu->ioParam, io->dar0, 1);
+        if (sp == NULL || dp == NULL)
+            break;
+        /* Whole bytes until we reach the budget, a page end or the count.
+           As a chunk stops at a page end only its last byte can cross 64K */
+        len = (budget - cost + 5) / 6;
+        if (len > left)
+            len = left;
+        if (len > z180_dma_span(io->sar0, sdir))
+            len = z180_dma_span(io->sar0, sdir);
+        if (len > z180_dma_span(io->dar0, ddir))
+            len = z180_dma_span(io->dar0, ddir);
+        if (sdir == 1 && ddir == 1 && (dp + len <= sp || sp + len <= dp))
+            memcpy(dp, sp, len);
+        else {
+            for (i = 0; i < len; i++) {
+                *dp = *sp;
+                sp += sdir;
+                dp += ddir;
+            }
+        }
+        cost += 6 * len;
+        io->sar0 = (io->sar0 + sdir * (int)(len - 1)) & 0xFFFFF;
+        cost += z180_dma_step(&io->sar0, sdir);
+        io->dar0 = (io->dar0 + ddir * (int)(len - 1)) & 0xFFFFF;
+        cost += z180_dma_step(&io->dar0, ddir);
+        left -= len;
+    }
+    io->bcr0 = left;
+    if (cost && left == 0) {
+        io->dstat &= ~0x40;
+        if (io->trace)
+            fprintf(stderr, "DMA0 complete.\n");
+    }
+    return cost;
+}
+
+static unsigned int z180_dma_0(struct z180_io *io, unsigned int budget)
 {
     unsigned int cost = 6;	/* Cost of each transfer */
     uint8_t byte;
@@ -800,18 +902,22 @@ static unsigned int z180_dma_0(struct z180_io *io)
         io->dma_state0++;
         if (io->dma_state0 & 1)
             return 0;
+    } else if (io->map && (io->dmode & 0x0C) != 0x0C &&
+            (io->dmode & 0x30) != 0x30) {
+        unsigned int n = z180_dma_0_burst(io, budget);
+        if (n)
+            return n;
     }
 
     /* Fetch a byte */
-    /* TODO: when sar0/dar0 crosses a 64K boundary add 4 clocks */
     switch(io->dmode & 0x0C) {
     case 0x00:
-        byte = z180_phys_read(io->cpu->ioParam, io->sar0++);
-        io->sar0 &= 0xFFFFF;
+        byte = z180_phys_read(io->cpu->ioParam, io->sar0);
+        cost += z180_dma_step(&io->sar0, 1);
         break;
     case 0x04:
-        byte = z180_phys_read(io->cpu->ioParam, io->sar0--);
-        io->sar0 &= 0xFFFFF;
+        byte = z180_phys_read(io->cpu->ioParam, io->sar0);
+        cost += z180_dma_step(&io->sar0, -1);
         break;
     case 0x08:
         byte = z180_phys_read(io->cpu->ioParam, io->sar0);
@@ -823,12 +929,12 @@ static unsigned int z180_dma_0(struct z180_io *io)
     /* Store the byte */
     switch(io->dmode & 0x30) {
     case 0x00:
-        z180_phys_write(io->cpu->ioParam, io->dar0++, byte);
-        io->dar0 &= 0xFFFFF;
+        z180_phys_write(io->cpu->ioParam, io->dar0, byte);
+        cost += z180_dma_step(&io->dar0, 1);
         break;
     case 0x10:
-        z180_phys_write(io->cpu->ioParam, io->dar0--, byte);
-        io->dar0 &= 0xFFFFF;
+        z180_phys_write(io->cpu->ioParam, io->dar0, byte);
+        cost += z180_dma_step(&io->dar0, -1);
         break;
     case 0x20:
         z180_phys_write(io->cpu->ioParam, io->dar0, byte);
@@ -853,18 +959,15 @@ static unsigned int z180_dma_1(struct z180_io *io)
 
     /* TODO: model wait states */
 
-
-    /* TODO: when mar1 crosses a 64K boundary add 4 clocks */
-
     /* Fetch a byte */
     switch(io->dcntl & 0x03) {
     case 0x00:
-        byte = z180_phys_read(io->cpu->ioParam, io->mar1++);
-        io->mar1 &= 0xFFFFF;
+        byte = z180_phys_read(io->cpu->ioParam, io->mar1);
+        cost += z180_dma_step(&io->mar1, 1);
         break;
     case 0x01:
-        byte = z180_phys_read(io->cpu->ioParam, io->mar1--);
-        io->mar1 &= 0xFFFFF;
+        byte = z180_phys_read(io->cpu->ioParam, io->mar1);
+        cost += z180_dma_step(&io->mar1, -1);
         break;
     case 0x02:
     case 0x03:
@@ -878,12 +981,12 @@ static unsigned int z180_dma_1(struct z180_io *io)
         io->cpu->ioWrite(io->cpu->ioParam, io->iar1, byte);
         break;
     case 0x02:
-        z180_phys_write(io->cpu->ioParam, io->mar1++, byte);
-        io->mar1 &= 0xFFFFF;
+        z180_phys_write(io->cpu->ioParam, io->mar1, byte);
+        cost += z180_dma_step(&io->mar1, 1);
         break;
     case 0x03:
-        z180_phys_write(io->cpu->ioParam, io->mar1--, byte);
-        io->mar1 &= 0xFFFFF;
+        z180_phys_write(io->cpu->ioParam, io->mar1, byte);
+        cost += z180_dma_step(&io->mar1, -1);
     }
     if (--io->bcr1)
         return cost;
@@ -893,8 +996,9 @@ static unsigned int z180_dma_1(struct z180_io *io)
     return cost;
 }
 
-/* Run the DMA engines */
-unsigned int z180_dma(struct z180_io *io)
+/* Run the DMA engines. The budget is how many clocks the caller has left
+   before its next device poll, we may go slightly over it */
+unsigned int z180_dma(struct z180_io *io, unsigned int budget)
 {
     /* Engines off */
     if (!(io->dstat & 1))
@@ -902,12 +1006,21 @@ unsigned int z180_dma(struct z180_io *io)
 
     /* Channel enables */
     if (io->dstat & 0x40)
-        return z180_dma_0(io);
+        return z180_dma_0(io, budget);
     if (io->dstat & 0x80)
         return z180_dma_1(io);
     return 0;
 }
 
+/* Give the DMA engine and CPU direct access to physical memory. The map
+   returns a host pointer valid to the end of the 4K page or NULL if the
+   access has to go through z180_phys_read/write */
+void z180_mem_map(struct z180_io *io, uint8_t *(*map)(int context, uint32_t addr, int wr))
+{
+    io->map = map;
+    z180_mem_remap(io);
+}
+
 struct z180_io *z180_create(Z180Context *cpu)
 {
     struct z180_io *io = malloc(sizeof(struct z180_io));
@@ -928,6 +1041,7 @@ struct z180_io *z180_create(Z180Context *cpu)
     io->dcntl = 0xF0;	/* Manual disagrees with itself here */
     io->cpu = cpu;
     io->clock = 18432000;
+    z180_mem_remap(io);
     return io;
 }
 
@@ -6,7 +6,9 @@ void z180_write(struct z180_io *io, uint8_t addr, uint8_t val);
 uint32_t z180_mmu_translate(struct z180_io *io, uint16_t addr);
 void z180_event(struct z180_io *io, unsigned int clocks);
 void z180_interrupt(struct z180_io *io, uint8_t pin, uint8_t vec, bool on);
-unsigned int z180_dma(struct z180_io *io);
+unsigned int z180_dma(struct z180_io *io, unsigned int budget);
+void z180_mem_map(struct z180_io *io, uint8_t *(*map)(int context, uint32_t addr, int wr));
+void z180_mem_remap(struct z180_io *io);
 struct z180_io *z180_create(Z180Context *cpu);
 void z180_free(struct z180_io *io);
 void z180_trace(struct z180_io *io, int trace);
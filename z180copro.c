@@ -13,6 +13,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
 #include "libz180/z180.h"
 #include "serialdevice.h"
 #include "ttycon.h"
@@ -20,6 +21,40 @@
 #include "z180_io.h"
 #include "z180copro.h"
 
+/*
+ *	Threaded mode
+ *
+ *	Each card can run on its own host thread. The main CPU and the card
+ *	only talk through the shared window and the reset/interrupt latches,
+ *	so while threaded the main CPU works on its own copy of those and the
+ *	two views are merged whenever the card finishes a quantum. The card
+ *	then runs its next quantum while the main CPU carries on.
+ *
+ *	When both sides write the same shared byte in one quantum the main CPU
+ *	wins. For the latches a set wins over a clear so no interrupt is lost.
+ */
+
+struct copro_thread {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned go;		/* Quanta handed to the card */
+	unsigned done;		/* Quanta it has finished */
+	int quit;
+	unsigned quantum;	/* z180copro_run calls per hand over */
+	unsigned calls;
+	int slice;		/* T-states to run this quantum */
+	/* Main CPU view of the card */
+	uint8_t shared[1024];
+	uint16_t state;
+	uint16_t base;		/* Latch state at the last merge */
+	uint16_t host_set, host_clr;
+	uint16_t copro_set, copro_clr;
+	uint8_t host_dirty[128];
+	uint8_t copro_dirty[128];
+	uint8_t host_any, copro_any;
+};
+
 /*
  *	Coprocessor internal memory and I/O model
  */
@@ -27,12 +62,15 @@
 #define TRACE_IO	1
 #define TRACE_MEM	2
 
-static struct z180copro *copro[MAX_COPRO];
-static int copro_next;
+/* Cards from every machine in the process, slots are reused once freed */
+#define COPRO_SLOTS	64
+
+static struct z180copro *copro[COPRO_SLOTS];
+static pthread_mutex_t copro_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static struct z180copro *get_copro(int n)
 {
-	if (n < 0 || n >= MAX_COPRO || !copro[n]) {
+	if (n < 0 || n >= COPRO_SLOTS || !copro[n]) {
 		fprintf(stderr, "Bad copro %d.\n", n);
 		exit(1);
 	}
@@ -43,7 +81,7 @@ static struct z180copro *get_copro(int n)
 static struct z180copro *find_copro(struct z180_io *io)
 {
 	unsigned n;
-	for (n = 0; n < MAX_COPRO; n++) {
+	for (n = 0; n < COPRO_SLOTS; n++) {
 		if (copro[n] && copro[n]->io == io)
 			return copro[n];
 	}
@@ -88,8 +126,11 @@ uint8_t z180_phys_read(int unit, uint32_t addr)
 	uint8_t *p = mdecode(c, addr, 0);
 	if (c->trace & TRACE_MEM)
 		fprintf(stderr, "R[%X] %06X = %02X\n", unit, addr, *p);
-	if (addr == 0x3FF)
+	if (addr == 0x3FF) {
 		c->state &= ~COPRO_IRQ_IN;
+		if (c->thread)
+			c->thread->copro_clr |= COPRO_IRQ_IN;
+	}
 	return *p;
 }
 
@@ -104,8 +145,16 @@ void z180_phys_write(int unit, uint32_t addr, uint8_t val)
 	}
 	if (c->trace & TRACE_MEM)
 		fprintf(stderr, "W[%X] %06X <- %02X\n", unit, addr, val);
-	if (addr == 0x3FE)
+	if (addr == 0x3FE) {
 		c->state |= COPRO_IRQ_OUT;
+		if (c->thread)
+			c->thread->copro_set |= COPRO_IRQ_OUT;
+	}
+	if (c->thread && addr < 0x80000) {
+		addr &= 0x3FF;
+		c->thread->copro_dirty[addr >> 3] |= 1 << (addr & 7);
+		c->thread->copro_any = 1;
+	}
 	*p = val;
 }
 
@@ -118,7 +167,7 @@ static uint8_t do_mem_read(int unit, uint16_t addr, int quiet)
 	struct z180copro *c = get_copro(unit);
 	uint32_t pa = z180_mmu_translate(c->io, addr);
 	uint8_t r;
-	r = z180_phys_read(0, pa);
+	r = z180_phys_read(unit, pa);
 	if (!quiet && (c->trace & TRACE_MEM))
 		fprintf(stderr, "R %04X[%06X] -> %02X\n", addr, pa, r);
 	return r;
@@ -135,7 +184,7 @@ static void mem_write(int unit, uint16_t addr, uint8_t val)
 	uint32_t pa = z180_mmu_translate(c->io, addr);
 	if (c->trace & TRACE_MEM)
 		fprintf(stderr, "W: %04X[%06X] <- %02X\n", addr, pa, val);
-	z180_phys_write(0, pa, val);
+	z180_phys_write(unit, pa, val);
 }
 
 /*
@@ -173,64 +222,213 @@ void z180copro_reset(struct z180copro *c)
 	c->cpu.ioParam = c->unit;
 	c->state = COPRO_RESET;
 	c->tstates = 37;
+	c->budget = 0;
 	c->irq_pending = 0;
 }
 
 /*
- *	Briefly run the co-processor.
+ *	Run the co-processor for a number of clocks
  */
-void z180copro_run(struct z180copro *c)
+static void z180copro_execute(struct z180copro *c, int tstates)
 {
-	static int n = 0;
 	unsigned used;
 	/* CPU is held in reset */
 	if (c->state & COPRO_RESET)
 		return;
 	if (c->state & COPRO_IRQ_IN)
 		Z180INT(&c->cpu, 0xFF);	/* Vector really not defined */
-	n += c->tstates;
-	while(n >= 0) {
-		used = z180_dma(c->io);
+	c->budget += tstates;
+	while(c->budget >= 0) {
+		used = z180_dma(c->io, c->budget + 1);
 		if (used == 0)
 			used = Z180Execute(&c->cpu);
-		n -= used;
+		c->budget -= used;
+	}
+}
+
+static void *z180copro_thread(void *arg)
+{
+	struct z180copro *c = arg;
+	struct copro_thread *t = c->thread;
+
+	pthread_mutex_lock(&t->lock);
+	while (!t->quit) {
+		if (t->go == t->done) {
+			pthread_cond_wait(&t->cond, &t->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&t->lock);
+		z180copro_execute(c, t->slice);
+		pthread_mutex_lock(&t->lock);
+		t->done = t->go;
+		pthread_cond_broadcast(&t->cond);
+	}
+	pthread_mutex_unlock(&t->lock);
+	return NULL;
+}
+
+/* Merge the two views of the card. Both sides must be idle */
+static void z180copro_exchange(struct z180copro *c)
+{
+	struct copro_thread *t = c->thread;
+	unsigned i;
+	uint16_t merged;
+
+	if (t->host_any || t->copro_any) {
+		for (i = 0; i < 1024; i++) {
+			uint8_t bit = 1 << (i & 7);
+			if (t->host_dirty[i >> 3] & bit)
+				c->shared[i] = t->shared[i];
+			else if (t->copro_dirty[i >> 3] & bit)
+				t->shared[i] = c->shared[i];
+		}
+		memset(t->host_dirty, 0, sizeof(t->host_dirty));
+		memset(t->copro_dirty, 0, sizeof(t->copro_dirty));
+		t->host_any = 0;
+		t->copro_any = 0;
+	}
+	merged = t->base & ~(t->host_clr | t->copro_clr);
+	merged |= t->host_set | t->copro_set;
+	c->state = merged;
+	t->state = merged;
+	t->base = merged;
+	t->host_set = t->host_clr = 0;
+	t->copro_set = t->copro_clr = 0;
+}
+
+/* Wait for the card to finish its quantum, merge and start the next */
+static void z180copro_sync(struct z180copro *c)
+{
+	struct copro_thread *t = c->thread;
+
+	pthread_mutex_lock(&t->lock);
+	while (t->done != t->go)
+		pthread_cond_wait(&t->cond, &t->lock);
+	z180copro_exchange(c);
+	t->slice = t->quantum * c->tstates;
+	t->go++;
+	pthread_cond_broadcast(&t->cond);
+	pthread_mutex_unlock(&t->lock);
+}
+
+/*
+ *	Briefly run the co-processor. In threaded mode we only hand over
+ *	every quantum calls and the card runs alongside us.
+ */
+void z180copro_run(struct z180copro *c)
+{
+	struct copro_thread *t = c->thread;
+	if (t == NULL) {
+		z180copro_execute(c, c->tstates);
+		return;
+	}
+	if (++t->calls < t->quantum)
+		return;
+	t->calls = 0;
+	z180copro_sync(c);
+}
+
+/*
+ *	Move the card onto its own host thread. quantum is the number of
+ *	z180copro_run calls between exchanges with the main CPU.
+ */
+void z180copro_threaded(struct z180copro *c, unsigned quantum)
+{
+	struct copro_thread *t;
+
+	if (c->thread)
+		return;
+	t = calloc(1, sizeof(struct copro_thread));
+	if (t == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+	t->quantum = quantum ? quantum : 1;
+	memcpy(t->shared, c->shared, sizeof(t->shared));
+	t->state = t->base = c->state;
+	pthread_mutex_init(&t->lock, NULL);
+	pthread_cond_init(&t->cond, NULL);
+	c->thread = t;
+	if (pthread_create(&t->thread, NULL, z180copro_thread, c)) {
+		fprintf(stderr, "z180copro: unable to create thread.\n");
+		exit(1);
 	}
 }
 
+static void z180copro_stop(struct z180copro *c)
+{
+	struct copro_thread *t = c->thread;
+
+	pthread_mutex_lock(&t->lock);
+	t->quit = 1;
+	pthread_cond_broadcast(&t->cond);
+	pthread_mutex_unlock(&t->lock);
+	pthread_join(t->thread, NULL);
+	pthread_mutex_destroy(&t->lock);
+	pthread_cond_destroy(&t->cond);
+	c->thread = NULL;
+	free(t);
+}
+
 /*
  *	Main system view of the co-processor card. The latches and their
  *	control effects included
  */
 void z180copro_iowrite(struct z180copro *c, uint16_t addr, uint8_t bits)
 {
+	struct copro_thread *t = c->thread;
 	uint16_t sma = (addr >> 8) | ((addr & 3) << 8);
-	c->shared[sma] = bits;
+	uint16_t *state = t ? &t->state : &c->state;
+	uint16_t set = 0, clr = 0;
+
+	if (t) {
+		t->shared[sma] = bits;
+		t->host_dirty[sma >> 3] |= 1 << (sma & 7);
+		t->host_any = 1;
+	} else
+		c->shared[sma] = bits;
 	if (addr & 4)
-		c->state &= ~COPRO_RESET;
+		clr |= COPRO_RESET;
 	else
-		c->state |= COPRO_RESET;
+		set |= COPRO_RESET;
 	if (sma == 0x3FF)
-		c->state |= COPRO_IRQ_IN;
+		set |= COPRO_IRQ_IN;
+	*state = (*state & ~clr) | set;
+	if (t) {
+		t->host_clr = (t->host_clr | clr) & ~set;
+		t->host_set = (t->host_set | set) & ~clr;
+	}
 }
 
 uint8_t z180copro_ioread(struct z180copro *c, uint16_t addr)
 {
+	struct copro_thread *t = c->thread;
 	uint16_t sma;
+	uint16_t *state = t ? &t->state : &c->state;
+	uint16_t set = 0, clr = 0;
+
 	sma = (addr >> 8) | ((addr & 3) << 8);
 	if (addr & 4)
-		c->state &= ~COPRO_RESET;
+		clr |= COPRO_RESET;
 	else
-		c->state |= COPRO_RESET;
+		set |= COPRO_RESET;
 	if (sma == 0x3FF)
-		c->state &= ~COPRO_IRQ_OUT;
+		clr |= COPRO_IRQ_OUT;
+	*state = (*state & ~clr) | set;
+	if (t) {
+		t->host_clr = (t->host_clr | clr) & ~set;
+		t->host_set = (t->host_set | set) & ~clr;
+		return t->shared[sma];
+	}
 	return c->shared[sma];
 }
 
 int z180copro_intraised(struct z180copro *c)
 {
-	if (c->state & COPRO_RESET)
+	uint16_t state = c->thread ? c->thread->state : c->state;
+	if (state & COPRO_RESET)
 		return 0;
-	return c->state & COPRO_IRQ_OUT;
+	return state & COPRO_IRQ_OUT;
 }
 
 /*
@@ -239,19 +437,25 @@ int z180copro_intraised(struct z180copro *c)
 struct z180copro *z180copro_create(void)
 {
 	struct z180copro *c;
+	int n;
 
-	if (copro_next >= MAX_COPRO) {
-		fprintf(stderr, "Too many co-processor cards.\n");
-		exit(1);
-	}
 	c = malloc(sizeof(struct z180copro));
 	if (c == NULL) {
 		fprintf(stderr, "Out of memory.\n");
 		exit(1);
 	}
 	memset(c, 0, sizeof(struct z180copro));
-	c->unit = copro_next++;
-	copro[c->unit] = c;
+	pthread_mutex_lock(&copro_lock);
+	for (n = 0; n < COPRO_SLOTS; n++)
+		if (copro[n] == NULL)
+			break;
+	if (n == COPRO_SLOTS) {
+		fprintf(stderr, "Too many co-processor cards.\n");
+		exit(1);
+	}
+	c->unit = n;
+	copro[n] = c;
+	pthread_mutex_unlock(&copro_lock);
 	c->io = z180_create(&c->cpu);
 	z180copro_reset(c);
 	/* For now route the serial to NULL */
@@ -262,8 +466,11 @@ struct z180copro *z180copro_create(void)
 
 void z180copro_free(struct z180copro *c)
 {
-	/* FIXME: we don't reuse slots */
+	if (c->thread)
+		z180copro_stop(c);
+	pthread_mutex_lock(&copro_lock);
 	copro[c->unit] = NULL;
+	pthread_mutex_unlock(&copro_lock);
 	free(c);
 }
 
@@ -10,8 +10,10 @@ struct z180copro {
 #define COPRO_IRQ_IN	2
 #define COPRO_IRQ_OUT	4
     int tstates;
+    int budget;
     int irq_pending;
     int trace;
+    struct copro_thread *thread;	/* Set if running on its own thread */
 };
 
 #define MAX_COPRO	4
@@ -26,3 +28,4 @@ extern struct z180copro *z180copro_create(void);
 extern void z180copro_free(struct z180copro *c);
 extern void z180copro_trace(struct z180copro *c, int onoff);
 extern void z180copro_attach_sd(struct z180copro *c, int fd);
+extern void z180copro_threaded(struct z180copro *c, unsigned quantum);
@@ -723,553 +723,742 @@ static int z8_cc_true(struct z8 *z8, int code)
 	return r;
 }
 
-static void z8_execute_group2(struct z8 *z8, uint_fast8_t oph, uint_fast8_t opl)
+/*
+ *	Instruction execution. Each opcode has its own handler in a table
+ *	built once at create time, so the addressing mode is decided when
+ *	the table is built rather than decoded on every instruction.
+ */
+
+typedef void (*z8_handler)(struct z8 *z8, uint8_t opcode);
+
+static z8_handler z8_optab[256];
+
+/* Illegal, WDH/WDT, STOP, HALT and the unused oddities */
+static void z8_op_none(struct z8 *z8, uint8_t opcode)
 {
-	uint8_t d;
-	uint16_t da;
-	switch (opl) {
-	case 0x08:		/* LD r1,R2 */
-		d = z8_read_code(z8, z8->pc++);
-		setwreg(z8, oph, getreg(z8, d));
-		z8->cycles += 6;
-		break;
-	case 0x09:		/* LD R2,r1 */
-		d = z8_read_code(z8, z8->pc++);
-		setreg(z8, d, getwreg(z8, oph));
-		z8->cycles += 6;
-		break;
-	case 0x0A:		/* DJNZ */
-		d = getwreg(z8, oph) - 1;
-		setwreg(z8, oph, d);
-		if (d) {
-			d = z8_read_code(z8, z8->pc++);
-			z8->pc += (int8_t)d;
-			z8->cycles += 12;
-		} else {
-			z8->pc++;
-			z8->cycles += 10;
-		}
-		break;
-	case 0x0B:		/* JR */
-		d = z8_read_code(z8, z8->pc++);
-		if (z8_cc_true(z8, oph)) {
-			z8->cycles += 12;
-			z8->pc += (int8_t)d;
-		} else
-			z8->cycles += 10;
-		break;
-	case 0x0C:		/* LD r1,IM */
+}
+
+/*
+ *	x8-xE : working register forms. The high nibble is the register
+ *	or condition code.
+ */
+static void z8_op_ld_r_R(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t d = z8_read_code(z8, z8->pc++);
+	setwreg(z8, opcode >> 4, getreg(z8, d));
+	z8->cycles += 6;
+}
+
+static void z8_op_ld_R_r(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t d = z8_read_code(z8, z8->pc++);
+	setreg(z8, d, getwreg(z8, opcode >> 4));
+	z8->cycles += 6;
+}
+
+static void z8_op_djnz(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t d = getwreg(z8, opcode >> 4) - 1;
+	setwreg(z8, opcode >> 4, d);
+	if (d) {
 		d = z8_read_code(z8, z8->pc++);
-		setwreg(z8, oph, d);
-		break;
-	case 0x0D:		/* JP cc,DA */
-		da = z8_read_code(z8, z8->pc++) << 8;
-		da |= z8_read_code(z8, z8->pc++);
-		if (z8_cc_true(z8, oph)) {
-			z8->cycles += 12;
-			z8->pc = da;
-		} else
-			z8->cycles += 10;
-		break;
-	case 0x0E:		/* INC */
-		d = getwreg(z8, oph) + 1;
-		setwreg(z8, oph, d);
-		z8->reg[R_FLAGS] &= ~(F_S | F_Z | F_V);
-		if (d == 0)
-			z8->reg[R_FLAGS] |= F_Z;
-		if (d & 0x80)
-			z8->reg[R_FLAGS] |= F_S;
-		if (d == 0x80)
-			z8->reg[R_FLAGS] |= F_V;
-		z8->cycles += 6;
-		break;
-	case 0x0F:
-		/* Specials */
-		switch (oph) {
-		case 0x04:
-			/* WDH */
-			break;
-		case 0x05:
-			/* WDL */
-			break;
-		case 0x06:
-			/* TODO */
-			/* STOP */
-			break;
-		case 0x07:
-			/* TODO */
-			/* HALT */
-			break;	/* FIXME */
-		case 0x08:
-			/* DI */
-			z8->reg[R_IMR] &= 0x7F;
-			z8->cycles += 6;
-			z8->ei_state = 0;
-			break;
-		case 0x09:
-			/* EI */
-			z8->reg[R_IMR] |= 0x80;
-			z8->cycles += 6;
-			z8->done_ei = 1;
-			z8->ei_state = 1;
-			break;
-		case 0x0A:
-			/* RET */
-			z8->pc = z8_pop16(z8);
-			z8->cycles += 14;
-			break;
-		case 0x0B:
-			/* IRET */
-			z8->reg[R_FLAGS] = z8_pop8(z8);
-			z8->pc = z8_pop16(z8);
-			z8->reg[R_IMR] |= 0x80;
-			z8->ei_state = 1;
-			z8->cycles += 16;
-			break;
-		case 0x0C:
-			/* RCF */
-			z8->reg[R_FLAGS] &= ~F_C;
-			z8->cycles += 6;
-			break;
-		case 0x0D:
-			/* SCF */
-			z8->reg[R_FLAGS] |= F_C;
-			z8->cycles += 6;
-			break;
-		case 0x0E:
-			/* CCF */
-			z8->reg[R_FLAGS] ^= F_C;
-			z8->cycles += 6;
-			break;
-		case 0x0F:
-			/* NOP */
-			z8->cycles += 6;
-			break;
-		}
+		z8->pc += (int8_t)d;
+		z8->cycles += 12;
+	} else {
+		z8->pc++;
+		z8->cycles += 10;
 	}
 }
 
-static void z8_execute_group3(struct z8 *z8, uint_fast8_t oph, uint_fast8_t opl)
+static void z8_op_jr(struct z8 *z8, uint8_t opcode)
 {
-	uint8_t v;
-	uint8_t w;
-	uint8_t r = z8_read_code(z8, z8->pc++);
-	/* SRP is weird */
-	if (opl == 0x01 && oph != 0x03) {
-		r = getreg(z8, r);
-	}
-	switch (oph) {
-	case 0x00:		/* DEC */
-		v = getreg(z8, r) - 1;
-		setreg(z8, r, v);
-		z8->reg[R_FLAGS] &= ~(F_S | F_Z | F_V);
-		if (v == 0)
-			z8->reg[R_FLAGS] |= F_Z;
-		if (v & 0x80)
-			z8->reg[R_FLAGS] |= F_S;
-		if (v == 0x7F)
-			z8->reg[R_FLAGS] |= F_V;
-		z8->cycles += 6;
-		break;
-	case 0x01:		/* RLC */
-		v = getreg(z8, r);
-		w = v << 1;
-		w |= CARRY ? 0x01 : 0x00;
-		if (v & 0x80)
-			z8->reg[R_FLAGS] |= F_C;
-		else
-			z8->reg[R_FLAGS] &= ~F_C;
-		setreg(z8, r, w);
-		z8_logic(z8, w);
-		z8->cycles += 6;
-		break;
-	case 0x02:		/* INC */
-		v = getreg(z8, r) + 1;
-		setreg(z8, r, v);
-		z8->reg[R_FLAGS] &= ~(F_S | F_Z | F_V);
-		if (v == 0)
-			z8->reg[R_FLAGS] |= F_Z;
-		if (v & 0x80)
-			z8->reg[R_FLAGS] |= F_S;
-		if (v == 0x80)
-			z8->reg[R_FLAGS] |= F_V;
-		z8->cycles += 6;
-		break;
-	case 0x03:		/* JP and SRP */
-		if (opl == 0x00) {
-			z8->pc = getIRR(z8, r);
-			z8->cycles += 8;
-		} else {
-			setreg(z8, R_RP, r);
-			z8->cycles += 6;
-		}
-		break;
-	case 0x04:		/* DA */
-		/* TODO */
-		z8->cycles += 8;
-		break;
-	case 0x05:		/* POP */
-		setreg(z8, r, z8_pop8(z8));
-		z8->cycles += 10;
-		break;
-	case 0x06:		/* COM */
-		setreg(z8, r, z8_logic(z8, ~getreg(z8, r)));
-		z8->cycles += 6;
-		break;
-	case 0x07:		/* PUSH */
-		z8_push8(z8, getreg(z8, r));
-		z8->cycles += 10;
-		if (opl == 0x01)
-			z8->cycles += 2;
-		/* FIXME: double check push/pop timing */
-		if (!(z8->reg[R_P01M] & 0x04))
-			z8->cycles += 2;
-		break;
-	case 0x08:		/* DECW */
-		r &= 0xFE;
-		z8_idop16(z8, r, -1);
+	uint8_t d = z8_read_code(z8, z8->pc++);
+	if (z8_cc_true(z8, opcode >> 4)) {
+		z8->cycles += 12;
+		z8->pc += (int8_t)d;
+	} else
 		z8->cycles += 10;
-		break;
-	case 0x09:		/* RL */
-		v = getreg(z8, r);
-		w = v << 1;
-		w |= (v & 0x80) ? 0x01 : 0x00;
-		if (v & 0x80)
-			z8->reg[R_FLAGS] |= F_C;
-		else
-			z8->reg[R_FLAGS] &= ~F_C;
-		setreg(z8, r, w);
-		z8_logic(z8, w);
-		z8->cycles += 6;
-		break;
-	case 0x0A:		/* INCW */
-		r &= 0xFE;
-		z8_idop16(z8, r, 1);
+}
+
+static void z8_op_ld_r_im(struct z8 *z8, uint8_t opcode)
+{
+	setwreg(z8, opcode >> 4, z8_read_code(z8, z8->pc++));
+}
+
+static void z8_op_jp_cc(struct z8 *z8, uint8_t opcode)
+{
+	uint16_t da = z8_read_code(z8, z8->pc++) << 8;
+	da |= z8_read_code(z8, z8->pc++);
+	if (z8_cc_true(z8, opcode >> 4)) {
+		z8->cycles += 12;
+		z8->pc = da;
+	} else
 		z8->cycles += 10;
-		break;
-	case 0x0B:		/* CLR */
-		setreg(z8, r, 0);
-		z8->cycles += 6;
-		break;
-	case 0x0C:		/* RRC */
-		v = getreg(z8, r);
-		w = v >> 1;
-		/* Go via carry (9bit rotate in effect) */
-		w |= CARRY ? 0x80 : 0x00;
-		if (v & 0x01)
-			z8->reg[R_FLAGS] |= F_C;
-		else
-			z8->reg[R_FLAGS] &= ~F_C;
-		setreg(z8, r, w);
-		z8_logic(z8, w);
-		z8->cycles += 6;
-		break;
-	case 0x0D:		/* SRA */
-		v = getreg(z8, r);
-		w = v >> 1;
-		w |= (v & 0x80);
-		if (v & 0x01)
-			z8->reg[R_FLAGS] |= F_C;
-		else
-			z8->reg[R_FLAGS] &= ~F_C;
-		setreg(z8, r, w);
-		z8_logic(z8, w);
-		z8->cycles += 6;
-		break;
-	case 0x0E:		/* RR */
-		v = getreg(z8, r);
-		w = v >> 1;
-		/* RR is SRA except bit 0 goes into bit 7 instead of bit 7
-		   being constant */
-		w |= (v & 0x01) ? 0x80 : 0x00;
-		if (v & 0x01)
-			z8->reg[R_FLAGS] |= F_C;
-		else
-			z8->reg[R_FLAGS] &= ~F_C;
-		setreg(z8, r, w);
-		z8_logic(z8, w);
-		z8->cycles += 6;
-		break;
-	case 0x0F:		/* SWAP */
-		v = getreg(z8, r);
-		v = (v >> 4) | (v << 4);
-		setreg(z8, r, v);
-		/* C and V are 'undefined'. As we don't know the algorithm the
-		   CPU uses just do whatever */
-		z8_logic(z8, v);
-		z8->cycles += 8;
-		break;
-	}
 }
 
-static void rdecode0(struct z8 *z8)
+static void z8_op_inc_r(struct z8 *z8, uint8_t opcode)
 {
-	uint8_t r = z8_read_code(z8, z8->pc++);
-	uint8_t r2;
-	/* 6 cycles for 2 byte, 10 for 3 */
+	uint8_t d = getwreg(z8, opcode >> 4) + 1;
+	setwreg(z8, opcode >> 4, d);
+	z8->reg[R_FLAGS] &= ~(F_S | F_Z | F_V);
+	if (d == 0)
+		z8->reg[R_FLAGS] |= F_Z;
+	if (d & 0x80)
+		z8->reg[R_FLAGS] |= F_S;
+	if (d == 0x80)
+		z8->reg[R_FLAGS] |= F_V;
+	z8->cycles += 6;
+}
 
+/*
+ *	xF : implicit operands
+ */
+static void z8_op_di(struct z8 *z8, uint8_t opcode)
+{
+	z8->reg[R_IMR] &= 0x7F;
 	z8->cycles += 6;
-	if (z8->opl & 0x04) {
-		z8->cycles += 4;
-		r2 = z8_read_code(z8, z8->pc++);
-	}
+	z8->ei_state = 0;
+}
 
-	switch(z8->opl) {
-	case 2:		/* r r */
-		z8->dreg = makereg(z8, r >> 4);
-		z8->arg0 = getwreg(z8, r >> 4);
-		z8->arg1 = getwreg(z8, r & 0x0F);
-		break;
-	case 3:		/* r Ir */
-		z8->dreg = makereg(z8, r >> 4);
-		z8->arg0 = getwreg(z8, r >> 4);
-		z8->arg1 = getwreg(z8, r & 0x0F);
-		break;
-	case 4:		/* R R */
-		z8->dreg = r2;
-		z8->arg0 = getreg(z8, r2);
-		z8->arg1 = getreg(z8, r);
-		break;
-	case 5:		/* R IR */
-		z8->dreg = r2;
-		z8->arg0 = getreg(z8, r2);
-		z8->arg1 = getireg(z8, r);
-		break;
-	case 6:		/* R IM */
-		z8->dreg = r;
-		z8->arg0 = getreg(z8, r);
-		z8->arg1 = r2;
-		break;
-	case 7:		/* IR IM */
-		z8->dreg = r;
-		z8->arg0 = getreg(z8, r);
-		z8->arg1 = getireg(z8, r2);
-		break;
-	}
+static void z8_op_ei(struct z8 *z8, uint8_t opcode)
+{
+	z8->reg[R_IMR] |= 0x80;
+	z8->cycles += 6;
+	z8->done_ei = 1;
+	z8->ei_state = 1;
+}
+
+static void z8_op_ret(struct z8 *z8, uint8_t opcode)
+{
+	z8->pc = z8_pop16(z8);
+	z8->cycles += 14;
+}
+
+static void z8_op_iret(struct z8 *z8, uint8_t opcode)
+{
+	z8->reg[R_FLAGS] = z8_pop8(z8);
+	z8->pc = z8_pop16(z8);
+	z8->reg[R_IMR] |= 0x80;
+	z8->ei_state = 1;
+	z8->cycles += 16;
+}
+
+static void z8_op_rcf(struct z8 *z8, uint8_t opcode)
+{
+	z8->reg[R_FLAGS] &= ~F_C;
+	z8->cycles += 6;
+}
+
+static void z8_op_scf(struct z8 *z8, uint8_t opcode)
+{
+	z8->reg[R_FLAGS] |= F_C;
+	z8->cycles += 6;
+}
+
+static void z8_op_ccf(struct z8 *z8, uint8_t opcode)
+{
+	z8->reg[R_FLAGS] ^= F_C;
+	z8->cycles += 6;
+}
+
+static void z8_op_nop(struct z8 *z8, uint8_t opcode)
+{
+	z8->cycles += 6;
 }
 
-/* Just like rdecode but we never reference the source - which on a Z8
-   may have side effects */
-static void rdecode0l(struct z8 *z8)
+/*
+ *	x0/x1 : single register operand, direct (R) or indirect (IR). The
+ *	operation is written once on the resolved register and the table
+ *	holds a wrapper for each addressing form.
+ */
+static void z8_dec(struct z8 *z8, uint8_t r)
+{
+	uint8_t v = getreg(z8, r) - 1;
+	setreg(z8, r, v);
+	z8->reg[R_FLAGS] &= ~(F_S | F_Z | F_V);
+	if (v == 0)
+		z8->reg[R_FLAGS] |= F_Z;
+	if (v & 0x80)
+		z8->reg[R_FLAGS] |= F_S;
+	if (v == 0x7F)
+		z8->reg[R_FLAGS] |= F_V;
+	z8->cycles += 6;
+}
+
+static void z8_rlc(struct z8 *z8, uint8_t r)
+{
+	uint8_t v = getreg(z8, r);
+	uint8_t w = v << 1;
+	w |= CARRY ? 0x01 : 0x00;
+	if (v & 0x80)
+		z8->reg[R_FLAGS] |= F_C;
+	else
+		z8->reg[R_FLAGS] &= ~F_C;
+	setreg(z8, r, w);
+	z8_logic(z8, w);
+	z8->cycles += 6;
+}
+
+static void z8_inc(struct z8 *z8, uint8_t r)
+{
+	uint8_t v = getreg(z8, r) + 1;
+	setreg(z8, r, v);
+	z8->reg[R_FLAGS] &= ~(F_S | F_Z | F_V);
+	if (v == 0)
+		z8->reg[R_FLAGS] |= F_Z;
+	if (v & 0x80)
+		z8->reg[R_FLAGS] |= F_S;
+	if (v == 0x80)
+		z8->reg[R_FLAGS] |= F_V;
+	z8->cycles += 6;
+}
+
+static void z8_da(struct z8 *z8, uint8_t r)
+{
+	/* TODO */
+	z8->cycles += 8;
+}
+
+static void z8_pop(struct z8 *z8, uint8_t r)
+{
+	setreg(z8, r, z8_pop8(z8));
+	z8->cycles += 10;
+}
+
+static void z8_com(struct z8 *z8, uint8_t r)
+{
+	setreg(z8, r, z8_logic(z8, ~getreg(z8, r)));
+	z8->cycles += 6;
+}
+
+static void z8_push(struct z8 *z8, uint8_t r)
+{
+	z8_push8(z8, getreg(z8, r));
+	z8->cycles += 10;
+	/* FIXME: double check push/pop timing */
+	if (!(z8->reg[R_P01M] & 0x04))
+		z8->cycles += 2;
+}
+
+static void z8_decw(struct z8 *z8, uint8_t r)
+{
+	z8_idop16(z8, r & 0xFE, -1);
+	z8->cycles += 10;
+}
+
+static void z8_rl(struct z8 *z8, uint8_t r)
+{
+	uint8_t v = getreg(z8, r);
+	uint8_t w = v << 1;
+	w |= (v & 0x80) ? 0x01 : 0x00;
+	if (v & 0x80)
+		z8->reg[R_FLAGS] |= F_C;
+	else
+		z8->reg[R_FLAGS] &= ~F_C;
+	setreg(z8, r, w);
+	z8_logic(z8, w);
+	z8->cycles += 6;
+}
+
+static void z8_incw(struct z8 *z8, uint8_t r)
+{
+	z8_idop16(z8, r & 0xFE, 1);
+	z8->cycles += 10;
+}
+
+static void z8_clr(struct z8 *z8, uint8_t r)
+{
+	setreg(z8, r, 0);
+	z8->cycles += 6;
+}
+
+static void z8_rrc(struct z8 *z8, uint8_t r)
+{
+	uint8_t v = getreg(z8, r);
+	uint8_t w = v >> 1;
+	/* Go via carry (9bit rotate in effect) */
+	w |= CARRY ? 0x80 : 0x00;
+	if (v & 0x01)
+		z8->reg[R_FLAGS] |= F_C;
+	else
+		z8->reg[R_FLAGS] &= ~F_C;
+	setreg(z8, r, w);
+	z8_logic(z8, w);
+	z8->cycles += 6;
+}
+
+static void z8_sra(struct z8 *z8, uint8_t r)
+{
+	uint8_t v = getreg(z8, r);
+	uint8_t w = v >> 1;
+	w |= (v & 0x80);
+	if (v & 0x01)
+		z8->reg[R_FLAGS] |= F_C;
+	else
+		z8->reg[R_FLAGS] &= ~F_C;
+	setreg(z8, r, w);
+	z8_logic(z8, w);
+	z8->cycles += 6;
+}
+
+static void z8_rr(struct z8 *z8, uint8_t r)
+{
+	uint8_t v = getreg(z8, r);
+	uint8_t w = v >> 1;
+	/* RR is SRA except bit 0 goes into bit 7 instead of bit 7
+	   being constant */
+	w |= (v & 0x01) ? 0x80 : 0x00;
+	if (v & 0x01)
+		z8->reg[R_FLAGS] |= F_C;
+	else
+		z8->reg[R_FLAGS] &= ~F_C;
+	setreg(z8, r, w);
+	z8_logic(z8, w);
+	z8->cycles += 6;
+}
+
+static void z8_swap(struct z8 *z8, uint8_t r)
+{
+	uint8_t v = getreg(z8, r);
+	v = (v >> 4) | (v << 4);
+	setreg(z8, r, v);
+	/* C and V are 'undefined'. As we don't know the algorithm the
+	   CPU uses just do whatever */
+	z8_logic(z8, v);
+	z8->cycles += 8;
+}
+
+#define Z8_UNARY(op) \
+static void z8_op_##op##_R(struct z8 *z8, uint8_t opcode) \
+{ \
+	z8_##op(z8, z8_read_code(z8, z8->pc++)); \
+} \
+static void z8_op_##op##_IR(struct z8 *z8, uint8_t opcode) \
+{ \
+	z8_##op(z8, getreg(z8, z8_read_code(z8, z8->pc++))); \
+}
+
+Z8_UNARY(dec)
+Z8_UNARY(rlc)
+Z8_UNARY(inc)
+Z8_UNARY(da)
+Z8_UNARY(pop)
+Z8_UNARY(com)
+Z8_UNARY(decw)
+Z8_UNARY(rl)
+Z8_UNARY(incw)
+Z8_UNARY(clr)
+Z8_UNARY(rrc)
+Z8_UNARY(sra)
+Z8_UNARY(rr)
+Z8_UNARY(swap)
+
+static void z8_op_push_R(struct z8 *z8, uint8_t opcode)
+{
+	z8_push(z8, z8_read_code(z8, z8->pc++));
+}
+
+static void z8_op_push_IR(struct z8 *z8, uint8_t opcode)
+{
+	z8_push(z8, getreg(z8, z8_read_code(z8, z8->pc++)));
+	z8->cycles += 2;
+}
+
+/* JP @RR and SRP #IM share the x0/x1 slots of row 3 */
+static void z8_op_jp_irr(struct z8 *z8, uint8_t opcode)
+{
+	z8->pc = getIRR(z8, z8_read_code(z8, z8->pc++));
+	z8->cycles += 8;
+}
+
+static void z8_op_srp(struct z8 *z8, uint8_t opcode)
+{
+	setreg(z8, R_RP, z8_read_code(z8, z8->pc++));
+	z8->cycles += 6;
+}
+
+/*
+ *	x2-x7 : two operand arithmetic and logic. There is one operand
+ *	decoder per addressing mode which loads dreg/arg0/arg1. The 'l'
+ *	forms are for LD and never reference the destination as on a Z8
+ *	that may have side effects.
+ *
+ *	6 cycles for 2 byte forms, 10 for 3
+ */
+static void z8_dec_rr(struct z8 *z8)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	z8->cycles += 6;
+	z8->dreg = makereg(z8, r >> 4);
+	z8->arg0 = getwreg(z8, r >> 4);
+	z8->arg1 = getwreg(z8, r & 0x0F);
+}
+
+/* r Ir currently decodes as r r */
+#define z8_dec_rIr	z8_dec_rr
+
+static void z8_dec_RR(struct z8 *z8)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	uint8_t r2 = z8_read_code(z8, z8->pc++);
+	z8->cycles += 10;
+	z8->dreg = r2;
+	z8->arg0 = getreg(z8, r2);
+	z8->arg1 = getreg(z8, r);
+}
+
+static void z8_dec_RIR(struct z8 *z8)
 {
 	uint8_t r = z8_read_code(z8, z8->pc++);
-	uint8_t r2;
-	/* 6 cycles for 2 byte, 10 for 3 */
+	uint8_t r2 = z8_read_code(z8, z8->pc++);
+	z8->cycles += 10;
+	z8->dreg = r2;
+	z8->arg0 = getreg(z8, r2);
+	z8->arg1 = getireg(z8, r);
+}
 
+static void z8_dec_RIM(struct z8 *z8)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	uint8_t r2 = z8_read_code(z8, z8->pc++);
+	z8->cycles += 10;
+	z8->dreg = r;
+	z8->arg0 = getreg(z8, r);
+	z8->arg1 = r2;
+}
+
+static void z8_dec_IRIM(struct z8 *z8)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	uint8_t r2 = z8_read_code(z8, z8->pc++);
+	z8->cycles += 10;
+	z8->dreg = r;
+	z8->arg0 = getreg(z8, r);
+	z8->arg1 = getireg(z8, r2);
+}
+
+static void z8_decl_rr(struct z8 *z8)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
 	z8->cycles += 6;
-	if (z8->opl & 0x04) {
-		z8->cycles += 4;
-		r2 = z8_read_code(z8, z8->pc++);
-	}
+	z8->dreg = makereg(z8, r >> 4);
+	z8->arg1 = getwreg(z8, r & 0x0F);
+}
 
-	switch(z8->opl) {
-	case 2:		/* r r */
-		z8->dreg = makereg(z8, r >> 4);
-		z8->arg1 = getwreg(z8, r & 0x0F);
-		break;
-	case 3:		/* r Ir */
-		z8->dreg = makereg(z8, r >> 4);
-		z8->arg1 = getwreg(z8, r & 0x0F);
-		break;
-	case 4:		/* R R */
-		z8->dreg = r2;
-		z8->arg1 = getreg(z8, r);
-		break;
-	case 5:		/* R IR */
-		z8->dreg = r2;
-		z8->arg1 = getireg(z8, r);
-		break;
-	case 6:		/* R IM */
-		z8->dreg = r;
-		z8->arg1 = r2;
-		break;
-	case 7:		/* IR IM */
-		z8->dreg = r;
-		z8->arg1 = getireg(z8, r2);
-		break;
+#define z8_decl_rIr	z8_decl_rr
+
+static void z8_decl_RR(struct z8 *z8)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	uint8_t r2 = z8_read_code(z8, z8->pc++);
+	z8->cycles += 10;
+	z8->dreg = r2;
+	z8->arg1 = getreg(z8, r);
+}
+
+static void z8_decl_RIR(struct z8 *z8)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	uint8_t r2 = z8_read_code(z8, z8->pc++);
+	z8->cycles += 10;
+	z8->dreg = r2;
+	z8->arg1 = getireg(z8, r);
+}
+
+static void z8_decl_RIM(struct z8 *z8)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	uint8_t r2 = z8_read_code(z8, z8->pc++);
+	z8->cycles += 10;
+	z8->dreg = r;
+	z8->arg1 = r2;
+}
+
+static void z8_decl_IRIM(struct z8 *z8)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	uint8_t r2 = z8_read_code(z8, z8->pc++);
+	z8->cycles += 10;
+	z8->dreg = r;
+	z8->arg1 = getireg(z8, r2);
+}
+
+static void z8_add(struct z8 *z8)
+{
+	setreg(z8, z8->dreg, z8_maths(z8, z8->arg0 + z8->arg1, 0));
+}
+
+static void z8_adc(struct z8 *z8)
+{
+	setreg(z8, z8->dreg, z8_maths(z8, z8->arg0 + z8->arg1 + CARRY, 0));
+}
+
+static void z8_sub(struct z8 *z8)
+{
+	setreg(z8, z8->dreg, z8_maths_sub(z8, z8->arg0 - z8->arg1, 1));
+}
+
+static void z8_sbc(struct z8 *z8)
+{
+	setreg(z8, z8->dreg, z8_maths_sub(z8, z8->arg0 - z8->arg1 - CARRY, 1));
+}
+
+static void z8_or(struct z8 *z8)
+{
+	setreg(z8, z8->dreg, z8_logic(z8, z8->arg0 | z8->arg1));
+}
+
+static void z8_and(struct z8 *z8)
+{
+	setreg(z8, z8->dreg, z8_logic(z8, z8->arg0 & z8->arg1));
+}
+
+static void z8_tcm(struct z8 *z8)
+{
+	z8_logic(z8, ~z8->arg0 & z8->arg1);
+}
+
+static void z8_tm(struct z8 *z8)
+{
+	z8_logic(z8, z8->arg0 & z8->arg1);
+}
+
+static void z8_cp(struct z8 *z8)
+{
+	z8_maths_noh(z8, z8->arg0 - z8->arg1);
+}
+
+static void z8_xor(struct z8 *z8)
+{
+	setreg(z8, z8->dreg, z8_logic(z8, z8->arg0 ^ z8->arg1));
+}
+
+static void z8_ld(struct z8 *z8)
+{
+	setreg(z8, z8->dreg, z8->arg1);
+}
+
+#define Z8_ALU_MODE(op, dec, mode) \
+static void z8_op_##op##_##mode(struct z8 *z8, uint8_t opcode) \
+{ \
+	dec##_##mode(z8); \
+	z8_##op(z8); \
+}
+
+#define Z8_ALU(op, dec) \
+	Z8_ALU_MODE(op, dec, rr) \
+	Z8_ALU_MODE(op, dec, rIr) \
+	Z8_ALU_MODE(op, dec, RR) \
+	Z8_ALU_MODE(op, dec, RIR) \
+	Z8_ALU_MODE(op, dec, RIM) \
+	Z8_ALU_MODE(op, dec, IRIM)
+
+Z8_ALU(add, z8_dec)
+Z8_ALU(adc, z8_dec)
+Z8_ALU(sub, z8_dec)
+Z8_ALU(sbc, z8_dec)
+Z8_ALU(or, z8_dec)
+Z8_ALU(and, z8_dec)
+Z8_ALU(tcm, z8_dec)
+Z8_ALU(tm, z8_dec)
+Z8_ALU(cp, z8_dec)
+Z8_ALU(xor, z8_dec)
+Z8_ALU(ld, z8_decl)
+
+/*
+ *	The oddities in the x2-x7 columns
+ */
+static void z8_op_lde_r_irr(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	setwreg(z8, r >> 4, z8_read_data(z8, getrr(z8, r & 0xF)));
+	z8->cycles += 12;
+}
+
+static void z8_op_ldei_ir_irr(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	setreg(z8, getiwreg(z8, r >> 4),
+		z8_read_data(z8, getrr(z8, r & 0x0F)));
+	setiwreg(z8, r >> 4, getiwreg(z8, r >> 4) + 1);
+	z8_inc16(z8, getwreg(z8, r & 0x0F));
+	z8->cycles += 18;
+}
+
+static void z8_op_lde_irr_r(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	z8_write_data(z8, getrr(z8, r & 0x0F), getwreg(z8, r >> 4));
+	z8->cycles += 12;
+}
+
+static void z8_op_ldei_irr_ir(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	z8_write_data(z8, getrr(z8, r & 0x0F), getiwreg(z8, r >> 4));
+	setiwreg(z8, r >> 4, getiwreg(z8, r >> 4) + 1);
+	z8_inc16(z8, makereg(z8, r & 0x0F));
+	z8->cycles += 18;
+}
+
+static void z8_op_ldc_r_irr(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	setwreg(z8, r >> 4, z8_read_code(z8, getrr(z8, r & 0xF)));
+	z8->cycles += 12;
+}
+
+static void z8_op_ldc_irr_r(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	z8_write_code(z8, getrr(z8, r & 0x0F), getwreg(z8, r >> 4));
+}
+
+static void z8_op_ld_r_x(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	uint8_t x = getwreg(z8, r & 0x0F);
+	setwreg(z8, r >> 4, getreg(z8, x + z8_read_code(z8, z8->pc++)));
+	z8->cycles += 10;
+}
+
+static void z8_op_ld_x_r(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	uint8_t x = getwreg(z8, r & 0x0F);
+	x += z8_read_code(z8, z8->pc++);
+	setreg(z8, x, getwreg(z8, r >> 4));
+	z8->cycles += 10;
+}
+
+static void z8_op_call_irr(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	z8_push16(z8, z8->pc);
+	z8->pc = getIRR(z8, r);
+	z8->cycles += 20;
+}
+
+static void z8_op_call_da(struct z8 *z8, uint8_t opcode)
+{
+	uint16_t da = z8_read_code(z8, z8->pc++) << 8;
+	da |= z8_read_code(z8, z8->pc++);
+	z8_push16(z8, z8->pc);
+	z8->pc = da;
+	z8->cycles += 20;
+}
+
+static void z8_op_ld_ir_r(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	setiwreg(z8, r >> 4, getwreg(z8, r & 0x0F));
+	z8->cycles += 10;
+}
+
+static void z8_op_ld_R_IR(struct z8 *z8, uint8_t opcode)
+{
+	uint8_t r = z8_read_code(z8, z8->pc++);
+	setireg(z8, z8_read_code(z8, z8->pc++), getreg(z8, r));
+	z8->cycles += 10;
+}
+
+static void z8_optab_alu(unsigned row, z8_handler rr, z8_handler rIr,
+	z8_handler RR, z8_handler RIR, z8_handler RIM, z8_handler IRIM)
+{
+	row <<= 4;
+	z8_optab[row | 2] = rr;
+	z8_optab[row | 3] = rIr;
+	z8_optab[row | 4] = RR;
+	z8_optab[row | 5] = RIR;
+	z8_optab[row | 6] = RIM;
+	z8_optab[row | 7] = IRIM;
+}
+
+#define Z8_OPTAB_ALU(row, op) \
+	z8_optab_alu(row, z8_op_##op##_rr, z8_op_##op##_rIr, z8_op_##op##_RR, \
+		z8_op_##op##_RIR, z8_op_##op##_RIM, z8_op_##op##_IRIM)
+
+#define Z8_OPTAB_UNARY(row, op) \
+	do { \
+		z8_optab[(row) << 4] = z8_op_##op##_R; \
+		z8_optab[((row) << 4) | 1] = z8_op_##op##_IR; \
+	} while(0)
+
+static void z8_build_optab(void)
+{
+	unsigned i;
+
+	for (i = 0; i < 256; i++)
+		z8_optab[i] = z8_op_none;
+
+	for (i = 0; i < 16; i++) {
+		z8_optab[(i << 4) | 0x08] = z8_op_ld_r_R;
+		z8_optab[(i << 4) | 0x09] = z8_op_ld_R_r;
+		z8_optab[(i << 4) | 0x0A] = z8_op_djnz;
+		z8_optab[(i << 4) | 0x0B] = z8_op_jr;
+		z8_optab[(i << 4) | 0x0C] = z8_op_ld_r_im;
+		z8_optab[(i << 4) | 0x0D] = z8_op_jp_cc;
+		z8_optab[(i << 4) | 0x0E] = z8_op_inc_r;
 	}
+	/* x0/x1 */
+	Z8_OPTAB_UNARY(0x0, dec);
+	Z8_OPTAB_UNARY(0x1, rlc);
+	Z8_OPTAB_UNARY(0x2, inc);
+	z8_optab[0x30] = z8_op_jp_irr;
+	z8_optab[0x31] = z8_op_srp;
+	Z8_OPTAB_UNARY(0x4, da);
+	Z8_OPTAB_UNARY(0x5, pop);
+	Z8_OPTAB_UNARY(0x6, com);
+	Z8_OPTAB_UNARY(0x7, push);
+	Z8_OPTAB_UNARY(0x8, decw);
+	Z8_OPTAB_UNARY(0x9, rl);
+	Z8_OPTAB_UNARY(0xA, incw);
+	Z8_OPTAB_UNARY(0xB, clr);
+	Z8_OPTAB_UNARY(0xC, rrc);
+	Z8_OPTAB_UNARY(0xD, sra);
+	Z8_OPTAB_UNARY(0xE, rr);
+	Z8_OPTAB_UNARY(0xF, swap);
+	/* x2-x7 */
+	Z8_OPTAB_ALU(0x0, add);
+	Z8_OPTAB_ALU(0x1, adc);
+	Z8_OPTAB_ALU(0x2, sub);
+	Z8_OPTAB_ALU(0x3, sbc);
+	Z8_OPTAB_ALU(0x4, or);
+	Z8_OPTAB_ALU(0x5, and);
+	Z8_OPTAB_ALU(0x6, tcm);
+	Z8_OPTAB_ALU(0x7, tm);
+	Z8_OPTAB_ALU(0xA, cp);
+	Z8_OPTAB_ALU(0xB, xor);
+	Z8_OPTAB_ALU(0xE, ld);
+	z8_optab[0x82] = z8_op_lde_r_irr;
+	z8_optab[0x83] = z8_op_ldei_ir_irr;
+	z8_optab[0x92] = z8_op_lde_irr_r;
+	z8_optab[0x93] = z8_op_ldei_irr_ir;
+	z8_optab[0xC2] = z8_op_ldc_r_irr;
+	z8_optab[0xC3] = z8_op_ldei_ir_irr;	/* LDCI, decoded as LDEI */
+	z8_optab[0xC7] = z8_op_ld_r_x;
+	z8_optab[0xD2] = z8_op_ldc_irr_r;
+	z8_optab[0xD3] = z8_op_ldei_irr_ir;	/* Ditto */
+	z8_optab[0xD4] = z8_op_call_irr;
+	z8_optab[0xD6] = z8_op_call_da;
+	z8_optab[0xD7] = z8_op_ld_x_r;
+	z8_optab[0xF3] = z8_op_ld_ir_r;
+	z8_optab[0xF5] = z8_op_ld_R_IR;
+	/* xF */
+	z8_optab[0x8F] = z8_op_di;
+	z8_optab[0x9F] = z8_op_ei;
+	z8_optab[0xAF] = z8_op_ret;
+	z8_optab[0xBF] = z8_op_iret;
+	z8_optab[0xCF] = z8_op_rcf;
+	z8_optab[0xDF] = z8_op_scf;
+	z8_optab[0xEF] = z8_op_ccf;
+	z8_optab[0xFF] = z8_op_nop;
 }
 
 static void z8_execute_one(struct z8 *z8)
 {
 	uint8_t opcode = z8_read_code(z8, z8->pc++);
-	uint_fast8_t oph = opcode >> 4;
-	uint8_t r;
-	uint16_t da;
-
-	z8->opl = opcode & 0x0F;
-
-	if (z8->opl & 0x08)
-		z8_execute_group2(z8, oph, z8->opl);
-	else if (z8->opl < 0x02)
-		z8_execute_group3(z8, oph, z8->opl);
-	else {
-		switch (oph) {
-		case 0x00:	/* ADD group */
-			rdecode0(z8);
-			setreg(z8, z8->dreg,
-			       z8_maths(z8, z8->arg0 + z8->arg1, 0));
-			break;
-		case 0x01:	/* ADC group */
-			rdecode0(z8);
-			setreg(z8, z8->dreg,
-			       z8_maths(z8, z8->arg0 + z8->arg1 + CARRY,
-					0));
-			break;
-		case 0x02:	/* SUB group */
-			rdecode0(z8);
-			setreg(z8, z8->dreg,
-			       z8_maths_sub(z8, z8->arg0 - z8->arg1, 1));
-			break;
-		case 0x03:	/* SBC group */
-			rdecode0(z8);
-			setreg(z8, z8->dreg,
-			       z8_maths_sub(z8, z8->arg0 - z8->arg1 - CARRY,
-					1));
-			break;
-		case 0x04:	/* OR group */
-			rdecode0(z8);
-			setreg(z8, z8->dreg,
-			       z8_logic(z8, z8->arg0 | z8->arg1));
-			break;
-		case 0x05:	/* AND group */
-			rdecode0(z8);
-			setreg(z8, z8->dreg,
-			       z8_logic(z8, z8->arg0 & z8->arg1));
-			break;
-		case 0x06:	/* TCM group */
-			rdecode0(z8);
-			z8_logic(z8, ~z8->arg0 & z8->arg1);
-			break;
-		case 0x07:	/* TM group */
-			rdecode0(z8);
-			z8_logic(z8, z8->arg0 & z8->arg1);
-			break;
-		case 0x0A:	/* CP group */
-			rdecode0(z8);
-			z8_maths_noh(z8, z8->arg0 - z8->arg1);
-			break;
-		case 0x0B:	/* XOR group */
-			rdecode0(z8);
-			setreg(z8, z8->dreg,
-			       z8_logic(z8, z8->arg0 ^ z8->arg1));
-			break;
-		case 0x0E:	/* LD group */
-			rdecode0l(z8);
-			setreg(z8, z8->dreg, z8->arg1);
-			break;
-			/*
-			 * The oddities
-			 */
-		case 0x08:
-		case 0x09:
-		case 0x0C:
-		case 0x0D:
-		case 0x0F:
-			switch (opcode) {
-			case 0x82:	/* LDE r,Irr */
-				r = z8_read_code(z8, z8->pc++);
-				setwreg(z8, r >> 4,
-				    z8_read_data(z8, getrr(z8, r & 0xF)));
-				z8->cycles += 12;
-				break;
-			case 0x83:	/* LDEI Ir,Irr*/
-				r = z8_read_code(z8, z8->pc++);
-				setreg(z8, getiwreg(z8, r >> 4),
-					z8_read_data(z8, getrr(z8, r & 0x0F)));
-				setiwreg(z8, r >> 4, getiwreg(z8, r >> 4) + 1);
-				z8_inc16(z8, getwreg(z8, r & 0x0F));
-				z8->cycles += 18;
-				break;
-			case 0x92:	/* LDE Irr,r */
-				r = z8_read_code(z8, z8->pc++);
-				z8_write_data(z8, getrr(z8, r & 0x0F),
-					      getwreg(z8, r >> 4));
-				z8->cycles += 12;
-				break;
-			case 0x93:	/* LDEI Irr,Ir*/
-				r = z8_read_code(z8, z8->pc++);
-				z8_write_data(z8, getrr(z8, r & 0x0F), 
-					getiwreg(z8, r >> 4));
-				setiwreg(z8, r >> 4, getiwreg(z8, r >> 4) + 1);
-				z8_inc16(z8, makereg(z8, r & 0x0F));
-				z8->cycles += 18;
-				break;
-			case 0xC2:	/* LDC r,Irr*/
-				r = z8_read_code(z8, z8->pc++);
-				setwreg(z8, r >> 4, 
-					z8_read_code(z8, getrr(z8, r & 0xF)));
-				z8->cycles += 12;
-				break;
-			case 0xC3:	/* LDCI */
-				r = z8_read_code(z8, z8->pc++);
-				setreg(z8, getiwreg(z8, r >> 4),
-					z8_read_data(z8, getrr(z8, r & 0x0F)));
-				setiwreg(z8, r >> 4, getiwreg(z8, r >> 4) + 1);
-				z8_inc16(z8, getwreg(z8, r & 0x0F));
-				z8->cycles += 18;
-				break;
-			case 0xC7:	/* LD r1,x.R2 */
-				r = z8_read_code(z8, z8->pc++);
-				setwreg(z8, r >> 4, getreg(z8,
-						   getwreg(z8,
-							   r & 0x0F) +
-						   z8_read_code(z8,
-								z8->pc++)));
-				z8->cycles += 10;
-				break;
-			case 0xD2:	/* LDC Irr,r */
-				r = z8_read_code(z8, z8->pc++);
-				z8_write_code(z8, getrr(z8, r & 0x0F),
-					      getwreg(z8, r >> 4));
-				break;
-			case 0xD3:	/* LDCI */
-				r = z8_read_code(z8, z8->pc++);
-				z8_write_data(z8, getrr(z8, r & 0x0F), 
-					getiwreg(z8, r >> 4));
-				setiwreg(z8, r >> 4, getiwreg(z8, r >> 4) + 1);
-				z8_inc16(z8, makereg(z8, r & 0x0F));
-				z8->cycles += 18;
-				break;
-			case 0xD4:	/* CALL IRR1 */
-				r = z8_read_code(z8, z8->pc++);
-				z8_push16(z8, z8->pc);
-				z8->pc = getIRR(z8, r);
-				z8->cycles += 20;
-				break;
-			case 0xD6:	/* CALL da */
-				da = z8_read_code(z8, z8->pc++) << 8;
-				da |= z8_read_code(z8, z8->pc++);
-				z8_push16(z8, z8->pc);
-				z8->pc = da;
-				z8->cycles += 20;
-				break;
-			case 0xD7:	/* LD r2.x,R1 */
-				r = z8_read_code(z8, z8->pc++);
-				setreg(z8, (getwreg(z8, r & 0x0F) +
-					 z8_read_code(z8, z8->pc++)),
-					getwreg(z8, r >> 4));
-				z8->cycles += 10;
-				break;
-			case 0xE3:	/* LD r1,Ir2 */
-				r = z8_read_code(z8, z8->pc++);
-				setireg(z8, r >> 4, getiwreg(z8, r & 0x0f));
-				z8->cycles += 6;
-				break;
-			case 0xF3:	/* LD Ir1,r2 */
-				r = z8_read_code(z8, z8->pc++);
-				setiwreg(z8, r >> 4, getwreg(z8, r & 0x0F));
-				z8->cycles += 10;
-				break;
-			case 0xF5:	/* LD R2,IR1 */
-				r = z8_read_code(z8, z8->pc++);
-				setireg(z8, z8_read_code(z8, z8->pc++),
-					getreg(z8, r));
-				z8->cycles += 10;
-				break;
-			}
-		}
-	}
+	z8_optab[opcode](z8, opcode);
 }
 
 /*
@@ -1362,6 +1551,8 @@ static uint16_t z8_irqpri(struct z8 *z8)
 /* Run an instruction */
 void z8_execute(struct z8 *z8)
 {
+	unsigned long start = z8->cycles;
+
 	/* EI state is visible in IMR top bit but it is just a copy
 	   and if changed directly is meaningless */
 	if (z8->ei_state) {
@@ -1384,7 +1575,19 @@ void z8_execute(struct z8 *z8)
 		fprintf(stderr, "%s : %s\n", fbuf, buf);
 	}
 	z8_execute_one(z8);
-	z8_clocks(z8, z8->cycles);
+	z8_clocks(z8, z8->cycles - start);
+}
+
+/* Run for a budget of clocks, carrying any overrun into the next call.
+   Returns the clocks actually run */
+unsigned long z8_run(struct z8 *z8, unsigned long cycles)
+{
+	unsigned long start = z8->cycles;
+
+	z8->cycle_goal += cycles;
+	while (z8->cycles < z8->cycle_goal)
+		z8_execute(z8);
+	return z8->cycles - start;
 }
 
 void z8_reset(struct z8 *z8)
@@ -1403,6 +1606,8 @@ struct z8 *z8_create(void)
 		exit(1);
 	}
 	memset(z8, 0, sizeof(*z8));
+	if (z8_optab[0] == NULL)
+		z8_build_optab();
 	z8->regmax = 240;
 	z8_reset(z8);
 	/* Serial starts idle so tx int */
@@ -5,12 +5,13 @@ struct z8
     uint16_t pc;
     uint8_t regmax;	/* Highest non special register present */
     /* Internal emulation state */
-    uint8_t arg0, arg1, dreg; uint8_t opl;
+    uint8_t arg0, arg1, dreg;
     /* Counter states */
     uint8_t psc0, psc1;	/* Prescalers */
     uint8_t t0, t1;	/* Timers */
     /* Instruction timing */
     unsigned long cycles;
+    unsigned long cycle_goal;	/* For z8_run */
     int done_ei;	/* Has done an EI (weirdness with IRR register) */
     int ei_state;	/* Interrupt control */
     int trace;
@@ -52,6 +53,7 @@ extern void z8_set_irq(struct z8 *z8, int irq);
 extern void z8_clear_irq(struct z8 *z8, int irq);
 extern void z8_reset(struct z8 *z8);
 extern void z8_execute(struct z8 *z8);
+extern unsigned long z8_run(struct z8 *z8, unsigned long cycles);
 extern void z8_raise_irq(struct z8 *z8, int irq);
 extern void z8_clear_irq(struct z8 *z8, int irq);
 extern void z8_rx_char(struct z8 *z8, uint8_t ch);
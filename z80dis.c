@@ -12,9 +12,9 @@
 
 #include "z80dis.h" 
  
-static uint8_t prefix;
-static const char *hlname;
-static uint16_t pc;
+static _Thread_local uint8_t prefix;
+static _Thread_local const char *hlname;
+static _Thread_local uint16_t pc;
 
 /*
  *	Glue to caller. Caller provides a single helper that returns
@@ -21,6 +21,8 @@ struct z80dma {
 	uint8_t enabled;
 	uint8_t trace;
 	uint8_t idle;
+	/* Host pointer for a guest address or NULL if it must go via mem_* */
+	uint8_t *(*map)(int unused, uint16_t addr, int wr);
 };
 
 #define	RR0		0
@@ -74,6 +76,11 @@ struct z80dma {
 #define R_ADDR_B_L	(1 << WR_B_L)
 #define R_RRMASK	(1 << WR_RRMASK)
 
+/* RR0 status bits. Match and end of block are active low */
+#define ST_DMA		0x01
+#define ST_NOMATCH	0x10
+#define ST_NOTEOB	0x20
+
 static uint8_t z80dma_rr(struct z80dma *dma)
 {
 	while(!(dma->rregmask & (1 << dma->rrcount)))
@@ -99,7 +106,10 @@ static void z80dma_wr(struct z80dma *dma, uint8_t val)
 
 void z80dma_reset(struct z80dma *dma)
 {
+	uint8_t *(*map)(int, uint16_t, int) = dma->map;
 	memset(dma, 0, sizeof(struct z80dma));
+	dma->map = map;
+	dma->reg[RR0] = ST_NOMATCH | ST_NOTEOB;
 	/* TODO */
 }
 
@@ -117,7 +127,7 @@ static void z80dma_command(struct z80dma *dma)
 		dma->reg[WR_TIMING_B] = 2;
 		break;
 	case 0xCF:
-		dma->reg[RR0] = 0;
+		dma->reg[RR0] &= ~ST_DMA;
 		dma->reg[RR1] = 0;
 		dma->reg[RR2] = 0;
 		dma->reg[RR3] = dma->reg[WR_A_L];
@@ -144,13 +154,15 @@ static void z80dma_command(struct z80dma *dma)
 		dma->reg[WR3] |= (1 << 5);
 	case 0xB7:
 		dma->enabled = 2;		/* Enable after reti */
+		dma->idle = 0;
 		break;
 	case 0xBF:
 		dma->rregmask = RR0;
 		break;
 	case 0x8B:
-		/* Reinit status: TODO */
+		/* Reinit status */
 		/* DMA must be disabled first */
+		dma->reg[RR0] |= ST_NOMATCH | ST_NOTEOB;
 		break;
 	case 0xBB:
 		dma->wregmask = R_RRMASK;
@@ -165,6 +177,8 @@ static void z80dma_command(struct z80dma *dma)
 	case 0x87:
 		/* Review RETI rule */
 		dma->enabled = 1;
+		/* Don't inherit wait states from the last transfer */
+		dma->idle = 0;
 		break;
 	case 0x83:
 		dma->enabled = 0;
@@ -245,90 +259,230 @@ void z80dma_write(struct z80dma *dma, uint8_t val)
 	}
 }
 
+/* Port A is always the address in RR3/4 */
+static uint16_t z80dma_addr_a(struct z80dma *dma)
+{
+	return dma->reg[RR3] | (dma->reg[RR4] << 8);
+}
+
+static uint16_t z80dma_addr_b(struct z80dma *dma)
+{
+	/* Weird rules about register B */
+	if (dma->reg[WR2] & 0x20)
+		return dma->reg[WR_B_L] | (dma->reg[WR_B_H] << 8);
+	if ((dma->reg[RR1] | dma->reg[RR2]) == 0) {
+		dma->reg[RR5] = dma->reg[WR_B_L];
+		dma->reg[RR6] = dma->reg[WR_B_H];
+	}
+	return dma->reg[RR5] | (dma->reg[RR6] << 8);
+}
+
+/* Address step for a port given WR1 or WR2: fixed, increment or decrement */
+static int z80dma_step(uint8_t wr)
+{
+	if (wr & 0x20)
+		return 0;
+	return (wr & 0x10) ? 1 : -1;
+}
+
+static int z80dma_match(struct z80dma *dma, uint8_t byte)
+{
+	/* Mask bits set are don't care */
+	return ((byte ^ dma->reg[WR_MATCH]) & ~dma->reg[WR_MASK]) == 0;
+}
+
+/* Move the addresses and count on by n bytes and check for the end */
+static void z80dma_advance(struct z80dma *dma, unsigned n, int matched)
+{
+	uint16_t count = dma->reg[RR1] | (dma->reg[RR2] << 8);
+	uint16_t addr;
+
+	count += n;
+	dma->reg[RR1] = count;
+	dma->reg[RR2] = count >> 8;
+
+	addr = z80dma_addr_a(dma) + z80dma_step(dma->reg[WR1]) * (int)n;
+	dma->reg[RR3] = addr;
+	dma->reg[RR4] = addr >> 8;
+	if (!(dma->reg[WR2] & 0x20)) {
+		addr = (dma->reg[RR5] | (dma->reg[RR6] << 8)) + z80dma_step(dma->reg[WR2]) * (int)n;
+		dma->reg[RR5] = addr;
+		dma->reg[RR6] = addr >> 8;
+	}
+	if (matched) {
+		dma->reg[RR0] &= ~ST_NOMATCH;
+		/* Stop on match */
+		if (dma->reg[WR3] & 0x04)
+			dma->enabled = 0;
+	}
+	if (dma->reg[RR1] == dma->reg[WR_LEN_L] &&
+	    dma->reg[RR2] == dma->reg[WR_LEN_H]) {
+		/* Completed */
+		dma->enabled = 0;
+		dma->forcerdy = 0;
+		dma->reg[RR0] |= ST_DMA;
+		dma->reg[RR0] &= ~ST_NOTEOB;
+		/* TODO: interrupt emulation */
+	}
+}
+
 static uint8_t z80_dma_one_cycle(struct z80dma *dma)
 {
 	uint16_t addr_a, addr_b;
 	int port_a, port_b;
 	uint8_t byte;
+	unsigned mode = dma->reg[WR0] & 3;
 
 	if (!dma->enabled)
 		return 0;
 	/* Ok what are we doing ? */
-	/* For now just model simple block transfers */
 
-	addr_a = dma->reg[RR3] | (dma->reg[RR4] << 8);
+	addr_a = z80dma_addr_a(dma);
 	port_a = dma->reg[WR1] & 0x08;
-
-	/* Weird rules about register B */
-	if (dma->reg[WR2] & 0x20) 
-		addr_b = dma->reg[WR_B_L] | (dma->reg[WR_B_H] << 8);
-	else {
-		if ((dma->reg[RR1] | dma->reg[RR2]) == 0) {
-			dma->reg[RR5] = dma->reg[WR_B_L];
-			dma->reg[RR6] = dma->reg[WR_B_H];
-		}
-		addr_b = dma->reg[RR5] | (dma->reg[RR6] << 8);
-	}
+	addr_b = z80dma_addr_b(dma);
 	port_b = dma->reg[WR2] & 0x08;
 
-	/* FIXME: add match/mask to this loop */
-
+	/* Mode 2 is search only, 3 search and transfer */
 	if (dma->reg[WR0] & 4) {
 		/* A->B */
 		if (port_a)
 			byte = io_read(0, addr_a);
 		else
 			byte = mem_read(0, addr_a);
-		if (port_b)
-			io_write(0, addr_b, byte);
-		else
-			mem_write(0, addr_b, byte);
+		if (mode != 2) {
+			if (port_b)
+				io_write(0, addr_b, byte);
+			else
+				mem_write(0, addr_b, byte);
+		}
 	} else {
 		if (port_b)
 			byte = io_read(0, addr_b);
 		else
 			byte = mem_read(0, addr_b);
-		if (port_a)
-			io_write(0, addr_a, byte);
-		else
-			mem_write(0, addr_a, byte);
+		if (mode != 2) {
+			if (port_a)
+				io_write(0, addr_a, byte);
+			else
+				mem_write(0, addr_a, byte);
+		}
 	}
+	z80dma_advance(dma, 1, (mode & 2) && z80dma_match(dma, byte));
+	return 2;	/* 2 tstates per simple bus hog */
+}
 
-	/* Adjust addresses and counters */
-	dma->reg[RR1]++;
-	if (dma->reg[RR1] == 0)
-		dma->reg[RR2]++;
-	if (!(dma->reg[WR1] & 0x20)) {
-		if (dma->reg[WR1] & 0x10) {
-			dma->reg[RR3]++;
-			if (dma->reg[RR3] == 0)
-				dma->reg[RR4]++;
-		} else {
-			dma->reg[RR3]--;
-			if (dma->reg[RR3] == 255)
-				dma->reg[RR4]--;
-		}
+/* Bytes left in the 256 byte page of a pointer going in direction step */
+static unsigned z80dma_span(uint16_t addr, int step)
+{
+	if (step > 0)
+		return 256 - (addr & 0xFF);
+	if (step < 0)
+		return (addr & 0xFF) + 1;
+	return 65536;
+}
+
+/*
+ *	Do up to n bytes at once. Memory on either side is accessed through
+ *	the host mapping a page at a time, I/O still goes a byte at a time
+ *	through io_read/io_write. Returns the number of bytes done, which may
+ *	be zero if the memory isn't mapped and the slow path has to do it.
+ */
+static unsigned z80dma_burst(struct z80dma *dma, unsigned n)
+{
+	unsigned mode = dma->reg[WR0] & 3;
+	unsigned xfer = mode != 2;
+	unsigned search = mode & 2;
+	unsigned done = 0, left, len, i;
+	uint8_t swr, dwr;
+	uint16_t src, dst;
+	int sstep, dstep;
+	uint8_t *sp, *dp = NULL, *hit;
+	uint8_t byte;
+	int matched = 0;
+
+	if (dma->reg[WR0] & 4) {
+		swr = dma->reg[WR1];
+		dwr = dma->reg[WR2];
+		src = z80dma_addr_a(dma);
+		dst = z80dma_addr_b(dma);
+	} else {
+		swr = dma->reg[WR2];
+		dwr = dma->reg[WR1];
+		src = z80dma_addr_b(dma);
+		dst = z80dma_addr_a(dma);
 	}
-	if (!(dma->reg[WR2] & 0x20)) {
-		if (dma->reg[WR2] & 0x10) {
-			dma->reg[RR5]++;
-			if (dma->reg[RR5] == 0)
-				dma->reg[RR6]++;
+	sstep = z80dma_step(swr);
+	dstep = z80dma_step(dwr);
+
+	/* Don't run past the end of the block */
+	left = (uint16_t)((dma->reg[WR_LEN_L] | (dma->reg[WR_LEN_H] << 8)) -
+		(dma->reg[RR1] | (dma->reg[RR2] << 8)));
+	if (left == 0)
+		left = 65536;
+	if (n > left)
+		n = left;
+
+	while (done < n && !matched) {
+		len = n - done;
+		sp = NULL;
+		if (!(swr & 0x08)) {
+			sp = dma->map(0, src, 0);
+			if (sp == NULL)
+				break;
+			if (len > z80dma_span(src, sstep))
+				len = z80dma_span(src, sstep);
+		}
+		if (xfer && !(dwr & 0x08)) {
+			dp = dma->map(0, dst, 1);
+			if (dp == NULL)
+				break;
+			if (len > z80dma_span(dst, dstep))
+				len = z80dma_span(dst, dstep);
+		}
+		if (sp && !search && dp && sstep == 1 && dstep == 1 &&
+		    (dp + len <= sp || sp + len <= dp)) {
+			memcpy(dp, sp, len);
+			i = len;
+		} else if (sp && search && !xfer && sstep == 1 && dma->reg[WR_MASK] == 0) {
+			hit = memchr(sp, dma->reg[WR_MATCH], len);
+			i = hit ? hit - sp + 1 : len;
+			matched = hit != NULL;
 		} else {
-			dma->reg[RR5]--;
-			if (dma->reg[RR5] == 255)
-				dma->reg[RR6]--;
+			for (i = 0; i < len && !matched; i++) {
+				if (sp) {
+					byte = *sp;
+					sp += sstep;
+				} else
+					byte = io_read(0, (uint16_t)(src + sstep * (int)i));
+				if (xfer) {
+					if (dp) {
+						*dp = byte;
+						dp += dstep;
+					} else
+						io_write(0, (uint16_t)(dst + dstep * (int)i), byte);
+				}
+				if (search)
+					matched = z80dma_match(dma, byte);
+			}
 		}
+		src += sstep * (int)i;
+		dst += dstep * (int)i;
+		done += i;
+		/* Record the match on the byte that made it */
+		if (matched) {
+			if (i > 1)
+				z80dma_advance(dma, i - 1, 0);
+			z80dma_advance(dma, 1, 1);
+		} else
+			z80dma_advance(dma, i, 0);
+		/* A match without stop on match just carries on */
+		if (dma->enabled == 0)
+			break;
+		matched = 0;
 	}
-	if (dma->reg[RR1] == dma->reg[WR_LEN_L] &&
-	    dma->reg[RR2] == dma->reg[WR_LEN_H]) {
-		/* Completed */
-		dma->enabled = 0;
-		dma->forcerdy = 0;
-		dma->reg[RR0] |= 1;
-		/* TODO: interrupt emulation */
-	}
-	return 2;	/* 2 tstates per simple bus hog */
+	if (dma->trace && done)
+		fprintf(stderr, "z80dma: burst of %u bytes.\n", done);
+	return done;
 }
 
 static uint8_t z80_dma_calc_idle(struct z80dma *dma)
@@ -362,12 +516,29 @@ static uint8_t z80_dma_do_run(struct z80dma *dma)
 int z80_dma_run(struct z80dma *dma, int cycles)
 {
 	int spare = 0;
+	unsigned idle, n;
 
 	if (!dma->enabled)
 		return cycles;
 
-	while(cycles) {
-		int n = z80_dma_do_run(dma);
+	while(cycles > 0) {
+		if (!dma->enabled) {
+			spare += cycles;
+			break;
+		}
+		/* Between bytes we can do whole byte and idle periods in bulk */
+		if (dma->idle == 0 && dma->map) {
+			idle = z80_dma_calc_idle(dma);
+			n = cycles / (2 + idle);
+			if (n)
+				n = z80dma_burst(dma, n);
+			if (n) {
+				cycles -= n * (2 + idle);
+				spare += n * idle;
+				continue;
+			}
+		}
+		n = z80_dma_do_run(dma);
 		if (n == 0) {
 			/* CPU time */
 			spare++;
@@ -386,10 +557,22 @@ struct z80dma *z80dma_create(void)
 		fprintf(stderr, "Out of memory.\n");
 		exit(1);
 	}
+	dma->map = NULL;
 	z80dma_reset(dma);
 	return dma;
 }
 
+int z80dma_busy(struct z80dma *dma)
+{
+	return dma->enabled;
+}
+
+/* Give the DMA direct access to memory that has no side effects */
+void z80dma_map(struct z80dma *dma, uint8_t *(*map)(int unused, uint16_t addr, int wr))
+{
+	dma->map = map;
+}
+
 void z80dma_free(struct z80dma *dma)
 {
 	free(dma);
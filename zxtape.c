@@ -0,0 +1,512 @@
+/*
+ *	ZX Spectrum tape images (.tap and .tzx)
+ *
+ *	The image is loaded into memory and broken into blocks. Standard
+ *	speed blocks can be handed to a ROM loader trap whole, anything else
+ *	is played back in real time as a series of pulses for the EAR input.
+ *
+ *	Only the TZX blocks that describe a signal we can generate are kept.
+ *	Informational blocks are skipped, and blocks we don't understand end
+ *	the tape.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "zxtape.h"
+
+/* Block types we keep. These are the TZX IDs */
+#define BLK_STANDARD	0x10
+#define BLK_TURBO	0x11
+#define BLK_TONE	0x12
+#define BLK_PULSES	0x13
+#define BLK_DATA	0x14
+#define BLK_PAUSE	0x20
+
+struct zxtape_block {
+	uint8_t type;
+	const uint8_t *data;
+	unsigned len;		/* Bytes, or pulses for BLK_PULSES */
+	unsigned pilot;
+	unsigned pilot_pulses;
+	unsigned sync1;
+	unsigned sync2;
+	unsigned zero;
+	unsigned one;
+	unsigned lastbits;
+	unsigned pause;		/* ms */
+};
+
+/* Playback phases */
+#define PH_START	0
+#define PH_PILOT	1
+#define PH_SYNC2	2
+#define PH_DATA		3
+#define PH_PULSES	4
+#define PH_PAUSE	5
+
+/* T states per ms at 3.5MHz */
+#define TSTATES_MS	3500
+
+struct zxtape {
+	uint8_t *image;
+	struct zxtape_block *block;
+	unsigned nblocks;
+	unsigned cur;		/* Next block to play or trap */
+
+	/* Playback state */
+	unsigned playing;
+	unsigned phase;
+	unsigned count;
+	unsigned pos;
+	uint8_t mask;
+	uint8_t half;
+	uint8_t level;
+	uint64_t next_edge;
+
+	int trace;
+};
+
+static unsigned get16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned get24(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+static struct zxtape_block *zxtape_add(struct zxtape *tape, uint8_t type)
+{
+	struct zxtape_block *b;
+
+	tape->block = realloc(tape->block, (tape->nblocks + 1) * sizeof(struct zxtape_block));
+	if (tape->block == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+	b = tape->block + tape->nblocks++;
+	memset(b, 0, sizeof(struct zxtape_block));
+	b->type = type;
+	return b;
+}
+
+/* A standard ROM speed block. The pilot is longer for headers */
+static void zxtape_standard(struct zxtape *tape, const uint8_t *data, unsigned len, unsigned pause)
+{
+	struct zxtape_block *b = zxtape_add(tape, BLK_STANDARD);
+	b->data = data;
+	b->len = len;
+	b->pilot = 2168;
+	b->pilot_pulses = (len && data[0] < 0x80) ? 8063 : 3223;
+	b->sync1 = 667;
+	b->sync2 = 735;
+	b->zero = 855;
+	b->one = 1710;
+	b->lastbits = 8;
+	b->pause = pause;
+}
+
+static int zxtape_parse_tap(struct zxtape *tape, const uint8_t *p, unsigned size)
+{
+	const uint8_t *end = p + size;
+	unsigned len;
+
+	while (end - p >= 2) {
+		len = get16(p);
+		p += 2;
+		if (len > end - p) {
+			fprintf(stderr, "zxtape: truncated block.\n");
+			return -1;
+		}
+		zxtape_standard(tape, p, len, 1000);
+		p += len;
+	}
+	return 0;
+}
+
+/* Size of the fixed part of each TZX block we know about */
+static int zxtape_hdrlen(uint8_t id)
+{
+	switch(id) {
+	case BLK_STANDARD:
+		return 4;
+	case BLK_TURBO:
+		return 18;
+	case BLK_TONE:
+		return 4;
+	case BLK_PULSES:
+	case 0x21:
+	case 0x30:
+	case 0x33:
+		return 1;
+	case BLK_DATA:
+		return 10;
+	case BLK_PAUSE:
+	case 0x24:
+	case 0x31:
+	case 0x32:
+		return 2;
+	case 0x2A:
+		return 4;
+	case 0x15:
+		return 8;
+	case 0x18:
+	case 0x19:
+		return 4;
+	case 0x35:
+		return 20;
+	case 0x5A:
+		return 9;
+	}
+	return 0;
+}
+
+static int zxtape_parse_tzx(struct zxtape *tape, const uint8_t *p, unsigned size)
+{
+	const uint8_t *end = p + size;
+	struct zxtape_block *b;
+	unsigned len;
+	uint8_t id;
+
+	p += 10;
+	while (p < end) {
+		id = *p++;
+		if (end - p < zxtape_hdrlen(id))
+			goto truncated;
+		switch(id) {
+		case BLK_STANDARD:
+			len = get16(p + 2);
+			if (len > end - p - 4)
+				goto truncated;
+			zxtape_standard(tape, p + 4, len, get16(p));
+			p += 4 + len;
+			break;
+		case BLK_TURBO:
+			len = get24(p + 15);
+			if (len > end - p - 18)
+				goto truncated;
+			b = zxtape_add(tape, BLK_TURBO);
+			b->pilot = get16(p);
+			b->sync1 = get16(p + 2);
+			b->sync2 = get16(p + 4);
+			b->zero = get16(p + 6);
+			b->one = get16(p + 8);
+			b->pilot_pulses = get16(p + 10);
+			b->lastbits = p[12];
+			b->pause = get16(p + 13);
+			b->data = p + 18;
+			b->len = len;
+			p += 18 + len;
+			break;
+		case BLK_TONE:
+			b = zxtape_add(tape, BLK_TONE);
+			b->pilot = get16(p);
+			b->pilot_pulses = get16(p + 2);
+			p += 4;
+			break;
+		case BLK_PULSES:
+			len = *p;
+			if (2 * len > end - p - 1)
+				goto truncated;
+			b = zxtape_add(tape, BLK_PULSES);
+			b->data = p + 1;
+			b->len = len;
+			p += 1 + 2 * len;
+			break;
+		case BLK_DATA:
+			len = get24(p + 7);
+			if (len > end - p - 10)
+				goto truncated;
+			b = zxtape_add(tape, BLK_DATA);
+			b->zero = get16(p);
+			b->one = get16(p + 2);
+			b->lastbits = p[4];
+			b->pause = get16(p + 5);
+			b->data = p + 10;
+			b->len = len;
+			p += 10 + len;
+			break;
+		case BLK_PAUSE:
+			b = zxtape_add(tape, BLK_PAUSE);
+			b->pause = get16(p);
+			p += 2;
+			break;
+		/* Things we can skip */
+		case 0x21:	/* Group start */
+		case 0x30:	/* Text */
+			p += 1 + *p;
+			break;
+		case 0x22:	/* Group end */
+		case 0x25:	/* Loop end */
+			break;
+		case 0x24:	/* Loop start - we just play once */
+			p += 2;
+			break;
+		case 0x2A:	/* Stop the tape if 48K */
+			p += 4;
+			break;
+		case 0x31:	/* Message */
+			p += 2 + p[1];
+			break;
+		case 0x32:	/* Archive info */
+			p += 2 + get16(p);
+			break;
+		case 0x33:	/* Hardware type */
+			p += 1 + 3 * *p;
+			break;
+		case 0x35:	/* Custom info */
+			p += 20 + (get16(p + 16) | (get16(p + 18) << 16));
+			break;
+		case 0x5A:	/* Glued files */
+			p += 9;
+			break;
+		/* Things we can't play but can step over */
+		case 0x15:	/* Direct recording */
+			fprintf(stderr, "zxtape: skipping direct recording block.\n");
+			p += 8 + get24(p + 5);
+			break;
+		case 0x18:	/* CSW */
+		case 0x19:	/* Generalized data */
+			fprintf(stderr, "zxtape: skipping unsupported block %02X.\n", id);
+			p += 4 + (get16(p) | (get16(p + 2) << 16));
+			break;
+		default:
+			fprintf(stderr, "zxtape: unknown block %02X, tape ends here.\n", id);
+			return 0;
+		}
+	}
+	return 0;
+truncated:
+	fprintf(stderr, "zxtape: truncated block %02X.\n", id);
+	return -1;
+}
+
+struct zxtape *zxtape_create(const char *path)
+{
+	struct zxtape *tape;
+	struct stat st;
+	int fd;
+	int r;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		perror(path);
+		return NULL;
+	}
+	if (fstat(fd, &st) == -1) {
+		perror(path);
+		close(fd);
+		return NULL;
+	}
+	tape = malloc(sizeof(struct zxtape));
+	if (tape == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+	memset(tape, 0, sizeof(struct zxtape));
+	tape->image = malloc(st.st_size + 1);
+	if (tape->image == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+	if (read(fd, tape->image, st.st_size) != st.st_size) {
+		perror(path);
+		close(fd);
+		zxtape_free(tape);
+		return NULL;
+	}
+	close(fd);
+
+	if (st.st_size >= 10 && memcmp(tape->image, "ZXTape!\x1A", 8) == 0)
+		r = zxtape_parse_tzx(tape, tape->image, st.st_size);
+	else
+		r = zxtape_parse_tap(tape, tape->image, st.st_size);
+	if (r < 0) {
+		zxtape_free(tape);
+		return NULL;
+	}
+	return tape;
+}
+
+void zxtape_free(struct zxtape *tape)
+{
+	free(tape->block);
+	free(tape->image);
+	free(tape);
+}
+
+void zxtape_trace(struct zxtape *tape, int onoff)
+{
+	tape->trace = onoff;
+}
+
+/* Skip pauses, they mean nothing to a trap */
+static struct zxtape_block *zxtape_rom_next(struct zxtape *tape)
+{
+	while (tape->cur < tape->nblocks && tape->block[tape->cur].type == BLK_PAUSE)
+		tape->cur++;
+	if (tape->cur == tape->nblocks)
+		return NULL;
+	return tape->block + tape->cur;
+}
+
+/*
+ *	True if the next thing on the tape is a block the ROM loader could
+ *	read and we are not busy playing the tape.
+ */
+int zxtape_rom_ready(struct zxtape *tape)
+{
+	struct zxtape_block *b;
+
+	if (tape->playing)
+		return 0;
+	b = zxtape_rom_next(tape);
+	return b && b->type == BLK_STANDARD;
+}
+
+/*
+ *	Take the next standard block off the tape. The data is the flag
+ *	byte, the payload and the checksum as the ROM would see them.
+ */
+const uint8_t *zxtape_rom_block(struct zxtape *tape, unsigned *len)
+{
+	struct zxtape_block *b;
+
+	if (!zxtape_rom_ready(tape))
+		return NULL;
+	b = tape->block + tape->cur++;
+	if (tape->trace)
+		fprintf(stderr, "[zxtape: block %u trapped, %u bytes]\n", tape->cur - 1, b->len);
+	*len = b->len;
+	return b->data;
+}
+
+/*
+ *	Work out the next pulse length. Returns 0 when the tape has run
+ *	out or hit a stop.
+ */
+static unsigned zxtape_pulse(struct zxtape *tape)
+{
+	struct zxtape_block *b;
+	unsigned bits;
+
+	while (tape->cur < tape->nblocks) {
+		b = tape->block + tape->cur;
+		switch(tape->phase) {
+		case PH_START:
+			tape->count = b->pilot_pulses;
+			tape->pos = 0;
+			tape->mask = 0x80;
+			tape->half = 0;
+			if (b->type == BLK_PULSES)
+				tape->phase = PH_PULSES;
+			else if (b->type == BLK_DATA)
+				tape->phase = PH_DATA;
+			else if (b->type == BLK_PAUSE) {
+				/* A zero pause is a stop the tape */
+				if (b->pause == 0) {
+					tape->cur++;
+					return 0;
+				}
+				tape->phase = PH_PAUSE;
+			} else
+				tape->phase = PH_PILOT;
+			if (tape->trace)
+				fprintf(stderr, "[zxtape: playing block %u type %02X]\n", tape->cur, b->type);
+			break;
+		case PH_PILOT:
+			if (tape->count) {
+				tape->count--;
+				return b->pilot;
+			}
+			if (b->type == BLK_TONE) {
+				tape->phase = PH_PAUSE;
+				break;
+			}
+			tape->phase = PH_SYNC2;
+			return b->sync1;
+		case PH_SYNC2:
+			tape->phase = PH_DATA;
+			return b->sync2;
+		case PH_DATA:
+			if (tape->pos >= b->len) {
+				tape->phase = PH_PAUSE;
+				break;
+			}
+			/* Each bit is two equal pulses */
+			bits = b->data[tape->pos] & tape->mask;
+			if (tape->half) {
+				tape->half = 0;
+				tape->mask >>= 1;
+				/* The last byte may be short */
+				if (tape->mask == 0 || (tape->pos == b->len - 1 &&
+					tape->mask == (0x80 >> b->lastbits))) {
+					tape->mask = 0x80;
+					tape->pos++;
+				}
+			} else
+				tape->half = 1;
+			return bits ? b->one : b->zero;
+		case PH_PULSES:
+			if (tape->pos < b->len)
+				return get16(b->data + 2 * tape->pos++);
+			tape->phase = PH_PAUSE;
+			break;
+		case PH_PAUSE:
+			tape->phase = PH_START;
+			tape->cur++;
+			if (b->pause)
+				return b->pause * TSTATES_MS;
+			break;
+		}
+	}
+	return 0;
+}
+
+void zxtape_play(struct zxtape *tape, uint64_t now)
+{
+	unsigned n;
+
+	if (tape->playing)
+		return;
+	tape->phase = PH_START;
+	n = zxtape_pulse(tape);
+	if (n == 0)
+		return;
+	tape->playing = 1;
+	tape->next_edge = now + n;
+}
+
+int zxtape_playing(struct zxtape *tape)
+{
+	return tape->playing;
+}
+
+/*
+ *	Report the EAR level at the given time, running the tape forward
+ *	to that point.
+ */
+unsigned zxtape_ear(struct zxtape *tape, uint64_t now)
+{
+	unsigned n;
+
+	while (tape->playing && now >= tape->next_edge) {
+		tape->level ^= 1;
+		n = zxtape_pulse(tape);
+		if (n == 0) {
+			tape->playing = 0;
+			if (tape->trace)
+				fprintf(stderr, "[zxtape: stopped]\n");
+			break;
+		}
+		tape->next_edge += n;
+	}
+	return tape->level;
+}
@@ -0,0 +1,14 @@
+struct zxtape;
+
+extern struct zxtape *zxtape_create(const char *path);
+extern void zxtape_free(struct zxtape *tape);
+extern void zxtape_trace(struct zxtape *tape, int onoff);
+
+/* Block level access for ROM loader traps */
+extern int zxtape_rom_ready(struct zxtape *tape);
+extern const uint8_t *zxtape_rom_block(struct zxtape *tape, unsigned *len);
+
+/* Real time playback. Times are in T states */
+extern void zxtape_play(struct zxtape *tape, uint64_t now);
+extern int zxtape_playing(struct zxtape *tape);
+extern unsigned zxtape_ear(struct zxtape *tape, uint64_t now);